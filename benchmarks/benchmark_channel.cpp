@@ -0,0 +1,51 @@
+//
+// Created by cycastic on 8/14/2023.
+//
+
+#include <benchmark/benchmark.h>
+#include <thread>
+#include "../core/types/lock_free_queue.h"
+
+template <class Queue>
+static void transfer(benchmark::State& state, Queue& p_queue) {
+    const auto message_count = state.range(0);
+    for (auto _ : state) {
+        std::thread producer([&p_queue, message_count](){
+            for (int64_t i = 0; i < message_count; i++){
+                while (!p_queue.try_enqueue(i)) std::this_thread::yield();
+            }
+        });
+        int64_t received = 0, v{};
+        while (received < message_count){
+            if (p_queue.try_dequeue(v)) received++;
+            else std::this_thread::yield();
+        }
+        producer.join();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * message_count);
+}
+
+static void BM_BoundedMPMCQueue(benchmark::State& state) {
+    BoundedMPMCQueue<int64_t> queue(1024);
+    transfer(state, queue);
+}
+
+static void BM_BoundedSPSCQueue(benchmark::State& state) {
+    BoundedSPSCQueue<int64_t> queue(1024);
+    transfer(state, queue);
+}
+
+static void BM_UnboundedMPMCQueue(benchmark::State& state) {
+    UnboundedMPMCQueue<int64_t> queue{};
+    transfer(state, queue);
+}
+
+static void BM_UnboundedSPSCQueue(benchmark::State& state) {
+    UnboundedSPSCQueue<int64_t> queue{};
+    transfer(state, queue);
+}
+
+BENCHMARK(BM_BoundedMPMCQueue)->Arg(1'000'000)->UseRealTime();
+BENCHMARK(BM_BoundedSPSCQueue)->Arg(1'000'000)->UseRealTime();
+BENCHMARK(BM_UnboundedMPMCQueue)->Arg(1'000'000)->UseRealTime();
+BENCHMARK(BM_UnboundedSPSCQueue)->Arg(1'000'000)->UseRealTime();
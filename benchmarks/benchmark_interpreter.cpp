@@ -0,0 +1,83 @@
+//
+// Created by cycastic on 8/17/2023.
+//
+
+#include <benchmark/benchmark.h>
+#include <cwchar>
+#include "../runtime/config.h"
+#include "../runtime/runtime.h"
+#include "../runtime/interpreter.h"
+#include "../runtime/profiler.h"
+#include "../tests/bytecode_builder.h"
+
+// Runs p_method on the calling thread, bypassing the scheduler. Reports instructions per second
+static void interpret(benchmark::State& state, const wchar_t* p_method, void (*p_builder)(const Ref<NexusBytecode>&, const InternedString&),
+                      const uint32_t& p_jit_hotness_threshold = 0, const bool& p_register_form = true) {
+    InternedString::configure();
+    initialize_nexus_runtime(false);
+    nexus_settings->jit_hotness_threshold = p_jit_hotness_threshold;
+    // Interpreted loops must not move to compiled code halfway through
+    nexus_settings->jit_loop_threshold = 0;
+    nexus_settings->jit_background_compilation = false;
+    nexus_settings->interpreter_register_form = p_register_form;
+    {
+        NexusRuntime runtime{};
+        auto bytecode = Ref<NexusBytecode>::make_ref();
+        p_builder(bytecode, p_method);
+        auto file = to_virtual_file(bytecode);
+        runtime.load_bytecode(file, NexusBytecodeInstance::LOAD_ALL);
+        auto method_pointer = runtime.get_method(p_method);
+        uint64_t instructions = 0;
+        for (auto _ : state) {
+            NexusExecutionState execution_state(method_pointer);
+            auto& frame = execution_state.thread_stack->push_stack_frame();
+            if (wcscmp(p_method, L"fib") == 0) frame->push(uint64_t(state.range(0)));
+            else frame->push(int64_t(state.range(0)));
+            Task::AsyncCallbackReturn result;
+            Ref<Task> child{};
+            NexusInterpreter::execute(&execution_state).unpack(result, child);
+            if (result != Task::EXITED_SAFELY) state.SkipWithError("Execution failed");
+            benchmark::DoNotOptimize(execution_state.thread_stack->get_last_frame()->top().data);
+            instructions += execution_state.instructions_executed;
+        }
+        state.SetItemsProcessed(int64_t(instructions));
+    }
+    destroy_nexus_runtime();
+    InternedString::cleanup();
+}
+
+static void BM_InterpreterLoop(benchmark::State& state) {
+    interpret(state, L"sum", add_sum_method);
+}
+
+static void BM_InterpreterRecursion(benchmark::State& state) {
+    interpret(state, L"fib", add_fib_method);
+}
+
+static void BM_InterpreterPolynomial(benchmark::State& state) {
+    interpret(state, L"poly", add_polynomial_method);
+}
+
+// Same method without the register form, compare with BM_InterpreterPolynomial
+static void BM_InterpreterPolynomialStackForm(benchmark::State& state) {
+    interpret(state, L"poly", add_polynomial_method, 0, false);
+}
+
+static void BM_JITLoop(benchmark::State& state) {
+    interpret(state, L"sum", add_sum_method, 1);
+}
+
+// Same loop while sampled at the default rate, compare with BM_InterpreterLoop. Sampling is
+// budgeted at under 2% of it in a release build
+static void BM_InterpreterLoopProfiled(benchmark::State& state) {
+    NexusProfiler profiler{};
+    interpret(state, L"sum", add_sum_method);
+    state.counters["samples"] = double(profiler.get_sample_count());
+}
+
+BENCHMARK(BM_InterpreterLoop)->Arg(100000);
+BENCHMARK(BM_InterpreterRecursion)->Arg(20);
+BENCHMARK(BM_InterpreterPolynomial)->Arg(100000);
+BENCHMARK(BM_InterpreterPolynomialStackForm)->Arg(100000);
+BENCHMARK(BM_JITLoop)->Arg(100000);
+BENCHMARK(BM_InterpreterLoopProfiled)->Arg(100000);
@@ -0,0 +1,30 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <benchmark/benchmark.h>
+#include "../core/types/object.h"
+
+static constexpr int64_t COPIES = 1024;
+
+class PlainObject : public ThreadSafeObject {};
+class BiasedPlainObject : public BiasedObject {};
+
+// Copies and releases references on the creating thread, as stack pushes and pops do
+template <class T>
+static void copy_references(benchmark::State& state) {
+    auto object = Ref<T>::make_ref();
+    for (auto _ : state) {
+        for (int64_t i = 0; i < COPIES; i++) {
+            Ref<T> copy = object;
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * COPIES);
+}
+
+static void BM_ThreadSafeObjectCopy(benchmark::State& state) { copy_references<PlainObject>(state); }
+static void BM_BiasedObjectCopy(benchmark::State& state) { copy_references<BiasedPlainObject>(state); }
+
+BENCHMARK(BM_ThreadSafeObjectCopy);
+BENCHMARK(BM_BiasedObjectCopy);
@@ -0,0 +1,35 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <benchmark/benchmark.h>
+#include "../runtime/typed_array.h"
+
+static constexpr size_t ELEMENTS = 1 << 16;
+static const char* LEVEL_NAMES[] = { "scalar", "sse2", "avx2", "avx512" };
+
+// Arguments: NexusSimd::Level, clamped to what the machine supports
+template <NexusStandardType Type>
+static void multiply_add_sum(benchmark::State& state) {
+    auto previous = NexusSimd::get_level();
+    NexusSimd::set_level(NexusSimd::Level(state.range(0)));
+    auto lhs = Ref<NexusTypedArray>::make_ref(Type, ELEMENTS);
+    auto rhs = Ref<NexusTypedArray>::make_ref(Type, ELEMENTS);
+    auto dst = Ref<NexusTypedArray>::make_ref(Type, ELEMENTS);
+    lhs->fill(3);
+    rhs->fill(2);
+    for (auto _ : state) {
+        dst->apply(NexusSimd::BINARY_MULTIPLY, *lhs.ptr(), *rhs.ptr());
+        dst->apply(NexusSimd::BINARY_ADD, *dst.ptr(), 1);
+        benchmark::DoNotOptimize(dst->reduce<double>(NexusSimd::REDUCE_SUM));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * ELEMENTS);
+    state.SetLabel(LEVEL_NAMES[NexusSimd::get_level()]);
+    NexusSimd::set_level(previous);
+}
+
+static void BM_TypedArrayF32(benchmark::State& state) { multiply_add_sum<SINGLE_PRECISION_FLOATING_POINT>(state); }
+static void BM_TypedArrayI64(benchmark::State& state) { multiply_add_sum<SIGNED_64_BIT_INTEGER>(state); }
+
+BENCHMARK(BM_TypedArrayF32)->DenseRange(NexusSimd::LEVEL_SCALAR, NexusSimd::LEVEL_AVX512);
+BENCHMARK(BM_TypedArrayI64)->DenseRange(NexusSimd::LEVEL_SCALAR, NexusSimd::LEVEL_AVX512);
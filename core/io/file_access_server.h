@@ -51,10 +51,14 @@ public:
         return re;
     }
     static bool exists(const VString& p_file_path){
-        auto file_ptr = open(p_file_path, FileAccess::ACCESS_READ, false);
-        auto file_exists = file_ptr->is_open();
-        file_ptr->close();
-        return file_exists;
+        try {
+            auto file_ptr = open(p_file_path, FileAccess::ACCESS_READ, false);
+            auto file_exists = file_ptr->is_open();
+            file_ptr->close();
+            return file_exists;
+        } catch (const FileCannotBeOpenedException&) {
+            return false;
+        }
     }
 };
 
@@ -45,7 +45,7 @@ public:
         auto current_capacity = data.capacity();
         auto end_region = position + p_bytes_count;
         if (end_region > current_capacity) data.resize(end_region);
-        memcpy(data.ptrw(), p_buffer, p_bytes_count);
+        memcpy(data.ptrw() + position, p_buffer, p_bytes_count);
         position += p_bytes_count;
     }
 public:
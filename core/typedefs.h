@@ -64,6 +64,11 @@ inline void __swap_tmpl(T &x, T &y) {
 #define unlikely(x) x
 #endif
 
+// Alignment that keeps independently written data off each other's cache lines
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 64
+#endif
+
 #define GUARD(lock_by_reference) LockGuard __guard(lock_by_reference)
 #define R_GUARD(lock_by_reference) ReadLockGuard __r_guard(lock_by_reference)
 #define W_GUARD(lock_by_reference) WriteLockGuard __w_guard(lock_by_reference)
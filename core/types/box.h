@@ -53,6 +53,8 @@ public:
     }
     _NO_DISCARD_ _FORCE_INLINE_ bool is_null() const { return inner_ptr.is_null(); }
     _NO_DISCARD_ _FORCE_INLINE_ bool is_valid() const { return inner_ptr.is_valid(); }
+    // No other Box shares the data
+    _NO_DISCARD_ _FORCE_INLINE_ bool is_unique() const { return inner_ptr.is_valid() && inner_ptr->get_reference_count() == 1; }
     _FORCE_INLINE_ void clear_reference() { inner_ptr = Ref<Box<T, RefCounter>::InnerPointer>::null(); }
     _FORCE_INLINE_ Box& operator=(const Box& p_other) {
         inner_ptr = p_other.inner_ptr;
@@ -179,7 +179,7 @@ public:
             return *iterating;
         }
     };
-    _NO_DISCARD_ _ALWAYS_INLINE_ uint16_t capacity() const { return cap; }
+    _NO_DISCARD_ _ALWAYS_INLINE_ size_t capacity() const { return cap; }
     _NO_DISCARD_ _FORCE_INLINE_ size_t size() const { return entries_count; }
     _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return size() == 0; }
     _NO_DISCARD_ _ALWAYS_INLINE_ ConstIterator const_iterator() const { return ConstIterator(this); }
@@ -262,7 +262,7 @@ public:
     _NO_DISCARD_ _FORCE_INLINE_ bool empty() const {
         return !is_initialized() || size() == 0;
     }
-    _NO_DISCARD_ _ALWAYS_INLINE_ uint16_t capacity() const {
+    _NO_DISCARD_ _ALWAYS_INLINE_ size_t capacity() const {
         if (!is_initialized()) return 0;
         return current_map->capacity();
     }
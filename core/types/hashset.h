@@ -42,7 +42,7 @@ public:
         return Hasher::hash(p_value) % cap;
     }
 private:
-    Cell* try_get(const T& p_value){
+    Cell* try_get(const T& p_value) const {
         auto idx = get_index(p_value);
         auto entry = entries[idx];
         if (!entry) {
@@ -166,7 +166,7 @@ public:
         }
     };
 
-    _NO_DISCARD_ _ALWAYS_INLINE_ uint16_t capacity() const { return cap; }
+    _NO_DISCARD_ _ALWAYS_INLINE_ size_t capacity() const { return cap; }
     _NO_DISCARD_ _FORCE_INLINE_ size_t size() const { return entries_count; }
     _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return size() == 0; }
     _NO_DISCARD_ _ALWAYS_INLINE_ ConstIterator const_iterator() const { return ConstIterator(this); }
@@ -241,7 +241,7 @@ public:
     _NO_DISCARD_ _FORCE_INLINE_ bool empty() const {
         return !is_initialized() || size() == 0;
     }
-    _NO_DISCARD_ _ALWAYS_INLINE_ uint16_t capacity() const {
+    _NO_DISCARD_ _ALWAYS_INLINE_ size_t capacity() const {
         if (!is_initialized()) return 0;
         return current_set->capacity();
     }
@@ -0,0 +1,362 @@
+//
+// Created by cycastic on 8/14/2023.
+//
+
+#ifndef NEXUS_LOCK_FREE_QUEUE_H
+#define NEXUS_LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include "../typedefs.h"
+
+// Uninitialized storage for a single value, constructed and destroyed explicitly
+template <typename T>
+struct LockFreeQueueCell {
+    alignas(T) uint8_t storage[sizeof(T)];
+
+    _FORCE_INLINE_ T* ptr() { return reinterpret_cast<T*>(&storage[0]); }
+    _FORCE_INLINE_ void put(const T& p_value) { new (ptr()) T(p_value); }
+    _FORCE_INLINE_ void take(T& p_value) {
+        p_value = *ptr();
+        ptr()->~T();
+    }
+};
+
+static _FORCE_INLINE_ size_t lock_free_queue_round_capacity(const size_t& p_capacity){
+    if (p_capacity < 2) throw std::invalid_argument("Capacity must be at least 2");
+    size_t re = 1;
+    while (re < p_capacity) re <<= 1;
+    return re;
+}
+
+// Dmitry Vyukov's bounded MPMC queue: every cell carries a sequence number,
+// so producers and consumers only contend on their own index
+template <typename T>
+class BoundedMPMCQueue {
+    struct Cell {
+        std::atomic<size_t> sequence;
+        LockFreeQueueCell<T> data;
+    };
+    Cell* const buffer;
+    const size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos{0};
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ size_t capacity() const { return mask + 1; }
+    // Approximation, only exact when the queue is quiescent
+    _NO_DISCARD_ _FORCE_INLINE_ size_t size() const {
+        auto head = dequeue_pos.load(std::memory_order_relaxed);
+        auto tail = enqueue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return size() == 0; }
+
+    bool try_enqueue(const T& p_value){
+        Cell* cell;
+        auto pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &buffer[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) return false;
+            else pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+        cell->data.put(p_value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_dequeue(T& p_value){
+        Cell* cell;
+        auto pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &buffer[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) return false;
+            else pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+        cell->data.take(p_value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // p_capacity is rounded up to a power of two
+    explicit BoundedMPMCQueue(const size_t& p_capacity)
+            : buffer(new Cell[lock_free_queue_round_capacity(p_capacity)]),
+              mask(lock_free_queue_round_capacity(p_capacity) - 1) {
+        for (size_t i = 0; i <= mask; i++) buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    BoundedMPMCQueue(const BoundedMPMCQueue&) = delete;
+    ~BoundedMPMCQueue(){
+        T discard;
+        while (try_dequeue(discard)) {}
+        delete[] buffer;
+    }
+};
+
+// Lamport ring with cached indices. Exactly one producer thread and one consumer thread
+template <typename T>
+class BoundedSPSCQueue {
+    LockFreeQueueCell<T>* const buffer;
+    const size_t mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0};
+    // Consumer's last observation of tail
+    size_t cached_tail{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};
+    // Producer's last observation of head
+    size_t cached_head{0};
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ size_t capacity() const { return mask + 1; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return size() == 0; }
+
+    bool try_enqueue(const T& p_value){
+        auto pos = tail.load(std::memory_order_relaxed);
+        if (pos - cached_head > mask) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (pos - cached_head > mask) return false;
+        }
+        buffer[pos & mask].put(p_value);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_dequeue(T& p_value){
+        auto pos = head.load(std::memory_order_relaxed);
+        if (pos == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (pos == cached_tail) return false;
+        }
+        buffer[pos & mask].take(p_value);
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    explicit BoundedSPSCQueue(const size_t& p_capacity)
+            : buffer(new LockFreeQueueCell<T>[lock_free_queue_round_capacity(p_capacity)]),
+              mask(lock_free_queue_round_capacity(p_capacity) - 1) {}
+    BoundedSPSCQueue(const BoundedSPSCQueue&) = delete;
+    ~BoundedSPSCQueue(){
+        T discard;
+        while (try_dequeue(discard)) {}
+        delete[] buffer;
+    }
+};
+
+// Linked chain of fixed size segments. The producer only touches the tail segment
+// and the consumer only the head one, so drained segments can be freed by the consumer
+template <typename T, size_t SegmentSize = 256>
+class UnboundedSPSCQueue {
+    struct Segment {
+        LockFreeQueueCell<T> cells[SegmentSize];
+        std::atomic<size_t> written{0};
+        std::atomic<Segment*> next{nullptr};
+        // Consumer only
+        size_t read{0};
+    };
+    alignas(CACHE_LINE_SIZE) Segment* head;
+    alignas(CACHE_LINE_SIZE) Segment* tail;
+public:
+    void enqueue(const T& p_value){
+        auto pos = tail->written.load(std::memory_order_relaxed);
+        if (pos == SegmentSize){
+            auto segment = new Segment();
+            tail->next.store(segment, std::memory_order_release);
+            tail = segment;
+            pos = 0;
+        }
+        tail->cells[pos].put(p_value);
+        tail->written.store(pos + 1, std::memory_order_release);
+    }
+    _FORCE_INLINE_ bool try_enqueue(const T& p_value){
+        enqueue(p_value);
+        return true;
+    }
+    bool try_dequeue(T& p_value){
+        for (;;) {
+            if (head->read < head->written.load(std::memory_order_acquire)) {
+                head->cells[head->read++].take(p_value);
+                return true;
+            }
+            if (head->read < SegmentSize) return false;
+            auto next = head->next.load(std::memory_order_acquire);
+            if (!next) return false;
+            delete head;
+            head = next;
+        }
+    }
+    // Consumer side only
+    _NO_DISCARD_ bool empty() const {
+        auto segment = head;
+        while (segment) {
+            if (segment->read < segment->written.load(std::memory_order_acquire)) return false;
+            segment = segment->next.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    UnboundedSPSCQueue() : head(new Segment()), tail(head) {}
+    UnboundedSPSCQueue(const UnboundedSPSCQueue&) = delete;
+    ~UnboundedSPSCQueue(){
+        T discard;
+        while (try_dequeue(discard)) {}
+        delete head;
+    }
+};
+
+// Chain of single-use segments: every cell is written and read exactly once,
+// producers and consumers claim cells with fetch_add.
+// Segments unlinked by consumers are retired and only freed once no
+// operation is in flight, see reclaim()
+template <typename T, size_t SegmentSize = 256>
+class UnboundedMPMCQueue {
+    enum CellState : uint8_t {
+        CELL_EMPTY,
+        CELL_WRITTEN,
+    };
+    struct Cell {
+        std::atomic<uint8_t> state{CELL_EMPTY};
+        LockFreeQueueCell<T> data;
+    };
+    struct Segment {
+        Cell cells[SegmentSize];
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos{0};
+        std::atomic<Segment*> next{nullptr};
+        Segment* next_retired{};
+    };
+    alignas(CACHE_LINE_SIZE) std::atomic<Segment*> head;
+    alignas(CACHE_LINE_SIZE) std::atomic<Segment*> tail;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> active_operations{0};
+    std::atomic<Segment*> retired{nullptr};
+
+    struct OperationGuard {
+        UnboundedMPMCQueue* queue;
+        explicit OperationGuard(UnboundedMPMCQueue* p_queue) : queue(p_queue) {
+            queue->active_operations.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~OperationGuard() {
+            if (queue->active_operations.fetch_sub(1, std::memory_order_seq_cst) == 1) queue->reclaim();
+        }
+    };
+
+    void push_retired(Segment* p_first, Segment* p_last){
+        auto top = retired.load(std::memory_order_relaxed);
+        do {
+            p_last->next_retired = top;
+        } while (!retired.compare_exchange_weak(top, p_first, std::memory_order_release, std::memory_order_relaxed));
+    }
+    // Segments are retired only after both head and tail moved past them,
+    // so operations that start afterward can not reach them. If nothing is in flight
+    // after the list was detached, every operation that could hold one has finished
+    void reclaim(){
+        auto list = retired.exchange(nullptr, std::memory_order_acquire);
+        if (!list) return;
+        if (active_operations.load(std::memory_order_seq_cst) == 0) {
+            while (list) {
+                auto next = list->next_retired;
+                delete list;
+                list = next;
+            }
+            return;
+        }
+        auto last = list;
+        while (last->next_retired) last = last->next_retired;
+        push_retired(list, last);
+    }
+    void advance(std::atomic<Segment*>& p_end, Segment* p_from, Segment* p_to){
+        p_end.compare_exchange_strong(p_from, p_to, std::memory_order_acq_rel);
+    }
+public:
+    void enqueue(const T& p_value){
+        OperationGuard guard(this);
+        for (;;) {
+            auto segment = tail.load(std::memory_order_acquire);
+            auto pos = segment->enqueue_pos.fetch_add(1, std::memory_order_acq_rel);
+            if (pos < SegmentSize) {
+                auto& cell = segment->cells[pos];
+                cell.data.put(p_value);
+                cell.state.store(CELL_WRITTEN, std::memory_order_release);
+                return;
+            }
+            auto next = segment->next.load(std::memory_order_acquire);
+            if (next) {
+                advance(tail, segment, next);
+                continue;
+            }
+            // Publish a new segment with the value already in its first cell
+            auto new_segment = new Segment();
+            new_segment->cells[0].data.put(p_value);
+            new_segment->cells[0].state.store(CELL_WRITTEN, std::memory_order_relaxed);
+            new_segment->enqueue_pos.store(1, std::memory_order_relaxed);
+            Segment* expected = nullptr;
+            if (segment->next.compare_exchange_strong(expected, new_segment, std::memory_order_acq_rel)) {
+                advance(tail, segment, new_segment);
+                return;
+            }
+            new_segment->cells[0].data.ptr()->~T();
+            new_segment->cells[0].state.store(CELL_EMPTY, std::memory_order_relaxed);
+            delete new_segment;
+            advance(tail, segment, expected);
+        }
+    }
+    _FORCE_INLINE_ bool try_enqueue(const T& p_value){
+        enqueue(p_value);
+        return true;
+    }
+    bool try_dequeue(T& p_value){
+        OperationGuard guard(this);
+        for (;;) {
+            auto segment = head.load(std::memory_order_acquire);
+            auto pos = segment->dequeue_pos.load(std::memory_order_acquire);
+            if (pos >= SegmentSize) {
+                auto next = segment->next.load(std::memory_order_acquire);
+                if (!next) return false;
+                // Tail may lag behind, it must never point to a retired segment
+                advance(tail, segment, next);
+                auto expected = segment;
+                if (head.compare_exchange_strong(expected, next, std::memory_order_acq_rel))
+                    push_retired(segment, segment);
+                continue;
+            }
+            auto limit = segment->enqueue_pos.load(std::memory_order_acquire);
+            if (pos >= limit) return false;
+            if (!segment->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_acq_rel)) continue;
+            // The producer claimed this cell but may not have finished writing it
+            auto& cell = segment->cells[pos];
+            while (cell.state.load(std::memory_order_acquire) != CELL_WRITTEN) std::this_thread::yield();
+            cell.data.take(p_value);
+            return true;
+        }
+    }
+    _NO_DISCARD_ bool empty() const {
+        OperationGuard guard(const_cast<UnboundedMPMCQueue*>(this));
+        auto segment = head.load(std::memory_order_acquire);
+        auto pos = segment->dequeue_pos.load(std::memory_order_acquire);
+        if (pos < SegmentSize) return pos >= segment->enqueue_pos.load(std::memory_order_acquire);
+        // Only an approximation while a segment switch is in flight
+        return segment->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    UnboundedMPMCQueue() {
+        auto segment = new Segment();
+        head.store(segment, std::memory_order_relaxed);
+        tail.store(segment, std::memory_order_relaxed);
+    }
+    UnboundedMPMCQueue(const UnboundedMPMCQueue&) = delete;
+    ~UnboundedMPMCQueue(){
+        T discard;
+        while (try_dequeue(discard)) {}
+        reclaim();
+        delete head.load(std::memory_order_relaxed);
+    }
+};
+
+#endif //NEXUS_LOCK_FREE_QUEUE_H
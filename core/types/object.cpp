@@ -5,12 +5,12 @@
 #include "object.h"
 
 HashMap<uint64_t, ManagedObject*> ObjectDB::objects_registry = HashMap<uint64_t, ManagedObject*>();
-SafeNumeric<uint64_t> ObjectDB::refcount = SafeNumeric<uint64_t>(0);
+IDRangeAllocator<uint64_t> ObjectDB::refcount{0};
 RWLock ObjectDB::lock = RWLock();
 
 void ObjectDB::register_object(ManagedObject *obj) {
+    obj->object_id = refcount.next();
     W_GUARD(lock);
-    obj->object_id = refcount.increment();
     objects_registry[obj->object_id] = obj;
 }
 
@@ -52,10 +52,131 @@ Vector<ManagedObject *> ObjectDB::get_all_instances() {
 }
 #endif
 
-ManagedObject::ManagedObject(){
+ManagedObject::ManagedObject(const bool& p_biasable) : BiasedObject(p_biasable) {
     ObjectDB::register_object(this);
 }
 
 ManagedObject::~ManagedObject() {
     ObjectDB::remove_object(this);
 }
+
+namespace {
+    struct BiasedObjectRegistry {
+        BinaryMutex lock{};
+        uint64_t next_token{};
+        // Threads still alive, by token
+        HashMap<uint64_t, void*> threads{};
+    };
+    // Leaked, threads may exit after static destructors ran
+    BiasedObjectRegistry& biased_object_registry() {
+        static auto* registry = new BiasedObjectRegistry();
+        return *registry;
+    }
+}
+
+void BiasedObject::register_thread() {
+    // Flushes what is left and retires the token, objects queued to it afterwards are merged by the releasing thread
+    struct ThreadExitGuard {
+        ~ThreadExitGuard() {
+            auto& registry = biased_object_registry();
+            Vector<const BiasedObject*> pending{};
+            {
+                GUARD(registry.lock);
+                registry.threads.erase(thread_token);
+                pending = thread_state->pending;
+            }
+            for (const auto* object : pending) {
+                if (object->merge_queued()) delete object;
+            }
+            delete thread_state;
+            thread_state = nullptr;
+        }
+    };
+    thread_local ThreadExitGuard exit_guard{};
+    auto& registry = biased_object_registry();
+    GUARD(registry.lock);
+    thread_token = ++registry.next_token;
+    thread_state = new ThreadState();
+    registry.threads[thread_token] = thread_state;
+}
+
+void BiasedObject::flush_pending() {
+    Vector<const BiasedObject*> pending{};
+    {
+        GUARD(biased_object_registry().lock);
+        pending = thread_state->pending;
+        thread_state->pending.clear();
+        thread_state->has_pending.store(false, std::memory_order_release);
+    }
+    for (const auto* object : pending) {
+        if (object->merge_queued()) delete object;
+    }
+}
+
+// Owner released its last biased reference
+bool BiasedObject::merge() const {
+    auto word = shared.fetch_add(MERGED, std::memory_order_acq_rel) + MERGED;
+    if (!(word & QUEUED)) return (word >> 2) == 0;
+    // The queue still points to this object, flush it now rather than keeping the object alive
+    // until the next flush. An object not pushed yet is left to that flush
+    if (thread_state) flush_pending();
+    return false;
+}
+
+// Folds the biased count in and takes the object off the queue. Called by the owner, or by
+// anyone once the owner exited
+bool BiasedObject::merge_queued() const {
+    auto count = biased.load(std::memory_order_relaxed);
+    biased.store(0, std::memory_order_relaxed);
+    // Objects the owner merged while queued only lose the flag
+    auto delta = int64_t(count) * ONE + (count ? MERGED : 0) - QUEUED;
+    auto word = shared.fetch_add(delta, std::memory_order_acq_rel) + delta;
+    return (word >> 2) == 0;
+}
+
+bool BiasedObject::ref_shared() const {
+    auto word = shared.load(std::memory_order_acquire);
+    while (true) {
+        // Unmerged objects are alive until merged, merged ones are only revived while counted
+        if ((word & MERGED) && (word >> 2) == 0) return false;
+        if (shared.compare_exchange_weak(word, word + ONE, std::memory_order_acq_rel, std::memory_order_acquire)) return true;
+    }
+}
+
+bool BiasedObject::unref_shared() const {
+    auto word = shared.fetch_sub(ONE, std::memory_order_acq_rel) - ONE;
+    if (word & MERGED) return !(word & QUEUED) && (word >> 2) == 0;
+    // The owner still holds biased references unless the shared count went negative
+    if ((word >> 2) >= 0 || (word & QUEUED)) return false;
+    auto previous = shared.fetch_or(QUEUED, std::memory_order_acq_rel);
+    if (previous & QUEUED) return false;
+    if (previous & MERGED) {
+        // The owner merged in between, the flag would keep the object alive forever
+        word = shared.fetch_and(~QUEUED, std::memory_order_acq_rel) & ~QUEUED;
+        return (word >> 2) == 0;
+    }
+    auto& registry = biased_object_registry();
+    GUARD(registry.lock);
+    void* state{};
+    // The owner is gone, it will never flush
+    if (!registry.threads.try_get(owner, state)) return merge_queued();
+    ((ThreadState*)state)->pending.push_back(this);
+    ((ThreadState*)state)->has_pending.store(true, std::memory_order_release);
+    return false;
+}
+
+void BiasedObject::init_ref() const {
+    if (!biasable) {
+        shared.store(ONE | MERGED, std::memory_order_relaxed);
+        return;
+    }
+    if (unlikely(!thread_token)) register_thread();
+    else flush_thread();
+    owner = thread_token;
+    biased.store(1, std::memory_order_relaxed);
+    shared.store(0, std::memory_order_relaxed);
+}
+
+uint32_t BiasedObject::get_reference_count() const {
+    return biased.load(std::memory_order_relaxed) + uint32_t(shared.load(std::memory_order_acquire) >> 2);
+}
@@ -6,6 +6,7 @@
 #define NEXUS_OBJECT_H
 
 #include "safe_refcount.h"
+#include "sharded_counter.h"
 #include "../lock.h"
 #include "vector.h"
 #include "hashmap.h"
@@ -49,22 +50,84 @@ public:
     ~ThreadUnsafeObject() override = default;
 };
 
+// Thread safe Object with biased reference counting: the creating thread counts without
+// atomics, other threads count on a shared atomic word. A release that takes the shared count
+// below zero queues the object to its owner, which merges both counts on its next flush.
+// Objects are only freed once merged, by whoever brings the merged count to zero.
+// So the last release of an object on another thread than its creator's does not free it: the
+// destructor runs on the owner's next flush, or when the owner exits. Every ManagedObject is
+// biased unless it passes false, types whose destructor must not wait (Task) opt out
+class BiasedObject : public BaseObject {
+private:
+    // Shared word: count << 2 | QUEUED | MERGED
+    static constexpr int64_t MERGED = 1;
+    static constexpr int64_t QUEUED = 2;
+    static constexpr int64_t ONE = 4;
+    static constexpr uint64_t NO_OWNER = UINT64_MAX;
+    struct ThreadState;
+
+    // Zero until the thread creates its first object, tokens are never reused
+    static inline thread_local uint64_t thread_token{};
+    static inline thread_local ThreadState* thread_state{};
+
+    const bool biasable;
+    mutable uint64_t owner{NO_OWNER};
+    // Written by the owner only. Zero once merged
+    mutable std::atomic<uint32_t> biased{};
+    mutable std::atomic<int64_t> shared{MERGED};
+
+    static void register_thread();
+    static void flush_pending();
+    bool merge() const;
+    bool merge_queued() const;
+    bool ref_shared() const;
+    bool unref_shared() const;
+public:
+    void init_ref() const final;
+    _ALWAYS_INLINE_ bool ref() const final {
+        auto count = biased.load(std::memory_order_relaxed);
+        if (likely(owner == thread_token && count)) {
+            biased.store(count + 1, std::memory_order_relaxed);
+            return true;
+        }
+        return ref_shared();
+    }
+    _ALWAYS_INLINE_ bool unref() const final {
+        auto count = biased.load(std::memory_order_relaxed);
+        if (likely(owner == thread_token && count)) {
+            biased.store(--count, std::memory_order_relaxed);
+            return !count && merge();
+        }
+        return unref_shared();
+    }
+    _NO_DISCARD_ uint32_t get_reference_count() const final;
+    // Merges the objects other threads queued to the calling thread. Thread pool workers flush
+    // between tasks and every thread flushes on exit, other long lived threads should call this
+    // now and then
+    static _ALWAYS_INLINE_ void flush_thread();
+
+    // Objects known to be shared across threads, such as tasks, pass false and are counted on the
+    // shared word only, so their last release frees them immediately
+    explicit BiasedObject(const bool& p_biasable = true) : biasable(p_biasable) {}
+    ~BiasedObject() override = default;
+};
+
 // Centralized, thread safe Object
-class ManagedObject : public ThreadSafeObject {
+class ManagedObject : public BiasedObject {
 private:
     uint64_t object_id{};
 
     friend class ObjectDB;
 public:
     uint64_t get_object_id() const { return object_id; }
-    ManagedObject();
+    explicit ManagedObject(const bool& p_biasable = true);
     ~ManagedObject() override;
 };
 
 class ObjectDB {
 private:
     static HashMap<uint64_t, ManagedObject*> objects_registry;
-    static SafeNumeric<uint64_t> refcount;
+    static IDRangeAllocator<uint64_t> refcount;
     static RWLock lock;
 
     friend class ManagedObject;
@@ -81,4 +144,14 @@ public:
 #endif
 };
 
+struct BiasedObject::ThreadState {
+    std::atomic<bool> has_pending{};
+    // Guarded by the registry lock
+    Vector<const BiasedObject*> pending{};
+};
+
+void BiasedObject::flush_thread() {
+    if (thread_state && thread_state->has_pending.load(std::memory_order_acquire)) flush_pending();
+}
+
 #endif //NEXUS_OBJECT_H
@@ -0,0 +1,98 @@
+//
+// Created by cycastic on 8/16/2023.
+//
+
+#ifndef NEXUS_SHARDED_COUNTER_H
+#define NEXUS_SHARDED_COUNTER_H
+
+#include <atomic>
+#include "../typedefs.h"
+
+// Slot of the calling thread, handed out round robin on first use.
+// Stands in for the CPU number, which is not portable and can change under our feet
+inline uint32_t sharded_counter_thread_slot() {
+    static std::atomic<uint32_t> next_slot{0};
+    thread_local const uint32_t slot = next_slot.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+// Counter split across cache line sized slots. Writers only touch their own slot,
+// get() sums every slot and is only exact while no one is writing
+template <typename T, uint32_t Shards = 16>
+class ShardedCounter {
+    static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<T> value{};
+    };
+    Slot slots[Shards];
+public:
+    _ALWAYS_INLINE_ void add(const T& p_value) {
+        slots[sharded_counter_thread_slot() & (Shards - 1)].value.fetch_add(p_value, std::memory_order_relaxed);
+    }
+    _ALWAYS_INLINE_ void sub(const T& p_value) {
+        slots[sharded_counter_thread_slot() & (Shards - 1)].value.fetch_sub(p_value, std::memory_order_relaxed);
+    }
+    _ALWAYS_INLINE_ void increment() { add(1); }
+    _ALWAYS_INLINE_ void decrement() { sub(1); }
+    _NO_DISCARD_ T get() const {
+        T re{};
+        for (const auto& slot : slots) re += slot.value.load(std::memory_order_relaxed);
+        return re;
+    }
+    // Not atomic with respect to concurrent writers
+    void set(const T& p_value) {
+        for (auto& slot : slots) slot.value.store(0, std::memory_order_relaxed);
+        slots[0].value.store(p_value, std::memory_order_release);
+    }
+
+    explicit ShardedCounter(const T& p_value = T{}) { set(p_value); }
+};
+
+// Unique id generator. Threads reserve blocks of BlockSize ids from a shared counter
+// and hand them out locally, so the shared cache line is touched once per block.
+// Ids are unique and greater than the starting value, but not monotonic across threads
+template <typename T, T BlockSize = 64>
+class IDRangeAllocator {
+    static constexpr uint32_t CACHE_WAYS = 16;
+    struct ThreadRange {
+        uint64_t serial{};
+        T next{};
+        T end{};
+    };
+    alignas(CACHE_LINE_SIZE) std::atomic<T> reserved;
+    std::atomic<uint64_t> serial{};
+
+    static uint64_t next_serial() {
+        static std::atomic<uint64_t> serial_allocator{0};
+        return serial_allocator.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    static ThreadRange& get_thread_range(const uint64_t& p_serial) {
+        // Direct mapped: allocators sharing a way evict each other's block, which only skips ids
+        thread_local ThreadRange ranges[CACHE_WAYS]{};
+        return ranges[p_serial % CACHE_WAYS];
+    }
+public:
+    _NO_DISCARD_ T next() {
+        auto current_serial = serial.load(std::memory_order_acquire);
+        auto& range = get_thread_range(current_serial);
+        if (unlikely(range.serial != current_serial || range.next == range.end)) {
+            auto begin = reserved.fetch_add(BlockSize, std::memory_order_relaxed);
+            range.serial = current_serial;
+            range.next = begin;
+            range.end = begin + BlockSize;
+        }
+        return ++range.next;
+    }
+    // Upper bound of every id handed out so far
+    _NO_DISCARD_ T get_reserved() const { return reserved.load(std::memory_order_relaxed); }
+    // Invalidates every thread's block. Must not race with next()
+    void reset(const T& p_value) {
+        reserved.store(p_value, std::memory_order_relaxed);
+        serial.store(next_serial(), std::memory_order_release);
+    }
+
+    explicit IDRangeAllocator(const T& p_value = T{}) { reset(p_value); }
+    IDRangeAllocator(const IDRangeAllocator&) = delete;
+};
+
+#endif //NEXUS_SHARDED_COUNTER_H
@@ -7,27 +7,22 @@
 #include "../runtime/nexus_stack.h"
 
 void NexusBytecode::load_header(const FilePointer &p_file) {
-#define COLLECT_CONSTANTS(collector, storage) {         \
-    auto size = p_file->get_32();                       \
-    for (size_t i = 0; i < size; i++){                  \
-        storage.push_back(p_file->collector());         \
-    }                                                   \
-}
     Ref<NexusBytecodeMetadata> bytecode_metadata = Ref<NexusBytecodeMetadata>::make_ref();
     bytecode_metadata->deserialize(p_file);
     if (bytecode_metadata->magic != MAGIC) throw BytecodeParseException("Incorrect magic sequence");
     if (bytecode_metadata->version != VERSION) throw BytecodeParseException("Version not supported");
     bytecode_metadata.unref();
+    constant_pool = Ref<NexusBytecodeConstantPool>::make_ref();
+    constant_pool->deserialize(p_file);
     auto method_count = p_file->get_32();
     methods_metadata = Vector<Ref<NexusBytecodeMethodMetadata>>(method_count);
     for (int i = 0; i < method_count; i++){
         methods_metadata.push_back(Ref<NexusBytecodeMethodMetadata>::make_ref());
-        methods_metadata[i]->deserialize(p_file);
+        methods_metadata[i]->deserialize(p_file, *constant_pool.ptr());
     }
     // Reserved space
     for (int i = 0; i < INSTRUCTIONS_RESERVED; i++)
         p_file->get_8();
-#undef COLLECT_CONSTANTS
 }
 
 void NexusBytecode::load_methods_body(const FilePointer &p_file) {
@@ -38,7 +33,7 @@ void NexusBytecode::load_methods_body(const FilePointer &p_file) {
     method_bodies = Vector<Ref<NexusBytecodeMethodBody>>(body_count);
     for (uint16_t i = 0; i < body_count; i++){
         Ref<NexusBytecodeMethodBody> body = Ref<NexusBytecodeMethodBody>::make_ref();
-        body->deserialize(p_file);
+        body->deserialize(p_file, *constant_pool.ptr());
         method_bodies.push_back(body);
     }
 }
@@ -49,13 +44,6 @@ void NexusBytecode::deserialize(const FilePointer& p_file) {
 }
 
 void NexusBytecode::serialize(FilePointer &p_file) const {
-#define STORE_CONSTANTS(dispenser, storage) {           \
-    auto size = storage.size();                         \
-    p_file->store_32(size);                             \
-    for (const auto& val : storage){                    \
-        p_file->dispenser(val);                         \
-    }                                                   \
-}
     // Cache
     HashMap<InternedString, uint64_t> method_metadata_offset_loc{};
     HashMap<InternedString, uint64_t> method_body_offset_loc{};
@@ -63,10 +51,23 @@ void NexusBytecode::serialize(FilePointer &p_file) const {
     Ref<NexusBytecodeMetadata> header = Ref<NexusBytecodeMetadata>::make_ref(MAGIC, VERSION);
     header->serialize(p_file);
     header.unref();
+    // Store constants, collected from every method
+    NexusBytecodeConstantPool pool{};
+    for (const auto& item : methods_metadata) pool.add_string(item->method_name);
+    for (const auto& body : method_bodies){
+        pool.add_string(body->method_name);
+        for (const auto& handler : body->exception_handlers){
+            pool.add_string(handler.try_begin);
+            pool.add_string(handler.try_end);
+            pool.add_string(handler.handler);
+        }
+        for (const auto& instruction : body->instructions) pool.collect(*instruction.ptr());
+    }
+    pool.serialize(p_file);
     // Store methods metadata_record
     p_file->store_32(methods_metadata.size());
     for (const auto& item : methods_metadata){
-        item->serialize(p_file);
+        item->serialize(p_file, pool);
         auto offset = item->get_method_offset();
         if (offset) method_metadata_offset_loc[item->method_name] = (uint64_t)offset;
     }
@@ -77,7 +78,7 @@ void NexusBytecode::serialize(FilePointer &p_file) const {
     p_file->store_16(method_bodies.size());
     for (const auto& body : method_bodies){
         method_body_offset_loc[body->method_name] = (uint64_t)p_file->get_pos();
-        body->serialize(p_file);
+        body->serialize(p_file, pool);
     }
     // Replace offsets from metadata_record with actual offsets
     auto it = method_body_offset_loc.const_iterator();
@@ -86,10 +87,83 @@ void NexusBytecode::serialize(FilePointer &p_file) const {
         p_file->seek(metadata_offset);
         p_file->store_64(it.get_pair().value);
     }
+}
+
+uint32_t NexusBytecodeConstantPool::add_number(const uint64_t& p_value) {
+    uint32_t index;
+    if (number_indices.try_get(p_value, index)) return index;
+    index = numbers.size();
+    numbers.push_back(p_value);
+    number_indices[p_value] = index;
+    return index;
+}
+
+uint32_t NexusBytecodeConstantPool::add_string(const InternedString& p_value) {
+    uint32_t index;
+    if (string_indices.try_get(p_value, index)) return index;
+    index = strings.size();
+    strings.push_back(p_value);
+    string_indices[p_value] = index;
+    return index;
+}
+
+void NexusBytecodeConstantPool::collect(const NexusBytecodeRawInstruction& p_instruction) {
+    for (const auto& item : p_instruction.arguments){
+        switch (item->type){
+            case NexusStandardType::UNSIGNED_64_BIT_INTEGER:
+            case NexusStandardType::SIGNED_64_BIT_INTEGER:
+            case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT:
+                add_number(item->get_data<uint64_t>());
+                break;
+            case NexusStandardType::STRING_LITERAL:
+                add_string(item->get_data<InternedString>());
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+uint32_t NexusBytecodeConstantPool::get_number_index(const uint64_t& p_value) const {
+    uint32_t index;
+    if (!number_indices.try_get(p_value, index)) throw BytecodeException("Constant was not collected");
+    return index;
+}
+
+uint32_t NexusBytecodeConstantPool::get_string_index(const InternedString& p_value) const {
+    uint32_t index;
+    if (!string_indices.try_get(p_value, index)) throw BytecodeException("Constant was not collected");
+    return index;
+}
+
+void NexusBytecodeConstantPool::deserialize(const FilePointer& p_file) {
+#define COLLECT_CONSTANTS(collector, storage) {         \
+    auto size = p_file->get_32();                       \
+    for (size_t i = 0; i < size; i++){                  \
+        storage.push_back(p_file->collector());         \
+    }                                                   \
+}
+    numbers.clear();
+    strings.clear();
+    COLLECT_CONSTANTS(get_64, numbers)
+    COLLECT_CONSTANTS(get_string, strings)
+#undef COLLECT_CONSTANTS
+}
+
+void NexusBytecodeConstantPool::serialize(FilePointer& p_file) const {
+#define STORE_CONSTANTS(dispenser, storage) {           \
+    auto size = storage.size();                         \
+    p_file->store_32(size);                             \
+    for (const auto& val : storage){                    \
+        p_file->dispenser(val);                         \
+    }                                                   \
+}
+    STORE_CONSTANTS(store_64, numbers)
+    STORE_CONSTANTS(store_string, strings)
 #undef STORE_CONSTANTS
 }
 
-void NexusBytecodeRawInstruction::deserialize(const FilePointer& p_file) {
+void NexusBytecodeRawInstruction::deserialize(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) {
     opcode = (NexusSerializedBytecode::OpCode)p_file->get_16();
     auto argc = p_file->get_8();
     arguments = Vector<Ref<NexusBytecodeArgument>>(argc);
@@ -105,19 +179,22 @@ void NexusBytecodeRawInstruction::deserialize(const FilePointer& p_file) {
                 argument = new NexusBytecodeArgument((int32_t)p_file->get_32());
                 break;
             case NexusStandardType::UNSIGNED_64_BIT_INTEGER:
-                argument = new NexusBytecodeArgument(p_file->get_64());
+                argument = new NexusBytecodeArgument(p_pool.get_number(p_file->get_32()));
                 break;
             case NexusStandardType::SIGNED_64_BIT_INTEGER:
-                argument = new NexusBytecodeArgument((int64_t)p_file->get_64());
+                argument = new NexusBytecodeArgument((int64_t)p_pool.get_number(p_file->get_32()));
                 break;
             case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT:
                 argument = new NexusBytecodeArgument(p_file->get_float());
                 break;
-            case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT:
-                argument = new NexusBytecodeArgument(p_file->get_double());
+            case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT: {
+                double value;
+                memcpy(&value, &p_pool.get_number(p_file->get_32()), sizeof(double));
+                argument = new NexusBytecodeArgument(value);
                 break;
+            }
             case NexusStandardType::STRING_LITERAL:
-                argument = new NexusBytecodeArgument(InternedString(p_file->get_string()));
+                argument = new NexusBytecodeArgument(p_pool.get_string(p_file->get_32()));
                 break;
             // Not supported / Can never be here
             case NexusStandardType::STACK_STRUCT:
@@ -132,7 +209,7 @@ void NexusBytecodeRawInstruction::deserialize(const FilePointer& p_file) {
         arguments.push_back(as_ref);
     }
 }
-void NexusBytecodeRawInstruction::serialize(FilePointer& p_file) const {
+void NexusBytecodeRawInstruction::serialize(FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) const {
     p_file->store_16(opcode);
     p_file->store_8(arguments.size());
     for (const auto& item : arguments){
@@ -146,19 +223,17 @@ void NexusBytecodeRawInstruction::serialize(FilePointer& p_file) const {
                 p_file->store_32(item->get_data<int32_t>());
                 break;
             case NexusStandardType::UNSIGNED_64_BIT_INTEGER:
-                p_file->store_64(item->get_data<uint64_t>());
-                break;
             case NexusStandardType::SIGNED_64_BIT_INTEGER:
-                p_file->store_64(item->get_data<int64_t>());
+                p_file->store_32(p_pool.get_number_index(item->get_data<uint64_t>()));
                 break;
             case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT:
                 p_file->store_float(item->get_data<float>());
                 break;
             case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT:
-                p_file->store_double(item->get_data<double>());
+                p_file->store_32(p_pool.get_number_index(item->get_data<uint64_t>()));
                 break;
             case NexusStandardType::STRING_LITERAL:
-                p_file->store_string(item->get_data<InternedString>());
+                p_file->store_32(p_pool.get_string_index(item->get_data<InternedString>()));
                 break;
             // Not supported / Can never be here
             case NexusStandardType::STACK_STRUCT:
@@ -172,8 +247,8 @@ void NexusBytecodeRawInstruction::serialize(FilePointer& p_file) const {
     }
 }
 
-void NexusBytecodeMethodBody::read_header(const FilePointer &p_file) {
-    method_name = p_file->get_string();
+void NexusBytecodeMethodBody::read_header(const FilePointer &p_file, const NexusBytecodeConstantPool& p_pool) {
+    method_name = p_pool.get_string(p_file->get_32());
     auto argc = p_file->get_8();
     arguments = Vector<Ref<NexusBytecodeArgument>>(argc);
     for (unsigned char i = 0; i < argc; i++){
@@ -190,25 +265,32 @@ void NexusBytecodeMethodBody::read_header(const FilePointer &p_file) {
         Ref<NexusBytecodeArgument> arg = Ref<NexusBytecodeArgument>::make_ref(arg_type);
         locals_init.push_back(arg);
     }
-    auto instructions_count = p_file->get_32();
-    instructions = Vector<Ref<NexusBytecodeRawInstruction>>(instructions_count);
-    p_file->get_pos();
+    auto handlers_count = p_file->get_32();
+    exception_handlers = Vector<NexusBytecodeExceptionHandler>(handlers_count);
+    for (uint32_t i = 0; i < handlers_count; i++){
+        NexusBytecodeExceptionHandler handler{};
+        handler.try_begin = p_pool.get_string(p_file->get_32());
+        handler.try_end = p_pool.get_string(p_file->get_32());
+        handler.handler = p_pool.get_string(p_file->get_32());
+        exception_handlers.push_back(handler);
+    }
+    declared_instructions_count = p_file->get_32();
+    instructions = Vector<Ref<NexusBytecodeRawInstruction>>(declared_instructions_count);
 }
-Ref<NexusBytecodeRawInstruction> NexusBytecodeMethodBody::read_next_instruction(const FilePointer &p_file) {
+Ref<NexusBytecodeRawInstruction> NexusBytecodeMethodBody::read_next_instruction(const FilePointer &p_file, const NexusBytecodeConstantPool& p_pool) {
     Ref<NexusBytecodeRawInstruction> instruction = Ref<NexusBytecodeRawInstruction>::make_ref();
-    instruction->deserialize(p_file);
+    instruction->deserialize(p_file, p_pool);
     return instruction;
 }
 
-void NexusBytecodeMethodBody::deserialize(const FilePointer& p_file){
-    read_header(p_file);
-    Ref<NexusBytecodeRawInstruction> instruction = read_next_instruction(p_file);
-    while (instruction.is_valid()) {
-        instructions.push_back(instruction);
+void NexusBytecodeMethodBody::deserialize(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool){
+    read_header(p_file, p_pool);
+    for (uint32_t i = 0; i < declared_instructions_count; i++){
+        instructions.push_back(read_next_instruction(p_file, p_pool));
     }
 }
-void NexusBytecodeMethodBody::serialize(FilePointer& p_file) const {
-    p_file->store_string(method_name);
+void NexusBytecodeMethodBody::serialize(FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) const {
+    p_file->store_32(p_pool.get_string_index(method_name));
     p_file->store_8(arguments.size());
     for (const auto& arg : arguments){
         p_file->store_8(arg->type);
@@ -218,9 +300,15 @@ void NexusBytecodeMethodBody::serialize(FilePointer& p_file) const {
     for (const auto& local : locals_init){
         p_file->store_8(local->type);
     }
+    p_file->store_32(exception_handlers.size());
+    for (const auto& handler : exception_handlers){
+        p_file->store_32(p_pool.get_string_index(handler.try_begin));
+        p_file->store_32(p_pool.get_string_index(handler.try_end));
+        p_file->store_32(p_pool.get_string_index(handler.handler));
+    }
     p_file->store_32(instructions.size());
     for (const auto& instruction : instructions){
-        instruction->serialize(p_file);
+        instruction->serialize(p_file, p_pool);
     }
 }
 
@@ -240,12 +328,13 @@ NexusBytecodeInstance::NexusBytecodeInstance(const NexusTypeInfoServer* p_type_i
                 break;
             }
             bytecode->load_methods_body(file_pointer);
+            bytecode->build_metadata_map();
             bytecode->build_bodies_map();
     }
     // Get body offset to jump around file faster
     // Method must not be external
     for (const auto& method_metadata : bytecode->get_methods_metadata()){
-        if (!(method_metadata->attributes | NexusBytecodeMethodMetadata::MA_EXTERNAL) && method_metadata->method_body_offset != 0)
+        if (!(method_metadata->attributes & NexusBytecodeMethodMetadata::MA_EXTERNAL) && method_metadata->method_body_offset != 0)
             bodies_location[method_metadata->method_name] = method_metadata->method_body_offset;
     }
 }
@@ -262,13 +351,18 @@ NexusBytecodeInstance::NexusBytecodeInstance(const NexusTypeInfoServer* p_type_i
         case LOAD_ALL:
             bytecode->load_header(file_pointer);
             header_end = (uint64_t)file_pointer->get_pos();
-            if (load_mode == LOAD_HEADER) break;
+            if (load_mode == LOAD_HEADER) {
+                bytecode->build_metadata_map();
+                break;
+            }
             bytecode->load_methods_body(file_pointer);
+            bytecode->build_metadata_map();
+            bytecode->build_bodies_map();
     }
     // Get body offset to jump around file faster
     // Method must not be external
     for (const auto& method_metadata : bytecode->get_methods_metadata()){
-        if (!(method_metadata->attributes | NexusBytecodeMethodMetadata::MA_EXTERNAL) && method_metadata->method_body_offset != 0)
+        if (!(method_metadata->attributes & NexusBytecodeMethodMetadata::MA_EXTERNAL) && method_metadata->method_body_offset != 0)
             bodies_location[method_metadata->method_name] = method_metadata->method_body_offset;
     }
 }
@@ -281,27 +375,29 @@ const NexusTypeInfoServer *NexusMethodPointer::get_type_info_server() const {
 
 void NexusMethodPointerJIT::load_method(const Ref<NexusBytecodeInstance>& p_bci, const InternedString& p_method_name) {
     file = FileAccessServer::duplicate_pointer(p_bci->file_pointer);
+    constant_pool = p_bci->bytecode->get_constant_pool();
 
     method_body = Ref<NexusBytecodeMethodBody>::make_ref();
-    method_body->read_header(file);
+    file->seek(p_bci->bodies_location[p_method_name]);
+    method_body->read_header(file, *constant_pool.ptr());
 
-    auto pos = p_bci->bodies_location[p_method_name];
-    file->seek(pos);
-    offsets = Vector<size_t>(method_body->get_instructions_count());
-    offsets.push_back(pos);
+    // offsets[i] is where instruction i begins, filled as instructions are read
+    offsets = Vector<size_t>(method_body->declared_instructions_count + 1);
+    offsets.push_back(file->get_pos());
     method_metadata = p_bci->bytecode->get_metadata_map()[method_body->method_name];
 }
 
 void NexusMethodPointerJIT::move_iterator(const int64_t& p_new_pos) {
+    if (p_new_pos + 1 >= int64_t(offsets.size())) throw BytecodeException("Can not move past an instruction that has not been read");
     instructions_iter = p_new_pos;
     file->seek(offsets[p_new_pos + 1]);
 }
 
 Ref<NexusBytecodeRawInstruction> NexusMethodPointerJIT::get_next_instruction() {
-    if (instructions_iter + 1 >= method_body->instructions.capacity()) return Ref<NexusBytecodeRawInstruction>::null();
+    if (instructions_iter + 1 >= method_body->declared_instructions_count) return Ref<NexusBytecodeRawInstruction>::null();
     instructions_iter++;
-    auto re = NexusBytecodeMethodBody::read_next_instruction(file);
-    offsets.push_back(file->get_pos());
+    auto re = NexusBytecodeMethodBody::read_next_instruction(file, *constant_pool.ptr());
+    if (offsets.size() <= instructions_iter + 1) offsets.push_back(file->get_pos());
     return re;
 }
 
@@ -319,7 +415,7 @@ void NexusMethodPointerMemory::load_method(const Ref<NexusBytecodeInstance>& p_b
 }
 
 Ref<NexusBytecodeRawInstruction> NexusMethodPointerMemory::get_next_instruction() {
-    if (instructions_iter + 1 >= method_body->instructions.capacity()) return Ref<NexusBytecodeRawInstruction>::null();
+    if (instructions_iter + 1 >= method_body->get_instructions_count()) return Ref<NexusBytecodeRawInstruction>::null();
     instructions_iter++;
     return method_body->instructions[instructions_iter];
 }
@@ -124,9 +124,44 @@ public:
         // Divide two value from stack1 and push the result onto the stack1. Can call overloaded method if necessary
         // Stack: -2: operand 1; -1: operand 2
         OP_DIVIDE,
+        // Compare two value from stack1 and push the result onto the stack1 as an unsigned 32-bit integer (1 or 0)
+        // Stack: -2: operand 1; -1: operand 2
+        OP_EQUAL,
+        OP_NOT_EQUAL,
+        OP_LESSER,
+        OP_LESSER_OR_EQUAL,
+        OP_GREATER,
+        OP_GREATER_OR_EQUAL,
+        // Return from the current method. The topmost value of the evaluation stack1, if any, is the return value
+        OP_RETURN,
+
+        //--------------------------------------------------------------------- //
+        //                           Typed operators                            //
+        //--------------------------------------------------------------------- //
+
+        // OP_ADD to OP_GREATER_OR_EQUAL for operands whose type is known when compiling, emitted by
+        // NexusCompiler. Both operands must be of the named type, forms follow NexusStandardType from
+        // UNSIGNED_32_BIT_INTEGER
+        // Stack: -2: operand 1; -1: operand 2
+        OP_ADD_U32, OP_ADD_I32, OP_ADD_U64, OP_ADD_I64, OP_ADD_F32, OP_ADD_F64,
+        OP_SUBTRACT_U32, OP_SUBTRACT_I32, OP_SUBTRACT_U64, OP_SUBTRACT_I64, OP_SUBTRACT_F32, OP_SUBTRACT_F64,
+        OP_MULTIPLY_U32, OP_MULTIPLY_I32, OP_MULTIPLY_U64, OP_MULTIPLY_I64, OP_MULTIPLY_F32, OP_MULTIPLY_F64,
+        OP_DIVIDE_U32, OP_DIVIDE_I32, OP_DIVIDE_U64, OP_DIVIDE_I64, OP_DIVIDE_F32, OP_DIVIDE_F64,
+        OP_EQUAL_U32, OP_EQUAL_I32, OP_EQUAL_U64, OP_EQUAL_I64, OP_EQUAL_F32, OP_EQUAL_F64,
+        OP_NOT_EQUAL_U32, OP_NOT_EQUAL_I32, OP_NOT_EQUAL_U64, OP_NOT_EQUAL_I64, OP_NOT_EQUAL_F32, OP_NOT_EQUAL_F64,
+        OP_LESSER_U32, OP_LESSER_I32, OP_LESSER_U64, OP_LESSER_I64, OP_LESSER_F32, OP_LESSER_F64,
+        OP_LESSER_OR_EQUAL_U32, OP_LESSER_OR_EQUAL_I32, OP_LESSER_OR_EQUAL_U64, OP_LESSER_OR_EQUAL_I64,
+        OP_LESSER_OR_EQUAL_F32, OP_LESSER_OR_EQUAL_F64,
+        OP_GREATER_U32, OP_GREATER_I32, OP_GREATER_U64, OP_GREATER_I64, OP_GREATER_F32, OP_GREATER_F64,
+        OP_GREATER_OR_EQUAL_U32, OP_GREATER_OR_EQUAL_I32, OP_GREATER_OR_EQUAL_U64, OP_GREATER_OR_EQUAL_I64,
+        OP_GREATER_OR_EQUAL_F32, OP_GREATER_OR_EQUAL_F64,
         // Ceiling
         OPCODE_END,
     };
+    // Typed form of an opcode from OP_ADD to OP_GREATER_OR_EQUAL, for operands of a numeric p_type
+    _NO_DISCARD_ static constexpr OpCode get_typed_opcode(const OpCode& p_opcode, const NexusStandardType& p_type) {
+        return OpCode(OP_ADD_U32 + (p_opcode - OP_ADD) * (OP_SUBTRACT_U32 - OP_ADD_U32) + (p_type - NexusStandardType::UNSIGNED_32_BIT_INTEGER));
+    }
 
     virtual void deserialize(const FilePointer& p_file) = 0;
     virtual void serialize(FilePointer& p_file) const = 0;
@@ -152,6 +187,38 @@ struct NexusBytecodeMetadata : public NexusSerializedBytecode{
     }
 };
 
+struct NexusBytecodeRawInstruction;
+
+// Constants shared by every method of a file, referenced by index. Each string is interned once when
+// the file is loaded, instead of once per use. 32-bit constants stay inline, an index is just as large
+struct NexusBytecodeConstantPool : public NexusSerializedBytecode {
+private:
+    HashMap<uint64_t, uint32_t> number_indices{};
+    HashMap<InternedString, uint32_t> string_indices{};
+public:
+    // 64-bit integers and doubles, as their bit pattern
+    Vector<uint64_t> numbers{};
+    Vector<InternedString> strings{};
+
+    // Return the constant's index, adding it if it is not in the pool yet
+    uint32_t add_number(const uint64_t& p_value);
+    uint32_t add_string(const InternedString& p_value);
+    void collect(const NexusBytecodeRawInstruction& p_instruction);
+    _NO_DISCARD_ uint32_t get_number_index(const uint64_t& p_value) const;
+    _NO_DISCARD_ uint32_t get_string_index(const InternedString& p_value) const;
+    _NO_DISCARD_ const uint64_t& get_number(const uint32_t& p_index) const {
+        if (p_index >= numbers.size()) throw BytecodeParseException("Constant index out of range");
+        return numbers[p_index];
+    }
+    _NO_DISCARD_ const InternedString& get_string(const uint32_t& p_index) const {
+        if (p_index >= strings.size()) throw BytecodeParseException("Constant index out of range");
+        return strings[p_index];
+    }
+
+    void deserialize(const FilePointer& p_file) override;
+    void serialize(FilePointer& p_file) const override;
+};
+
 struct NexusBytecodeMethodMetadata : public NexusSerializedBytecode {
     enum MethodAttribute : unsigned int {
         MA_NORMAL = 0,
@@ -160,8 +227,8 @@ struct NexusBytecodeMethodMetadata : public NexusSerializedBytecode {
         MA_INLINE = 4,
         MA_MAX
     };
-    uint64_t id;
-    uint32_t attributes;
+    uint64_t id{};
+    uint32_t attributes{};
     InternedString method_name;
     // Address of method body in file
     uint64_t method_body_offset{};
@@ -170,15 +237,21 @@ private:
 public:
 
     void deserialize(const FilePointer& p_file) override {
+        throw BytecodeParseException("NexusBytecodeMethodMetadata needs a constant pool");
+    }
+    void serialize(FilePointer& p_file) const override {
+        throw BytecodeParseException("NexusBytecodeMethodMetadata needs a constant pool");
+    }
+    void deserialize(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) {
         id = p_file->get_64();
         attributes = p_file->get_32();
-        method_name = p_file->get_string();
+        method_name = p_pool.get_string(p_file->get_32());
         method_body_offset = (uint64_t)p_file->get_64();
     }
-    void serialize(FilePointer& p_file) const override {
+    void serialize(FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) const {
         p_file->store_64(id);
         p_file->store_32(attributes);
-        p_file->store_string(method_name);
+        p_file->store_32(p_pool.get_string_index(method_name));
         offset_from_last_serialization = (uint64_t)p_file->get_pos();
         p_file->store_64(0);
     }
@@ -248,8 +321,22 @@ public:
     NexusSerializedBytecode::OpCode opcode{};
     Vector<Ref<NexusBytecodeArgument>> arguments{};
 
-    void deserialize(const FilePointer& p_file) override;
-    void serialize(FilePointer& p_file) const override;
+    void deserialize(const FilePointer& p_file) override {
+        throw BytecodeParseException("NexusBytecodeRawInstruction needs a constant pool");
+    }
+    void serialize(FilePointer& p_file) const override {
+        throw BytecodeParseException("NexusBytecodeRawInstruction needs a constant pool");
+    }
+    void deserialize(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool);
+    void serialize(FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) const;
+};
+
+// Instructions from try_begin up to, but excluding, try_end are protected by the code at handler.
+// All three are labels of the same method, the first matching entry wins
+struct NexusBytecodeExceptionHandler {
+    InternedString try_begin{};
+    InternedString try_end{};
+    InternedString handler{};
 };
 
 struct NexusBytecodeMethodBody : public NexusSerializedBytecode {
@@ -259,24 +346,38 @@ public:
     Vector<Ref<NexusBytecodeArgument>> arguments{};
     uint16_t max_stack{};
     Vector<Ref<NexusBytecodeArgument>> locals_init{};
+    // Stored in the header, before the instructions
+    Vector<NexusBytecodeExceptionHandler> exception_handlers{};
     Vector<Ref<NexusBytecodeRawInstruction>> instructions{};
+    // As written in the header, instructions might not have been loaded
+    uint32_t declared_instructions_count{};
 
-    void deserialize(const FilePointer& p_file) override;
-    void serialize(FilePointer& p_file) const override;
+    void deserialize(const FilePointer& p_file) override {
+        throw BytecodeParseException("NexusBytecodeMethodBody needs a constant pool");
+    }
+    void serialize(FilePointer& p_file) const override {
+        throw BytecodeParseException("NexusBytecodeMethodBody needs a constant pool");
+    }
+    void deserialize(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool);
+    void serialize(FilePointer& p_file, const NexusBytecodeConstantPool& p_pool) const;
 
-    void read_header(const FilePointer& p_file);
-    static Ref<NexusBytecodeRawInstruction> read_next_instruction(const FilePointer& p_file);
+    void read_header(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool);
+    static Ref<NexusBytecodeRawInstruction> read_next_instruction(const FilePointer& p_file, const NexusBytecodeConstantPool& p_pool);
 
-    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_instructions_count() const { return instructions.capacity(); }
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_instructions_count() const { return instructions.size(); }
 };
 
 class NexusBytecode : public NexusSerializedBytecode {
 public:
     // NEX
     static constexpr uint32_t MAGIC = 0x6E6578;
-    static constexpr uint32_t VERSION = 0x000100;
+    // 0x000200: constant pool
+    // 0x000300: exception tables
+    // 0x000400: typed arithmetic and comparison opcodes
+    static constexpr uint32_t VERSION = 0x000400;
     static constexpr uint32_t INSTRUCTIONS_RESERVED = 32; // 256 bit
 private:
+    Ref<NexusBytecodeConstantPool> constant_pool = Ref<NexusBytecodeConstantPool>::make_ref();
     Vector<Ref<NexusBytecodeMethodMetadata>> methods_metadata{};
     Vector<Ref<NexusBytecodeMethodBody>> method_bodies{};
     HashMap<InternedString, Ref<NexusBytecodeMethodMetadata>> metadata_map{};
@@ -286,6 +387,8 @@ public:
     void serialize(FilePointer& p_file) const override;
     void load_header(const FilePointer& p_file);
     void load_methods_body(const FilePointer& p_file);
+    // Filled by deserialize(), serialize() builds its own
+    _FORCE_INLINE_ const Ref<NexusBytecodeConstantPool>& get_constant_pool() const { return constant_pool; }
     _FORCE_INLINE_ const Vector<Ref<NexusBytecodeMethodMetadata>>& get_methods_metadata() const { return methods_metadata; }
     _FORCE_INLINE_ const Vector<Ref<NexusBytecodeMethodBody>>& get_method_bodies() const { return method_bodies; }
     _FORCE_INLINE_ const HashMap<InternedString, Ref<NexusBytecodeMethodMetadata>>& get_metadata_map() const { return metadata_map; }
@@ -306,6 +409,18 @@ public:
             bodies_map[it->method_name] = it;
         }
     }
+    _FORCE_INLINE_ void add_method(const Ref<NexusBytecodeMethodMetadata>& p_metadata, const Ref<NexusBytecodeMethodBody>& p_body){
+        methods_metadata.push_back(p_metadata);
+        method_bodies.push_back(p_body);
+        metadata_map[p_metadata->method_name] = p_metadata;
+        bodies_map[p_body->method_name] = p_body;
+    }
+    // Declaration without a body, resolved against the runtime's native methods at load time
+    _FORCE_INLINE_ void add_external_method(Ref<NexusBytecodeMethodMetadata> p_metadata){
+        p_metadata->attributes |= NexusBytecodeMethodMetadata::MA_EXTERNAL;
+        methods_metadata.push_back(p_metadata);
+        metadata_map[p_metadata->method_name] = p_metadata;
+    }
     NexusBytecode() : NexusSerializedBytecode() {}
     explicit NexusBytecode(const FilePointer& p_from) { parse_from_file(p_from); }
 
@@ -328,6 +443,9 @@ public:
     virtual Ref<NexusBytecodeRawInstruction> get_next_instruction() = 0;
     virtual Ref<NexusBytecodeMethodMetadata> get_method_metadata() const = 0;
     virtual Vector<Ref<NexusBytecodeArgument>> get_arguments() const = 0;
+    virtual Vector<Ref<NexusBytecodeArgument>> get_locals() const = 0;
+    virtual uint16_t get_max_stack() const = 0;
+    virtual Vector<NexusBytecodeExceptionHandler> get_exception_handlers() const { return {}; }
     
     virtual void load_method(const Ref<NexusBytecodeInstance>& p_bci, const InternedString& p_method_name) = 0;
 
@@ -337,6 +455,7 @@ public:
 struct NexusMethodPointerJIT : public NexusMethodPointer {
 private:
     FilePointer file{};
+    Ref<NexusBytecodeConstantPool> constant_pool{};
     Ref<NexusBytecodeMethodBody> method_body{};
     Ref<NexusBytecodeMethodMetadata> method_metadata{};
     Vector<size_t> offsets{};
@@ -349,6 +468,9 @@ public:
     Ref<NexusBytecodeRawInstruction> get_next_instruction() override;
     Ref<NexusBytecodeMethodMetadata> get_method_metadata() const override;
     Vector<Ref<NexusBytecodeArgument>> get_arguments() const override;
+    Vector<Ref<NexusBytecodeArgument>> get_locals() const override { return method_body->locals_init; }
+    uint16_t get_max_stack() const override { return method_body->max_stack; }
+    Vector<NexusBytecodeExceptionHandler> get_exception_handlers() const override { return method_body->exception_handlers; }
     
     void load_method(const Ref<NexusBytecodeInstance>& p_bci, const InternedString& p_method_name) override;
 };
@@ -366,6 +488,9 @@ public:
     Ref<NexusBytecodeRawInstruction> get_next_instruction() override;
     Ref<NexusBytecodeMethodMetadata> get_method_metadata() const override;
     Vector<Ref<NexusBytecodeArgument>> get_arguments() const override;
+    Vector<Ref<NexusBytecodeArgument>> get_locals() const override { return method_body->locals_init; }
+    uint16_t get_max_stack() const override { return method_body->max_stack; }
+    Vector<NexusBytecodeExceptionHandler> get_exception_handlers() const override { return method_body->exception_handlers; }
 
     void load_method(const Ref<NexusBytecodeInstance>& p_bci, const InternedString& p_method_name) override;
 };
@@ -0,0 +1,285 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include "compiler.h"
+
+typedef NexusSerializedBytecode BC;
+typedef NexusASTNode AST;
+
+static _FORCE_INLINE_ bool is_numeric(const NexusStandardType& p_type) {
+    return p_type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER && p_type <= NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT;
+}
+
+static _FORCE_INLINE_ bool is_integer(const NexusStandardType& p_type) {
+    return p_type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER && p_type <= NexusStandardType::SIGNED_64_BIT_INTEGER;
+}
+
+static _FORCE_INLINE_ bool is_comparison(const BC::OpCode& p_opcode) {
+    return p_opcode >= BC::OP_EQUAL && p_opcode <= BC::OP_GREATER_OR_EQUAL;
+}
+
+// Generic opcode of an arithmetic or comparison operator, OPCODE_END for any other
+static BC::OpCode opcode_of(const AST::OperatorType& p_operator) {
+    switch (p_operator) {
+        case AST::OP_ADD: return BC::OP_ADD;
+        case AST::OP_SUBTRACT: return BC::OP_SUBTRACT;
+        case AST::OP_MULTIPLY: return BC::OP_MULTIPLY;
+        case AST::OP_DIVIDE: return BC::OP_DIVIDE;
+        case AST::OP_EQUAL: return BC::OP_EQUAL;
+        case AST::OP_NOT_EQUAL: return BC::OP_NOT_EQUAL;
+        case AST::OP_GREATER: return BC::OP_GREATER;
+        case AST::OP_GREATER_OR_EQUAL: return BC::OP_GREATER_OR_EQUAL;
+        case AST::OP_LESSER: return BC::OP_LESSER;
+        case AST::OP_LESSER_OR_EQUAL: return BC::OP_LESSER_OR_EQUAL;
+        default: return BC::OPCODE_END;
+    }
+}
+
+NexusCompiler::NexusCompiler(const HashMap<InternedString, Ref<MethodDeclarationNode>>& p_declarations,
+                             const Ref<MethodDeclarationNode>& p_method) : declarations(p_declarations), method(p_method) {
+    if (method.is_null()) throw CompilerException("Missing method declaration");
+    if (method->return_type != NexusStandardType::NONE && !is_numeric(method->return_type))
+        throw CompilerException("Methods must return a numeric type or nothing");
+    if (method->arguments.is_null()) return;
+    for (const auto& argument : method->arguments->arguments) {
+        if (argument.is_null()) throw CompilerException("Missing argument declaration");
+        if (argument->default_value.is_valid()) throw CompilerException("Default arguments are not supported");
+        declare(argument->identifier, argument->type, argument_count++);
+    }
+}
+
+void NexusCompiler::declare(const Ref<IdentifierNode>& p_identifier, const NexusStandardType& p_type, const uint32_t& p_index) {
+    if (p_identifier.is_null()) throw CompilerException("Missing identifier");
+    if (!is_numeric(p_type)) throw CompilerException("Arguments and variables must be of a numeric type");
+    if (slots.has(p_identifier->identifier)) throw CompilerException("Identifier declared more than once");
+    slots[p_identifier->identifier] = Slot{ .index = p_index, .type = p_type };
+}
+
+NexusCompiler::Slot NexusCompiler::get_slot(const Ref<NexusASTNode>& p_identifier) const {
+    if (p_identifier.is_null() || p_identifier->get_type() != AST::Identifier) throw CompilerException("Expected an identifier");
+    Slot re{};
+    if (!slots.try_get(p_identifier.c_style_cast<IdentifierNode>()->identifier, re)) throw CompilerException("Undeclared identifier");
+    return re;
+}
+
+void NexusCompiler::load(const Slot& p_slot) {
+    if (p_slot.index < argument_count) emit(1, BC::OP_LOAD_ARG, p_slot.index);
+    else emit(1, BC::OP_LOAD_STACK, p_slot.index);
+}
+
+void NexusCompiler::store(const Slot& p_slot) {
+    if (p_slot.index < argument_count) emit(-1, BC::OP_STORE_ARG, p_slot.index);
+    else emit(-1, BC::OP_STORE_STACK, p_slot.index);
+}
+
+const MethodDeclarationNode* NexusCompiler::get_declaration(const InternedString& p_method_name) const {
+    Ref<MethodDeclarationNode> re{};
+    if (!declarations.try_get(p_method_name, re) || re.is_null()) throw CompilerException("Call to an undeclared method");
+    // Kept alive by the package
+    return re.ptr();
+}
+
+NexusStandardType NexusCompiler::type_of(const Ref<NexusASTNode>& p_expression, bool& p_real) const {
+    if (p_expression.is_null()) throw CompilerException("Missing expression");
+    switch (p_expression->get_type()) {
+        case AST::RealValue:
+            p_real = true;
+            return NexusStandardType::NONE;
+        case AST::Identifier:
+            return get_slot(p_expression).type;
+        case AST::MethodInvocation:
+            return get_declaration(p_expression.c_style_cast<MethodInvocationNode>()->method_name)->return_type;
+        case AST::BinaryOperator: {
+            const auto binary = p_expression.c_style_cast<BinaryOperatorNode>();
+            if (is_comparison(opcode_of(binary->op))) return NexusStandardType::UNSIGNED_32_BIT_INTEGER;
+            const auto re = type_of(binary->left_operand, p_real);
+            return re != NexusStandardType::NONE ? re : type_of(binary->right_operand, p_real);
+        }
+        default:
+            // Integer literals, anything else is rejected when compiled
+            return NexusStandardType::NONE;
+    }
+}
+
+NexusStandardType NexusCompiler::compile_expression(const Ref<NexusASTNode>& p_expression, const NexusStandardType& p_expected) {
+    if (p_expression.is_null()) throw CompilerException("Missing expression");
+    switch (p_expression->get_type()) {
+        case AST::IntegerValue: {
+            const auto value = p_expression.c_style_cast<IntegerValueNode>()->value;
+            const auto type = is_numeric(p_expected) ? p_expected : NexusStandardType::SIGNED_64_BIT_INTEGER;
+            switch (type) {
+                case NexusStandardType::UNSIGNED_32_BIT_INTEGER:
+                    if (value > UINT32_MAX) throw CompilerException("Integer literal out of range");
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_U32, uint32_t(value));
+                    break;
+                case NexusStandardType::SIGNED_32_BIT_INTEGER:
+                    if (value > INT32_MAX) throw CompilerException("Integer literal out of range");
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_I32, int32_t(value));
+                    break;
+                case NexusStandardType::UNSIGNED_64_BIT_INTEGER:
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(value));
+                    break;
+                case NexusStandardType::SIGNED_64_BIT_INTEGER:
+                    if (value > INT64_MAX) throw CompilerException("Integer literal out of range");
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_I64, int64_t(value));
+                    break;
+                case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT:
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_FP32, float(value));
+                    break;
+                default:
+                    emit(1, BC::OPCODE_LOAD_CONSTANT_FP64, double(value));
+                    break;
+            }
+            return type;
+        }
+        case AST::RealValue: {
+            const auto value = p_expression.c_style_cast<RealValueNode>()->value;
+            if (is_integer(p_expected)) throw CompilerException("Real literal where an integer is expected");
+            if (p_expected == NexusStandardType::SINGLE_PRECISION_FLOATING_POINT) {
+                emit(1, BC::OPCODE_LOAD_CONSTANT_FP32, float(value));
+                return NexusStandardType::SINGLE_PRECISION_FLOATING_POINT;
+            }
+            emit(1, BC::OPCODE_LOAD_CONSTANT_FP64, value);
+            return NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT;
+        }
+        case AST::Identifier: {
+            const auto slot = get_slot(p_expression);
+            load(slot);
+            return slot.type;
+        }
+        case AST::MethodInvocation:
+            return compile_invocation(p_expression.c_style_cast<MethodInvocationNode>());
+        case AST::BinaryOperator:
+            return compile_operator(p_expression.c_style_cast<BinaryOperatorNode>(), p_expected);
+        default:
+            throw CompilerException("Expression not supported");
+    }
+}
+
+void NexusCompiler::expect_expression(const Ref<NexusASTNode>& p_expression, const NexusStandardType& p_expected, const char* p_mismatch) {
+    if (compile_expression(p_expression, p_expected) != p_expected) throw CompilerException(p_mismatch);
+}
+
+NexusStandardType NexusCompiler::compile_operator(const Ref<BinaryOperatorNode>& p_operator, const NexusStandardType& p_expected) {
+    const auto opcode = opcode_of(p_operator->op);
+    if (opcode == BC::OPCODE_END) throw CompilerException("Operator not supported");
+    // The first typed operand decides, literals follow it
+    bool real = false;
+    auto type = type_of(p_operator->left_operand, real);
+    if (type == NexusStandardType::NONE) type = type_of(p_operator->right_operand, real);
+    if (type == NexusStandardType::NONE) {
+        if (!is_comparison(opcode) && is_numeric(p_expected)) type = p_expected;
+        else type = real ? NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT : NexusStandardType::SIGNED_64_BIT_INTEGER;
+    }
+    if (!is_numeric(type)) throw CompilerException("Operator not supported for this type");
+    expect_expression(p_operator->left_operand, type, "Operands are of different types");
+    expect_expression(p_operator->right_operand, type, "Operands are of different types");
+    emit(-1, BC::get_typed_opcode(opcode, type));
+    return is_comparison(opcode) ? NexusStandardType::UNSIGNED_32_BIT_INTEGER : type;
+}
+
+NexusStandardType NexusCompiler::compile_invocation(const Ref<MethodInvocationNode>& p_invocation) {
+    const auto declaration = get_declaration(p_invocation->method_name);
+    const auto argc = declaration->arguments.is_valid() ? declaration->arguments->arguments.size() : 0;
+    const auto given = p_invocation->arguments.is_valid() ? p_invocation->arguments->arguments.size() : 0;
+    if (argc != given) throw CompilerException("Wrong number of arguments");
+    for (size_t i = 0; i < argc; i++) {
+        const auto& argument = p_invocation->arguments->arguments[i];
+        if (argument.is_null()) throw CompilerException("Missing expression");
+        expect_expression(argument->value, declaration->arguments->arguments[i]->type, "Argument of incompatible type");
+    }
+    const auto returns = declaration->return_type != NexusStandardType::NONE;
+    emit(int64_t(returns) - int64_t(argc), BC::OP_CALL, p_invocation->method_name);
+    return declaration->return_type;
+}
+
+void NexusCompiler::compile_assignment(const Ref<BinaryOperatorNode>& p_assignment) {
+    auto opcode = BC::OPCODE_END;
+    switch (p_assignment->op) {
+        case AST::OP_ASSIGN: break;
+        case AST::OP_ADD_ASSIGN: opcode = BC::OP_ADD; break;
+        case AST::OP_SUBTRACT_ASSIGN: opcode = BC::OP_SUBTRACT; break;
+        case AST::OP_MULTIPLY_ASSIGN: opcode = BC::OP_MULTIPLY; break;
+        case AST::OP_DIVIDE_ASSIGN: opcode = BC::OP_DIVIDE; break;
+        default: throw CompilerException("Only assignments and calls can be used as statements");
+    }
+    const auto slot = get_slot(p_assignment->left_operand);
+    if (opcode != BC::OPCODE_END) load(slot);
+    expect_expression(p_assignment->right_operand, slot.type, "Can not store a value of incompatible type");
+    if (opcode != BC::OPCODE_END) emit(-1, BC::get_typed_opcode(opcode, slot.type));
+    store(slot);
+}
+
+void NexusCompiler::compile_statement(const Ref<NexusASTNode>& p_statement) {
+    if (p_statement.is_null()) throw CompilerException("Missing statement");
+    switch (p_statement->get_type()) {
+        case AST::VariableDeclaration: {
+            const auto declaration = p_statement.c_style_cast<VariableDeclarationNode>();
+            const auto& initialization = declaration->initialization;
+            // Declared after its initializer, which can not refer to it
+            if (initialization.is_valid())
+                expect_expression(initialization->value, declaration->data_type, "Initializer is not of the declared type");
+            const auto index = argument_count + uint32_t(locals.size());
+            declare(declaration->identifier, declaration->data_type, index);
+            locals.push_back(declaration->data_type);
+            // Locals start zeroed otherwise
+            if (initialization.is_valid()) store(Slot{ .index = index, .type = declaration->data_type });
+            break;
+        }
+        case AST::BinaryOperator:
+            compile_assignment(p_statement.c_style_cast<BinaryOperatorNode>());
+            break;
+        case AST::MethodInvocation:
+            if (compile_invocation(p_statement.c_style_cast<MethodInvocationNode>()) != NexusStandardType::NONE) emit(-1, BC::OP_POP);
+            break;
+        case AST::Return: {
+            const auto& value = p_statement.c_style_cast<ReturnNode>()->value;
+            if (value.is_null()) {
+                if (method->return_type != NexusStandardType::NONE) throw CompilerException("Missing return value");
+            } else {
+                if (method->return_type == NexusStandardType::NONE) throw CompilerException("Method does not return a value");
+                expect_expression(value, method->return_type, "Return value of incompatible type");
+            }
+            emit(-int64_t(value.is_valid()), BC::OP_RETURN);
+            break;
+        }
+        default:
+            throw CompilerException("Statement not supported");
+    }
+}
+
+void NexusCompiler::compile_method(Ref<NexusBytecode>& p_bytecode) {
+    bool returned = false;
+    if (method->method_body.is_valid()) {
+        for (const auto& statement : method->method_body->instructions) {
+            if (returned) throw CompilerException("Unreachable statement");
+            compile_statement(statement);
+            returned = statement->get_type() == AST::Return;
+        }
+    }
+    if (!returned && method->return_type != NexusStandardType::NONE) throw CompilerException("Method must end with a return");
+    if (max_stack > UINT16_MAX) throw CompilerException("Evaluation stack too deep");
+    auto metadata = Ref<NexusBytecodeMethodMetadata>::make_ref();
+    metadata->id = p_bytecode->get_methods_metadata().size();
+    metadata->method_name = method->method_name;
+    auto body = Ref<NexusBytecodeMethodBody>::make_ref();
+    body->method_name = method->method_name;
+    if (method->arguments.is_valid()) {
+        for (const auto& argument : method->arguments->arguments) body->arguments.push_back(Ref<NexusBytecodeArgument>::make_ref(argument->type));
+    }
+    for (const auto& type : locals) body->locals_init.push_back(Ref<NexusBytecodeArgument>::make_ref(type));
+    body->max_stack = uint16_t(max_stack);
+    body->instructions = instructions;
+    p_bytecode->add_method(metadata, body);
+}
+
+Ref<NexusBytecode> NexusCompiler::compile(const Ref<NexusParser::NexusASTPackage>& p_package) {
+    auto re = Ref<NexusBytecode>::make_ref();
+    auto it = p_package->method_declarations.const_iterator();
+    while (it.move_next()) {
+        NexusCompiler compiler(p_package->method_declarations, it.get_pair().value);
+        compiler.compile_method(re);
+    }
+    return re;
+}
@@ -0,0 +1,69 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_COMPILER_H
+#define NEXUS_COMPILER_H
+
+#include "parser.h"
+#include "bytecode.h"
+
+class CompilerException : public Exception {
+public:
+    explicit CompilerException(const char* p_msg = nullptr) : Exception(p_msg) {}
+};
+
+// Type checks method declarations against the types they declare, then compiles them to bytecode.
+// Every expression has a type known here, so arithmetic and comparisons are emitted in their typed
+// form (OP_ADD_I64, OP_LESSER_F64, ...) and run without quickening or type dispatch.
+// Arguments, variables and return values are numeric. Both operands of an operator must have the
+// same type, nothing converts implicitly: literals take the type their context expects, signed 64
+// bit integer or double precision floating point without one. Bodies are straight line code
+class NexusCompiler {
+    struct Slot {
+        // Frame index, arguments then locals
+        uint32_t index;
+        NexusStandardType type;
+    };
+    const HashMap<InternedString, Ref<MethodDeclarationNode>>& declarations;
+    const Ref<MethodDeclarationNode> method;
+    HashMap<InternedString, Slot> slots{};
+    uint32_t argument_count{};
+    Vector<NexusStandardType> locals{};
+    Vector<Ref<NexusBytecodeRawInstruction>> instructions{};
+    int64_t depth{};
+    int64_t max_stack{};
+
+    NexusCompiler(const HashMap<InternedString, Ref<MethodDeclarationNode>>& p_declarations, const Ref<MethodDeclarationNode>& p_method);
+
+    template <class ...Args>
+    void emit(const int64_t& p_stack_effect, const NexusSerializedBytecode::OpCode& p_opcode, const Args&... p_args) {
+        auto instruction = Ref<NexusBytecodeRawInstruction>::make_ref();
+        instruction->opcode = p_opcode;
+        (instruction->arguments.push_back(Ref<NexusBytecodeArgument>::make_ref(p_args)), ...);
+        instructions.push_back(instruction);
+        depth += p_stack_effect;
+        if (depth > max_stack) max_stack = depth;
+    }
+    void declare(const Ref<IdentifierNode>& p_identifier, const NexusStandardType& p_type, const uint32_t& p_index);
+    _NO_DISCARD_ Slot get_slot(const Ref<NexusASTNode>& p_identifier) const;
+    void load(const Slot& p_slot);
+    void store(const Slot& p_slot);
+    _NO_DISCARD_ const MethodDeclarationNode* get_declaration(const InternedString& p_method_name) const;
+    // Type of p_expression, NONE if it only has literals. Sets p_real if one of them is a real literal
+    _NO_DISCARD_ NexusStandardType type_of(const Ref<NexusASTNode>& p_expression, bool& p_real) const;
+    // Emits p_expression, returns its type. p_expected types the literals of untyped expressions
+    NexusStandardType compile_expression(const Ref<NexusASTNode>& p_expression, const NexusStandardType& p_expected);
+    // Same, throws p_mismatch unless p_expression is of p_expected
+    void expect_expression(const Ref<NexusASTNode>& p_expression, const NexusStandardType& p_expected, const char* p_mismatch);
+    NexusStandardType compile_operator(const Ref<BinaryOperatorNode>& p_operator, const NexusStandardType& p_expected);
+    NexusStandardType compile_invocation(const Ref<MethodInvocationNode>& p_invocation);
+    void compile_assignment(const Ref<BinaryOperatorNode>& p_assignment);
+    void compile_statement(const Ref<NexusASTNode>& p_statement);
+    void compile_method(Ref<NexusBytecode>& p_bytecode);
+public:
+    // Methods may call each other regardless of declaration order
+    static Ref<NexusBytecode> compile(const Ref<NexusParser::NexusASTPackage>& p_package);
+};
+
+#endif //NEXUS_COMPILER_H
@@ -0,0 +1,142 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include "opcode_ngrams.h"
+#include "../core/io/file_access_server.h"
+
+static_assert(NexusSerializedBytecode::OPCODE_END <= 0xFF, "Opcodes are packed one per byte");
+
+static constexpr const char* opcode_names[] = {
+        "UNUSED", "LOAD_CONSTANT_I32", "LOAD_CONSTANT_I64", "LOAD_CONSTANT_U32", "LOAD_CONSTANT_U64",
+        "LOAD_CONSTANT_FP32", "LOAD_CONSTANT_FP64", "DUPLICATE", "CALL", "CALL_VIRTUAL", "LOAD_ARG", "STORE_ARG",
+        "LOAD_STACK", "STORE_STACK", "LOAD_FIELD", "STORE_FIELD", "POP", "LABEL_DECLARE", "LABEL_REMOVE", "GOTO",
+        "GOTO_IF_TRUE", "GOTO_IF_FALSE", "ADD", "SUBTRACT", "MULTIPLY", "DIVIDE", "EQUAL", "NOT_EQUAL", "LESSER",
+        "LESSER_OR_EQUAL", "GREATER", "GREATER_OR_EQUAL", "RETURN",
+#define TYPED_OPCODE_NAMES(m_name) m_name "_U32", m_name "_I32", m_name "_U64", m_name "_I64", m_name "_F32", m_name "_F64",
+        TYPED_OPCODE_NAMES("ADD") TYPED_OPCODE_NAMES("SUBTRACT") TYPED_OPCODE_NAMES("MULTIPLY") TYPED_OPCODE_NAMES("DIVIDE")
+        TYPED_OPCODE_NAMES("EQUAL") TYPED_OPCODE_NAMES("NOT_EQUAL") TYPED_OPCODE_NAMES("LESSER")
+        TYPED_OPCODE_NAMES("LESSER_OR_EQUAL") TYPED_OPCODE_NAMES("GREATER") TYPED_OPCODE_NAMES("GREATER_OR_EQUAL")
+#undef TYPED_OPCODE_NAMES
+};
+static_assert(sizeof(opcode_names) / sizeof(*opcode_names) == NexusSerializedBytecode::OPCODE_END,
+              "Every opcode needs a name");
+
+OpcodeNGramCounter::OpcodeNGramCounter(const uint32_t &p_length) : length(p_length) {
+    if (length == 0 || length > MAX_LENGTH) throw Exception("N-gram length out of range");
+}
+
+const char *OpcodeNGramCounter::get_opcode_name(const OpCode &p_opcode) {
+    return p_opcode < NexusSerializedBytecode::OPCODE_END ? opcode_names[p_opcode] : "INVALID";
+}
+
+void OpcodeNGramCounter::add_sequence(const Vector<OpCode> &p_opcodes) {
+    if (p_opcodes.size() < length) return;
+    const uint64_t mask = length == MAX_LENGTH ? ~uint64_t(0) : (uint64_t(1) << (length * 8)) - 1;
+    uint64_t key = 0;
+    for (size_t i = 0; i < p_opcodes.size(); i++) {
+        key = ((key << 8) | p_opcodes[i]) & mask;
+        if (i + 1 < length) continue;
+        uint64_t count = 0;
+        counts.try_get(key, count);
+        counts[key] = count + 1;
+        total++;
+    }
+}
+
+static _FORCE_INLINE_ bool is_label(const NexusSerializedBytecode::OpCode& p_opcode) {
+    return p_opcode == NexusSerializedBytecode::OP_LABEL_DECLARE || p_opcode == NexusSerializedBytecode::OP_LABEL_REMOVE;
+}
+
+void OpcodeNGramCounter::add_method(const Ref<NexusBytecodeMethodBody> &p_body) {
+    Vector<OpCode> opcodes{};
+    for (const auto& instruction : p_body->instructions)
+        if (!is_label(instruction->opcode)) opcodes.push_back(instruction->opcode);
+    add_sequence(opcodes);
+}
+
+void OpcodeNGramCounter::add_method(const Ref<NexusMethodPointer> &p_method) {
+    Vector<OpCode> opcodes{};
+    // Iterating moves the pointer's cursor
+    auto cursor = p_method;
+    cursor->move_iterator(-1);
+    for (auto instruction = cursor->get_next_instruction(); instruction.is_valid(); instruction = cursor->get_next_instruction())
+        if (!is_label(instruction->opcode)) opcodes.push_back(instruction->opcode);
+    add_sequence(opcodes);
+}
+
+void OpcodeNGramCounter::add_bytecode(const Ref<NexusBytecode> &p_bytecode) {
+    for (const auto& body : p_bytecode->get_method_bodies()) add_method(body);
+}
+
+void OpcodeNGramCounter::add_instance(const Ref<NexusBytecodeInstance> &p_instance) {
+    auto it = p_instance->bodies_location.const_iterator();
+    while (it.move_next()) add_method(p_instance->get_method(it.get_pair().key));
+}
+
+void OpcodeNGramCounter::add_file(const VString &p_path) {
+    auto file = FileAccessServer::open(p_path, FileAccess::ACCESS_READ);
+    if (!file->is_open()) throw BytecodeException(CharString("Failed to open bytecode: ") + p_path.utf8());
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    bytecode->load_header(file);
+    bytecode->load_methods_body(file);
+    add_bytecode(bytecode);
+}
+
+uint64_t OpcodeNGramCounter::get_count(const Vector<OpCode> &p_opcodes) const {
+    if (p_opcodes.size() != length) return 0;
+    uint64_t key = 0, re = 0;
+    for (const auto& opcode : p_opcodes) key = (key << 8) | opcode;
+    counts.try_get(key, re);
+    return re;
+}
+
+Vector<OpcodeNGramCounter::NGram> OpcodeNGramCounter::get_most_frequent(const size_t &p_count) const {
+    Vector<NGram> re{};
+    auto it = counts.const_iterator();
+    struct Entry { uint64_t key; uint64_t count; };
+    Vector<Entry> sorted{};
+    while (it.move_next()) sorted.push_back({ it.get_pair().key, it.get_pair().value });
+    if (sorted.empty()) return re;
+    // Ties are broken by key, so the output is stable
+    std::sort(sorted.ptrw(), sorted.ptrw() + sorted.size(), [](const Entry& p_lhs, const Entry& p_rhs) {
+        return p_lhs.count != p_rhs.count ? p_lhs.count > p_rhs.count : p_lhs.key < p_rhs.key;
+    });
+    for (size_t i = 0; i < sorted.size() && i < p_count; i++) {
+        NGram ngram{};
+        ngram.length = length;
+        ngram.count = sorted[i].count;
+        for (uint32_t j = 0; j < length; j++)
+            ngram.opcodes[j] = OpCode((sorted[i].key >> ((length - 1 - j) * 8)) & 0xFF);
+        re.push_back(ngram);
+    }
+    return re;
+}
+
+void OpcodeNGramCounter::print(std::ostream &p_stream, const size_t &p_count) const {
+    for (const auto& ngram : get_most_frequent(p_count)) {
+        p_stream << ngram.count << " (" << (total ? double(ngram.count) * 100.0 / double(total) : 0.0) << "%)";
+        for (uint32_t i = 0; i < ngram.length; i++) p_stream << (i ? ", " : " ") << get_opcode_name(ngram.opcodes[i]);
+        p_stream << '\n';
+    }
+}
+
+int OpcodeNGramCounter::run_command(const Vector<VString> &p_arguments, const size_t &p_first, std::ostream &p_stream) {
+    if (p_arguments.size() < p_first + 3) {
+        p_stream << "Usage: --opcode-ngrams <length> <count> <file>...\n";
+        return 1;
+    }
+    const auto length = uint32_t(strtoul(p_arguments[p_first].utf8().c_str(), nullptr, 10));
+    const auto count = strtoul(p_arguments[p_first + 1].utf8().c_str(), nullptr, 10);
+    try {
+        OpcodeNGramCounter counter(length);
+        for (size_t i = p_first + 2; i < p_arguments.size(); i++) counter.add_file(p_arguments[i]);
+        counter.print(p_stream, count);
+    } catch (const Exception& e) {
+        p_stream << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#ifndef NEXUS_OPCODE_NGRAMS_H
+#define NEXUS_OPCODE_NGRAMS_H
+
+#include <ostream>
+#include "bytecode.h"
+
+// Counts how often each run of consecutive opcodes occurs, to choose the interpreter's
+// superinstructions from real bytecode. Label pseudo-instructions are skipped since they are
+// never executed, and runs do not cross method boundaries
+class OpcodeNGramCounter {
+public:
+    typedef NexusSerializedBytecode::OpCode OpCode;
+    static constexpr uint32_t MAX_LENGTH = 8;
+    struct NGram {
+        OpCode opcodes[MAX_LENGTH];
+        uint32_t length;
+        uint64_t count;
+    };
+private:
+    uint32_t length;
+    // Opcodes packed one per byte
+    HashMap<uint64_t, uint64_t> counts{};
+    uint64_t total{};
+
+    void add_sequence(const Vector<OpCode>& p_opcodes);
+public:
+    void add_method(const Ref<NexusBytecodeMethodBody>& p_body);
+    void add_method(const Ref<NexusMethodPointer>& p_method);
+    void add_bytecode(const Ref<NexusBytecode>& p_bytecode);
+    // Also works on instances loaded with LOAD_HEADER
+    void add_instance(const Ref<NexusBytecodeInstance>& p_instance);
+    // Every method of a serialized bytecode file
+    void add_file(const VString& p_path);
+
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_length() const { return length; }
+    // Number of runs counted, distinct or not
+    _NO_DISCARD_ _FORCE_INLINE_ uint64_t get_total() const { return total; }
+    _NO_DISCARD_ uint64_t get_count(const Vector<OpCode>& p_opcodes) const;
+    // Ordered by decreasing count
+    _NO_DISCARD_ Vector<NGram> get_most_frequent(const size_t& p_count) const;
+    void print(std::ostream& p_stream, const size_t& p_count) const;
+
+    static const char* get_opcode_name(const OpCode& p_opcode);
+    // Command line front end: "<length> <count> <file>...", the arguments that follow the flag in
+    // p_arguments[p_first]. Prints the most frequent runs over every file, returns the exit code.
+    // InternedString must be configured
+    static int run_command(const Vector<VString>& p_arguments, const size_t& p_first, std::ostream& p_stream);
+
+    explicit OpcodeNGramCounter(const uint32_t& p_length);
+};
+
+#endif //NEXUS_OPCODE_NGRAMS_H
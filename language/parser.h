@@ -33,6 +33,9 @@ struct NexusASTNode : public ThreadUnsafeObject {
 
         UnaryOperator,
         BinaryOperator,
+
+        Return,
+        Package,
     };
     enum OperatorType {
         OP_ADD,
@@ -79,6 +82,8 @@ struct NexusASTNode : public ThreadUnsafeObject {
 protected:
     Type type;
     explicit NexusASTNode(const Type& p_type) : type(p_type) {}
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ Type get_type() const { return type; }
 };
 
 struct IntegerValueNode : public NexusASTNode {
@@ -162,12 +167,14 @@ struct MethodDeclarationNode : public NexusASTNode {
     InternedString method_name;
     Ref<ArgumentsDeclarationNode> arguments;
     Ref<MethodBodyNode> method_body;
+    NexusStandardType return_type; // NONE for void
 
     explicit MethodDeclarationNode(const InternedString& p_method_name,
                                    const Ref<ArgumentsDeclarationNode>& p_arguments = Ref<ArgumentsDeclarationNode>::null(),
-                                   const Ref<MethodBodyNode>& p_body = Ref<MethodBodyNode>::null())
+                                   const Ref<MethodBodyNode>& p_body = Ref<MethodBodyNode>::null(),
+                                   const NexusStandardType& p_return_type = NexusStandardType::NONE)
                                    : NexusASTNode(MethodDeclaration), method_name(p_method_name),
-                                     arguments(p_arguments), method_body(p_body) {}
+                                     arguments(p_arguments), method_body(p_body), return_type(p_return_type) {}
 };
 
 struct MethodInvocationNode : public NexusASTNode {
@@ -223,10 +230,19 @@ struct BinaryOperatorNode : public NexusASTNode {
             left_operand(p_left_operand), right_operand(p_right_operand) {}
 };
 
+struct ReturnNode : public NexusASTNode {
+    Ref<NexusASTNode> value; // null for void methods
+
+    explicit ReturnNode(const Ref<NexusASTNode>& p_value = Ref<NexusASTNode>::null())
+    : NexusASTNode(Return), value(p_value) {}
+};
+
 class NexusParser {
 public:
     struct NexusASTPackage : public NexusASTNode {
         HashMap<InternedString, Ref<MethodDeclarationNode>> method_declarations{};
+
+        NexusASTPackage() : NexusASTNode(Package) {}
     };
 private:
     static HashMap<InternedString, NexusASTNode::OperatorType>* operators_map;
@@ -8,11 +8,22 @@
 #include <gtest/gtest.h>
 #endif
 
+#include <iostream>
 #include "core/cmd_handler.h"
+#include "core/types/interned_string.h"
+#include "language/opcode_ngrams.h"
 
 int main(int argc, char** argv) {
     CmdHandler::load_cmd_arguments(argc, argv);
     int result{};
+    // nexus --opcode-ngrams <length> <count> <file>...
+    if (CmdHandler::args().size() > 1 && CmdHandler::args()[1] == "--opcode-ngrams") {
+        InternedString::configure();
+        result = OpcodeNGramCounter::run_command(CmdHandler::args(), 2, std::cout);
+        InternedString::cleanup();
+        CmdHandler::cleanup();
+        return result;
+    }
 #ifdef BENCHMARKS_ENABLED
     std::cout << "-------------------------------- BENCHMARK --------------------------------\n";
     ::benchmark::Initialize(&argc, argv);
@@ -0,0 +1,228 @@
+//
+// Created by cycastic on 8/14/2023.
+//
+
+#ifndef NEXUS_CHANNEL_H
+#define NEXUS_CHANNEL_H
+
+#include <mutex>
+#include <condition_variable>
+#include "../core/types/lock_free_queue.h"
+#include "../core/types/vector.h"
+#include "task.h"
+
+// A thread blocked in send, recv or select_recv, registered with every channel it waits on
+struct ChannelThreadWaiter {
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    bool notified{};
+
+    void notify() {
+        std::unique_lock<std::mutex> guard(mutex);
+        notified = true;
+        condition.notify_one();
+    }
+    void wait() {
+        std::unique_lock<std::mutex> guard(mutex);
+        condition.wait(guard, [this] { return notified; });
+    }
+};
+
+// Threads blocked on one side of a channel, the thread counterpart of TaskWaitQueue
+class ChannelThreadWaiters {
+    std::mutex mutex{};
+    Vector<ChannelThreadWaiter*> waiters{};
+    std::atomic<uint32_t> waiter_count{0};
+public:
+    // Check readiness again after this, a change made before it may not have been notified
+    void add(ChannelThreadWaiter* p_waiter) {
+        std::unique_lock<std::mutex> guard(mutex);
+        waiters.push_back(p_waiter);
+        waiter_count.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    void remove(ChannelThreadWaiter* p_waiter) {
+        std::unique_lock<std::mutex> guard(mutex);
+        waiters.erase(p_waiter);
+        waiter_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // Call after every change that may unblock a waiter. Only costs a load while no thread is blocked
+    void notify_all() {
+        // Pairs with the fence in add(): either the waiter is seen here, or it sees the change
+        if (waiter_count.load(std::memory_order_seq_cst) == 0) return;
+        std::unique_lock<std::mutex> guard(mutex);
+        for (auto waiter : waiters) waiter->notify();
+    }
+};
+
+// Shared between a channel and its wait queues, so a stale TaskWaitQueue never outlives it
+class ChannelState : public ThreadSafeObject {
+public:
+    std::atomic<int64_t> count{0};
+    // 0 if unbounded
+    const int64_t capacity;
+    SafeFlag closed{false};
+    ChannelThreadWaiters blocked_receivers{};
+    ChannelThreadWaiters blocked_senders{};
+
+    explicit ChannelState(const int64_t& p_capacity) : capacity(p_capacity) {}
+};
+
+class ChannelReadableQueue : public TaskWaitQueue {
+    const Ref<ChannelState> state;
+public:
+    explicit ChannelReadableQueue(const Ref<ChannelState>& p_state) : state(p_state) {}
+    _NO_DISCARD_ bool is_ready() const override {
+        return state->count.load(std::memory_order_seq_cst) > 0 || state->closed.is_set();
+    }
+};
+
+class ChannelWritableQueue : public TaskWaitQueue {
+    const Ref<ChannelState> state;
+public:
+    explicit ChannelWritableQueue(const Ref<ChannelState>& p_state) : state(p_state) {}
+    _NO_DISCARD_ bool is_ready() const override {
+        return !state->capacity || state->count.load(std::memory_order_seq_cst) < state->capacity || state->closed.is_set();
+    }
+};
+
+template <class Buffer>
+struct ChannelBufferTraits {
+    static constexpr bool bounded = true;
+};
+
+template <typename T, size_t SegmentSize>
+struct ChannelBufferTraits<UnboundedSPSCQueue<T, SegmentSize>> {
+    static constexpr bool bounded = false;
+};
+
+template <typename T, size_t SegmentSize>
+struct ChannelBufferTraits<UnboundedMPMCQueue<T, SegmentSize>> {
+    static constexpr bool bounded = false;
+};
+
+// Blocks the calling thread until p_queue may be ready, registered with p_waiters meanwhile
+inline void wait_for_channel(ChannelThreadWaiters& p_waiters, const TaskWaitQueue* p_queue) {
+    ChannelThreadWaiter waiter{};
+    p_waiters.add(&waiter);
+    if (!p_queue->is_ready()) waiter.wait();
+    p_waiters.remove(&waiter);
+}
+
+// Typed channel between tasks. try_send/try_recv never block; a task that can not proceed
+// returns Task::suspend(p_state, { channel->readable() }) and is executed again once the
+// channel may have changed. SPSC buffers allow one sending and one receiving task at a time
+template <typename T, class Buffer>
+class NexusChannel : public ThreadSafeObject {
+private:
+    Buffer* buffer;
+    Ref<ChannelState> state;
+    Ref<TaskWaitQueue> readable_queue;
+    Ref<TaskWaitQueue> writable_queue;
+
+    static Buffer* make_buffer(const size_t& p_capacity){
+        if constexpr (ChannelBufferTraits<Buffer>::bounded) return new Buffer(p_capacity);
+        else return new Buffer();
+    }
+    static int64_t capacity_of(const Buffer* p_buffer){
+        if constexpr (ChannelBufferTraits<Buffer>::bounded) return int64_t(p_buffer->capacity());
+        else return 0;
+    }
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ Ref<TaskWaitQueue> readable() const { return readable_queue; }
+    _NO_DISCARD_ _FORCE_INLINE_ Ref<TaskWaitQueue> writable() const { return writable_queue; }
+    _NO_DISCARD_ _FORCE_INLINE_ ChannelState* get_state() { return state.ptr(); }
+    _NO_DISCARD_ _FORCE_INLINE_ bool is_closed() const { return state->closed.is_set(); }
+    // Approximation while senders or receivers are active
+    _NO_DISCARD_ _FORCE_INLINE_ int64_t size() const { return state->count.load(std::memory_order_acquire); }
+
+    // Fails if the channel is full or closed
+    bool try_send(const T& p_value){
+        if (is_closed() || !buffer->try_enqueue(p_value)) return false;
+        state->count.fetch_add(1, std::memory_order_seq_cst);
+        readable_queue->notify_one();
+        state->blocked_receivers.notify_all();
+        return true;
+    }
+    // Fails if the channel is empty. Values sent before close() are still delivered
+    bool try_recv(T& p_value){
+        if (!buffer->try_dequeue(p_value)) return false;
+        state->count.fetch_sub(1, std::memory_order_seq_cst);
+        if constexpr (ChannelBufferTraits<Buffer>::bounded) {
+            writable_queue->notify_one();
+            state->blocked_senders.notify_all();
+        }
+        return true;
+    }
+    // Wakes every parked task and blocked thread, which then observe is_closed()
+    void close(){
+        state->closed.set();
+        // Pairs with the fence in ChannelThreadWaiters::add
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        readable_queue->notify_all();
+        writable_queue->notify_all();
+        state->blocked_receivers.notify_all();
+        state->blocked_senders.notify_all();
+    }
+
+    // Blocking variants, for threads that do not run inside a Task
+    bool send(const T& p_value){
+        for (;;) {
+            if (try_send(p_value)) return true;
+            if (is_closed()) return false;
+            wait_for_channel(state->blocked_senders, writable_queue.ptr());
+        }
+    }
+    bool recv(T& p_value){
+        for (;;) {
+            if (try_recv(p_value)) return true;
+            if (is_closed()) return try_recv(p_value);
+            wait_for_channel(state->blocked_receivers, readable_queue.ptr());
+        }
+    }
+
+    // p_capacity is ignored by unbounded buffers
+    explicit NexusChannel(const size_t& p_capacity = 0)
+            : buffer(make_buffer(p_capacity)),
+              state(Ref<ChannelState>::make_ref(capacity_of(buffer))),
+              readable_queue(Ref<ChannelReadableQueue>::make_ref(state).template safe_cast<TaskWaitQueue>()),
+              writable_queue(Ref<ChannelWritableQueue>::make_ref(state).template safe_cast<TaskWaitQueue>()) {}
+    NexusChannel(const NexusChannel&) = delete;
+    ~NexusChannel() override { delete buffer; }
+};
+
+// Receives from the first of p_channels holding a value. Returns the index of that channel, -1 if
+// all of them are empty. A task that gets -1 suspends on every channel's readable()
+template <typename T, class... Buffers>
+int try_select_recv(T& p_value, NexusChannel<T, Buffers>&... p_channels) {
+    int index = 0;
+    auto attempt = [&p_value, &index](auto& p_channel) {
+        if (p_channel.try_recv(p_value)) return true;
+        index++;
+        return false;
+    };
+    return (attempt(p_channels) || ...) ? index : -1;
+}
+
+// Blocking variant of try_select_recv, for threads that do not run inside a Task.
+// Returns -1 once every channel is closed and drained
+template <typename T, class... Buffers>
+int select_recv(T& p_value, NexusChannel<T, Buffers>&... p_channels) {
+    for (;;) {
+        auto index = try_select_recv(p_value, p_channels...);
+        if (index >= 0) return index;
+        if ((p_channels.is_closed() && ...)) return try_select_recv(p_value, p_channels...);
+        ChannelThreadWaiter waiter{};
+        (p_channels.get_state()->blocked_receivers.add(&waiter), ...);
+        // A closed channel is always readable, only its values count until every channel is closed
+        if (!((p_channels.size() > 0) || ...) && !(p_channels.is_closed() && ...)) waiter.wait();
+        (p_channels.get_state()->blocked_receivers.remove(&waiter), ...);
+    }
+}
+
+template <typename T> using BoundedChannel = NexusChannel<T, BoundedMPMCQueue<T>>;
+template <typename T> using BoundedSPSCChannel = NexusChannel<T, BoundedSPSCQueue<T>>;
+template <typename T> using UnboundedChannel = NexusChannel<T, UnboundedMPMCQueue<T>>;
+template <typename T> using UnboundedSPSCChannel = NexusChannel<T, UnboundedSPSCQueue<T>>;
+
+#endif //NEXUS_CHANNEL_H
@@ -28,6 +28,10 @@ static void initialize_nexus_runtime(bool initialize_wcout){
         .bytecode_endian_mode = false,
         .task_scheduler_max_request_per_cycle = 3,
         .task_scheduler_starting_thread_count = 3,
+        .jit_hotness_threshold = 1000,
+        .jit_loop_threshold = 10000,
+        .jit_background_compilation = true,
+        .interpreter_register_form = true,
     };
     NexusRuntimeGlobalSettings::set_singleton(nexus_settings);
 #if defined(_WIN32) || defined(_WIN64)
@@ -44,6 +48,8 @@ static void initialize_nexus_runtime(bool initialize_wcout){
 
 static void destroy_nexus_runtime(){
     delete task_scheduler;
+    // Workers are joined, free what they released on behalf of this thread
+    BiasedObject::flush_thread();
     delete nexus_system;
     NexusRuntimeGlobalSettings::set_singleton(nullptr);
     delete nexus_settings;
@@ -0,0 +1,1313 @@
+//
+// Created by cycastic on 8/17/2023.
+//
+
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <functional>
+#include "interpreter.h"
+#include "runtime.h"
+#include "runtime_global_settings.h"
+#include "task_scheduler.h"
+#include "verifier.h"
+#include "profiler.h"
+#include "../core/types/lock_free_queue.h"
+
+typedef NexusStack::ObjectInfo ObjectInfo;
+typedef NexusInterpretedMethod::Instruction Instruction;
+
+#define NEXUS_INTERPRETER_TYPED_FORMS(X, m_op) \
+    X(m_op##_U32) X(m_op##_I32) X(m_op##_U64) X(m_op##_I64) X(m_op##_F32) X(m_op##_F64)
+// Must follow NexusSerializedBytecode::OpCode
+#define NEXUS_INTERPRETER_OPCODES(X)                                                                            \
+    X(OPCODE_UNUSED) X(OPCODE_LOAD_CONSTANT_I32) X(OPCODE_LOAD_CONSTANT_I64) X(OPCODE_LOAD_CONSTANT_U32)         \
+    X(OPCODE_LOAD_CONSTANT_U64) X(OPCODE_LOAD_CONSTANT_FP32) X(OPCODE_LOAD_CONSTANT_FP64) X(OP_DUPLICATE)        \
+    X(OP_CALL) X(OP_CALL_VIRTUAL) X(OP_LOAD_ARG) X(OP_STORE_ARG) X(OP_LOAD_STACK) X(OP_STORE_STACK)             \
+    X(OP_LOAD_FIELD) X(OP_STORE_FIELD) X(OP_POP) X(OP_LABEL_DECLARE) X(OP_LABEL_REMOVE) X(OP_GOTO)              \
+    X(OP_GOTO_IF_TRUE) X(OP_GOTO_IF_FALSE) X(OP_ADD) X(OP_SUBTRACT) X(OP_MULTIPLY) X(OP_DIVIDE)                 \
+    X(OP_EQUAL) X(OP_NOT_EQUAL) X(OP_LESSER) X(OP_LESSER_OR_EQUAL) X(OP_GREATER) X(OP_GREATER_OR_EQUAL)         \
+    X(OP_RETURN)                                                                                                  \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, OP_ADD) NEXUS_INTERPRETER_TYPED_FORMS(X, OP_SUBTRACT)                       \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, OP_MULTIPLY) NEXUS_INTERPRETER_TYPED_FORMS(X, OP_DIVIDE)                    \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, OP_EQUAL) NEXUS_INTERPRETER_TYPED_FORMS(X, OP_NOT_EQUAL)                    \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, OP_LESSER) NEXUS_INTERPRETER_TYPED_FORMS(X, OP_LESSER_OR_EQUAL)             \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, OP_GREATER) NEXUS_INTERPRETER_TYPED_FORMS(X, OP_GREATER_OR_EQUAL)
+
+// Must follow NexusInterpretedMethod::QuickenedOpCode
+#define NEXUS_INTERPRETER_QUICKENED_ARITHMETIC(X, m_op) \
+    X(m_op##_U32) X(m_op##_I32) X(m_op##_U64) X(m_op##_I64) X(m_op##_F32) X(m_op##_F64) X(m_op##_POLYMORPHIC)
+#define NEXUS_INTERPRETER_QUICKENED_OPCODES(X)                                                                  \
+    NEXUS_INTERPRETER_QUICKENED_ARITHMETIC(X, QOP_ADD) NEXUS_INTERPRETER_QUICKENED_ARITHMETIC(X, QOP_SUBTRACT)   \
+    NEXUS_INTERPRETER_QUICKENED_ARITHMETIC(X, QOP_MULTIPLY) NEXUS_INTERPRETER_QUICKENED_ARITHMETIC(X, QOP_DIVIDE)   \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_EQUAL) NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_NOT_EQUAL)                  \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_LESSER) NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_LESSER_OR_EQUAL)           \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_GREATER) NEXUS_INTERPRETER_TYPED_FORMS(X, QOP_GREATER_OR_EQUAL)         \
+    X(SOP_ADD_TO_SLOT) X(SOP_SUBTRACT_TO_SLOT) X(SOP_MULTIPLY_TO_SLOT) X(SOP_DIVIDE_TO_SLOT)                     \
+    X(SOP_EQUAL_BRANCH) X(SOP_NOT_EQUAL_BRANCH) X(SOP_LESSER_BRANCH) X(SOP_LESSER_OR_EQUAL_BRANCH)             \
+    X(SOP_GREATER_BRANCH) X(SOP_GREATER_OR_EQUAL_BRANCH) X(QOP_CALL_NATIVE)                                     \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_ADD) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_SUBTRACT)                  \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_MULTIPLY) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_DIVIDE)               \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_MOVE) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_PUSH)                     \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_EQUAL_BRANCH) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_NOT_EQUAL_BRANCH) \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_LESSER_BRANCH) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_LESSER_OR_EQUAL_BRANCH) \
+    NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_GREATER_BRANCH) NEXUS_INTERPRETER_TYPED_FORMS(X, ROP_GREATER_OR_EQUAL_BRANCH)
+
+#define VM_OPCODE_ENTRY(m_opcode) NexusSerializedBytecode::m_opcode,
+#define VM_QUICKENED_OPCODE_ENTRY(m_opcode) NexusInterpretedMethod::m_opcode,
+static constexpr uint32_t handled_opcodes[] = { NEXUS_INTERPRETER_OPCODES(VM_OPCODE_ENTRY)
+                                                NEXUS_INTERPRETER_QUICKENED_OPCODES(VM_QUICKENED_OPCODE_ENTRY) };
+#undef VM_OPCODE_ENTRY
+#undef VM_QUICKENED_OPCODE_ENTRY
+
+static constexpr bool opcodes_in_order() {
+    for (size_t i = 0; i < sizeof(handled_opcodes) / sizeof(*handled_opcodes); i++)
+        if (handled_opcodes[i] != i) return false;
+    return true;
+}
+static_assert(sizeof(handled_opcodes) / sizeof(*handled_opcodes) == NexusInterpretedMethod::QOPCODE_END,
+              "Every opcode needs a handler");
+static_assert(opcodes_in_order(), "Handlers must follow NexusSerializedBytecode::OpCode and QuickenedOpCode");
+
+// Objects are packed without padding
+template <class T>
+static _ALWAYS_INLINE_ T vm_load(const void* p_data) {
+    T re;
+    memcpy(&re, p_data, sizeof(T));
+    return re;
+}
+
+template <class T>
+static _ALWAYS_INLINE_ void vm_store(void* p_data, const T& p_value) {
+    memcpy(p_data, &p_value, sizeof(T));
+}
+
+// Copied with memcpy and never destroyed
+static _ALWAYS_INLINE_ bool vm_is_trivial(const StackItemMetadata* p_type) {
+    return (p_type->type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER &&
+            p_type->type <= NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT) ||
+           p_type->type == NexusStandardType::METHOD;
+}
+
+static _ALWAYS_INLINE_ void vm_copy_to_top(ObjectInfo*& p_sp, uint8_t*& p_mem, const ObjectInfo* p_fp, const ObjectInfo& p_source) {
+    auto type = p_source.type;
+    if (vm_is_trivial(type)) memcpy(p_mem, p_source.data, type->data_size);
+    else type->vtable->copy_constructor(type, p_mem, p_source.data);
+    *p_sp = ObjectInfo{ .type = type, .data = p_mem, .index = size_t(p_sp - p_fp) };
+    p_sp++;
+    p_mem += type->data_size;
+}
+
+template <bool Unchecked>
+static _ALWAYS_INLINE_ void vm_store_top(ObjectInfo*& p_sp, uint8_t*& p_mem, const ObjectInfo& p_target) {
+    const auto& top = p_sp[-1];
+    if constexpr (!Unchecked) {
+        if (unlikely(top.type != p_target.type)) throw InterpreterException("Can not store a value of incompatible type");
+    }
+    if (vm_is_trivial(top.type)) memcpy(p_target.data, top.data, top.type->data_size);
+    else {
+        top.type->vtable->op_assign(top.type, p_target.data, top.data);
+        top.type->vtable->destructor(top.type, top.data);
+    }
+    p_sp--;
+    p_mem = (uint8_t*)p_sp->data;
+}
+
+static _ALWAYS_INLINE_ void vm_pop(ObjectInfo*& p_sp, uint8_t*& p_mem) {
+    p_sp--;
+    if (!vm_is_trivial(p_sp->type)) p_sp->type->vtable->destructor(p_sp->type, p_sp->data);
+    p_mem = (uint8_t*)p_sp->data;
+}
+
+static _ALWAYS_INLINE_ bool vm_is_true(const ObjectInfo& p_object) {
+    switch (p_object.type->type) {
+        case NexusStandardType::UNSIGNED_32_BIT_INTEGER:
+        case NexusStandardType::SIGNED_32_BIT_INTEGER:
+            return vm_load<uint32_t>(p_object.data) != 0;
+        case NexusStandardType::UNSIGNED_64_BIT_INTEGER:
+        case NexusStandardType::SIGNED_64_BIT_INTEGER:
+            return vm_load<uint64_t>(p_object.data) != 0;
+        case NexusStandardType::METHOD:
+            return vm_load<size_t>(p_object.data) != 0;
+        case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT:
+            return vm_load<float>(p_object.data) != 0.0f;
+        case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT:
+            return vm_load<double>(p_object.data) != 0.0;
+        default:
+            throw InterpreterException("Condition must be numeric");
+    }
+}
+
+// Integers wrap around instead of overflowing
+struct VMAdd {
+    template <class T> _ALWAYS_INLINE_ T operator()(const T& p_lhs, const T& p_rhs) const {
+        if constexpr (std::is_integral_v<T>) return T(std::make_unsigned_t<T>(p_lhs) + std::make_unsigned_t<T>(p_rhs));
+        else return p_lhs + p_rhs;
+    }
+};
+struct VMSubtract {
+    template <class T> _ALWAYS_INLINE_ T operator()(const T& p_lhs, const T& p_rhs) const {
+        if constexpr (std::is_integral_v<T>) return T(std::make_unsigned_t<T>(p_lhs) - std::make_unsigned_t<T>(p_rhs));
+        else return p_lhs - p_rhs;
+    }
+};
+struct VMMultiply {
+    template <class T> _ALWAYS_INLINE_ T operator()(const T& p_lhs, const T& p_rhs) const {
+        if constexpr (std::is_integral_v<T>) return T(std::make_unsigned_t<T>(p_lhs) * std::make_unsigned_t<T>(p_rhs));
+        else return p_lhs * p_rhs;
+    }
+};
+struct VMDivide {
+    template <class T> _ALWAYS_INLINE_ T operator()(const T& p_lhs, const T& p_rhs) const {
+        if constexpr (std::is_integral_v<T>) {
+            if (unlikely(p_rhs == 0)) throw InterpreterException("Division by zero");
+            // MIN / -1 traps
+            if constexpr (std::is_signed_v<T>) if (p_rhs == -1) return T(std::make_unsigned_t<T>(0) - std::make_unsigned_t<T>(p_lhs));
+        }
+        return p_lhs / p_rhs;
+    }
+};
+
+template <class T, class Op>
+static _ALWAYS_INLINE_ void vm_binary(void* p_result, const void* p_lhs, const void* p_rhs, const Op& p_op) {
+    vm_store<T>(p_result, p_op(vm_load<T>(p_lhs), vm_load<T>(p_rhs)));
+}
+
+// Operands are of p_type, p_result may alias either of them
+template <class Op>
+static _ALWAYS_INLINE_ void vm_arithmetic(const NexusStandardType& p_type, void* p_result, const void* p_lhs, const void* p_rhs, const Op& p_op) {
+    switch (p_type) {
+        case NexusStandardType::UNSIGNED_32_BIT_INTEGER: vm_binary<uint32_t>(p_result, p_lhs, p_rhs, p_op); return;
+        case NexusStandardType::SIGNED_32_BIT_INTEGER: vm_binary<int32_t>(p_result, p_lhs, p_rhs, p_op); return;
+        case NexusStandardType::UNSIGNED_64_BIT_INTEGER: vm_binary<uint64_t>(p_result, p_lhs, p_rhs, p_op); return;
+        case NexusStandardType::SIGNED_64_BIT_INTEGER: vm_binary<int64_t>(p_result, p_lhs, p_rhs, p_op); return;
+        case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT: vm_binary<float>(p_result, p_lhs, p_rhs, p_op); return;
+        case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT: vm_binary<double>(p_result, p_lhs, p_rhs, p_op); return;
+        default: throw InterpreterException("Operator not supported for this type");
+    }
+}
+
+// Result is stored into p_lhs
+template <class Op>
+static _ALWAYS_INLINE_ void vm_arithmetic(const ObjectInfo& p_lhs, const ObjectInfo& p_rhs, const Op& p_op) {
+    if (unlikely(p_lhs.type != p_rhs.type)) throw InterpreterException("Operands are of different types");
+    vm_arithmetic(p_lhs.type->type, p_lhs.data, p_lhs.data, p_rhs.data, p_op);
+}
+
+template <class Op>
+static _ALWAYS_INLINE_ bool vm_compare(const NexusStandardType& p_type, const void* p_lhs, const void* p_rhs, const Op& p_op) {
+    switch (p_type) {
+        case NexusStandardType::UNSIGNED_32_BIT_INTEGER: return p_op(vm_load<uint32_t>(p_lhs), vm_load<uint32_t>(p_rhs));
+        case NexusStandardType::SIGNED_32_BIT_INTEGER: return p_op(vm_load<int32_t>(p_lhs), vm_load<int32_t>(p_rhs));
+        case NexusStandardType::UNSIGNED_64_BIT_INTEGER: return p_op(vm_load<uint64_t>(p_lhs), vm_load<uint64_t>(p_rhs));
+        case NexusStandardType::SIGNED_64_BIT_INTEGER: return p_op(vm_load<int64_t>(p_lhs), vm_load<int64_t>(p_rhs));
+        case NexusStandardType::SINGLE_PRECISION_FLOATING_POINT: return p_op(vm_load<float>(p_lhs), vm_load<float>(p_rhs));
+        case NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT: return p_op(vm_load<double>(p_lhs), vm_load<double>(p_rhs));
+        default: throw InterpreterException("Operator not supported for this type");
+    }
+}
+
+template <class Op>
+static _ALWAYS_INLINE_ bool vm_compare(const ObjectInfo& p_lhs, const ObjectInfo& p_rhs, const Op& p_op) {
+    if (unlikely(p_lhs.type != p_rhs.type)) throw InterpreterException("Operands are of different types");
+    return vm_compare(p_lhs.type->type, p_lhs.data, p_rhs.data, p_op);
+}
+
+static _ALWAYS_INLINE_ bool vm_is_numeric(const StackItemMetadata* p_type) {
+    return p_type && p_type->type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER &&
+           p_type->type <= NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT;
+}
+
+static _ALWAYS_INLINE_ bool vm_is_constant(const uint32_t& p_opcode) {
+    return p_opcode >= NexusSerializedBytecode::OPCODE_LOAD_CONSTANT_I32 &&
+           p_opcode <= NexusSerializedBytecode::OPCODE_LOAD_CONSTANT_FP64;
+}
+
+static_assert(NexusSerializedBytecode::OP_ADD_U32 + 10 * NexusInterpretedMethod::REGISTER_FORMS == NexusSerializedBytecode::OPCODE_END,
+              "Typed opcodes come in one form per numeric type");
+
+// Quickened form a typed opcode of the bytecode decodes to, p_opcode itself for any other
+static uint32_t decode_typed_opcode(const uint32_t& p_opcode) {
+    if (p_opcode < NexusSerializedBytecode::OP_ADD_U32) return p_opcode;
+    constexpr uint32_t arithmetic = NexusSerializedBytecode::OP_DIVIDE - NexusSerializedBytecode::OP_ADD + 1;
+    const auto family = (p_opcode - NexusSerializedBytecode::OP_ADD_U32) / NexusInterpretedMethod::REGISTER_FORMS;
+    const auto form = (p_opcode - NexusSerializedBytecode::OP_ADD_U32) % NexusInterpretedMethod::REGISTER_FORMS;
+    return family < arithmetic ? NexusInterpretedMethod::QOP_ADD_U32 + family * NexusInterpretedMethod::QUICKENED_FORMS + form
+                               : NexusInterpretedMethod::QOP_EQUAL_U32 + (family - arithmetic) * NexusInterpretedMethod::REGISTER_FORMS + form;
+}
+
+// Frame slot, temporary or constant named by a ROP_* operand. Constants are only ever read
+static _ALWAYS_INLINE_ void* vm_register(const uint16_t& p_register, const ObjectInfo* p_fp, uint64_t* p_temporaries,
+                                         const uint64_t* p_constants) {
+    if (p_register < NexusInterpretedMethod::FIRST_TEMPORARY) return p_fp[p_register].data;
+    if (p_register < NexusInterpretedMethod::FIRST_CONSTANT) return p_temporaries + (p_register - NexusInterpretedMethod::FIRST_TEMPORARY);
+    return const_cast<uint64_t*>(p_constants) + (p_register - NexusInterpretedMethod::FIRST_CONSTANT);
+}
+
+static const StackItemMetadata* resolve_slot_type(const NexusTypeInfoServer* p_type_info_server, const NexusStandardType& p_type) {
+    if (p_type == NexusStandardType::STACK_STRUCT || p_type >= NexusStandardType::NONE)
+        throw BytecodeException("Arguments and locals must be of a primitive type");
+    auto re = p_type_info_server->get_primitive_metadata(p_type);
+    if (!re) throw BytecodeException("Can not find metadata for primitive type");
+    return re;
+}
+
+static void expect_operand(const NexusBytecodeRawInstruction* p_instruction, const NexusStandardType& p_type) {
+    if (p_instruction->arguments.empty() || p_instruction->arguments[0]->type != p_type)
+        throw BytecodeException("Missing or malformed operand");
+}
+
+template <class T>
+static _ALWAYS_INLINE_ T operand_of(const NexusBytecodeRawInstruction* p_instruction) {
+    return p_instruction->arguments[0]->get_data<T>();
+}
+
+static_assert(sizeof(Instruction) == 32, "Instructions must stay two per cache line");
+
+NexusInterpretedMethod::NexusInterpretedMethod(const Ref<NexusMethodPointer> &p_method_pointer) {
+    auto type_info_server = p_method_pointer->get_type_info_server();
+    method_name = p_method_pointer->get_method_metadata()->method_name;
+    max_stack = p_method_pointer->get_max_stack();
+    for (const auto& argument : p_method_pointer->get_arguments())
+        argument_types.push_back(resolve_slot_type(type_info_server, argument->type));
+    for (const auto& local : p_method_pointer->get_locals())
+        local_types.push_back(resolve_slot_type(type_info_server, local->type));
+    // Label pseudo-instructions are dropped, each label maps to the instruction that follows it
+    HashMap<InternedString, uint32_t> labels{};
+    Vector<Ref<NexusBytecodeRawInstruction>> raw_instructions{};
+    // Iterating moves the pointer's cursor
+    auto cursor = p_method_pointer;
+    cursor->move_iterator(-1);
+    for (auto raw = cursor->get_next_instruction(); raw.is_valid(); raw = cursor->get_next_instruction()) {
+        switch (raw->opcode) {
+            case NexusSerializedBytecode::OP_LABEL_DECLARE:
+                expect_operand(raw.ptr(), NexusStandardType::STRING_LITERAL);
+                if (labels.has(operand_of<InternedString>(raw.ptr()))) throw BytecodeException("Label declared more than once");
+                labels[operand_of<InternedString>(raw.ptr())] = raw_instructions.size();
+                break;
+            case NexusSerializedBytecode::OP_LABEL_REMOVE:
+                // Labels are scoped to the whole method
+                expect_operand(raw.ptr(), NexusStandardType::STRING_LITERAL);
+                break;
+            default:
+                if (raw->opcode >= NexusSerializedBytecode::OPCODE_END) throw BytecodeException("Invalid opcode");
+                raw_instructions.push_back(raw);
+                break;
+        }
+    }
+    instructions_count = raw_instructions.size();
+    for (const auto& entry : p_method_pointer->get_exception_handlers()) {
+        ExceptionRange range{};
+        if (!labels.try_get(entry.try_begin, range.begin) || !labels.try_get(entry.try_end, range.end) ||
+            !labels.try_get(entry.handler, range.handler)) throw BytecodeException("Exception handler refers to an undeclared label");
+        if (range.begin > range.end) throw BytecodeException("Exception handler range ends before it begins");
+        exception_table.push_back(range);
+    }
+    Vector<InternedString> names{};
+    Vector<const NexusNativeMethod*> natives{};
+    auto runtime = NexusRuntime::get_singleton();
+
+    // Records are kept two per cache line
+    auto bytes = sizeof(Instruction) * (instructions_count + 1);
+    instructions = (Instruction*)aligned_alloc(CACHE_LINE_SIZE, (bytes + CACHE_LINE_SIZE - 1) & ~size_t(CACHE_LINE_SIZE - 1));
+    if (!instructions) throw InterpreterException("Failed to allocate instructions");
+    for (uint32_t i = 0; i <= instructions_count; i++) {
+        auto& instruction = *new (&instructions[i]) Instruction();
+        instruction.operand.u64 = 0;
+        instruction.metadata = nullptr;
+        instruction.opcode = i < instructions_count ? decode_typed_opcode(raw_instructions[i]->opcode) : NexusSerializedBytecode::OP_RETURN;
+        instruction.handler = nullptr;
+        instruction.back_edges = 0;
+    }
+    try {
+        for (uint32_t i = 0; i < instructions_count; i++) {
+            const auto raw = raw_instructions[i].ptr();
+            auto& instruction = instructions[i];
+            switch (raw->opcode) {
+#define DECODE_CONSTANT(m_opcode, m_standard_type, m_field, m_type)                     \
+                case NexusSerializedBytecode::m_opcode:                                 \
+                    expect_operand(raw, m_standard_type);                               \
+                    instruction.operand.m_field = operand_of<m_type>(raw);              \
+                    instruction.metadata = resolve_slot_type(type_info_server, m_standard_type); \
+                    break;
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_I32, NexusStandardType::SIGNED_32_BIT_INTEGER, i32, int32_t)
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_I64, NexusStandardType::SIGNED_64_BIT_INTEGER, i64, int64_t)
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_U32, NexusStandardType::UNSIGNED_32_BIT_INTEGER, u32, uint32_t)
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_U64, NexusStandardType::UNSIGNED_64_BIT_INTEGER, u64, uint64_t)
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_FP32, NexusStandardType::SINGLE_PRECISION_FLOATING_POINT, f32, float)
+                DECODE_CONSTANT(OPCODE_LOAD_CONSTANT_FP64, NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT, f64, double)
+#undef DECODE_CONSTANT
+                case NexusSerializedBytecode::OP_GOTO:
+                case NexusSerializedBytecode::OP_GOTO_IF_TRUE:
+                case NexusSerializedBytecode::OP_GOTO_IF_FALSE: {
+                    expect_operand(raw, NexusStandardType::STRING_LITERAL);
+                    uint32_t target{};
+                    if (!labels.try_get(operand_of<InternedString>(raw), target)) throw BytecodeException("Branch to an undeclared label");
+                    instruction.operand.i32 = int32_t(target) - int32_t(i);
+                    break;
+                }
+                case NexusSerializedBytecode::OP_CALL:
+                case NexusSerializedBytecode::OP_CALL_VIRTUAL:
+                    expect_operand(raw, NexusStandardType::STRING_LITERAL);
+                    names.push_back(operand_of<InternedString>(raw));
+                    instruction.operand.u32 = names.size() - 1;
+                    // Natives are registered before any bytecode is loaded, so they resolve once, here
+                    natives.push_back(raw->opcode == NexusSerializedBytecode::OP_CALL && runtime ? runtime->get_native_method(names.last()) : nullptr);
+                    if (natives.last()) instruction.opcode.store(QOP_CALL_NATIVE, std::memory_order_relaxed);
+                    break;
+                case NexusSerializedBytecode::OP_LOAD_ARG:
+                case NexusSerializedBytecode::OP_STORE_ARG:
+                    expect_operand(raw, NexusStandardType::UNSIGNED_32_BIT_INTEGER);
+                    instruction.operand.u32 = operand_of<uint32_t>(raw);
+                    if (instruction.operand.u32 >= argument_types.size()) throw BytecodeException("Argument index out of range");
+                    instruction.metadata = argument_types[instruction.operand.u32];
+                    break;
+                case NexusSerializedBytecode::OP_LOAD_STACK:
+                case NexusSerializedBytecode::OP_STORE_STACK:
+                case NexusSerializedBytecode::OP_LOAD_FIELD:
+                case NexusSerializedBytecode::OP_STORE_FIELD:
+                    expect_operand(raw, NexusStandardType::UNSIGNED_32_BIT_INTEGER);
+                    instruction.operand.u32 = operand_of<uint32_t>(raw);
+                    break;
+                default:
+                    break;
+            }
+        }
+        call_sites_count = names.size();
+        call_sites = new CallSite[call_sites_count];
+        for (uint32_t i = 0; i < call_sites_count; i++) {
+            call_sites[i].name = names[i];
+            call_sites[i].native = natives[i];
+        }
+        NexusBytecodeVerifier::verify(this, type_info_server);
+        const auto settings = NexusRuntimeGlobalSettings::get_settings();
+        const auto boundaries = get_block_boundaries();
+        if (verified && (!settings || settings->interpreter_register_form)) translate_to_registers(boundaries);
+        fuse_superinstructions(boundaries);
+        if (verified) quicken_verified();
+    } catch (...) {
+        free(instructions);
+        instructions = nullptr;
+        delete[] call_sites;
+        call_sites = nullptr;
+        delete[] register_constants;
+        register_constants = nullptr;
+        throw;
+    }
+    // Verified methods only ever run in the unchecked variant of the interpreter
+    auto dispatch_table = NexusInterpreter::get_dispatch_table(verified);
+    for (uint32_t i = 0; i <= instructions_count; i++) {
+        instructions[i].handler = dispatch_table ? dispatch_table[instructions[i].opcode.load(std::memory_order_relaxed)] : nullptr;
+    }
+}
+
+const StackItemMetadata* NexusInterpretedMethod::get_slot_type(const uint32_t &p_index) const {
+    if (p_index < argument_types.size()) return argument_types[p_index];
+    if (p_index < argument_types.size() + local_types.size()) return local_types[p_index - argument_types.size()];
+    return nullptr;
+}
+
+Vector<bool> NexusInterpretedMethod::get_block_boundaries() const {
+    Vector<bool> boundaries{};
+    for (uint32_t i = 0; i <= instructions_count; i++) boundaries.push_back(false);
+    for (uint32_t i = 0; i < instructions_count; i++) {
+        auto opcode = instructions[i].opcode.load(std::memory_order_relaxed);
+        if (opcode >= NexusSerializedBytecode::OP_GOTO && opcode <= NexusSerializedBytecode::OP_GOTO_IF_FALSE)
+            boundaries.ptrw()[i + instructions[i].operand.i32] = true;
+    }
+    for (const auto& range : exception_table) {
+        auto flags = boundaries.ptrw();
+        flags[range.begin] = flags[range.end] = flags[range.handler] = true;
+    }
+    return boundaries;
+}
+
+void NexusInterpretedMethod::fuse_superinstructions(const Vector<bool>& p_boundaries) {
+    // Type of the value pushed by a fusable load, nullptr otherwise
+    auto operand_type = [this](const Instruction& p_instruction) -> const StackItemMetadata* {
+        auto opcode = p_instruction.opcode.load(std::memory_order_relaxed);
+        if (vm_is_constant(opcode)) return p_instruction.metadata;
+        if (opcode == NexusSerializedBytecode::OP_LOAD_STACK || opcode == NexusSerializedBytecode::OP_LOAD_ARG)
+            return get_slot_type(p_instruction.operand.u32);
+        return nullptr;
+    };
+    // The fused instructions stay in place: the superinstruction reads their operands and skips them
+    for (uint32_t i = 0; i + 3 < instructions_count; i++) {
+        auto& head = instructions[i];
+        auto head_opcode = head.opcode.load(std::memory_order_relaxed);
+        if (head_opcode != NexusSerializedBytecode::OP_LOAD_STACK && head_opcode != NexusSerializedBytecode::OP_LOAD_ARG) continue;
+        // The superinstruction faults and is caught at the head, and a sequence entered midway is not fused
+        if (p_boundaries[i + 1] || p_boundaries[i + 2] || p_boundaries[i + 3]) continue;
+        auto type = operand_type(head);
+        if (!vm_is_numeric(type) || operand_type(instructions[i + 1]) != type) continue;
+        // Typed arithmetic and comparisons fuse like their generic opcode, the superinstruction is
+        // specialized for the operands anyway
+        auto op = get_generic_opcode(instructions[i + 2].opcode.load(std::memory_order_relaxed));
+        auto tail = instructions[i + 3].opcode.load(std::memory_order_relaxed);
+        uint32_t fused = QOPCODE_END;
+        if (op >= NexusSerializedBytecode::OP_ADD && op <= NexusSerializedBytecode::OP_DIVIDE &&
+            tail == NexusSerializedBytecode::OP_STORE_STACK && get_slot_type(instructions[i + 3].operand.u32) == type)
+            fused = SOP_ADD_TO_SLOT + (op - NexusSerializedBytecode::OP_ADD);
+        else if (op >= NexusSerializedBytecode::OP_EQUAL && op <= NexusSerializedBytecode::OP_GREATER_OR_EQUAL &&
+                 (tail == NexusSerializedBytecode::OP_GOTO_IF_TRUE || tail == NexusSerializedBytecode::OP_GOTO_IF_FALSE))
+            fused = SOP_EQUAL_BRANCH + (op - NexusSerializedBytecode::OP_EQUAL);
+        if (fused == QOPCODE_END) continue;
+        head.metadata = type;
+        head.opcode.store(fused, std::memory_order_relaxed);
+        i += 3;
+    }
+}
+
+void NexusInterpretedMethod::translate_to_registers(const Vector<bool>& p_boundaries) {
+    // Value of the evaluation stack while translating a block, held in a register
+    struct Value {
+        uint16_t reg;
+        NexusStandardType type;
+        // Instructions computing it that no register instruction stands for yet
+        uint8_t covered;
+        // Block index of the instruction writing it, for temporaries
+        uint32_t producer;
+    };
+    struct Translated {
+        uint32_t opcode;
+        RegisterOperands registers;
+        // Branches only
+        uint32_t target;
+    };
+    const auto slot_count = uint32_t(argument_types.size() + local_types.size());
+    auto form_of = [](const NexusStandardType& p_type) { return uint32_t(p_type - NexusStandardType::UNSIGNED_32_BIT_INTEGER); };
+    auto is_temporary = [](const uint16_t& p_register) { return p_register >= FIRST_TEMPORARY && p_register < FIRST_CONSTANT; };
+    Vector<uint64_t> constants{};
+    uint32_t start = 0;
+    while (start < instructions_count) {
+        if (stack_states[start].depth == StackState::UNREACHABLE) {
+            start++;
+            continue;
+        }
+        const auto constants_before = constants.size();
+        // Above the evaluation stack the block starts with, which it never touches
+        Vector<Value> values{};
+        Vector<Translated> block{};
+        auto end = start;
+        for (; end < instructions_count && end - start < MAX_BLOCK_LENGTH; end++) {
+            if (end > start && p_boundaries[end]) break;
+            const auto& instruction = instructions[end];
+            const auto opcode = get_generic_opcode(instruction.opcode.load(std::memory_order_relaxed));
+            if (vm_is_constant(opcode)) {
+                if (constants.size() > size_t(UINT16_MAX - FIRST_CONSTANT)) break;
+                constants.push_back(instruction.operand.u64);
+                values.push_back({ uint16_t(FIRST_CONSTANT + constants.size() - 1), instruction.metadata->type, 1, 0 });
+            } else if (opcode == NexusSerializedBytecode::OP_LOAD_ARG || opcode == NexusSerializedBytecode::OP_LOAD_STACK) {
+                // Evaluation slots move, only arguments and locals have a register
+                auto index = instruction.operand.u32;
+                if (index >= slot_count || index >= FIRST_TEMPORARY || !vm_is_numeric(get_slot_type(index))) break;
+                values.push_back({ uint16_t(index), get_slot_type(index)->type, 1, 0 });
+            } else if (opcode == NexusSerializedBytecode::OP_STORE_ARG || opcode == NexusSerializedBytecode::OP_STORE_STACK) {
+                auto index = instruction.operand.u32;
+                if (values.empty() || index >= slot_count || index >= FIRST_TEMPORARY) break;
+                // Loads not used yet must still see the old value
+                bool read_later = false;
+                for (size_t i = 0; i + 1 < values.size(); i++) read_later |= values[i].reg == index;
+                if (read_later) break;
+                const auto value = values.last();
+                values.pop_back();
+                if (is_temporary(value.reg) && value.producer + 1 == block.size()) {
+                    // Computed by the last instruction, which can write the slot directly
+                    auto& producer = block.ptrw()[value.producer];
+                    producer.registers.destination = uint16_t(index);
+                    producer.registers.covered++;
+                } else {
+                    block.push_back({ ROP_MOVE_U32 + form_of(value.type),
+                                      { uint16_t(index), value.reg, 0, 1, uint8_t(value.covered + 1) }, 0 });
+                }
+            } else if (opcode >= NexusSerializedBytecode::OP_ADD && opcode <= NexusSerializedBytecode::OP_DIVIDE) {
+                // Temporaries are allocated by evaluation stack depth
+                if (values.size() < 2 || values.size() - 2 >= MAX_TEMPORARIES) break;
+                const auto rhs = values.last();
+                values.pop_back();
+                const auto lhs = values.last();
+                values.pop_back();
+                const auto temporary = uint16_t(FIRST_TEMPORARY + values.size());
+                block.push_back({ ROP_ADD_U32 + (opcode - NexusSerializedBytecode::OP_ADD) * REGISTER_FORMS + form_of(lhs.type),
+                                  { temporary, lhs.reg, rhs.reg, 1, uint8_t(lhs.covered + rhs.covered + 1) }, 0 });
+                values.push_back({ temporary, lhs.type, 0, uint32_t(block.size() - 1) });
+            } else if (opcode >= NexusSerializedBytecode::OP_EQUAL && opcode <= NexusSerializedBytecode::OP_GREATER_OR_EQUAL) {
+                // Only fused with the branch consuming the result, both ways must find the stack the
+                // block started with
+                if (end + 2 - start > MAX_BLOCK_LENGTH || values.size() != 2 || p_boundaries[end + 1]) break;
+                const auto& branch = instructions[end + 1];
+                const auto branch_opcode = branch.opcode.load(std::memory_order_relaxed);
+                if (branch_opcode != NexusSerializedBytecode::OP_GOTO_IF_TRUE && branch_opcode != NexusSerializedBytecode::OP_GOTO_IF_FALSE) break;
+                const auto& lhs = values[0];
+                const auto& rhs = values[1];
+                block.push_back({ ROP_EQUAL_BRANCH_U32 + (opcode - NexusSerializedBytecode::OP_EQUAL) * REGISTER_FORMS + form_of(lhs.type),
+                                  { uint16_t(branch_opcode == NexusSerializedBytecode::OP_GOTO_IF_TRUE), lhs.reg, rhs.reg, 1,
+                                    uint8_t(lhs.covered + rhs.covered + 2) },
+                                  uint32_t(int64_t(end + 1) + branch.operand.i32) });
+                values.clear();
+                end++;
+            } else break;
+        }
+        // What is left is pushed, as the instruction after the block expects it
+        for (const auto& value : values) {
+            block.push_back({ ROP_PUSH_U32 + form_of(value.type), { 0, value.reg, 0, 1, value.covered }, 0 });
+        }
+        const auto length = end - start;
+        if (block.empty() || block.size() >= length) {
+            while (constants.size() > constants_before) constants.pop_back();
+            start++;
+            continue;
+        }
+        for (uint32_t i = 0; i < block.size(); i++) {
+            const auto& translated = block[i];
+            auto& instruction = instructions[start + i];
+            instruction.opcode.store(translated.opcode, std::memory_order_relaxed);
+            instruction.registers = translated.registers;
+            if (i + 1 == block.size()) instruction.registers.next = uint8_t(length - i);
+            if (translated.opcode >= ROP_EQUAL_BRANCH_U32) instruction.operand.i32 = int32_t(translated.target) - int32_t(start + i);
+        }
+        start = end;
+    }
+    if (constants.empty()) return;
+    register_constants = new uint64_t[constants.size()];
+    memcpy(register_constants, constants.ptr(), constants.size() * sizeof(uint64_t));
+}
+
+void NexusInterpretedMethod::quicken_verified() {
+    static constexpr uint32_t forms = QOP_SUBTRACT_U32 - QOP_ADD_U32;
+    for (uint32_t i = 0; i < instructions_count; i++) {
+        auto opcode = instructions[i].opcode.load(std::memory_order_relaxed);
+        const auto& state = stack_states[i];
+        if (opcode < NexusSerializedBytecode::OP_ADD || opcode > NexusSerializedBytecode::OP_DIVIDE ||
+            state.depth == StackState::UNREACHABLE) continue;
+        instructions[i].opcode.store(QOP_ADD_U32 + (opcode - NexusSerializedBytecode::OP_ADD) * forms +
+                                     (state.top->type - NexusStandardType::UNSIGNED_32_BIT_INTEGER), std::memory_order_relaxed);
+    }
+}
+
+uint32_t NexusInterpretedMethod::find_exception_handler(const uint32_t& p_pc) const {
+    for (const auto& range : exception_table) {
+        if (p_pc >= range.begin && p_pc < range.end) return range.handler;
+    }
+    return NO_HANDLER;
+}
+
+NexusInterpretedMethod::~NexusInterpretedMethod() {
+    free(instructions);
+    delete[] call_sites;
+    delete[] register_constants;
+    delete compiled.load(std::memory_order_acquire);
+}
+
+const NexusCompiledMethod* NexusInterpretedMethod::on_invocation() const {
+    auto code = compiled.load(std::memory_order_acquire);
+    if (likely(code != nullptr)) return code;
+    auto settings = NexusRuntimeGlobalSettings::get_settings();
+    if (!NexusJIT::is_supported() || !settings || !settings->jit_hotness_threshold) return nullptr;
+    // Stop counting once past the threshold, only the call reaching it requests compilation
+    if (invocations.load(std::memory_order_relaxed) >= settings->jit_hotness_threshold) return nullptr;
+    if (invocations.fetch_add(1, std::memory_order_relaxed) + 1 != settings->jit_hotness_threshold) return nullptr;
+    request_compilation();
+    return compiled.load(std::memory_order_acquire);
+}
+
+void NexusInterpretedMethod::request_compilation() const {
+    if (!NexusJIT::is_supported() || compilation_requested.exchange(true, std::memory_order_relaxed)) return;
+    auto settings = NexusRuntimeGlobalSettings::get_settings();
+    if (settings && settings->jit_background_compilation) {
+        // Keeps the method alive until the worker is done with it
+        auto self = Ref<NexusInterpretedMethod>::from_initialized_object(const_cast<NexusInterpretedMethod*>(this));
+        if (TaskScheduler::queue_background_work([self]() -> void {
+            self->compiled.store(NexusJIT::compile(self.ptr()), std::memory_order_release);
+        })) return;
+    }
+    compiled.store(NexusJIT::compile(this), std::memory_order_release);
+}
+
+NexusInterpreterContext::NexusInterpreterContext(const NexusTypeInfoServer *p_type_info_server) {
+    for (auto type = (unsigned char)NexusStandardType::UNSIGNED_32_BIT_INTEGER; type < NexusStandardType::NONE; type++) {
+        primitives[type] = p_type_info_server->get_primitive_metadata((NexusStandardType)type);
+        if (!primitives[type]) throw InterpreterException("Can not find metadata for primitive type, "
+                                                          "NexusTypeInfoServer might not have been initialized");
+        if (primitives[type]->data_size > max_slot_size) max_slot_size = primitives[type]->data_size;
+    }
+}
+
+// Checked, then unchecked
+static const void* const* exported_dispatch_tables[2]{};
+
+const void* const* NexusInterpreter::get_dispatch_table(const bool& p_unchecked) {
+#ifdef NEXUS_COMPUTED_GOTO
+    // Handler addresses are only visible from inside run()
+    static const bool exported = (run<false>(nullptr, nullptr), run<true>(nullptr, nullptr), true);
+    (void)exported;
+#endif
+    return exported_dispatch_tables[p_unchecked];
+}
+
+void NexusInterpreter::enter(NexusStack* p_stack, NexusInterpreterContext* p_context, const NexusInterpretedMethod* p_method) {
+    auto slots = p_method->get_local_count() + p_method->get_max_stack();
+    // Nothing is pushed before every check passed, a failed call leaves the caller intact
+    if (p_context->call_stack.size() >= MAX_CALL_DEPTH ||
+        p_stack->allocated + slots * p_context->max_slot_size > p_stack->max_stack_size) throw InterpreterException("Stack overflow");
+    p_stack->reserve_objects(p_stack->object_count() + slots);
+    auto& frame = p_stack->push_stack_frame(p_method->get_argument_count());
+    for (auto type : p_method->local_types) frame->push_empty(type);
+    p_context->call_stack.push_back({ p_method, 0 });
+}
+
+// Runs compiled code over the p_count arguments (and, for on-stack replacement, locals) starting at
+// p_objects, which must be 32 or 64 bit integers. Throws on division by zero, otherwise returns
+// NexusCompiledMethod::Status
+static uint32_t vm_call_compiled(NexusCompiledMethod::Entry p_entry, const ObjectInfo* p_objects, const size_t& p_count,
+                                 const NexusExecutionState* p_state, uint64_t& p_result,
+                                 uint64_t& p_executed, uint32_t& p_safepoint_countdown) {
+    // Locals not passed in start zeroed, as primitive constructors leave them
+    uint64_t slots[NexusJIT::MAX_SLOTS]{};
+    for (size_t i = 0; i < p_count; i++) {
+        slots[i] = p_objects[i].type->data_size == sizeof(uint64_t) ? vm_load<uint64_t>(p_objects[i].data)
+                                                                    : vm_load<uint32_t>(p_objects[i].data);
+    }
+    NexusJITFrame jit_frame{ .instructions_executed = 0, .state = p_state, .safepoint_countdown = p_safepoint_countdown };
+    auto status = p_entry(slots, &p_result, &jit_frame);
+    p_executed += jit_frame.instructions_executed;
+    p_safepoint_countdown = jit_frame.safepoint_countdown;
+    if (unlikely(status == NexusCompiledMethod::STATUS_DIVISION_BY_ZERO)) throw InterpreterException("Division by zero");
+    return status;
+}
+
+template <bool Unchecked>
+NexusInterpreter::RunStatus NexusInterpreter::run(NexusExecutionState *p_state, NexusInterpreterContext *p_context) {
+#ifdef NEXUS_COMPUTED_GOTO
+#define VM_LABEL_ADDRESS(m_opcode) &&handle_##m_opcode,
+    static const void* const dispatch_table[] = { NEXUS_INTERPRETER_OPCODES(VM_LABEL_ADDRESS)
+                                                  NEXUS_INTERPRETER_QUICKENED_OPCODES(VM_LABEL_ADDRESS) };
+#undef VM_LABEL_ADDRESS
+    if (!p_state) {
+        exported_dispatch_tables[Unchecked] = dispatch_table;
+        return RUN_EXITED;
+    }
+#define VM_CASE(m_opcode) handle_##m_opcode
+#define VM_QUICKENED_CASE(m_opcode) handle_##m_opcode
+#define VM_DISPATCH() { executed++; goto *ip->handler.load(std::memory_order_relaxed); }
+#define VM_HANDLER_OF(m_opcode) dispatch_table[m_opcode]
+#else
+#define VM_CASE(m_opcode) case NexusSerializedBytecode::m_opcode
+#define VM_QUICKENED_CASE(m_opcode) case NexusInterpretedMethod::m_opcode
+#define VM_DISPATCH() { executed++; goto dispatch; }
+#define VM_HANDLER_OF(m_opcode) nullptr
+#endif
+// Other tasks may be running the same instruction and see either form
+#define VM_REWRITE(m_opcode) {                                                      \
+    ip->opcode.store(m_opcode, std::memory_order_relaxed);                          \
+    ip->handler.store(VM_HANDLER_OF(m_opcode), std::memory_order_relaxed);          \
+}
+#define VM_NEXT() { ip++; VM_DISPATCH() }
+#define VM_LOAD_REGISTERS() {                                                       \
+    frame = stack->get_last_frame().ptr();                                          \
+    const auto& call_frame = context->call_stack.last();                            \
+    method = call_frame.method;                                                     \
+    ip = method->instructions + call_frame.pc;                                      \
+    fp = stack->object_info + frame->object_offset;                                 \
+    sp = stack->object_info + stack->current_object_count;                          \
+    mem = stack_begin + stack->allocated;                                           \
+    eval_base = fp + method->argument_types.size() + method->local_types.size();    \
+    limit = eval_base + method->max_stack;                                          \
+}
+#define VM_SAVE_REGISTERS() {                                                       \
+    stack->current_object_count = sp - stack->object_info;                          \
+    stack->allocated = mem - stack_begin;                                           \
+    if (size_t(peak - stack_begin) > stack->peak_allocated)                         \
+        stack->peak_allocated = peak - stack_begin;                                 \
+    frame->current_object_count = sp - fp;                                          \
+    frame->memory_offset = mem;                                                     \
+    context->call_stack.last().pc = uint32_t(ip - method->instructions);            \
+    p_state->instructions_executed += executed;                                     \
+    executed = 0;                                                                   \
+}
+// Proven by NexusBytecodeVerifier in the unchecked variant
+#define VM_REQUIRE_OPERANDS(m_count) if constexpr (!Unchecked) \
+    if (unlikely(sp - eval_base < int64_t(m_count))) throw InterpreterException("Evaluation stack underflow");
+#define VM_REQUIRE_SLOT() if constexpr (!Unchecked) \
+    if (unlikely(sp >= limit)) throw InterpreterException("Evaluation stack overflow, max_stack exceeded");
+#define VM_REQUIRE_INDEX(m_index, m_count) if constexpr (!Unchecked) \
+    if (unlikely(int64_t(m_index) >= (m_count))) throw InterpreterException("Invalid stack frame index");
+// The method now on top of the call stack may need the other variant
+#define VM_CHECK_VARIANT() if (method->verified != Unchecked) { VM_SAVE_REGISTERS() return RUN_SWITCHED; }
+#define VM_PUSHED() if (mem > peak) peak = mem;
+#define VM_SAFEPOINT()                                                              \
+    if (unlikely(p_state->group != nullptr) && --safepoint_countdown == 0) {        \
+        safepoint_countdown = SAFEPOINT_INTERVAL;                                   \
+        if (p_state->should_unwind()) {                                             \
+            VM_SAVE_REGISTERS()                                                     \
+            return RUN_CANCELLED;                                                   \
+        }                                                                           \
+    }
+// Takes the sample NexusProfiler asked for, if any
+#define VM_PROFILE(m_compiled)                                                      \
+    if (unlikely(profiler_slot->sample_requested.load(std::memory_order_relaxed))) { \
+        VM_SAVE_REGISTERS()                                                         \
+        NexusProfiler::take_sample(profiler_slot, context, m_compiled);             \
+    }
+// Counts the iteration towards the loop threshold. Past it, moves to compiled code once there is
+// some, if the loop header has an entry and nothing is left on the evaluation stack
+#define VM_BACK_EDGE() {                                                            \
+    auto back_edges = ip->back_edges.load(std::memory_order_relaxed);               \
+    if (likely(back_edges < loop_threshold)) {                                      \
+        ip->back_edges.store(back_edges + 1, std::memory_order_relaxed);            \
+        if (unlikely(back_edges + 1 == loop_threshold)) method->request_compilation(); \
+    } else if (auto code = method->get_compiled_method(); code && sp == eval_base) { \
+        osr_entry = code->get_osr_entry(uint32_t(ip + ip->operand.i32 - method->instructions)); \
+        if (osr_entry) goto on_stack_replacement;                                   \
+    }                                                                               \
+}
+#define VM_JUMP() {                                                                 \
+    if (ip->operand.i32 <= 0) {                                                     \
+        VM_SAFEPOINT()                                                              \
+        VM_PROFILE(nullptr)                                                         \
+        VM_BACK_EDGE()                                                              \
+    }                                                                               \
+    ip += ip->operand.i32;                                                          \
+    VM_DISPATCH()                                                                   \
+}
+#define VM_PUSH_RESULT(m_code, m_result)                                            \
+    if ((m_code)->get_return_type() != NexusStandardType::NONE) {                   \
+        VM_REQUIRE_SLOT()                                                           \
+        auto type = primitives[(m_code)->get_return_type()];                        \
+        if (type->data_size == sizeof(uint64_t)) vm_store<uint64_t>(mem, m_result); \
+        else vm_store<uint32_t>(mem, uint32_t(m_result));                           \
+        *sp = ObjectInfo{ .type = type, .data = mem, .index = size_t(sp - fp) };    \
+        sp++;                                                                       \
+        mem += type->data_size;                                                     \
+        VM_PUSHED()                                                                 \
+    }
+#define VM_LOAD_CONSTANT(m_field, m_type) {                                         \
+    VM_REQUIRE_SLOT()                                                               \
+    vm_store<m_type>(mem, ip->operand.m_field);                                     \
+    *sp = ObjectInfo{ .type = ip->metadata, .data = mem, .index = size_t(sp - fp) }; \
+    sp++;                                                                           \
+    mem += sizeof(m_type);                                                          \
+    VM_PUSHED()                                                                     \
+    VM_NEXT()                                                                       \
+}
+// Quickened to m_quickened plus the operand type, unless m_quickened is QOPCODE_END
+#define VM_ARITHMETIC(m_op, m_quickened) {                                          \
+    VM_REQUIRE_OPERANDS(2)                                                          \
+    vm_arithmetic(sp[-2], sp[-1], m_op);                                            \
+    if (m_quickened != NexusInterpretedMethod::QOPCODE_END)                         \
+        VM_REWRITE(m_quickened + sp[-1].type->type - NexusStandardType::UNSIGNED_32_BIT_INTEGER) \
+    sp--;                                                                           \
+    mem = (uint8_t*)sp->data;                                                       \
+    VM_NEXT()                                                                       \
+}
+// Falls back to the polymorphic form and executes it when the guard fails
+#define VM_QUICKENED_ARITHMETIC(m_op, m_standard_type, m_type, m_polymorphic) {    \
+    VM_REQUIRE_OPERANDS(2)                                                          \
+    const auto type = primitives[m_standard_type];                                  \
+    if (!Unchecked && unlikely(sp[-1].type != type || sp[-2].type != type)) {       \
+        VM_REWRITE(m_polymorphic)                                                   \
+        executed--;                                                                 \
+        VM_DISPATCH()                                                               \
+    }                                                                               \
+    vm_binary<m_type>(sp[-2].data, sp[-2].data, sp[-1].data, m_op);                 \
+    sp--;                                                                           \
+    mem = (uint8_t*)sp->data;                                                       \
+    VM_NEXT()                                                                       \
+}
+#define VM_QUICKENED_ARITHMETIC_CASES(m_name, m_op)                                                                        \
+    VM_QUICKENED_CASE(QOP_##m_name##_U32): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::UNSIGNED_32_BIT_INTEGER,         \
+                                                                   uint32_t, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_I32): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::SIGNED_32_BIT_INTEGER,           \
+                                                                   int32_t, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_U64): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::UNSIGNED_64_BIT_INTEGER,         \
+                                                                   uint64_t, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_I64): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::SIGNED_64_BIT_INTEGER,           \
+                                                                   int64_t, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_F32): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::SINGLE_PRECISION_FLOATING_POINT, \
+                                                                   float, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_F64): VM_QUICKENED_ARITHMETIC(m_op, NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT, \
+                                                                   double, NexusInterpretedMethod::QOP_##m_name##_POLYMORPHIC) \
+    VM_QUICKENED_CASE(QOP_##m_name##_POLYMORPHIC): VM_ARITHMETIC(m_op, NexusInterpretedMethod::QOPCODE_END)
+// Right hand operand of a superinstruction, an argument, a local or a constant
+#define VM_FUSED_RHS() (vm_is_constant(ip[1].opcode.load(std::memory_order_relaxed)) ?        \
+    (const void*)&ip[1].operand : (const void*)fp[ip[1].operand.u32].data)
+#define VM_FUSED_ARITHMETIC(m_op) {                                                 \
+    vm_arithmetic(ip->metadata->type, fp[ip[3].operand.u32].data,                   \
+                  fp[ip->operand.u32].data, VM_FUSED_RHS(), m_op);                  \
+    executed += 3;                                                                  \
+    ip += 4;                                                                        \
+    VM_DISPATCH()                                                                   \
+}
+#define VM_FUSED_BRANCH(m_op) {                                                     \
+    auto condition = vm_compare(ip->metadata->type, fp[ip->operand.u32].data, VM_FUSED_RHS(), m_op); \
+    executed += 3;                                                                  \
+    ip += 3;                                                                        \
+    if (condition == (ip->opcode.load(std::memory_order_relaxed) == NexusSerializedBytecode::OP_GOTO_IF_TRUE)) VM_JUMP() \
+    VM_NEXT()                                                                       \
+}
+// Operand of a ROP_* instruction
+#define VM_REGISTER(m_operand) vm_register(ip->registers.m_operand, fp, temporaries, method->register_constants)
+// Counts the stack instructions the register instruction stands for
+#define VM_REGISTER_COUNT() executed = executed + ip->registers.covered - 1;
+#define VM_REGISTER_NEXT() {                                                        \
+    VM_REGISTER_COUNT()                                                             \
+    ip += ip->registers.next;                                                       \
+    VM_DISPATCH()                                                                   \
+}
+#define VM_REGISTER_ARITHMETIC(m_op, m_standard_type, m_type) {                    \
+    vm_binary<m_type>(VM_REGISTER(destination), VM_REGISTER(lhs), VM_REGISTER(rhs), m_op); \
+    VM_REGISTER_NEXT()                                                              \
+}
+#define VM_REGISTER_MOVE(m_op, m_standard_type, m_type) {                          \
+    vm_store<m_type>(VM_REGISTER(destination), vm_load<m_type>(VM_REGISTER(lhs)));  \
+    VM_REGISTER_NEXT()                                                              \
+}
+#define VM_REGISTER_PUSH(m_op, m_standard_type, m_type) {                          \
+    vm_store<m_type>(mem, vm_load<m_type>(VM_REGISTER(lhs)));                       \
+    *sp = ObjectInfo{ .type = primitives[m_standard_type], .data = mem, .index = size_t(sp - fp) }; \
+    sp++;                                                                           \
+    mem += sizeof(m_type);                                                          \
+    VM_PUSHED()                                                                     \
+    VM_REGISTER_NEXT()                                                              \
+}
+#define VM_REGISTER_BRANCH(m_op, m_standard_type, m_type) {                        \
+    VM_REGISTER_COUNT()                                                             \
+    if (m_op(vm_load<m_type>(VM_REGISTER(lhs)), vm_load<m_type>(VM_REGISTER(rhs))) == bool(ip->registers.destination)) VM_JUMP() \
+    ip += ip->registers.next;                                                       \
+    VM_DISPATCH()                                                                   \
+}
+#define VM_REGISTER_CASES(m_name, m_handler, m_op)                                                                    \
+    VM_QUICKENED_CASE(ROP_##m_name##_U32): m_handler(m_op, NexusStandardType::UNSIGNED_32_BIT_INTEGER, uint32_t)         \
+    VM_QUICKENED_CASE(ROP_##m_name##_I32): m_handler(m_op, NexusStandardType::SIGNED_32_BIT_INTEGER, int32_t)            \
+    VM_QUICKENED_CASE(ROP_##m_name##_U64): m_handler(m_op, NexusStandardType::UNSIGNED_64_BIT_INTEGER, uint64_t)         \
+    VM_QUICKENED_CASE(ROP_##m_name##_I64): m_handler(m_op, NexusStandardType::SIGNED_64_BIT_INTEGER, int64_t)            \
+    VM_QUICKENED_CASE(ROP_##m_name##_F32): m_handler(m_op, NexusStandardType::SINGLE_PRECISION_FLOATING_POINT, float)    \
+    VM_QUICKENED_CASE(ROP_##m_name##_F64): m_handler(m_op, NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT, double)
+#define VM_COMPARE(m_op) {                                                          \
+    VM_REQUIRE_OPERANDS(2)                                                          \
+    auto result = Unchecked ? vm_compare(sp[-2].type->type, sp[-2].data, sp[-1].data, m_op) \
+                            : vm_compare(sp[-2], sp[-1], m_op);                     \
+    sp--;                                                                           \
+    sp[-1].type = u32_type;                                                         \
+    vm_store<uint32_t>(sp[-1].data, uint32_t(result));                              \
+    mem = (uint8_t*)sp[-1].data + sizeof(uint32_t);                                 \
+    VM_NEXT()                                                                       \
+}
+// Falls back to the generic comparison and executes it when the guard fails
+#define VM_QUICKENED_COMPARE(m_op, m_standard_type, m_type, m_generic) {           \
+    VM_REQUIRE_OPERANDS(2)                                                          \
+    const auto type = primitives[m_standard_type];                                  \
+    if (!Unchecked && unlikely(sp[-1].type != type || sp[-2].type != type)) {       \
+        VM_REWRITE(m_generic)                                                       \
+        executed--;                                                                 \
+        VM_DISPATCH()                                                               \
+    }                                                                               \
+    auto result = m_op(vm_load<m_type>(sp[-2].data), vm_load<m_type>(sp[-1].data)); \
+    sp--;                                                                           \
+    sp[-1].type = u32_type;                                                         \
+    vm_store<uint32_t>(sp[-1].data, uint32_t(result));                              \
+    mem = (uint8_t*)sp[-1].data + sizeof(uint32_t);                                 \
+    VM_NEXT()                                                                       \
+}
+#define VM_QUICKENED_COMPARE_CASES(m_name, m_op)                                                                          \
+    VM_QUICKENED_CASE(QOP_##m_name##_U32): VM_QUICKENED_COMPARE(m_op, NexusStandardType::UNSIGNED_32_BIT_INTEGER,          \
+                                                                uint32_t, NexusSerializedBytecode::OP_##m_name)          \
+    VM_QUICKENED_CASE(QOP_##m_name##_I32): VM_QUICKENED_COMPARE(m_op, NexusStandardType::SIGNED_32_BIT_INTEGER,            \
+                                                                int32_t, NexusSerializedBytecode::OP_##m_name)           \
+    VM_QUICKENED_CASE(QOP_##m_name##_U64): VM_QUICKENED_COMPARE(m_op, NexusStandardType::UNSIGNED_64_BIT_INTEGER,          \
+                                                                uint64_t, NexusSerializedBytecode::OP_##m_name)          \
+    VM_QUICKENED_CASE(QOP_##m_name##_I64): VM_QUICKENED_COMPARE(m_op, NexusStandardType::SIGNED_64_BIT_INTEGER,            \
+                                                                int64_t, NexusSerializedBytecode::OP_##m_name)           \
+    VM_QUICKENED_CASE(QOP_##m_name##_F32): VM_QUICKENED_COMPARE(m_op, NexusStandardType::SINGLE_PRECISION_FLOATING_POINT,  \
+                                                                float, NexusSerializedBytecode::OP_##m_name)             \
+    VM_QUICKENED_CASE(QOP_##m_name##_F64): VM_QUICKENED_COMPARE(m_op, NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT,  \
+                                                                double, NexusSerializedBytecode::OP_##m_name)
+
+    auto context = p_context;
+    auto stack = p_state->thread_stack;
+    auto runtime = NexusRuntime::get_singleton();
+    const auto primitives = context->primitives;
+    const auto u32_type = primitives[NexusStandardType::UNSIGNED_32_BIT_INTEGER];
+    auto stack_begin = (uint8_t*)stack->stack_begin;
+    auto peak = stack_begin + stack->peak_allocated;
+    uint64_t executed = 0;
+    uint32_t safepoint_countdown = 1;
+    const auto settings = NexusRuntimeGlobalSettings::get_settings();
+    const uint32_t loop_threshold = NexusJIT::is_supported() && settings && settings->jit_loop_threshold ?
+                                    settings->jit_loop_threshold : UINT32_MAX;
+    NexusCompiledMethod::Entry osr_entry{};
+    const auto profiler_slot = NexusProfiler::get_thread_slot();
+
+    // Kept in registers between sync points
+    NexusStack::Frame* frame;
+    const NexusInterpretedMethod* method;
+    const Instruction* ip;
+    ObjectInfo* fp;
+    ObjectInfo* sp;
+    ObjectInfo* eval_base;
+    ObjectInfo* limit;
+    uint8_t* mem;
+    // Values computed within a block of ROP_* instructions, nothing is left in them past its end
+    uint64_t temporaries[NexusInterpretedMethod::MAX_TEMPORARIES];
+    VM_LOAD_REGISTERS()
+
+    try {
+#ifdef NEXUS_COMPUTED_GOTO
+        VM_DISPATCH()
+#else
+        executed++;
+        dispatch:
+        switch (ip->opcode.load(std::memory_order_relaxed)) {
+#endif
+        VM_CASE(OPCODE_UNUSED):
+        // Removed at decode time
+        VM_CASE(OP_LABEL_DECLARE):
+        VM_CASE(OP_LABEL_REMOVE):
+            VM_NEXT()
+        VM_CASE(OPCODE_LOAD_CONSTANT_I32): VM_LOAD_CONSTANT(i32, int32_t)
+        VM_CASE(OPCODE_LOAD_CONSTANT_I64): VM_LOAD_CONSTANT(i64, int64_t)
+        VM_CASE(OPCODE_LOAD_CONSTANT_U32): VM_LOAD_CONSTANT(u32, uint32_t)
+        VM_CASE(OPCODE_LOAD_CONSTANT_U64): VM_LOAD_CONSTANT(u64, uint64_t)
+        VM_CASE(OPCODE_LOAD_CONSTANT_FP32): VM_LOAD_CONSTANT(f32, float)
+        VM_CASE(OPCODE_LOAD_CONSTANT_FP64): VM_LOAD_CONSTANT(f64, double)
+        VM_CASE(OP_DUPLICATE): {
+            VM_REQUIRE_OPERANDS(1)
+            VM_REQUIRE_SLOT()
+            vm_copy_to_top(sp, mem, fp, sp[-1]);
+            VM_PUSHED()
+            VM_NEXT()
+        }
+        VM_CASE(OP_LOAD_ARG): {
+            VM_REQUIRE_SLOT()
+            vm_copy_to_top(sp, mem, fp, fp[ip->operand.u32]);
+            VM_PUSHED()
+            VM_NEXT()
+        }
+        VM_CASE(OP_STORE_ARG): {
+            VM_REQUIRE_OPERANDS(1)
+            vm_store_top<Unchecked>(sp, mem, fp[ip->operand.u32]);
+            VM_NEXT()
+        }
+        VM_CASE(OP_LOAD_STACK): {
+            VM_REQUIRE_SLOT()
+            auto idx = ip->operand.u32;
+            VM_REQUIRE_INDEX(idx, sp - fp)
+            vm_copy_to_top(sp, mem, fp, fp[idx]);
+            VM_PUSHED()
+            VM_NEXT()
+        }
+        VM_CASE(OP_STORE_STACK): {
+            VM_REQUIRE_OPERANDS(1)
+            auto idx = ip->operand.u32;
+            VM_REQUIRE_INDEX(idx, sp - fp - 1)
+            vm_store_top<Unchecked>(sp, mem, fp[idx]);
+            VM_NEXT()
+        }
+        VM_CASE(OP_POP): {
+            VM_REQUIRE_OPERANDS(1)
+            vm_pop(sp, mem);
+            VM_NEXT()
+        }
+        VM_CASE(OP_GOTO): VM_JUMP()
+        VM_CASE(OP_GOTO_IF_TRUE): {
+            VM_REQUIRE_OPERANDS(1)
+            auto condition = vm_is_true(sp[-1]);
+            sp--;
+            mem = (uint8_t*)sp->data;
+            if (condition) VM_JUMP()
+            VM_NEXT()
+        }
+        VM_CASE(OP_GOTO_IF_FALSE): {
+            VM_REQUIRE_OPERANDS(1)
+            auto condition = vm_is_true(sp[-1]);
+            sp--;
+            mem = (uint8_t*)sp->data;
+            if (!condition) VM_JUMP()
+            VM_NEXT()
+        }
+        VM_CASE(OP_ADD): VM_ARITHMETIC(VMAdd(), NexusInterpretedMethod::QOP_ADD_U32)
+        VM_CASE(OP_SUBTRACT): VM_ARITHMETIC(VMSubtract(), NexusInterpretedMethod::QOP_SUBTRACT_U32)
+        VM_CASE(OP_MULTIPLY): VM_ARITHMETIC(VMMultiply(), NexusInterpretedMethod::QOP_MULTIPLY_U32)
+        VM_CASE(OP_DIVIDE): VM_ARITHMETIC(VMDivide(), NexusInterpretedMethod::QOP_DIVIDE_U32)
+        VM_QUICKENED_ARITHMETIC_CASES(ADD, VMAdd())
+        VM_QUICKENED_ARITHMETIC_CASES(SUBTRACT, VMSubtract())
+        VM_QUICKENED_ARITHMETIC_CASES(MULTIPLY, VMMultiply())
+        VM_QUICKENED_ARITHMETIC_CASES(DIVIDE, VMDivide())
+        VM_QUICKENED_CASE(SOP_ADD_TO_SLOT): VM_FUSED_ARITHMETIC(VMAdd())
+        VM_QUICKENED_CASE(SOP_SUBTRACT_TO_SLOT): VM_FUSED_ARITHMETIC(VMSubtract())
+        VM_QUICKENED_CASE(SOP_MULTIPLY_TO_SLOT): VM_FUSED_ARITHMETIC(VMMultiply())
+        VM_QUICKENED_CASE(SOP_DIVIDE_TO_SLOT): VM_FUSED_ARITHMETIC(VMDivide())
+        VM_QUICKENED_CASE(SOP_EQUAL_BRANCH): VM_FUSED_BRANCH(std::equal_to<>())
+        VM_QUICKENED_CASE(SOP_NOT_EQUAL_BRANCH): VM_FUSED_BRANCH(std::not_equal_to<>())
+        VM_QUICKENED_CASE(SOP_LESSER_BRANCH): VM_FUSED_BRANCH(std::less<>())
+        VM_QUICKENED_CASE(SOP_LESSER_OR_EQUAL_BRANCH): VM_FUSED_BRANCH(std::less_equal<>())
+        VM_QUICKENED_CASE(SOP_GREATER_BRANCH): VM_FUSED_BRANCH(std::greater<>())
+        VM_QUICKENED_CASE(SOP_GREATER_OR_EQUAL_BRANCH): VM_FUSED_BRANCH(std::greater_equal<>())
+        VM_REGISTER_CASES(ADD, VM_REGISTER_ARITHMETIC, VMAdd())
+        VM_REGISTER_CASES(SUBTRACT, VM_REGISTER_ARITHMETIC, VMSubtract())
+        VM_REGISTER_CASES(MULTIPLY, VM_REGISTER_ARITHMETIC, VMMultiply())
+        VM_REGISTER_CASES(DIVIDE, VM_REGISTER_ARITHMETIC, VMDivide())
+        VM_REGISTER_CASES(MOVE, VM_REGISTER_MOVE, )
+        VM_REGISTER_CASES(PUSH, VM_REGISTER_PUSH, )
+        VM_REGISTER_CASES(EQUAL_BRANCH, VM_REGISTER_BRANCH, std::equal_to<>())
+        VM_REGISTER_CASES(NOT_EQUAL_BRANCH, VM_REGISTER_BRANCH, std::not_equal_to<>())
+        VM_REGISTER_CASES(LESSER_BRANCH, VM_REGISTER_BRANCH, std::less<>())
+        VM_REGISTER_CASES(LESSER_OR_EQUAL_BRANCH, VM_REGISTER_BRANCH, std::less_equal<>())
+        VM_REGISTER_CASES(GREATER_BRANCH, VM_REGISTER_BRANCH, std::greater<>())
+        VM_REGISTER_CASES(GREATER_OR_EQUAL_BRANCH, VM_REGISTER_BRANCH, std::greater_equal<>())
+        VM_CASE(OP_EQUAL): VM_COMPARE(std::equal_to<>())
+        VM_CASE(OP_NOT_EQUAL): VM_COMPARE(std::not_equal_to<>())
+        VM_CASE(OP_LESSER): VM_COMPARE(std::less<>())
+        VM_CASE(OP_LESSER_OR_EQUAL): VM_COMPARE(std::less_equal<>())
+        VM_CASE(OP_GREATER): VM_COMPARE(std::greater<>())
+        VM_CASE(OP_GREATER_OR_EQUAL): VM_COMPARE(std::greater_equal<>())
+        VM_QUICKENED_COMPARE_CASES(EQUAL, std::equal_to<>())
+        VM_QUICKENED_COMPARE_CASES(NOT_EQUAL, std::not_equal_to<>())
+        VM_QUICKENED_COMPARE_CASES(LESSER, std::less<>())
+        VM_QUICKENED_COMPARE_CASES(LESSER_OR_EQUAL, std::less_equal<>())
+        VM_QUICKENED_COMPARE_CASES(GREATER, std::greater<>())
+        VM_QUICKENED_COMPARE_CASES(GREATER_OR_EQUAL, std::greater_equal<>())
+        VM_CASE(OP_CALL): {
+            const auto& call_site = method->call_sites[ip->operand.u32];
+            auto callee = call_site.target.load(std::memory_order_acquire);
+            if (unlikely(!callee)) {
+                // Racing resolvers find the same method
+                callee = runtime->get_interpreted_method(call_site.name).ptr();
+                call_site.target.store(callee, std::memory_order_release);
+            }
+            auto argc = callee->get_argument_count();
+            VM_REQUIRE_OPERANDS(argc)
+            for (size_t i = 0; i < argc; i++) {
+                if (unlikely((sp - argc)[i].type != callee->argument_types[i])) throw InterpreterException("Argument of incompatible type");
+            }
+            VM_SAFEPOINT()
+            VM_PROFILE(nullptr)
+            if (auto code = callee->on_invocation()) {
+                uint64_t result = 0;
+                auto status = vm_call_compiled(code->get_entry(), sp - argc, argc, p_state, result, executed, safepoint_countdown);
+                if (unlikely(status == NexusCompiledMethod::STATUS_CANCELLED)) {
+                    VM_SAVE_REGISTERS()
+                    return RUN_CANCELLED;
+                }
+                VM_PROFILE(callee)
+                // Integer arguments have nothing to destroy
+                if (argc) {
+                    sp -= argc;
+                    mem = (uint8_t*)sp->data;
+                }
+                VM_PUSH_RESULT(code, result)
+                VM_NEXT()
+            }
+            // Saved at the call, so a failed call is attributed to it. OP_RETURN resumes past it
+            VM_SAVE_REGISTERS()
+            enter(stack, context, callee);
+            VM_LOAD_REGISTERS()
+            VM_CHECK_VARIANT()
+            VM_DISPATCH()
+        }
+        VM_QUICKENED_CASE(QOP_CALL_NATIVE): {
+            // No frame and no safepoint, the thunk reads its arguments where they are
+            auto native = method->call_sites[ip->operand.u32].native;
+            auto argc = native->get_argument_count();
+            VM_REQUIRE_OPERANDS(argc)
+            if constexpr (!Unchecked) {
+                for (size_t i = 0; i < argc; i++) {
+                    if (unlikely((sp - argc)[i].type->type != native->get_argument_type(i))) throw InterpreterException("Argument of incompatible type");
+                }
+            }
+            uint64_t result = 0;
+            native->call(sp - argc, &result);
+            for (size_t i = 0; i < argc; i++) vm_pop(sp, mem);
+            VM_PUSH_RESULT(native, result)
+            VM_NEXT()
+        }
+        VM_CASE(OP_RETURN): {
+            VM_PROFILE(nullptr)
+            size_t returned = sp > eval_base ? 1 : 0;
+            VM_SAVE_REGISTERS()
+            stack->pop_stack_frame(returned);
+            context->call_stack.pop_back();
+            if (context->call_stack.empty()) return RUN_EXITED;
+            context->call_stack.last().pc++;
+            VM_LOAD_REGISTERS()
+            if (unlikely(sp > limit)) throw InterpreterException("Evaluation stack overflow, max_stack exceeded");
+            VM_CHECK_VARIANT()
+            VM_DISPATCH()
+        }
+        VM_CASE(OP_CALL_VIRTUAL):
+        VM_CASE(OP_LOAD_FIELD):
+        VM_CASE(OP_STORE_FIELD):
+            throw InterpreterException("Opcode not supported by the interpreter");
+        // Decoded to their quickened form, never executed
+#define VM_TYPED_CASE(m_opcode) VM_CASE(m_opcode):
+        NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_ADD) NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_SUBTRACT)
+        NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_MULTIPLY) NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_DIVIDE)
+        NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_EQUAL) NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_NOT_EQUAL)
+        NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_LESSER) NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_LESSER_OR_EQUAL)
+        NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_GREATER) NEXUS_INTERPRETER_TYPED_FORMS(VM_TYPED_CASE, OP_GREATER_OR_EQUAL)
+#undef VM_TYPED_CASE
+            throw InterpreterException("Invalid opcode");
+#ifndef NEXUS_COMPUTED_GOTO
+            default:
+                throw InterpreterException("Invalid opcode");
+        }
+#endif
+        on_stack_replacement: {
+            // Continues at the loop header with the frame's arguments and locals
+            uint64_t result = 0;
+            auto status = vm_call_compiled(osr_entry, fp, eval_base - fp, p_state, result, executed, safepoint_countdown);
+            if (unlikely(status == NexusCompiledMethod::STATUS_CANCELLED)) {
+                VM_SAVE_REGISTERS()
+                return RUN_CANCELLED;
+            }
+            VM_PROFILE(method)
+            // Leave through the implicit OP_RETURN, which the compiled code already counted
+            VM_PUSH_RESULT(method->get_compiled_method(), result)
+            ip = method->instructions + method->instructions_count;
+            executed--;
+            VM_DISPATCH()
+        }
+    } catch (...) {
+        // Leave the stack consistent, so it can be unwound or torn down. A call that already
+        // pushed the callee's frame saved the caller's registers first
+        if (frame == stack->get_last_frame().ptr()) VM_SAVE_REGISTERS()
+        p_state->exception = std::current_exception();
+        return RUN_THROWN;
+    }
+#undef VM_CASE
+#undef VM_QUICKENED_CASE
+#undef VM_DISPATCH
+#undef VM_HANDLER_OF
+#undef VM_REWRITE
+#undef VM_NEXT
+#undef VM_LOAD_REGISTERS
+#undef VM_SAVE_REGISTERS
+#undef VM_REQUIRE_OPERANDS
+#undef VM_REQUIRE_SLOT
+#undef VM_REQUIRE_INDEX
+#undef VM_CHECK_VARIANT
+#undef VM_PUSHED
+#undef VM_SAFEPOINT
+#undef VM_PROFILE
+#undef VM_BACK_EDGE
+#undef VM_JUMP
+#undef VM_PUSH_RESULT
+#undef VM_LOAD_CONSTANT
+#undef VM_ARITHMETIC
+#undef VM_QUICKENED_ARITHMETIC
+#undef VM_QUICKENED_ARITHMETIC_CASES
+#undef VM_FUSED_RHS
+#undef VM_FUSED_ARITHMETIC
+#undef VM_FUSED_BRANCH
+#undef VM_REGISTER
+#undef VM_REGISTER_COUNT
+#undef VM_REGISTER_NEXT
+#undef VM_REGISTER_ARITHMETIC
+#undef VM_REGISTER_MOVE
+#undef VM_REGISTER_PUSH
+#undef VM_REGISTER_BRANCH
+#undef VM_REGISTER_CASES
+#undef VM_COMPARE
+#undef VM_QUICKENED_COMPARE
+#undef VM_QUICKENED_COMPARE_CASES
+}
+
+Task::AsyncCallbackReturn NexusInterpreter::resume(NexusExecutionState* p_state, NexusInterpreterContext* p_context) {
+    NexusProfiler::ActiveScope profiler_scope(NexusProfiler::get_thread_slot());
+    while (true) {
+        auto status = p_context->call_stack.last().method->is_verified() ? run<true>(p_state, p_context)
+                                                                           : run<false>(p_state, p_context);
+        if (status == RUN_EXITED) return Task::EXITED_SAFELY;
+        if (status == RUN_CANCELLED) return Task::CANCELLED;
+        if (status == RUN_THROWN && !unwind(p_state, p_context)) return Task::EXCEPTION_THROWN;
+    }
+}
+
+bool NexusInterpreter::unwind(NexusExecutionState* p_state, NexusInterpreterContext* p_context) {
+    auto stack = p_state->thread_stack;
+    auto& call_stack = p_context->call_stack;
+    // Every call frame owns one NexusStack frame, counted from the top
+    const auto base = stack->frame_count() - call_stack.size();
+    for (auto depth = call_stack.size(); depth > 0; depth--) {
+        const auto& call_frame = call_stack[depth - 1];
+        auto handler = call_frame.method->find_exception_handler(call_frame.pc);
+        if (handler == NexusInterpretedMethod::NO_HANDLER) continue;
+        const auto method = call_frame.method;
+        const auto& frame = stack->get_frame_at(int64_t(base + depth - 1));
+        stack->unwind(base + depth, frame->object_offset + method->get_argument_count() + method->get_local_count());
+        while (call_stack.size() > depth) call_stack.pop_back();
+        call_stack.ptrw()[depth - 1].pc = handler;
+        p_state->exception = nullptr;
+        return true;
+    }
+    return false;
+}
+
+Task::AsyncCallbackReturn NexusInterpreter::start(NexusExecutionState* p_state, NexusInterpreterContext* p_context,
+                                                  const NexusInterpretedMethod* p_entry) {
+    auto stack = p_state->thread_stack;
+    if (stack->empty()) stack->push_stack_frame();
+    const auto& root = stack->get_last_frame();
+    auto argc = int64_t(p_entry->get_argument_count());
+    if (int64_t(root->object_count()) < argc) throw InterpreterException("Missing arguments for the entry method");
+    for (int64_t i = 0; i < argc; i++) {
+        if (root->get_at(i - argc).type != p_entry->argument_types[i]) throw InterpreterException("Argument of incompatible type");
+    }
+    if (auto code = p_entry->on_invocation()) {
+        uint64_t result = 0;
+        uint32_t safepoint_countdown = 1;
+        auto profiler_slot = NexusProfiler::get_thread_slot();
+        NexusProfiler::ActiveScope profiler_scope(profiler_slot);
+        auto status = vm_call_compiled(code->get_entry(), stack->object_info + stack->current_object_count - argc, argc,
+                                       p_state, result, p_state->instructions_executed, safepoint_countdown);
+        if (profiler_slot->sample_requested.load(std::memory_order_relaxed))
+            NexusProfiler::take_sample(profiler_slot, p_context, p_entry);
+        if (status == NexusCompiledMethod::STATUS_CANCELLED) return Task::CANCELLED;
+        auto& caller = stack->get_last_frame();
+        for (int64_t i = 0; i < argc; i++) caller->pop();
+        switch (code->get_return_type()) {
+            case NexusStandardType::UNSIGNED_32_BIT_INTEGER: caller->push(uint32_t(result)); break;
+            case NexusStandardType::SIGNED_32_BIT_INTEGER: caller->push(int32_t(result)); break;
+            case NexusStandardType::UNSIGNED_64_BIT_INTEGER: caller->push(uint64_t(result)); break;
+            case NexusStandardType::SIGNED_64_BIT_INTEGER: caller->push(int64_t(result)); break;
+            default: break;
+        }
+        return Task::EXITED_SAFELY;
+    }
+    enter(stack, p_context, p_entry);
+    return resume(p_state, p_context);
+}
+
+TupleT2<Task::AsyncCallbackReturn, Ref<Task>> NexusInterpreter::execute(NexusExecutionState *p_state) {
+    try {
+        auto context = p_state->interpreter_context;
+        if (!context) {
+            auto runtime = NexusRuntime::get_singleton();
+            if (!runtime) throw InterpreterException("NexusRuntime has not been initialized");
+            auto entry = runtime->get_interpreted_method(p_state->method_pointer->get_method_metadata()->method_name);
+            context = new NexusInterpreterContext(p_state->method_pointer->get_type_info_server());
+            p_state->interpreter_context = context;
+            return { start(p_state, context, entry.ptr()), Ref<Task>::null() };
+        }
+        return { resume(p_state, context), Ref<Task>::null() };
+    } catch (...) {
+        p_state->exception = std::current_exception();
+        return { Task::EXCEPTION_THROWN, Ref<Task>::null() };
+    }
+}
+
+void NexusInterpreter::invoke(NexusExecutionState* p_state, const NexusInterpretedMethod* p_method) {
+    auto context = p_state->interpreter_context;
+    if (!context) {
+        context = new NexusInterpreterContext(p_state->method_pointer->get_type_info_server());
+        p_state->interpreter_context = context;
+    }
+    if (!context->call_stack.empty()) throw InterpreterException("Execution state is still running a method");
+    auto status = start(p_state, context, p_method);
+    if (status == Task::CANCELLED) throw InterpreterException("Method was cancelled");
+    if (status == Task::EXCEPTION_THROWN) {
+        auto exception = p_state->exception;
+        p_state->exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
@@ -0,0 +1,314 @@
+//
+// Created by cycastic on 8/17/2023.
+//
+
+#ifndef NEXUS_INTERPRETER_H
+#define NEXUS_INTERPRETER_H
+
+#include <atomic>
+#include "../core/exception.h"
+#include "../core/types/tuple.h"
+#include "../language/bytecode.h"
+#include "nexus_stack.h"
+#include "task.h"
+#include "jit.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+// Labels as values, every handler jumps straight to the next one
+#define NEXUS_COMPUTED_GOTO
+#endif
+
+class NexusNativeMethod;
+
+class InterpreterException : public Exception {
+public:
+    explicit InterpreterException(const char* p_msg = nullptr) : Exception(p_msg) {}
+    explicit InterpreterException(const CharString& p_msg) : Exception(p_msg) {}
+};
+
+// A method decoded once for NexusInterpreter and shared by every task running it
+class NexusInterpretedMethod : public ThreadSafeObject {
+public:
+    // Opcodes only written by the interpreter.
+    // QOP_*: type specialized arithmetic, written over the generic opcode the first time it executes.
+    // Specializations follow NexusStandardType from UNSIGNED_32_BIT_INTEGER. A failed guard rewrites
+    // the instruction to *_POLYMORPHIC, which never specializes again.
+    // SOP_*: superinstructions, written at decode time over the first of four instructions that load
+    // two argument, local or constant operands of one numeric type, then either store their
+    // arithmetic result into a slot of that type (*_TO_SLOT) or branch on their comparison (*_BRANCH).
+    // QOP_CALL_NATIVE: written at decode time over OP_CALL when the callee is a NexusNativeMethod.
+    // Typed opcodes of the bytecode decode straight to their QOP_* form, comparisons included. A
+    // failed guard of a comparison rewrites it to the generic opcode.
+    // ROP_*: register form of verified methods, see translate_to_registers(). Typed like QOP_*
+    // without a polymorphic fallback, and never rewritten
+    enum QuickenedOpCode : uint32_t {
+        QOP_ADD_U32 = NexusSerializedBytecode::OPCODE_END,
+        QOP_ADD_I32, QOP_ADD_U64, QOP_ADD_I64, QOP_ADD_F32, QOP_ADD_F64, QOP_ADD_POLYMORPHIC,
+        QOP_SUBTRACT_U32, QOP_SUBTRACT_I32, QOP_SUBTRACT_U64, QOP_SUBTRACT_I64, QOP_SUBTRACT_F32, QOP_SUBTRACT_F64, QOP_SUBTRACT_POLYMORPHIC,
+        QOP_MULTIPLY_U32, QOP_MULTIPLY_I32, QOP_MULTIPLY_U64, QOP_MULTIPLY_I64, QOP_MULTIPLY_F32, QOP_MULTIPLY_F64, QOP_MULTIPLY_POLYMORPHIC,
+        QOP_DIVIDE_U32, QOP_DIVIDE_I32, QOP_DIVIDE_U64, QOP_DIVIDE_I64, QOP_DIVIDE_F32, QOP_DIVIDE_F64, QOP_DIVIDE_POLYMORPHIC,
+        QOP_EQUAL_U32, QOP_EQUAL_I32, QOP_EQUAL_U64, QOP_EQUAL_I64, QOP_EQUAL_F32, QOP_EQUAL_F64,
+        QOP_NOT_EQUAL_U32, QOP_NOT_EQUAL_I32, QOP_NOT_EQUAL_U64, QOP_NOT_EQUAL_I64, QOP_NOT_EQUAL_F32, QOP_NOT_EQUAL_F64,
+        QOP_LESSER_U32, QOP_LESSER_I32, QOP_LESSER_U64, QOP_LESSER_I64, QOP_LESSER_F32, QOP_LESSER_F64,
+        QOP_LESSER_OR_EQUAL_U32, QOP_LESSER_OR_EQUAL_I32, QOP_LESSER_OR_EQUAL_U64, QOP_LESSER_OR_EQUAL_I64,
+        QOP_LESSER_OR_EQUAL_F32, QOP_LESSER_OR_EQUAL_F64,
+        QOP_GREATER_U32, QOP_GREATER_I32, QOP_GREATER_U64, QOP_GREATER_I64, QOP_GREATER_F32, QOP_GREATER_F64,
+        QOP_GREATER_OR_EQUAL_U32, QOP_GREATER_OR_EQUAL_I32, QOP_GREATER_OR_EQUAL_U64, QOP_GREATER_OR_EQUAL_I64,
+        QOP_GREATER_OR_EQUAL_F32, QOP_GREATER_OR_EQUAL_F64,
+        SOP_ADD_TO_SLOT, SOP_SUBTRACT_TO_SLOT, SOP_MULTIPLY_TO_SLOT, SOP_DIVIDE_TO_SLOT,
+        SOP_EQUAL_BRANCH, SOP_NOT_EQUAL_BRANCH, SOP_LESSER_BRANCH, SOP_LESSER_OR_EQUAL_BRANCH,
+        SOP_GREATER_BRANCH, SOP_GREATER_OR_EQUAL_BRANCH,
+        QOP_CALL_NATIVE,
+        // destination = lhs op rhs
+        ROP_ADD_U32, ROP_ADD_I32, ROP_ADD_U64, ROP_ADD_I64, ROP_ADD_F32, ROP_ADD_F64,
+        ROP_SUBTRACT_U32, ROP_SUBTRACT_I32, ROP_SUBTRACT_U64, ROP_SUBTRACT_I64, ROP_SUBTRACT_F32, ROP_SUBTRACT_F64,
+        ROP_MULTIPLY_U32, ROP_MULTIPLY_I32, ROP_MULTIPLY_U64, ROP_MULTIPLY_I64, ROP_MULTIPLY_F32, ROP_MULTIPLY_F64,
+        ROP_DIVIDE_U32, ROP_DIVIDE_I32, ROP_DIVIDE_U64, ROP_DIVIDE_I64, ROP_DIVIDE_F32, ROP_DIVIDE_F64,
+        // destination = lhs
+        ROP_MOVE_U32, ROP_MOVE_I32, ROP_MOVE_U64, ROP_MOVE_I64, ROP_MOVE_F32, ROP_MOVE_F64,
+        // Pushes lhs onto the evaluation stack
+        ROP_PUSH_U32, ROP_PUSH_I32, ROP_PUSH_U64, ROP_PUSH_I64, ROP_PUSH_F32, ROP_PUSH_F64,
+        // Branches by operand if lhs op rhs equals destination, which is 0 or 1
+        ROP_EQUAL_BRANCH_U32, ROP_EQUAL_BRANCH_I32, ROP_EQUAL_BRANCH_U64, ROP_EQUAL_BRANCH_I64,
+        ROP_EQUAL_BRANCH_F32, ROP_EQUAL_BRANCH_F64,
+        ROP_NOT_EQUAL_BRANCH_U32, ROP_NOT_EQUAL_BRANCH_I32, ROP_NOT_EQUAL_BRANCH_U64, ROP_NOT_EQUAL_BRANCH_I64,
+        ROP_NOT_EQUAL_BRANCH_F32, ROP_NOT_EQUAL_BRANCH_F64,
+        ROP_LESSER_BRANCH_U32, ROP_LESSER_BRANCH_I32, ROP_LESSER_BRANCH_U64, ROP_LESSER_BRANCH_I64,
+        ROP_LESSER_BRANCH_F32, ROP_LESSER_BRANCH_F64,
+        ROP_LESSER_OR_EQUAL_BRANCH_U32, ROP_LESSER_OR_EQUAL_BRANCH_I32, ROP_LESSER_OR_EQUAL_BRANCH_U64,
+        ROP_LESSER_OR_EQUAL_BRANCH_I64, ROP_LESSER_OR_EQUAL_BRANCH_F32, ROP_LESSER_OR_EQUAL_BRANCH_F64,
+        ROP_GREATER_BRANCH_U32, ROP_GREATER_BRANCH_I32, ROP_GREATER_BRANCH_U64, ROP_GREATER_BRANCH_I64,
+        ROP_GREATER_BRANCH_F32, ROP_GREATER_BRANCH_F64,
+        ROP_GREATER_OR_EQUAL_BRANCH_U32, ROP_GREATER_OR_EQUAL_BRANCH_I32, ROP_GREATER_OR_EQUAL_BRANCH_U64,
+        ROP_GREATER_OR_EQUAL_BRANCH_I64, ROP_GREATER_OR_EQUAL_BRANCH_F32, ROP_GREATER_OR_EQUAL_BRANCH_F64,
+        QOPCODE_END,
+    };
+    // Numeric types, and forms of each ROP_* and typed comparison family
+    static constexpr uint32_t REGISTER_FORMS = 6;
+    // Forms of each quickened arithmetic family, the polymorphic one included
+    static constexpr uint32_t QUICKENED_FORMS = QOP_SUBTRACT_U32 - QOP_ADD_U32;
+    // Register operands below FIRST_TEMPORARY are frame slots, arguments then locals. Temporaries
+    // live in the interpreter and only hold values within one block, constants are read from the
+    // method's register constants
+    static constexpr uint16_t FIRST_TEMPORARY = 0x8000;
+    static constexpr uint16_t FIRST_CONSTANT = 0xC000;
+    static constexpr uint16_t MAX_TEMPORARIES = 16;
+    // Instructions one block may replace
+    static constexpr uint32_t MAX_BLOCK_LENGTH = UINT8_MAX;
+    union Operand {
+        int32_t i32;
+        uint32_t u32;
+        int64_t i64;
+        uint64_t u64;
+        float f32;
+        double f64;
+    };
+    struct RegisterOperands {
+        uint16_t destination;
+        uint16_t lhs;
+        uint16_t rhs;
+        // Instructions to advance by when falling through, past the rest of the block on its last one
+        uint8_t next;
+        // Stack instructions this one stands for, counted as executed
+        uint8_t covered;
+    };
+    // Fixed size record with its operand stored inline, executing it touches no other memory but the
+    // constants of ROP_* instructions
+    struct Instruction {
+        // Handler address when NEXUS_COMPUTED_GOTO is defined. Rewritten by quickening while other
+        // tasks may be executing the method, along with opcode
+        mutable std::atomic<const void*> handler;
+        // Branches hold the offset to their target, relative to the branch itself
+        Operand operand;
+        union {
+            // Type pushed by constant loads, type of the accessed argument for OP_LOAD_ARG and OP_STORE_ARG,
+            // operand type for superinstructions
+            const StackItemMetadata* metadata;
+            // ROP_* only
+            RegisterOperands registers;
+        };
+        // A NexusSerializedBytecode::OpCode or a QuickenedOpCode
+        mutable std::atomic<uint32_t> opcode;
+        // Taken backward jumps, counted on branches up to the loop threshold. Increments from
+        // concurrent tasks may be lost
+        mutable std::atomic<uint32_t> back_edges;
+    };
+    // Evaluation stack before an instruction, as inferred by NexusBytecodeVerifier
+    struct StackState {
+        static constexpr uint32_t UNREACHABLE = UINT32_MAX;
+        // As decoded, before quickening, fusion and translation to registers. Typed arithmetic and
+        // comparisons are recorded as their generic opcode
+        uint32_t opcode;
+        Operand operand;
+        // UNREACHABLE if no path leads to the instruction
+        uint32_t depth;
+        // Type of the topmost item, nullptr if the stack is empty
+        const StackItemMetadata* top;
+    };
+    struct CallSite {
+        InternedString name{};
+        // Inline cache, resolved by the first call. NexusRuntime keeps every method alive, so the
+        // steady state is a single load
+        mutable std::atomic<const NexusInterpretedMethod*> target{};
+        // Resolved at decode time for QOP_CALL_NATIVE, owned by NexusRuntime
+        const NexusNativeMethod* native{};
+    };
+    // Instructions in [begin, end) are protected by the handler at handler, which starts with an
+    // empty evaluation stack
+    struct ExceptionRange {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t handler;
+    };
+    static constexpr uint32_t NO_HANDLER = UINT32_MAX;
+private:
+    InternedString method_name{};
+    // Followed by an implicit OP_RETURN
+    Instruction* instructions{};
+    uint32_t instructions_count{};
+    // One per OP_CALL and OP_CALL_VIRTUAL, indexed by Instruction::operand
+    CallSite* call_sites{};
+    uint32_t call_sites_count{};
+    Vector<const StackItemMetadata*> argument_types{};
+    Vector<const StackItemMetadata*> local_types{};
+    uint32_t max_stack{};
+    // Only read while unwinding, innermost ranges first
+    Vector<ExceptionRange> exception_table{};
+    // Verified methods run without per instruction stack and type checks
+    bool verified{};
+    // One per instruction including the implicit OP_RETURN, empty unless verified
+    Vector<StackState> stack_states{};
+    // Constant operands of ROP_* instructions, stored like Instruction::operand
+    uint64_t* register_constants{};
+    // Calls so far, until the method is handed to NexusJIT
+    mutable std::atomic<uint32_t> invocations{};
+    // Set by the first request, a method is compiled at most once
+    mutable std::atomic<bool> compilation_requested{};
+    // nullptr until compiled, stays nullptr if NexusJIT rejected the method
+    mutable std::atomic<NexusCompiledMethod*> compiled{};
+
+    // Type of an argument or local, nullptr for evaluation slots
+    _NO_DISCARD_ const StackItemMetadata* get_slot_type(const uint32_t& p_index) const;
+    // Branch targets and the bounds and handlers of protected ranges, one flag per instruction and
+    // the implicit OP_RETURN. Decoded code may start at them but not extend over them
+    _NO_DISCARD_ Vector<bool> get_block_boundaries() const;
+    void fuse_superinstructions(const Vector<bool>& p_boundaries);
+    // Rewrites runs of loads, arithmetic, stores and compare-and-branch into ROP_* instructions over
+    // frame slots, temporaries and constants, without going through the evaluation stack. Each block
+    // is written over its first instructions, the rest stay in place but are skipped. Blocks do not
+    // extend over branch targets or the bounds of protected ranges, so every instruction of a block
+    // is found in the same handlers
+    void translate_to_registers(const Vector<bool>& p_boundaries);
+    // Rewrites arithmetic to its quickened form ahead of time, operand types are known
+    void quicken_verified();
+
+    friend class NexusInterpreter;
+    friend class NexusJIT;
+    friend class NexusBytecodeVerifier;
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ const InternedString& get_method_name() const { return method_name; }
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_instructions_count() const { return instructions_count; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_argument_count() const { return argument_types.size(); }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_local_count() const { return local_types.size(); }
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_max_stack() const { return max_stack; }
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_opcode(const uint32_t& p_index) const {
+        return instructions[p_index].opcode.load(std::memory_order_relaxed);
+    }
+    // Generic opcode of a quickened arithmetic or comparison, p_opcode itself for any other
+    _NO_DISCARD_ static constexpr uint32_t get_generic_opcode(const uint32_t& p_opcode) {
+        if (p_opcode >= QOP_ADD_U32 && p_opcode <= QOP_DIVIDE_POLYMORPHIC)
+            return NexusSerializedBytecode::OP_ADD + (p_opcode - QOP_ADD_U32) / QUICKENED_FORMS;
+        if (p_opcode >= QOP_EQUAL_U32 && p_opcode <= QOP_GREATER_OR_EQUAL_F64)
+            return NexusSerializedBytecode::OP_EQUAL + (p_opcode - QOP_EQUAL_U32) / REGISTER_FORMS;
+        return p_opcode;
+    }
+    // Operand type a quickened arithmetic or comparison is specialized for, NONE for any other
+    _NO_DISCARD_ static constexpr NexusStandardType get_specialized_type(const uint32_t& p_opcode) {
+        uint32_t form = REGISTER_FORMS;
+        if (p_opcode >= QOP_ADD_U32 && p_opcode <= QOP_DIVIDE_POLYMORPHIC) form = (p_opcode - QOP_ADD_U32) % QUICKENED_FORMS;
+        else if (p_opcode >= QOP_EQUAL_U32 && p_opcode <= QOP_GREATER_OR_EQUAL_F64) form = (p_opcode - QOP_EQUAL_U32) % REGISTER_FORMS;
+        return form < REGISTER_FORMS ? NexusStandardType(NexusStandardType::UNSIGNED_32_BIT_INTEGER + form) : NexusStandardType::NONE;
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ bool is_verified() const { return verified; }
+    _NO_DISCARD_ _FORCE_INLINE_ const StackState& get_stack_state(const uint32_t& p_index) const { return stack_states[p_index]; }
+    _NO_DISCARD_ _FORCE_INLINE_ uint32_t get_call_sites_count() const { return call_sites_count; }
+    _NO_DISCARD_ _FORCE_INLINE_ const CallSite& get_call_site(const uint32_t& p_index) const { return call_sites[p_index]; }
+    _NO_DISCARD_ _FORCE_INLINE_ const Vector<ExceptionRange>& get_exception_table() const { return exception_table; }
+    // Handler protecting the instruction at p_pc, NO_HANDLER if none
+    _NO_DISCARD_ uint32_t find_exception_handler(const uint32_t& p_pc) const;
+    _NO_DISCARD_ _FORCE_INLINE_ const NexusCompiledMethod* get_compiled_method() const {
+        return compiled.load(std::memory_order_acquire);
+    }
+    // Counts one call and requests compilation on the call that reaches the hotness threshold.
+    // Returns the machine code if it is ready
+    const NexusCompiledMethod* on_invocation() const;
+    // Hands the method to NexusJIT, in the background unless disabled by the settings.
+    // Only the first request does anything
+    void request_compilation() const;
+
+    explicit NexusInterpretedMethod(const Ref<NexusMethodPointer>& p_method_pointer);
+    NexusInterpretedMethod(const NexusInterpretedMethod&) = delete;
+    ~NexusInterpretedMethod() override;
+};
+
+// Per task state of NexusInterpreter, owned by NexusExecutionState
+struct NexusInterpreterContext {
+    struct CallFrame {
+        // Owned by NexusRuntime
+        const NexusInterpretedMethod* method;
+        // Instruction being executed, saved at the call while a callee runs
+        uint32_t pc;
+    };
+    Vector<CallFrame> call_stack{};
+    // Looked up once, NexusTypeInfoServer takes a lock on every query
+    const StackItemMetadata* primitives[NexusStandardType::MAX_TYPE]{};
+    // Largest object a frame slot may hold
+    size_t max_slot_size{};
+
+    explicit NexusInterpreterContext(const NexusTypeInfoServer* p_type_info_server);
+};
+
+// Executes bytecode methods directly on the task's NexusStack. Each call pushes a NexusStack frame
+// holding the arguments (adopted from the caller), the locals and up to max_stack evaluation slots;
+// OP_LOAD_STACK and OP_STORE_STACK index that frame from its first argument
+class NexusInterpreter {
+private:
+    enum RunStatus {
+        RUN_EXITED,
+        RUN_CANCELLED,
+        // The method on top of the call stack needs the other variant of run()
+        RUN_SWITCHED,
+        // Left in NexusExecutionState::exception, with the stack saved at the faulting instruction
+        RUN_THROWN,
+    };
+    static const void* const* get_dispatch_table(const bool& p_unchecked);
+    static void enter(NexusStack* p_stack, NexusInterpreterContext* p_context, const NexusInterpretedMethod* p_method);
+    // Unchecked runs verified methods and skips what NexusBytecodeVerifier proved
+    template <bool Unchecked>
+    static RunStatus run(NexusExecutionState* p_state, NexusInterpreterContext* p_context);
+    // Moves execution to the innermost handler covering the faulting instruction of any frame, then
+    // drops every frame above it at once. Returns false if no frame has a handler
+    static bool unwind(NexusExecutionState* p_state, NexusInterpreterContext* p_context);
+    static Task::AsyncCallbackReturn resume(NexusExecutionState* p_state, NexusInterpreterContext* p_context);
+    // Runs p_entry over the arguments on top of the stack, compiled if it can be
+    static Task::AsyncCallbackReturn start(NexusExecutionState* p_state, NexusInterpreterContext* p_context,
+                                           const NexusInterpretedMethod* p_entry);
+
+    friend class NexusInterpretedMethod;
+public:
+    // Frames without slots do not use any NexusStack memory, so recursion is bounded separately
+    static constexpr size_t MAX_CALL_DEPTH = 1 << 16;
+    // Backward branches and calls check for cancellation once every SAFEPOINT_INTERVAL times
+    static constexpr uint32_t SAFEPOINT_INTERVAL = 1024;
+
+    // Task callback. Runs the method named by the task's method pointer, which NexusRuntime must
+    // know about, over the arguments on top of the task's stack. The return value, if any, is left
+    // on top of the task's last stack frame
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> execute(NexusExecutionState* p_state);
+    // Runs p_method to completion on the calling thread, for native code calling back into bytecode.
+    // Same stack contract as execute, but throws what the method threw. p_state can run any number
+    // of methods one after the other, until one throws
+    static void invoke(NexusExecutionState* p_state, const NexusInterpretedMethod* p_method);
+};
+
+#endif //NEXUS_INTERPRETER_H
@@ -0,0 +1,357 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#include <cstring>
+#include <cstddef>
+#include <initializer_list>
+#include "jit.h"
+#include "interpreter.h"
+#ifdef NEXUS_JIT_ENABLED
+#include <sys/mman.h>
+#endif
+
+NexusCompiledMethod::~NexusCompiledMethod() {
+#ifdef NEXUS_JIT_ENABLED
+    munmap(code, code_size);
+#endif
+}
+
+#ifdef NEXUS_JIT_ENABLED
+
+typedef NexusSerializedBytecode BC;
+typedef NexusInterpretedMethod IM;
+
+class X86Emitter {
+    Vector<uint8_t> bytes{};
+public:
+    _FORCE_INLINE_ void emit(const std::initializer_list<uint8_t>& p_bytes) {
+        for (auto byte : p_bytes) bytes.push_back(byte);
+    }
+    _FORCE_INLINE_ void emit_32(const uint32_t& p_value) {
+        for (int i = 0; i < 4; i++) bytes.push_back(uint8_t(p_value >> (i * 8)));
+    }
+    _FORCE_INLINE_ void emit_64(const uint64_t& p_value) {
+        for (int i = 0; i < 8; i++) bytes.push_back(uint8_t(p_value >> (i * 8)));
+    }
+    _FORCE_INLINE_ void patch_32(const size_t& p_position, const uint32_t& p_value) {
+        auto data = bytes.ptrw();
+        for (int i = 0; i < 4; i++) data[p_position + i] = uint8_t(p_value >> (i * 8));
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t size() const { return bytes.size(); }
+    _NO_DISCARD_ _FORCE_INLINE_ const uint8_t* ptr() const { return bytes.ptr(); }
+};
+
+// A rel32 operand to be patched once its target is known
+struct JumpFixup {
+    size_t position;
+    // Instruction index, or one of the stubs below
+    uint32_t target;
+};
+
+static constexpr uint32_t QUICKENED_FORMS = IM::QOP_SUBTRACT_U32 - IM::QOP_ADD_U32;
+
+static _FORCE_INLINE_ bool is_integer(const NexusStandardType& p_type) {
+    return p_type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER && p_type <= NexusStandardType::SIGNED_64_BIT_INTEGER;
+}
+static _FORCE_INLINE_ bool is_wide(const NexusStandardType& p_type) {
+    return p_type == NexusStandardType::UNSIGNED_64_BIT_INTEGER || p_type == NexusStandardType::SIGNED_64_BIT_INTEGER;
+}
+static _FORCE_INLINE_ bool is_signed(const NexusStandardType& p_type) {
+    return p_type == NexusStandardType::SIGNED_32_BIT_INTEGER || p_type == NexusStandardType::SIGNED_64_BIT_INTEGER;
+}
+
+static uint32_t jit_safepoint(NexusJITFrame* p_frame) {
+    p_frame->safepoint_countdown = NexusInterpreter::SAFEPOINT_INTERVAL;
+    return p_frame->state && p_frame->state->should_unwind();
+}
+
+#define REX_W(m_wide) if (m_wide) emitter.emit({ 0x48 });
+
+NexusCompiledMethod* NexusJIT::compile(const NexusInterpretedMethod* p_method) {
+    const auto count = p_method->instructions_count + 1;
+    const auto argc = p_method->argument_types.size();
+    const auto slot_count = argc + p_method->local_types.size();
+    if (slot_count > MAX_SLOTS) return nullptr;
+    for (size_t i = 0; i < slot_count; i++) {
+        if (!is_integer((i < argc ? p_method->argument_types[i] : p_method->local_types[i - argc])->type)) return nullptr;
+    }
+    auto target_of = [p_method](const uint32_t& p_index) {
+        return uint32_t(int64_t(p_index) + p_method->stack_states[p_index].operand.i32);
+    };
+
+    // Stack shapes and decoded operands come from NexusBytecodeVerifier, the interpreter may have
+    // rewritten the instructions since. What is left is rejecting what can not be compiled
+    if (!p_method->verified) return nullptr;
+    // Faults in machine code are only seen at the caller, handlers stay with the interpreter
+    if (!p_method->exception_table.empty()) return nullptr;
+    Vector<bool> leaders{};
+    Vector<bool> loop_headers{};
+    for (uint32_t i = 0; i < count; i++) {
+        leaders.push_back(i == 0);
+        loop_headers.push_back(false);
+    }
+    auto return_type = NexusStandardType::MAX_TYPE;
+    for (uint32_t i = 0; i < count; i++) {
+        const auto& state = p_method->stack_states[i];
+        if (state.depth == IM::StackState::UNREACHABLE) continue;
+        if (state.top && !is_integer(state.top->type)) return nullptr;
+        switch (state.opcode) {
+            case BC::OP_LOAD_ARG:
+            case BC::OP_LOAD_STACK:
+            case BC::OP_STORE_ARG:
+            case BC::OP_STORE_STACK:
+                // Frame slots only, evaluation slots live on the machine stack
+                if (state.operand.u32 >= slot_count) return nullptr;
+                break;
+            case BC::OPCODE_LOAD_CONSTANT_I32:
+            case BC::OPCODE_LOAD_CONSTANT_I64:
+            case BC::OPCODE_LOAD_CONSTANT_U32:
+            case BC::OPCODE_LOAD_CONSTANT_U64:
+            case BC::OP_DUPLICATE:
+            case BC::OP_POP:
+            case BC::OP_ADD:
+            case BC::OP_SUBTRACT:
+            case BC::OP_MULTIPLY:
+            case BC::OP_DIVIDE:
+            case BC::OP_EQUAL:
+            case BC::OP_NOT_EQUAL:
+            case BC::OP_LESSER:
+            case BC::OP_LESSER_OR_EQUAL:
+            case BC::OP_GREATER:
+            case BC::OP_GREATER_OR_EQUAL:
+                break;
+            case BC::OP_GOTO:
+            case BC::OP_GOTO_IF_TRUE:
+            case BC::OP_GOTO_IF_FALSE: {
+                auto target = target_of(i);
+                leaders.ptrw()[target] = true;
+                if (target <= i && p_method->stack_states[target].depth == 0) loop_headers.ptrw()[target] = true;
+                if (i + 1 < count) leaders.ptrw()[i + 1] = true;
+                break;
+            }
+            case BC::OP_RETURN: {
+                auto returned = state.top ? state.top->type : NexusStandardType::NONE;
+                if (return_type != NexusStandardType::MAX_TYPE && return_type != returned) return nullptr;
+                return_type = returned;
+                if (i + 1 < count) leaders.ptrw()[i + 1] = true;
+                break;
+            }
+            default:
+                // Floating point, calls, fields
+                return nullptr;
+        }
+    }
+
+    // Stubs shared by every instruction
+    static constexpr uint32_t EPILOGUE = ~uint32_t(0);
+    static constexpr uint32_t DIVISION_BY_ZERO = ~uint32_t(1);
+    constexpr int32_t EXECUTED_OFFSET = offsetof(NexusJITFrame, instructions_executed);
+    constexpr int32_t COUNTDOWN_OFFSET = offsetof(NexusJITFrame, safepoint_countdown);
+    X86Emitter emitter{};
+    Vector<size_t> positions{};
+    Vector<JumpFixup> fixups{};
+    auto jump_to = [&](const std::initializer_list<uint8_t>& p_opcode, const uint32_t& p_target) {
+        emitter.emit(p_opcode);
+        fixups.push_back({ emitter.size(), p_target });
+        emitter.emit_32(0);
+    };
+    // Local forward jump, patched by the returned lambda's caller
+    auto safepoint = [&](const uint32_t& p_depth) {
+        emitter.emit({ 0x41, 0x83, 0xAC, 0x24 });                   // sub dword [r12 + countdown], 1
+        emitter.emit_32(COUNTDOWN_OFFSET);
+        emitter.emit({ 0x01 });
+        emitter.emit({ 0x0F, 0x85 });                               // jnz skip
+        auto skip_countdown = emitter.size();
+        emitter.emit_32(0);
+        bool realign = p_depth % 2;
+        if (realign) emitter.emit({ 0x48, 0x83, 0xEC, 0x08 });      // sub rsp, 8
+        emitter.emit({ 0x4C, 0x89, 0xE7 });                         // mov rdi, r12
+        emitter.emit({ 0x48, 0xB8 });                               // mov rax, jit_safepoint
+        emitter.emit_64(uint64_t(&jit_safepoint));
+        emitter.emit({ 0xFF, 0xD0 });                               // call rax
+        if (realign) emitter.emit({ 0x48, 0x83, 0xC4, 0x08 });      // add rsp, 8
+        emitter.emit({ 0x85, 0xC0 });                               // test eax, eax
+        emitter.emit({ 0x0F, 0x84 });                               // jz skip
+        auto skip_unwind = emitter.size();
+        emitter.emit_32(0);
+        emitter.emit({ 0xB8 });                                     // mov eax, STATUS_CANCELLED
+        emitter.emit_32(NexusCompiledMethod::STATUS_CANCELLED);
+        jump_to({ 0xE9 }, EPILOGUE);
+        emitter.patch_32(skip_countdown, uint32_t(emitter.size() - (skip_countdown + 4)));
+        emitter.patch_32(skip_unwind, uint32_t(emitter.size() - (skip_unwind + 4)));
+    };
+
+    // rbx = slots, r12 = frame, r13 = result. The machine stack is 16 byte aligned whenever the
+    // evaluation stack depth is even
+    auto prologue = [&]() {
+        emitter.emit({ 0x55, 0x48, 0x89, 0xE5 });                   // push rbp; mov rbp, rsp
+        emitter.emit({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56 }); // push rbx, r12, r13, r14
+        emitter.emit({ 0x48, 0x89, 0xFB });                         // mov rbx, rdi
+        emitter.emit({ 0x49, 0x89, 0xF5 });                         // mov r13, rsi
+        emitter.emit({ 0x49, 0x89, 0xD4 });                         // mov r12, rdx
+    };
+    prologue();
+
+    for (uint32_t i = 0; i < count; i++) {
+        positions.push_back(emitter.size());
+        const auto& state = p_method->stack_states[i];
+        if (state.depth == IM::StackState::UNREACHABLE) continue;
+        const auto operand = state.top ? state.top->type : NexusStandardType::NONE;
+        if (leaders[i]) {
+            uint32_t length = 1;
+            while (i + length < count && !leaders[i + length]) length++;
+            emitter.emit({ 0x49, 0x81, 0x84, 0x24 });               // add qword [r12 + executed], length
+            emitter.emit_32(EXECUTED_OFFSET);
+            emitter.emit_32(length);
+        }
+        const bool wide = is_wide(operand);
+        switch (state.opcode) {
+            case BC::OPCODE_LOAD_CONSTANT_I32:
+            case BC::OPCODE_LOAD_CONSTANT_U32:
+                emitter.emit({ 0xB8 });                             // mov eax, imm32
+                emitter.emit_32(state.operand.u32);
+                emitter.emit({ 0x50 });                             // push rax
+                break;
+            case BC::OPCODE_LOAD_CONSTANT_I64:
+            case BC::OPCODE_LOAD_CONSTANT_U64:
+                emitter.emit({ 0x48, 0xB8 });                       // mov rax, imm64
+                emitter.emit_64(state.operand.u64);
+                emitter.emit({ 0x50 });                             // push rax
+                break;
+            case BC::OP_LOAD_ARG:
+            case BC::OP_LOAD_STACK:
+                emitter.emit({ 0xFF, 0xB3 });                       // push qword [rbx + index * 8]
+                emitter.emit_32(state.operand.u32 * 8);
+                break;
+            case BC::OP_STORE_ARG:
+            case BC::OP_STORE_STACK:
+                emitter.emit({ 0x58, 0x48, 0x89, 0x83 });           // pop rax; mov [rbx + index * 8], rax
+                emitter.emit_32(state.operand.u32 * 8);
+                break;
+            case BC::OP_DUPLICATE:
+                emitter.emit({ 0xFF, 0x34, 0x24 });                 // push qword [rsp]
+                break;
+            case BC::OP_POP:
+                emitter.emit({ 0x48, 0x83, 0xC4, 0x08 });           // add rsp, 8
+                break;
+            case BC::OP_ADD:
+                emitter.emit({ 0x59, 0x58 });                       // pop rcx; pop rax
+                REX_W(wide) emitter.emit({ 0x01, 0xC8 });           // add rax, rcx
+                emitter.emit({ 0x50 });
+                break;
+            case BC::OP_SUBTRACT:
+                emitter.emit({ 0x59, 0x58 });
+                REX_W(wide) emitter.emit({ 0x29, 0xC8 });           // sub rax, rcx
+                emitter.emit({ 0x50 });
+                break;
+            case BC::OP_MULTIPLY:
+                emitter.emit({ 0x59, 0x58 });
+                REX_W(wide) emitter.emit({ 0x0F, 0xAF, 0xC1 });     // imul rax, rcx
+                emitter.emit({ 0x50 });
+                break;
+            case BC::OP_DIVIDE:
+                emitter.emit({ 0x59, 0x58 });
+                REX_W(wide) emitter.emit({ 0x85, 0xC9 });           // test rcx, rcx
+                jump_to({ 0x0F, 0x84 }, DIVISION_BY_ZERO);          // jz division_by_zero
+                if (is_signed(operand)) {
+                    // MIN / -1 traps, negate instead
+                    REX_W(wide) emitter.emit({ 0x83, 0xF9, 0xFF }); // cmp rcx, -1
+                    emitter.emit({ 0x75, uint8_t(wide ? 5 : 4) });  // jne divide
+                    REX_W(wide) emitter.emit({ 0xF7, 0xD8 });       // neg rax
+                    emitter.emit({ 0xEB, uint8_t(wide ? 5 : 3) });  // jmp done
+                    REX_W(wide) emitter.emit({ 0x99 });             // divide: cqo
+                    REX_W(wide) emitter.emit({ 0xF7, 0xF9 });       // idiv rcx
+                } else {
+                    emitter.emit({ 0x31, 0xD2 });                   // xor edx, edx
+                    REX_W(wide) emitter.emit({ 0xF7, 0xF1 });       // div rcx
+                }
+                emitter.emit({ 0x50 });                             // done: push rax
+                break;
+            case BC::OP_EQUAL:
+            case BC::OP_NOT_EQUAL:
+            case BC::OP_LESSER:
+            case BC::OP_LESSER_OR_EQUAL:
+            case BC::OP_GREATER:
+            case BC::OP_GREATER_OR_EQUAL: {
+                static constexpr uint8_t signed_conditions[] = { 0x94, 0x95, 0x9C, 0x9E, 0x9F, 0x9D };
+                static constexpr uint8_t unsigned_conditions[] = { 0x94, 0x95, 0x92, 0x96, 0x97, 0x93 };
+                auto condition = (is_signed(operand) ? signed_conditions : unsigned_conditions)[state.opcode - BC::OP_EQUAL];
+                emitter.emit({ 0x59, 0x58 });
+                REX_W(wide) emitter.emit({ 0x39, 0xC8 });           // cmp rax, rcx
+                emitter.emit({ 0x0F, condition, 0xC0 });            // setcc al
+                emitter.emit({ 0x0F, 0xB6, 0xC0, 0x50 });           // movzx eax, al; push rax
+                break;
+            }
+            case BC::OP_GOTO:
+                if (target_of(i) <= i) safepoint(state.depth);
+                jump_to({ 0xE9 }, target_of(i));
+                break;
+            case BC::OP_GOTO_IF_TRUE:
+            case BC::OP_GOTO_IF_FALSE: {
+                bool on_true = state.opcode == BC::OP_GOTO_IF_TRUE;
+                emitter.emit({ 0x58 });                             // pop rax
+                REX_W(wide) emitter.emit({ 0x85, 0xC0 });           // test rax, rax
+                if (target_of(i) > i) {
+                    jump_to({ 0x0F, uint8_t(on_true ? 0x85 : 0x84) }, target_of(i));
+                    break;
+                }
+                emitter.emit({ 0x0F, uint8_t(on_true ? 0x84 : 0x85) });  // not taken: skip the safepoint
+                auto skip = emitter.size();
+                emitter.emit_32(0);
+                safepoint(state.depth - 1);
+                jump_to({ 0xE9 }, target_of(i));
+                emitter.patch_32(skip, uint32_t(emitter.size() - (skip + 4)));
+                break;
+            }
+            case BC::OP_RETURN:
+                if (state.depth) emitter.emit({ 0x58, 0x49, 0x89, 0x45, 0x00 });  // pop rax; mov [r13], rax
+                emitter.emit({ 0x31, 0xC0 });                       // xor eax, eax (STATUS_RETURNED)
+                jump_to({ 0xE9 }, EPILOGUE);
+                break;
+            default:
+                return nullptr;
+        }
+    }
+    // On-stack replacement entries, the loop header's block is counted as if jumped to
+    HashMap<uint32_t, size_t> osr_entries{};
+    for (uint32_t i = 0; i < count; i++) {
+        if (!loop_headers[i]) continue;
+        osr_entries[i] = emitter.size();
+        prologue();
+        jump_to({ 0xE9 }, i);
+    }
+    auto division_by_zero = emitter.size();
+    emitter.emit({ 0xB8 });                                         // mov eax, STATUS_DIVISION_BY_ZERO
+    emitter.emit_32(NexusCompiledMethod::STATUS_DIVISION_BY_ZERO);
+    auto epilogue = emitter.size();
+    emitter.emit({ 0x48, 0x8D, 0x65, 0xE0 });                       // lea rsp, [rbp - 32]
+    emitter.emit({ 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D, 0xC3 });  // pop r14, r13, r12, rbx, rbp; ret
+
+    for (const auto& fixup : fixups) {
+        size_t target = fixup.target == EPILOGUE ? epilogue : fixup.target == DIVISION_BY_ZERO ? division_by_zero : positions[fixup.target];
+        emitter.patch_32(fixup.position, uint32_t(int64_t(target) - int64_t(fixup.position + 4)));
+    }
+
+    auto code = mmap(nullptr, emitter.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return nullptr;
+    memcpy(code, emitter.ptr(), emitter.size());
+    if (mprotect(code, emitter.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, emitter.size());
+        return nullptr;
+    }
+    auto compiled = new NexusCompiledMethod(code, emitter.size(),
+                                            return_type == NexusStandardType::MAX_TYPE ? NexusStandardType::NONE : return_type);
+    compiled->osr_entries = osr_entries;
+    return compiled;
+}
+
+#undef REX_W
+
+#else
+
+NexusCompiledMethod* NexusJIT::compile(const NexusInterpretedMethod* p_method) {
+    return nullptr;
+}
+
+#endif
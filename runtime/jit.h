@@ -0,0 +1,82 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#ifndef NEXUS_JIT_H
+#define NEXUS_JIT_H
+
+#include "../core/typedefs.h"
+#include "../core/types/vector.h"
+#include "../core/types/hashmap.h"
+#include "../language/standard_types.h"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+// System V AMD64 ABI with POSIX mmap
+#define NEXUS_JIT_ENABLED
+#endif
+
+struct NexusExecutionState;
+class NexusInterpretedMethod;
+
+// Shared with compiled code, which has the field offsets baked in
+struct NexusJITFrame {
+    uint64_t instructions_executed;
+    const NexusExecutionState* state;
+    uint32_t safepoint_countdown;
+};
+
+// Machine code of one method. Arguments and locals live in a slot array of 64 bit values (32 bit
+// values are zero extended), the evaluation stack lives on the machine stack
+class NexusCompiledMethod {
+public:
+    enum Status : uint32_t {
+        STATUS_RETURNED,
+        STATUS_CANCELLED,
+        STATUS_DIVISION_BY_ZERO,
+    };
+    typedef uint32_t (*Entry)(uint64_t* p_slots, uint64_t* p_result, NexusJITFrame* p_frame);
+private:
+    void* code;
+    size_t code_size;
+    // NONE if the method returns nothing
+    NexusStandardType return_type;
+    // Loop header instruction index to code offset, for loops entered with an empty evaluation stack.
+    // Entering there continues an interpreted call over its current arguments and locals
+    HashMap<uint32_t, size_t> osr_entries{};
+
+    friend class NexusJIT;
+    NexusCompiledMethod(void* p_code, const size_t& p_code_size, const NexusStandardType& p_return_type)
+        : code(p_code), code_size(p_code_size), return_type(p_return_type) {}
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ Entry get_entry() const { return (Entry)code; }
+    // nullptr if p_index is not a loop header
+    _NO_DISCARD_ Entry get_osr_entry(const uint32_t& p_index) const {
+        size_t offset{};
+        return osr_entries.try_get(p_index, offset) ? (Entry)((uint8_t*)code + offset) : nullptr;
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_code_size() const { return code_size; }
+    _NO_DISCARD_ _FORCE_INLINE_ NexusStandardType get_return_type() const { return return_type; }
+
+    NexusCompiledMethod(const NexusCompiledMethod&) = delete;
+    ~NexusCompiledMethod();
+};
+
+// Baseline compiler: one machine code template per opcode, no register allocation across
+// instructions. Handles methods whose arguments, locals and evaluation stack only hold 32 or 64 bit
+// integers and which do not call other methods; the interpreter runs everything else
+class NexusJIT {
+public:
+    static constexpr uint32_t MAX_SLOTS = 64;
+
+    static constexpr bool is_supported() {
+#ifdef NEXUS_JIT_ENABLED
+        return true;
+#else
+        return false;
+#endif
+    }
+    // nullptr if the method uses anything the compiler does not handle
+    static NexusCompiledMethod* compile(const NexusInterpretedMethod* p_method);
+};
+
+#endif //NEXUS_JIT_H
@@ -5,13 +5,47 @@
 #ifndef NEXUS_BUILTIN_H
 #define NEXUS_BUILTIN_H
 
-#include "../nexus_stack.h"
 #include "../nexus_output.h"
+#include "../typed_array.h"
 
-void __builtin_println(NexusStack* p_stack){
-    auto param_0 = (VString*)p_stack->get_last_frame().get_at(-1).data;
+// Registered by NexusRuntime under their own name, see NexusNativeMethod
+static void __builtin_println(const VString& p_line){
+    print_line(p_line);
+}
 
-    print_line(*param_0);
+// Registered as __builtin_array_*, GCC mangles templates named __builtin_* without their arguments.
+// Typed arrays are created by the host and passed in. Destinations come first and must match the
+// operands' type and size. Numbers are converted to and from the element type
+static int64_t builtin_array_size(const Ref<ManagedObject>& p_array){
+    return int64_t(NexusTypedArray::cast(p_array)->size());
+}
+template <class T>
+static T builtin_array_get(const Ref<ManagedObject>& p_array, int64_t p_index){
+    return NexusTypedArray::cast(p_array)->get<T>(size_t(p_index));
+}
+template <class T>
+static void builtin_array_set(const Ref<ManagedObject>& p_array, int64_t p_index, T p_value){
+    NexusTypedArray::cast(p_array)->set(size_t(p_index), p_value);
+}
+template <class T>
+static void builtin_array_fill(const Ref<ManagedObject>& p_array, T p_value){
+    NexusTypedArray::cast(p_array)->fill(p_value);
+}
+template <NexusSimd::BinaryOp Op>
+static void builtin_array_apply(const Ref<ManagedObject>& p_dst, const Ref<ManagedObject>& p_lhs, const Ref<ManagedObject>& p_rhs){
+    NexusTypedArray::cast(p_dst)->apply(Op, *NexusTypedArray::cast(p_lhs), *NexusTypedArray::cast(p_rhs));
+}
+template <NexusSimd::BinaryOp Op, class T>
+static void builtin_array_apply_scalar(const Ref<ManagedObject>& p_dst, const Ref<ManagedObject>& p_lhs, T p_value){
+    NexusTypedArray::cast(p_dst)->apply(Op, *NexusTypedArray::cast(p_lhs), p_value);
+}
+template <NexusSimd::CompareOp Op>
+static void builtin_array_compare(const Ref<ManagedObject>& p_dst, const Ref<ManagedObject>& p_lhs, const Ref<ManagedObject>& p_rhs){
+    NexusTypedArray::cast(p_dst)->compare(Op, *NexusTypedArray::cast(p_lhs), *NexusTypedArray::cast(p_rhs));
+}
+template <NexusSimd::ReduceOp Op, class T>
+static T builtin_array_reduce(const Ref<ManagedObject>& p_array){
+    return NexusTypedArray::cast(p_array)->reduce<T>(Op);
 }
 
 #endif //NEXUS_BUILTIN_H
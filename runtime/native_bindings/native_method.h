@@ -0,0 +1,140 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_NATIVE_METHOD_H
+#define NEXUS_NATIVE_METHOD_H
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include "../nexus_stack.h"
+
+// Standard type of a native argument or return value
+template <class T>
+struct NexusNativeType;
+#define NEXUS_NATIVE_TYPE(m_type, m_standard_type)                                      \
+template <>                                                                             \
+struct NexusNativeType<m_type> {                                                        \
+    static constexpr NexusStandardType type = NexusStandardType::m_standard_type;       \
+};
+NEXUS_NATIVE_TYPE(uint32_t, UNSIGNED_32_BIT_INTEGER)
+NEXUS_NATIVE_TYPE(int32_t, SIGNED_32_BIT_INTEGER)
+NEXUS_NATIVE_TYPE(uint64_t, UNSIGNED_64_BIT_INTEGER)
+NEXUS_NATIVE_TYPE(int64_t, SIGNED_64_BIT_INTEGER)
+NEXUS_NATIVE_TYPE(float, SINGLE_PRECISION_FLOATING_POINT)
+NEXUS_NATIVE_TYPE(double, DOUBLE_PRECISION_FLOATING_POINT)
+NEXUS_NATIVE_TYPE(InternedString, STRING_LITERAL)
+NEXUS_NATIVE_TYPE(VString, STRING)
+NEXUS_NATIVE_TYPE(Ref<ManagedObject>, REFERENCE_COUNTED_OBJECT)
+#undef NEXUS_NATIVE_TYPE
+
+// Numbers are copied out, objects are passed by reference to the stack slot
+template <class T>
+static _ALWAYS_INLINE_ decltype(auto) native_argument(const NexusStack::ObjectInfo& p_object) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        T re;
+        memcpy(&re, p_object.data, sizeof(T));
+        return re;
+    } else return *(const T*)p_object.data;
+}
+
+// Numbers that fit a 32 or 64 bit result slot. Only instantiated for non void types, sizeof(void) is ill formed
+template <class T>
+struct is_register_sized : std::bool_constant<std::is_arithmetic_v<T> && (sizeof(T) == sizeof(uint32_t) || sizeof(T) == sizeof(uint64_t))> {};
+
+// Marshalling for one signature: reads every argument at its fixed position and stores the return value
+template <class Signature>
+struct NexusNativeSignature;
+template <class R, class ...Args>
+struct NexusNativeSignature<R(Args...)> {
+    static_assert(std::conditional_t<std::is_void_v<R>, std::true_type, is_register_sized<R>>::value,
+                  "Native methods may only return void or a 32 or 64 bit number");
+    static constexpr NexusStandardType return_type = std::is_void_v<R> ? NexusStandardType::NONE : NexusNativeType<std::conditional_t<std::is_void_v<R>, uint32_t, R>>::type;
+
+    template <class Callable, size_t ...Indexes>
+    static _ALWAYS_INLINE_ void invoke(const Callable& p_callable, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result,
+                                       std::index_sequence<Indexes...>) {
+        if constexpr (std::is_void_v<R>) p_callable(native_argument<std::decay_t<Args>>(p_arguments[Indexes])...);
+        else {
+            R result = p_callable(native_argument<std::decay_t<Args>>(p_arguments[Indexes])...);
+            // Narrow results occupy the low half, whatever the byte order
+            if constexpr (sizeof(R) == sizeof(uint32_t)) {
+                uint32_t bits;
+                memcpy(&bits, &result, sizeof(bits));
+                *p_result = bits;
+            } else memcpy(p_result, &result, sizeof(R));
+        }
+    }
+    // Trampoline for functions only known at run time, such as library symbols
+    static void call_pointer(const void* p_function, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result) {
+        invoke((R (*)(Args...))p_function, p_arguments, p_result, std::index_sequence_for<Args...>{});
+    }
+    static Vector<NexusStandardType> get_argument_types() {
+        return { NexusNativeType<std::decay_t<Args>>::type... };
+    }
+};
+
+// Generated per function, which is called directly
+template <auto Function>
+struct NexusNativeThunk;
+template <class R, class ...Args, R (*Function)(Args...)>
+struct NexusNativeThunk<Function> : public NexusNativeSignature<R(Args...)> {
+    static void call(const void*, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result) {
+        NexusNativeSignature<R(Args...)>::invoke(Function, p_arguments, p_result, std::index_sequence_for<Args...>{});
+    }
+};
+
+// A C++ function callable from bytecode, declared as an external method (MA_EXTERNAL) and
+// registered with NexusRuntime::register_native_method or bind_library_method before the bytecode
+// is loaded
+class NexusNativeMethod : public ThreadSafeObject {
+public:
+    // Calls p_function, unless the thunk was generated for one function. Reads the arguments in
+    // place, the caller destroys them afterwards. Numbers returned are stored in p_result, in the
+    // low half if 32 bit wide
+    typedef void (*Thunk)(const void* p_function, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result);
+private:
+    const Thunk thunk;
+    const void* const function;
+    const NexusStandardType return_type;
+    const Vector<NexusStandardType> argument_types;
+    // Data behind function, if the method owns it
+    const Ref<ThreadSafeObject> closure;
+public:
+    _NO_DISCARD_ _FORCE_INLINE_ Thunk get_thunk() const { return thunk; }
+    _NO_DISCARD_ _FORCE_INLINE_ const void* get_function() const { return function; }
+    _NO_DISCARD_ _FORCE_INLINE_ NexusStandardType get_return_type() const { return return_type; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_argument_count() const { return argument_types.size(); }
+    _NO_DISCARD_ _FORCE_INLINE_ NexusStandardType get_argument_type(const size_t& p_index) const { return argument_types[p_index]; }
+
+    _FORCE_INLINE_ void call(const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result) const {
+        thunk(function, p_arguments, p_result);
+    }
+
+    template <auto Function>
+    static Ref<NexusNativeMethod> bind() {
+        using Binding = NexusNativeThunk<Function>;
+        return Ref<NexusNativeMethod>::make_ref(&Binding::call, nullptr, Binding::return_type, Binding::get_argument_types());
+    }
+    // p_function must have the C++ signature Signature
+    template <class Signature>
+    static Ref<NexusNativeMethod> bind(const void* p_function) {
+        using Binding = NexusNativeSignature<Signature>;
+        return Ref<NexusNativeMethod>::make_ref(&Binding::call_pointer, p_function, Binding::return_type, Binding::get_argument_types());
+    }
+
+    // p_thunk receives p_closure as its p_function, the method keeps it alive
+    template <class Signature>
+    static Ref<NexusNativeMethod> bind_closure(const Thunk& p_thunk, const Ref<ThreadSafeObject>& p_closure) {
+        using Binding = NexusNativeSignature<Signature>;
+        return Ref<NexusNativeMethod>::make_ref(p_thunk, p_closure.ptr(), Binding::return_type, Binding::get_argument_types(), p_closure);
+    }
+
+    NexusNativeMethod(const Thunk& p_thunk, const void* p_function, const NexusStandardType& p_return_type,
+                      const Vector<NexusStandardType>& p_argument_types,
+                      const Ref<ThreadSafeObject>& p_closure = Ref<ThreadSafeObject>::null())
+        : thunk(p_thunk), function(p_function), return_type(p_return_type), argument_types(p_argument_types), closure(p_closure) {}
+};
+
+#endif //NEXUS_NATIVE_METHOD_H
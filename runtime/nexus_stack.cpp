@@ -83,7 +83,7 @@ void NexusTypeInfoServer::add_builtin_types() {
              generic_copy_constructor<int32_t>, generic_copy_assignment<int32_t>, empty_destructor)
     ADD_TYPE(NexusStandardType::UNSIGNED_64_BIT_INTEGER, uint64_t, numeric_constructor<uint64_t>,
              generic_copy_constructor<uint64_t>, generic_copy_assignment<uint64_t>, empty_destructor)
-    ADD_TYPE(NexusStandardType::UNSIGNED_64_BIT_INTEGER, int64_t, numeric_constructor<int64_t>,
+    ADD_TYPE(NexusStandardType::SIGNED_64_BIT_INTEGER, int64_t, numeric_constructor<int64_t>,
              generic_copy_constructor<int64_t>, generic_copy_assignment<int64_t>, empty_destructor)
     ADD_TYPE(NexusStandardType::SINGLE_PRECISION_FLOATING_POINT, float, numeric_constructor<float>,
              generic_copy_constructor<float>, generic_copy_assignment<float>, empty_destructor)
@@ -137,9 +137,13 @@ NexusBaseVtable::ID NexusTypeInfoServer::add_vtable(NexusBaseVtable *p_vtable, c
     return p_id;
 }
 
-NexusStack::Frame::Frame(NexusStack *p_stack)
-    : parent(p_stack), current_object_count(0)
-{
+NexusStack::Frame::Frame(NexusStack *p_stack) {
+    reset(p_stack);
+}
+
+void NexusStack::Frame::reset(NexusStack *p_stack) {
+    parent = p_stack;
+    current_object_count = 0;
     memory_offset = (void*)(parent->allocated + (size_t)parent->stack_begin);
     object_offset = parent->current_object_count;
 }
@@ -162,14 +166,15 @@ NexusStack::Frame::~Frame() {
 
 void NexusStack::Frame::register_object(const StackItemMetadata *p_metadata) {
     auto last_allocation = memory_offset;
+    if (parent->current_object_count == parent->object_capacity) parent->reserve_objects(parent->object_capacity * 2);
     memory_offset = (void*)((size_t)memory_offset + p_metadata->data_size);
-    parent->current_object_count++;
     parent->allocated += p_metadata->data_size;
-    parent->object_info.push_back(ObjectInfo{
+    if (parent->allocated > parent->peak_allocated) parent->peak_allocated = parent->allocated;
+    parent->object_info[parent->current_object_count++] = ObjectInfo{
         .type = p_metadata,
         .data = last_allocation,
         .index = current_object_count++
-    });
+    };
 }
 
 void NexusStack::Frame::push(const NexusStack::ObjectInfo &p_info) {
@@ -286,16 +291,13 @@ void NexusStack::Frame::set(const int64_t &p_idx, const Ref<ManagedObject> &p_re
 
 void NexusStack::Frame::pop() {
     if (empty()) throw NexusStackException("Stack frame is empty");
-    const auto& last_object_info = parent->object_info.last();
+    // If current frame is not the latest frame, this will lead to undefined behavior
+    const auto& last_object_info = parent->object_info[--parent->current_object_count];
     const auto* metadata = last_object_info.type;
     memory_offset = last_object_info.data;
-    parent->current_object_count--;
     current_object_count--;
     parent->allocated -= metadata->data_size;
     metadata->vtable->destructor(metadata, memory_offset);
-
-    // If current frame is not the latest frame, this will lead to undefined behavior
-    parent->object_info.pop_back();
 }
 
 void NexusStack::Frame::push_object(const StackItemMetadata *p_metadata, const void* p_data) {
@@ -317,34 +319,133 @@ void NexusStack::Frame::copy_to_top(const int64_t &p_idx) {
 }
 
 NexusStack::~NexusStack() {
+    while (!empty()) drop_last_frame();
     stack_frames.clear();
+    free(object_info);
     free(stack_begin);
 }
 
 NexusStack::NexusStack(const NexusTypeInfoServer *p_type_info_server, const size_t &p_stack_size, const size_t& p_initial_frame_capacity)
 : stack_begin(malloc(p_stack_size)), max_stack_size(p_stack_size),
-allocated(0), current_object_count(0), stack_frames(p_initial_frame_capacity),
-type_info_server(p_type_info_server), object_info(p_initial_frame_capacity) {}
+allocated(0), peak_allocated(0), current_object_count(0), stack_frames(p_initial_frame_capacity), frames_in_use(0),
+type_info_server(p_type_info_server), object_info(nullptr), object_capacity(0) {
+    reserve_objects(p_initial_frame_capacity < 1 ? 1 : p_initial_frame_capacity);
+}
+
+void NexusStack::reserve_objects(const size_t &p_count) {
+    if (p_count <= object_capacity) return;
+    auto new_capacity = object_capacity ? object_capacity : 1;
+    while (new_capacity < p_count) new_capacity *= 2;
+    auto new_info = (ObjectInfo*)realloc(object_info, sizeof(ObjectInfo) * new_capacity);
+    if (!new_info) throw NexusStackException("Failed to allocate object slots");
+    object_info = new_info;
+    object_capacity = new_capacity;
+}
+
+void NexusStack::push_frame() {
+    if (frames_in_use == stack_frames.size()) stack_frames.push_back(Box<Frame, ThreadUnsafeObject>::make_box(this));
+    else {
+        auto& box = stack_frames.ptrw()[frames_in_use];
+        if (box.is_unique()) box->reset(this);
+        else box = Box<Frame, ThreadUnsafeObject>::make_box(this);
+    }
+    frames_in_use++;
+}
+
+void NexusStack::drop_last_frame() {
+    auto& box = stack_frames.ptrw()[--frames_in_use];
+    if (box.is_unique()) box->clear();
+    // Escaped, the frame is left to the copy
+    else box.clear_reference();
+}
 
 Box<NexusStack::Frame, ThreadUnsafeObject> &NexusStack::push_stack_frame() {
-    stack_frames.emplace(Box<Frame, ThreadUnsafeObject>::make_box(this));
+    push_frame();
     return get_last_frame();
 }
 
+Box<NexusStack::Frame, ThreadUnsafeObject> &NexusStack::push_stack_frame(const size_t &p_adopted_count) {
+    if (!p_adopted_count) return push_stack_frame();
+    if (empty() || get_last_frame()->object_count() < p_adopted_count) throw NexusStackException("Not enough objects to adopt");
+    auto& caller = get_last_frame();
+    caller->current_object_count -= p_adopted_count;
+    auto first_adopted = current_object_count - p_adopted_count;
+    caller->memory_offset = object_info[first_adopted].data;
+    push_frame();
+    auto& callee = get_last_frame();
+    callee->object_offset = first_adopted;
+    callee->current_object_count = p_adopted_count;
+    for (size_t i = 0; i < p_adopted_count; i++) object_info[first_adopted + i].index = i;
+    return callee;
+}
+
 bool NexusStack::pop_stack_frame() {
     if (empty()) return false;
-    stack_frames.safe_pop();
+    drop_last_frame();
+    return true;
+}
+
+bool NexusStack::pop_stack_frame(const size_t &p_returned_count) {
+    if (!p_returned_count) return pop_stack_frame();
+    if (frame_count() < 2) return false;
+    auto& callee = get_last_frame();
+    if (callee->object_count() < p_returned_count) throw NexusStackException("Not enough objects to return");
+    auto first_returned = current_object_count - p_returned_count;
+    auto returned_begin = (size_t)object_info[first_returned].data;
+    auto returned_size = (size_t)callee->memory_offset - returned_begin;
+    // Destroy everything below the returned objects, top first
+    for (auto i = first_returned; i > callee->object_offset; i--) {
+        const auto& info = object_info[i - 1];
+        info.type->vtable->destructor(info.type, info.data);
+    }
+    auto destination = callee->object_offset;
+    auto destination_begin = destination < first_returned ? (size_t)object_info[destination].data : returned_begin;
+    memmove((void*)destination_begin, (const void*)returned_begin, returned_size);
+    for (size_t i = 0; i < p_returned_count; i++) {
+        auto& info = object_info[destination + i];
+        info = object_info[first_returned + i];
+        info.data = (void*)((size_t)info.data - returned_begin + destination_begin);
+    }
+    current_object_count = destination + p_returned_count;
+    allocated = destination_begin + returned_size - (size_t)stack_begin;
+    // Nothing left for the frame's destructor to clear
+    callee->current_object_count = 0;
+    drop_last_frame();
+    auto& caller = get_last_frame();
+    for (size_t i = 0; i < p_returned_count; i++) object_info[destination + i].index = caller->current_object_count++;
+    caller->memory_offset = (void*)(destination_begin + returned_size);
     return true;
 }
 
+void NexusStack::unwind(const size_t& p_frame_count, const size_t& p_object_count) {
+    if (!p_frame_count || p_frame_count > frame_count()) throw NexusStackException("Invalid frame count");
+    if (p_object_count < get_frame_at(int64_t(p_frame_count) - 1)->object_offset || p_object_count > current_object_count)
+        throw NexusStackException("Invalid object count");
+    auto end = p_object_count < current_object_count ? object_info[p_object_count].data : (void*)((size_t)stack_begin + allocated);
+    for (auto i = current_object_count; i > p_object_count; i--) {
+        const auto& info = object_info[i - 1];
+        info.type->vtable->destructor(info.type, info.data);
+    }
+    while (frame_count() > p_frame_count) {
+        // Nothing left for the frame's destructor to clear
+        get_last_frame()->current_object_count = 0;
+        drop_last_frame();
+    }
+    auto& frame = get_last_frame();
+    frame->current_object_count = p_object_count - frame->object_offset;
+    frame->memory_offset = end;
+    current_object_count = p_object_count;
+    allocated = (size_t)end - (size_t)stack_begin;
+}
+
 Box<NexusStack::Frame, ThreadUnsafeObject> &NexusStack::get_last_frame() {
-    return stack_frames.modify_last();
+    return stack_frames.ptrw()[frames_in_use - 1];
 }
 
 const Box<NexusStack::Frame, ThreadUnsafeObject> &NexusStack::get_last_frame() const {
-    return stack_frames.peek_last();
+    return stack_frames[frames_in_use - 1];
 }
 
 const Box<NexusStack::Frame, ThreadUnsafeObject> &NexusStack::get_frame_at(const int64_t &p_idx) const {
-    return stack_frames.peek_at(p_idx);
+    return stack_frames[p_idx >= 0 ? size_t(p_idx) : size_t(int64_t(frames_in_use) + p_idx)];
 }
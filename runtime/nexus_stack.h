@@ -234,6 +234,9 @@ public:
 
         static void set_object(const ObjectInfo& p_info, const StackItemMetadata* p_metadata, const void* p_data);
         void register_object(const StackItemMetadata* p_metadata);
+        // Starts over as an empty frame on top of p_stack
+        void reset(NexusStack* p_stack);
+        friend class NexusInterpreter;
     public:
         explicit Frame(NexusStack* p_stack);
         Frame(const Frame& p_other) = delete;
@@ -291,14 +294,27 @@ public:
     };
 
     friend class Frame;
+    friend class NexusInterpreter;
 private:
     const size_t max_stack_size;
     const NexusTypeInfoServer* type_info_server;
     void* stack_begin;
     size_t allocated;
+    // High-water mark of allocated, in bytes
+    size_t peak_allocated;
     size_t current_object_count;
-    VectorStack<Box<Frame, ThreadUnsafeObject>> stack_frames;
-    Vector<ObjectInfo> object_info;
+    // Never shrinks: the boxes above frames_in_use belong to popped frames and are reset by the
+    // next push. A frame does not outlive its call unless someone kept a copy of its box, so calls
+    // push and pop frames without allocating
+    Vector<Box<Frame, ThreadUnsafeObject>> stack_frames;
+    size_t frames_in_use;
+    // Grows by doubling and never shrinks, so push/pop at a capacity boundary does not reallocate.
+    // Holds current_object_count entries
+    ObjectInfo* object_info;
+    size_t object_capacity;
+
+    void push_frame();
+    void drop_last_frame();
 public:
     NexusStack(const NexusTypeInfoServer* p_type_info_server, const size_t& p_stack_size, const size_t& p_initial_frame_capacity);
     NexusStack(const NexusStack& p_other) = delete;
@@ -309,16 +325,29 @@ public:
     // Plus, allocating the stack frame itself on the Vector's heap is more efficient.
     // Just make sure not to push any frame onto the stack while holding a reference
     Box<NexusStack::Frame, ThreadUnsafeObject>& push_stack_frame();
+    // The top p_adopted_count objects of the last frame are moved into the new frame, in place
+    Box<NexusStack::Frame, ThreadUnsafeObject>& push_stack_frame(const size_t& p_adopted_count);
     bool pop_stack_frame();
+    // Destroys every object of the last frame except its top p_returned_count ones, which are
+    // relocated (bitwise) to the bottom of the frame and handed to the frame below
+    bool pop_stack_frame(const size_t& p_returned_count);
+    // Keeps the first p_frame_count frames and the first p_object_count objects, which must not
+    // reach below the last kept frame. Everything above is destroyed top first, frames are dropped
+    // at once instead of being cleared one object at a time
+    void unwind(const size_t& p_frame_count, const size_t& p_object_count);
+    // Object slots are reallocated at most once while the count stays below p_count
+    void reserve_objects(const size_t& p_count);
     _NO_DISCARD_ Box<Frame, ThreadUnsafeObject>& get_last_frame();
     _NO_DISCARD_ const Box<Frame, ThreadUnsafeObject>& get_last_frame() const;
     // DO NOT const_cast this Frame&, pushing onto a frame that is not at the top of the stack
     // lead to undefined behavior. There will be no check so do it at your discretion
     _NO_DISCARD_ const Box<Frame, ThreadUnsafeObject>& get_frame_at(const int64_t& p_idx) const;
 
-    _NO_DISCARD_ _FORCE_INLINE_ size_t frame_count() const { return stack_frames.size(); }
-    _NO_DISCARD_ _FORCE_INLINE_ size_t object_count() const { return object_info.size(); }
-    _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return stack_frames.empty(); }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t frame_count() const { return frames_in_use; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t object_count() const { return current_object_count; }
+    _NO_DISCARD_ _FORCE_INLINE_ bool empty() const { return frames_in_use == 0; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_allocated() const { return allocated; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_peak_allocated() const { return peak_allocated; }
 };
 
 template<class T>
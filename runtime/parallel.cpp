@@ -0,0 +1,209 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include "parallel.h"
+#include "interpreter.h"
+#include "runtime.h"
+#include "task.h"
+#include "task_scheduler.h"
+
+namespace {
+    NexusRuntime* get_runtime() {
+        auto runtime = NexusRuntime::get_singleton();
+        if (!runtime) throw ParallelException("NexusRuntime has not been initialized");
+        return runtime;
+    }
+
+    // Shared by the participants of one loop. Helpers keep it alive, they may start after the loop ended
+    struct ParallelJob : public ThreadSafeObject {
+        // Resolved once by the calling thread, which also releases them: NexusMethodPointer shares
+        // thread unsafe objects with its bytecode instance
+        Ref<NexusMethodPointer> method_pointer;
+        Ref<NexusInterpretedMethod> body;
+        Ref<NexusInterpretedMethod> combine;
+        const int64_t begin;
+        // Unsigned, [INT64_MIN, INT64_MAX) does not fit a signed 64 bit integer
+        const uint64_t count;
+        const int64_t identity;
+        const uint64_t grain;
+        const int64_t chunk_count;
+        // Claimed with fetch_add, a participant leaves once it is past chunk_count
+        std::atomic<int64_t> next_chunk{};
+        std::atomic<uint32_t> active_helpers{};
+        // Signalled by the last helper to leave
+        std::mutex helpers_mutex{};
+        std::condition_variable helpers_done{};
+        std::atomic<bool> failed{};
+        BinaryMutex exception_lock{};
+        std::exception_ptr exception{};
+        // Result of each chunk, written by whoever ran it
+        int64_t* const partials;
+
+        ParallelJob(const VString& p_body, const VString& p_combine, const int64_t& p_begin, const uint64_t& p_count,
+                    const int64_t& p_identity, const int64_t& p_chunk_count)
+            : method_pointer(get_runtime()->get_method(p_body)),
+              body(get_runtime()->get_interpreted_method(p_body)),
+              combine(p_combine.empty() ? Ref<NexusInterpretedMethod>() : get_runtime()->get_interpreted_method(p_combine)),
+              begin(p_begin), count(p_count), identity(p_identity),
+              grain(p_count / p_chunk_count + (p_count % p_chunk_count != 0)),
+              chunk_count(int64_t(p_count / grain + (p_count % grain != 0))), partials(new int64_t[chunk_count]) {}
+        ~ParallelJob() override { delete[] partials; }
+    };
+
+    // NexusStack of one participant, created once it claimed a chunk
+    struct ParallelWorker {
+        NexusExecutionState state;
+
+        explicit ParallelWorker(const ParallelJob* p_job) : state(p_job->method_pointer) {
+            state.thread_stack->push_stack_frame();
+        }
+        // Leaves the stack as it found it. Returns the method's result if p_has_result
+        template <size_t Count>
+        int64_t call(const NexusInterpretedMethod* p_method, const int64_t (&p_arguments)[Count], const bool& p_has_result) {
+            auto base = state.thread_stack->get_last_frame()->object_count();
+            for (const auto& argument : p_arguments) state.thread_stack->get_last_frame()->push(argument);
+            NexusInterpreter::invoke(&state, p_method);
+            // Frames were pushed meanwhile, the last one may have moved
+            auto& frame = state.thread_stack->get_last_frame();
+            int64_t re{};
+            if (p_has_result) {
+                auto top = frame->top();
+                if (frame->object_count() != base + 1 || top.type->type != NexusStandardType::SIGNED_64_BIT_INTEGER)
+                    throw ParallelException("Parallel bodies must return a signed 64 bit integer");
+                memcpy(&re, top.data, sizeof(re));
+            }
+            while (frame->object_count() > base) frame->pop();
+            return re;
+        }
+    };
+
+    void run_chunks(ParallelJob* p_job) {
+        ParallelWorker* worker{};
+        try {
+            while (!p_job->failed.load()) {
+                auto chunk = p_job->next_chunk.fetch_add(1);
+                if (chunk >= p_job->chunk_count) break;
+                if (!worker) worker = new ParallelWorker(p_job);
+                // Offsets from begin, in two's complement so the indexes never overflow
+                auto from = uint64_t(chunk) * p_job->grain;
+                auto length = p_job->count - from < p_job->grain ? p_job->count - from : p_job->grain;
+                auto accumulated = p_job->identity;
+                for (uint64_t offset = from; offset < from + length; offset++) {
+                    auto i = int64_t(uint64_t(p_job->begin) + offset);
+                    if (p_job->combine.is_null()) worker->call(p_job->body.ptr(), { i }, false);
+                    else {
+                        auto value = worker->call(p_job->body.ptr(), { i }, true);
+                        accumulated = worker->call(p_job->combine.ptr(), { accumulated, value }, true);
+                    }
+                }
+                p_job->partials[chunk] = accumulated;
+            }
+        } catch (...) {
+            GUARD(p_job->exception_lock);
+            if (!p_job->exception) p_job->exception = std::current_exception();
+            p_job->failed.store(true);
+        }
+        delete worker;
+    }
+
+    // Folds the chunks in index order, on a stack of its own as the participants' are gone
+    int64_t combine_partials(const ParallelJob* p_job) {
+        auto re = p_job->partials[0];
+        if (p_job->chunk_count == 1) return re;
+        ParallelWorker worker(p_job);
+        for (int64_t i = 1; i < p_job->chunk_count; i++) re = worker.call(p_job->combine.ptr(), { re, p_job->partials[i] }, true);
+        return re;
+    }
+
+    int64_t run(Ref<ParallelJob> p_job) {
+        auto helpers = int64_t(TaskScheduler::get_worker_count());
+        if (helpers > p_job->chunk_count - 1) helpers = p_job->chunk_count - 1;
+        for (int64_t i = 0; i < helpers; i++) {
+            auto queued = TaskScheduler::queue_background_work([job = p_job]() mutable {
+                // Counted before claiming anything, so the caller cannot miss a running helper
+                job->active_helpers.fetch_add(1);
+                run_chunks(job.ptr());
+                if (job->active_helpers.fetch_sub(1) == 1) {
+                    std::unique_lock<std::mutex> lock(job->helpers_mutex);
+                    job->helpers_done.notify_all();
+                }
+            });
+            if (!queued) break;
+        }
+        run_chunks(p_job.ptr());
+        // Every chunk is claimed, only wait for the helpers still running one
+        {
+            std::unique_lock<std::mutex> lock(p_job->helpers_mutex);
+            p_job->helpers_done.wait(lock, [&p_job] { return p_job->active_helpers.load() == 0; });
+        }
+        int64_t re{};
+        if (!p_job->exception && !p_job->combine.is_null()) {
+            try {
+                re = combine_partials(p_job.ptr());
+            } catch (...) {
+                p_job->exception = std::current_exception();
+            }
+        }
+        p_job->method_pointer = Ref<NexusMethodPointer>();
+        if (p_job->exception) std::rethrow_exception(p_job->exception);
+        return re;
+    }
+
+    int64_t chunk_count_of(const uint64_t& p_count) {
+        auto chunks = int64_t(TaskScheduler::get_worker_count() + 1) * NexusParallel::CHUNKS_PER_THREAD;
+        return uint64_t(chunks) < p_count ? chunks : int64_t(p_count);
+    }
+
+    uint64_t count_of(const int64_t& p_begin, const int64_t& p_end) {
+        return uint64_t(p_end) - uint64_t(p_begin);
+    }
+
+    struct ParallelBinding : public ThreadSafeObject {
+        const VString body;
+        const VString combine;
+        ParallelBinding(const VString& p_body, const VString& p_combine) : body(p_body), combine(p_combine) {}
+    };
+
+    void parallel_for_thunk(const void* p_binding, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result) {
+        auto binding = (const ParallelBinding*)p_binding;
+        NexusNativeSignature<void(int64_t, int64_t)>::invoke([binding](int64_t p_begin, int64_t p_end) {
+            NexusParallel::parallel_for(binding->body, p_begin, p_end);
+        }, p_arguments, p_result, std::index_sequence_for<int64_t, int64_t>{});
+    }
+
+    void parallel_reduce_thunk(const void* p_binding, const NexusStack::ObjectInfo* p_arguments, uint64_t* p_result) {
+        auto binding = (const ParallelBinding*)p_binding;
+        NexusNativeSignature<int64_t(int64_t, int64_t, int64_t)>::invoke([binding](int64_t p_begin, int64_t p_end, int64_t p_identity) {
+            return NexusParallel::parallel_reduce(binding->body, binding->combine, p_begin, p_end, p_identity);
+        }, p_arguments, p_result, std::index_sequence_for<int64_t, int64_t, int64_t>{});
+    }
+}
+
+void NexusParallel::parallel_for(const VString& p_body, const int64_t& p_begin, const int64_t& p_end) {
+    if (p_end <= p_begin) return;
+    const auto count = count_of(p_begin, p_end);
+    run(Ref<ParallelJob>::make_ref(p_body, VString(), p_begin, count, 0, chunk_count_of(count)));
+}
+
+int64_t NexusParallel::parallel_reduce(const VString& p_body, const VString& p_combine,
+                                       const int64_t& p_begin, const int64_t& p_end, const int64_t& p_identity) {
+    if (p_end <= p_begin) return p_identity;
+    if (p_combine.empty()) throw ParallelException("Reductions need a combining method");
+    const auto count = count_of(p_begin, p_end);
+    return run(Ref<ParallelJob>::make_ref(p_body, p_combine, p_begin, count, p_identity, chunk_count_of(count)));
+}
+
+Ref<NexusNativeMethod> NexusParallel::bind_for(const VString& p_body) {
+    auto binding = Ref<ParallelBinding>::make_ref(p_body, VString());
+    return NexusNativeMethod::bind_closure<void(int64_t, int64_t)>(parallel_for_thunk, binding.safe_cast<ThreadSafeObject>());
+}
+
+Ref<NexusNativeMethod> NexusParallel::bind_reduce(const VString& p_body, const VString& p_combine) {
+    auto binding = Ref<ParallelBinding>::make_ref(p_body, p_combine);
+    return NexusNativeMethod::bind_closure<int64_t(int64_t, int64_t, int64_t)>(parallel_reduce_thunk, binding.safe_cast<ThreadSafeObject>());
+}
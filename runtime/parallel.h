@@ -0,0 +1,42 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_PARALLEL_H
+#define NEXUS_PARALLEL_H
+
+#include "../core/types/vstring.h"
+#include "native_bindings/native_method.h"
+
+class ParallelException : public Exception {
+public:
+    explicit ParallelException(const char* p_msg = nullptr) : Exception(p_msg) {}
+};
+
+// Data parallel loops over bytecode methods. The range is split into chunks that the calling thread
+// and idle pool workers claim one at a time; each participant runs its chunks on its own NexusStack
+// through NexusInterpreter::invoke instead of spawning a Task per index. The calling thread never
+// waits for a helper that has not started, so a busy pool only costs parallelism.
+// Bodies are looked up in NexusRuntime by name and take the index as their only argument, a signed
+// 64 bit integer. The first exception thrown by a body stops every participant and is rethrown
+class NexusParallel {
+public:
+    // Chunks per participant, more balances uneven bodies better
+    static constexpr int64_t CHUNKS_PER_THREAD = 8;
+
+    // Runs p_body(i) for every i in [p_begin, p_end), in no particular order
+    static void parallel_for(const VString& p_body, const int64_t& p_begin, const int64_t& p_end);
+    // Folds p_body(i) for every i in [p_begin, p_end) with p_combine(accumulated, value), which takes
+    // and returns signed 64 bit integers and must be associative: chunks start from p_identity and
+    // are combined in index order
+    static int64_t parallel_reduce(const VString& p_body, const VString& p_combine,
+                                   const int64_t& p_begin, const int64_t& p_end, const int64_t& p_identity);
+
+    // Native methods running the loops over fixed bodies, for bytecode to call as external methods:
+    // (i64 begin, i64 end)
+    static Ref<NexusNativeMethod> bind_for(const VString& p_body);
+    // (i64 begin, i64 end, i64 identity) -> i64
+    static Ref<NexusNativeMethod> bind_reduce(const VString& p_body, const VString& p_combine);
+};
+
+#endif //NEXUS_PARALLEL_H
@@ -0,0 +1,244 @@
+//
+// Created by cycastic on 8/15/2023.
+//
+
+#ifndef NEXUS_PIPELINE_H
+#define NEXUS_PIPELINE_H
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "../core/exception.h"
+#include "../core/types/lock_free_queue.h"
+#include "../core/types/vector.h"
+#include "thread_pool.h"
+
+class PipelineException : public Exception {
+public:
+    explicit PipelineException(const char* p_msg = nullptr) : Exception(p_msg) {}
+};
+
+// Chain of stages run by ThreadPool workers. Every item in flight holds one of
+// p_max_tokens slots, so memory stays bounded and a slow stage throttles the source.
+// Stages are connected by bounded lock-free queues and any worker may run any stage
+template <typename T>
+class Pipeline {
+public:
+    enum StageMode {
+        // One item at a time, in source order
+        SERIAL_IN_ORDER,
+        // One item at a time, in arrival order
+        SERIAL_OUT_OF_ORDER,
+        PARALLEL,
+    };
+private:
+    struct Item {
+        T value{};
+        uint64_t sequence{};
+    };
+    struct Stage {
+        const StageMode mode;
+        const std::function<void(T&)> function;
+        BoundedMPMCQueue<Item*>* input{};
+        std::atomic<bool> busy{false};
+        // SERIAL_IN_ORDER only, guarded by busy
+        uint64_t next_sequence{};
+        Item** reorder_buffer{};
+
+        Stage(const StageMode& p_mode, const std::function<void(T&)>& p_function) : mode(p_mode), function(p_function) {}
+    };
+    // Per run
+    struct RunState {
+        Item* items;
+        size_t mask;
+        BoundedMPMCQueue<Item*> free_items;
+        std::atomic<bool> source_busy{false};
+        SafeFlag source_finished{false};
+        SafeFlag aborted{false};
+        std::atomic<size_t> in_flight{0};
+        uint64_t next_sequence{};
+        // Bumped after every change that may give an idle worker something to do
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<uint32_t> sleepers{0};
+        std::mutex mutex{};
+        std::condition_variable condition{};
+
+        void wake(){
+            epoch.fetch_add(1, std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_seq_cst) == 0) return;
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.notify_all();
+        }
+        // Blocks until wake() is called after p_epoch was read. Either wake() sees this worker
+        // among the sleepers, or the predicate sees its epoch
+        void sleep(const uint64_t& p_epoch){
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this, &p_epoch] { return epoch.load(std::memory_order_seq_cst) != p_epoch || aborted.is_set(); });
+            }
+            sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        // Queues need at least 2 cells even for a single token
+        explicit RunState(const size_t& p_max_tokens)
+                : mask(lock_free_queue_round_capacity(p_max_tokens < 2 ? 2 : p_max_tokens) - 1), free_items(mask + 1) {
+            items = new Item[p_max_tokens];
+            for (size_t i = 0; i < p_max_tokens; i++) free_items.try_enqueue(&items[i]);
+        }
+        ~RunState() { delete[] items; }
+    };
+
+    std::function<bool(T&)> source{};
+    Vector<Stage*> stages{};
+
+    void forward(RunState& p_state, const size_t& p_stage_idx, Item* p_item){
+        auto next = p_stage_idx + 1;
+        if (next < stages.size()) {
+            // Never full, every queue can hold every token
+            stages[next]->input->try_enqueue(p_item);
+        } else {
+            p_state.free_items.try_enqueue(p_item);
+            p_state.in_flight.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        p_state.wake();
+    }
+    bool run_source(RunState& p_state){
+        if (p_state.source_finished.is_set()) return false;
+        if (p_state.source_busy.exchange(true, std::memory_order_acquire)) return false;
+        Item* item{};
+        bool progressed = false;
+        if (!p_state.source_finished.is_set() && p_state.free_items.try_dequeue(item)) {
+            p_state.in_flight.fetch_add(1, std::memory_order_acq_rel);
+            if (source(item->value)) {
+                item->sequence = p_state.next_sequence++;
+                stages[0]->input->try_enqueue(item);
+            } else {
+                p_state.source_finished.set();
+                p_state.free_items.try_enqueue(item);
+                p_state.in_flight.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            progressed = true;
+        }
+        p_state.source_busy.store(false, std::memory_order_release);
+        // Also wakes a worker that found the source busy
+        p_state.wake();
+        return progressed;
+    }
+    bool run_stage(RunState& p_state, const size_t& p_stage_idx){
+        auto stage = stages[p_stage_idx];
+        Item* item{};
+        switch (stage->mode) {
+            case PARALLEL:
+                if (!stage->input->try_dequeue(item)) return false;
+                stage->function(item->value);
+                forward(p_state, p_stage_idx, item);
+                return true;
+            case SERIAL_OUT_OF_ORDER: {
+                if (stage->busy.exchange(true, std::memory_order_acquire)) return false;
+                auto dequeued = stage->input->try_dequeue(item);
+                if (dequeued) {
+                    stage->function(item->value);
+                    forward(p_state, p_stage_idx, item);
+                }
+                stage->busy.store(false, std::memory_order_release);
+                // Items queued while busy were left to this worker, which may have missed them
+                p_state.wake();
+                return dequeued;
+            }
+            case SERIAL_IN_ORDER: {
+                if (stage->busy.exchange(true, std::memory_order_acquire)) return false;
+                // Sequences in flight span at most mask + 1 values, so they never collide
+                while (stage->input->try_dequeue(item)) stage->reorder_buffer[item->sequence & p_state.mask] = item;
+                bool progressed = false;
+                while ((item = stage->reorder_buffer[stage->next_sequence & p_state.mask])) {
+                    stage->reorder_buffer[stage->next_sequence & p_state.mask] = nullptr;
+                    stage->next_sequence++;
+                    stage->function(item->value);
+                    forward(p_state, p_stage_idx, item);
+                    progressed = true;
+                }
+                stage->busy.store(false, std::memory_order_release);
+                p_state.wake();
+                return progressed;
+            }
+        }
+        return false;
+    }
+    void worker(RunState* p_state){
+        auto& state = *p_state;
+        try {
+            while (!state.aborted.is_set()) {
+                const auto epoch = state.epoch.load(std::memory_order_seq_cst);
+                bool progressed = false;
+                // Drain the later stages first, so tokens are returned as early as possible
+                for (auto i = int64_t(stages.size()) - 1; i >= 0 && !progressed; i--)
+                    progressed = run_stage(state, i);
+                if (!progressed) progressed = run_source(state);
+                if (progressed) continue;
+                if (state.source_finished.is_set() && state.in_flight.load(std::memory_order_acquire) == 0) return;
+                state.sleep(epoch);
+            }
+        } catch (...) {
+            state.aborted.set();
+            state.wake();
+            throw;
+        }
+    }
+public:
+    // Serial and in order. Fill the item and return true, or return false once exhausted
+    Pipeline& set_source(const std::function<bool(T&)>& p_source){
+        source = p_source;
+        return *this;
+    }
+    Pipeline& add_stage(const StageMode& p_mode, const std::function<void(T&)>& p_function){
+        stages.push_back(new Stage(p_mode, p_function));
+        return *this;
+    }
+    // Blocks until the source is exhausted and every item left the last stage.
+    // Must not be called from p_pool's own workers. Rethrows the first exception thrown by a stage
+    void run(ThreadPool* p_pool, const size_t& p_max_tokens, size_t p_worker_count = 0,
+             const ThreadPool::Priority& p_priority = ThreadPool::MEDIUM){
+        if (!source) throw PipelineException("Pipeline has no source");
+        if (stages.empty()) throw PipelineException("Pipeline has no stage");
+        if (p_max_tokens == 0) throw PipelineException("Pipeline needs at least one token");
+        if (p_worker_count == 0) p_worker_count = p_pool->get_thread_count();
+        RunState state(p_max_tokens);
+        for (auto stage : stages) {
+            stage->input = new BoundedMPMCQueue<Item*>(state.mask + 1);
+            stage->next_sequence = 0;
+            if (stage->mode == SERIAL_IN_ORDER) {
+                stage->reorder_buffer = new Item*[state.mask + 1];
+                for (size_t i = 0; i <= state.mask; i++) stage->reorder_buffer[i] = nullptr;
+            }
+        }
+        Vector<std::future<void>*> futures{};
+        for (size_t i = 0; i < p_worker_count; i++)
+            futures.push_back(new std::future<void>(p_pool->queue_task_method(p_priority, this, &Pipeline::worker, &state)));
+        for (auto future : futures) future->wait();
+        for (auto stage : stages) {
+            delete stage->input;
+            delete[] stage->reorder_buffer;
+            stage->input = nullptr;
+            stage->reorder_buffer = nullptr;
+        }
+        std::exception_ptr exception{};
+        for (auto future : futures) {
+            try {
+                future->get();
+            } catch (...) {
+                if (!exception) exception = std::current_exception();
+            }
+            delete future;
+        }
+        if (exception) std::rethrow_exception(exception);
+    }
+
+    Pipeline() = default;
+    Pipeline(const Pipeline&) = delete;
+    ~Pipeline() {
+        for (auto stage : stages) delete stage;
+    }
+};
+
+#endif //NEXUS_PIPELINE_H
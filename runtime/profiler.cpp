@@ -0,0 +1,118 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include "profiler.h"
+#include "interpreter.h"
+
+// Every slot and the running profiler. Never freed: threads may exit after static destruction
+struct ProfilerRegistry {
+    BinaryMutex lock{};
+    Vector<NexusProfiler::ThreadSlot*> slots{};
+    NexusProfiler* profiler{};
+};
+
+static ProfilerRegistry& get_registry() {
+    static auto registry = new ProfilerRegistry();
+    return *registry;
+}
+
+NexusProfiler::ThreadSlot::ThreadSlot() {
+    auto& registry = get_registry();
+    GUARD(registry.lock);
+    registry.slots.push_back(this);
+}
+
+NexusProfiler::ThreadSlot::~ThreadSlot() {
+    auto& registry = get_registry();
+    GUARD(registry.lock);
+    registry.slots.erase(this);
+}
+
+NexusProfiler::ThreadSlot* NexusProfiler::get_thread_slot() {
+    thread_local ThreadSlot slot{};
+    return &slot;
+}
+
+void NexusProfiler::take_sample(ThreadSlot* p_slot, const NexusInterpreterContext* p_context,
+                                const NexusInterpretedMethod* p_compiled) {
+    p_slot->sample_requested.store(false, std::memory_order_relaxed);
+    VString stack{};
+    const auto& call_stack = p_context->call_stack;
+    for (size_t i = 0; i < call_stack.size(); i++) {
+        const auto& call_frame = call_stack[i];
+        if (i) stack += ';';
+        stack += VString(call_frame.method->get_method_name()) + ":" + uitos(call_frame.pc);
+    }
+    if (p_compiled) {
+        if (!stack.empty()) stack += ';';
+        stack += VString(p_compiled->get_method_name()) + ":jit";
+    }
+
+    auto& registry = get_registry();
+    GUARD(registry.lock);
+    auto profiler = registry.profiler;
+    if (!profiler) return;
+    uint64_t count = 0;
+    profiler->samples.try_get(stack, count);
+    profiler->samples[stack] = count + 1;
+    profiler->sample_count++;
+}
+
+void NexusProfiler::sample_loop() {
+    auto& registry = get_registry();
+    while (!stopped.is_set()) {
+        ManagedThread::sleep(interval_usec);
+        GUARD(registry.lock);
+        for (auto slot : registry.slots) {
+            if (slot->active.load(std::memory_order_relaxed))
+                slot->sample_requested.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t NexusProfiler::get_sample_count() const {
+    GUARD(get_registry().lock);
+    return sample_count;
+}
+
+uint64_t NexusProfiler::get_sample_count(const VString& p_prefix) const {
+    GUARD(get_registry().lock);
+    uint64_t re = 0;
+    auto it = samples.const_iterator();
+    while (it.move_next()) {
+        if (it.get_pair().key.begins_with(p_prefix)) re += it.get_pair().value;
+    }
+    return re;
+}
+
+void NexusProfiler::write_collapsed(std::ostream& p_stream) const {
+    GUARD(get_registry().lock);
+    auto it = samples.const_iterator();
+    while (it.move_next()) {
+        p_stream << it.get_pair().key << ' ' << it.get_pair().value << '\n';
+    }
+}
+
+void NexusProfiler::stop() {
+    if (stopped.is_set()) return;
+    stopped.set();
+    sampler.join();
+    auto& registry = get_registry();
+    GUARD(registry.lock);
+    if (registry.profiler == this) registry.profiler = nullptr;
+}
+
+NexusProfiler::NexusProfiler(const uint64_t& p_interval_usec) : interval_usec(p_interval_usec) {
+    auto& registry = get_registry();
+    {
+        GUARD(registry.lock);
+        if (registry.profiler) throw ProfilerException("A profiler is already running");
+        registry.profiler = this;
+    }
+    sampler.start_method(this, &NexusProfiler::sample_loop);
+}
+
+NexusProfiler::~NexusProfiler() {
+    stop();
+}
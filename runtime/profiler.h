@@ -0,0 +1,85 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_PROFILER_H
+#define NEXUS_PROFILER_H
+
+#include <atomic>
+#include <ostream>
+#include "../core/types/hashmap.h"
+#include "../core/types/vstring.h"
+#include "../core/exception.h"
+#include "../core/types/safe_refcount.h"
+#include "managed_thread.h"
+
+class NexusInterpretedMethod;
+struct NexusInterpreterContext;
+
+class ProfilerException : public Exception {
+public:
+    explicit ProfilerException(const char* p_msg = nullptr) : Exception(p_msg) {}
+};
+
+// Sampling profiler for interpreted bytecode. A sampler thread wakes up every interval and asks each
+// thread currently inside NexusInterpreter for a sample, which that thread takes at its next backward
+// branch, call or return by walking its own call stack. Between samples, workers pay one relaxed load
+// at those points.
+// Samples are keyed by collapsed stack, as flame graph tools expect: "method:instruction" frames from
+// the entry method down, separated by ';'. At most one profiler runs at a time
+class NexusProfiler {
+public:
+    static constexpr uint64_t DEFAULT_INTERVAL_USEC = 10000;
+
+    // One per thread that has run NexusInterpreter, see get_thread_slot()
+    struct ThreadSlot {
+        std::atomic<bool> sample_requested{};
+        // Requests only go to threads inside NexusInterpreter, idle time is not sampled
+        std::atomic<bool> active{};
+
+        ThreadSlot();
+        ~ThreadSlot();
+    };
+    // Marks the calling thread as running bytecode, drops pending requests when leaving. Nests, for
+    // natives that call back into bytecode
+    class ActiveScope {
+        ThreadSlot* slot;
+        bool was_active;
+    public:
+        explicit ActiveScope(ThreadSlot* p_slot) : slot(p_slot), was_active(slot->active.exchange(true, std::memory_order_relaxed)) {}
+        ~ActiveScope() {
+            if (was_active) return;
+            slot->active.store(false, std::memory_order_relaxed);
+            slot->sample_requested.store(false, std::memory_order_relaxed);
+        }
+    };
+private:
+    const uint64_t interval_usec;
+    SafeFlag stopped{false};
+    ManagedThread sampler{};
+    // Guarded by the registry lock
+    HashMap<VString, uint64_t> samples{};
+    uint64_t sample_count{};
+
+    void sample_loop();
+public:
+    static ThreadSlot* get_thread_slot();
+    // Records the call stack in p_context, called by the thread owning p_slot once it sees a request.
+    // p_compiled is the callee whose machine code was running when the request came in, if any
+    static void take_sample(ThreadSlot* p_slot, const NexusInterpreterContext* p_context,
+                            const NexusInterpretedMethod* p_compiled = nullptr);
+
+    _NO_DISCARD_ uint64_t get_sample_count() const;
+    // Samples whose stack starts with p_prefix
+    _NO_DISCARD_ uint64_t get_sample_count(const VString& p_prefix) const;
+    // One "stack count" line per distinct stack
+    void write_collapsed(std::ostream& p_stream) const;
+    // Joins the sampler thread, samples stay readable
+    void stop();
+
+    explicit NexusProfiler(const uint64_t& p_interval_usec = DEFAULT_INTERVAL_USEC);
+    NexusProfiler(const NexusProfiler&) = delete;
+    ~NexusProfiler();
+};
+
+#endif //NEXUS_PROFILER_H
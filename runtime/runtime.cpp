@@ -5,9 +5,43 @@
 #include "runtime.h"
 #include "nexus_stack.h"
 #include "../core/types/linked_list.h"
+#include "native_bindings/builtin.h"
+
+NexusRuntime* NexusRuntime::singleton = nullptr;
 
 NexusRuntime::NexusRuntime() : ManagedObject(), type_info_server(new NexusTypeInfoServer(true)) {
     anonymous_instances_count.set(0);
+    singleton = this;
+    register_native_method<__builtin_println>("__builtin_println");
+    register_array_builtins();
+}
+
+void NexusRuntime::register_array_builtins() {
+    register_native_method<builtin_array_size>("__builtin_array_size");
+#define REGISTER_NUMBER_BUILTINS(m_suffix, m_type)                                                                                   \
+    register_native_method<builtin_array_get<m_type>>("__builtin_array_get_" #m_suffix);                                           \
+    register_native_method<builtin_array_set<m_type>>("__builtin_array_set_" #m_suffix);                                           \
+    register_native_method<builtin_array_fill<m_type>>("__builtin_array_fill_" #m_suffix);                                         \
+    register_native_method<builtin_array_apply_scalar<NexusSimd::BINARY_ADD, m_type>>("__builtin_array_add_" #m_suffix);           \
+    register_native_method<builtin_array_apply_scalar<NexusSimd::BINARY_SUBTRACT, m_type>>("__builtin_array_subtract_" #m_suffix); \
+    register_native_method<builtin_array_apply_scalar<NexusSimd::BINARY_MULTIPLY, m_type>>("__builtin_array_multiply_" #m_suffix); \
+    register_native_method<builtin_array_apply_scalar<NexusSimd::BINARY_DIVIDE, m_type>>("__builtin_array_divide_" #m_suffix);     \
+    register_native_method<builtin_array_reduce<NexusSimd::REDUCE_SUM, m_type>>("__builtin_array_sum_" #m_suffix);                 \
+    register_native_method<builtin_array_reduce<NexusSimd::REDUCE_MIN, m_type>>("__builtin_array_min_" #m_suffix);                 \
+    register_native_method<builtin_array_reduce<NexusSimd::REDUCE_MAX, m_type>>("__builtin_array_max_" #m_suffix);
+    REGISTER_NUMBER_BUILTINS(i64, int64_t)
+    REGISTER_NUMBER_BUILTINS(f64, double)
+#undef REGISTER_NUMBER_BUILTINS
+    register_native_method<builtin_array_apply<NexusSimd::BINARY_ADD>>("__builtin_array_add");
+    register_native_method<builtin_array_apply<NexusSimd::BINARY_SUBTRACT>>("__builtin_array_subtract");
+    register_native_method<builtin_array_apply<NexusSimd::BINARY_MULTIPLY>>("__builtin_array_multiply");
+    register_native_method<builtin_array_apply<NexusSimd::BINARY_DIVIDE>>("__builtin_array_divide");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_EQUAL>>("__builtin_array_equal");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_NOT_EQUAL>>("__builtin_array_not_equal");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_LESSER>>("__builtin_array_lesser");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_LESSER_OR_EQUAL>>("__builtin_array_lesser_or_equal");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_GREATER>>("__builtin_array_greater");
+    register_native_method<builtin_array_compare<NexusSimd::COMPARE_GREATER_OR_EQUAL>>("__builtin_array_greater_or_equal");
 }
 
 void NexusRuntime::load_bytecode(const VString &p_bytecode_path, NexusBytecodeInstance::BytecodeLoadMode p_load_mode) {
@@ -28,18 +62,103 @@ void NexusRuntime::cache_method_bodies(const Ref<NexusBytecodeInstance>& instanc
     auto it = instance->bodies_location.const_iterator();
     LinkedList<VString> loaded_methods{};
     try {
+        for (const auto& metadata : instance->bytecode->get_methods_metadata()){
+            if (!(metadata->attributes & NexusBytecodeMethodMetadata::MA_EXTERNAL)) continue;
+            if (!get_native_method(metadata->method_name))
+                throw RuntimeException(CharString("Native method not registered: ") + metadata->method_name.operator VString().utf8());
+        }
         while (it.move_next()){
             const auto& method_name = it.get_pair().key;
             if (bytecode_method_bodies.has(method_name)) throw RuntimeException(CharString("Method already has: ") + method_name.operator VString().utf8());
+            if (get_native_method(method_name)) throw RuntimeException(CharString("Method shadows a native method: ") + method_name.operator VString().utf8());
             bytecode_method_bodies[method_name] = instance;
+            loaded_methods.add_last(method_name);
+        }
+        // Bodies are already in memory, decode them now rather than on the first call
+        if (instance->load_mode == NexusBytecodeInstance::LOAD_ALL){
+            for (const auto* method_name = loaded_methods.first(); method_name; method_name = method_name->next()){
+                interpreted_methods[method_name->data] = Ref<NexusInterpretedMethod>::make_ref(instance->get_method(method_name->data));
+            }
         }
     } catch (const std::exception& ex){
         // Rollback changes before rethrowing
         for (const auto* method_name = loaded_methods.first(); method_name; method_name = method_name->next()){
             bytecode_method_bodies.erase(method_name->data);
+            interpreted_methods.erase(method_name->data);
         }
-        throw ex;
+        throw;
+    }
+}
+
+Ref<NexusMethodPointer> NexusRuntime::get_method(const VString &p_method_name) {
+    Ref<NexusBytecodeInstance> instance{};
+    {
+        R_GUARD(rwlock);
+        if (!bytecode_method_bodies.try_get(p_method_name, instance))
+            throw RuntimeException(CharString("Method not found: ") + p_method_name.utf8());
+    }
+    return instance->get_method(p_method_name);
+}
+
+Ref<NexusInterpretedMethod> NexusRuntime::get_interpreted_method(const VString &p_method_name) {
+    Ref<NexusInterpretedMethod> re{};
+    {
+        R_GUARD(rwlock);
+        if (interpreted_methods.try_get(p_method_name, re)) return re;
     }
+    // Decode outside of the lock, a racing decoder of the same method loses below
+    auto decoded = Ref<NexusInterpretedMethod>::make_ref(get_method(p_method_name));
+    W_GUARD(rwlock);
+    if (interpreted_methods.try_get(p_method_name, re)) return re;
+    interpreted_methods[p_method_name] = decoded;
+    return decoded;
 }
 
-NexusRuntime::~NexusRuntime() = default;
+void NexusRuntime::add_native_method(const VString& p_method_name, const Ref<NexusNativeMethod>& p_method) {
+    W_GUARD(natives_lock);
+    if (native_methods.has(p_method_name)) throw RuntimeException(CharString("Native method already registered: ") + p_method_name.utf8());
+    native_methods[p_method_name] = p_method;
+}
+
+const NexusNativeMethod* NexusRuntime::get_native_method(const VString& p_method_name) const {
+    R_GUARD(natives_lock);
+    Ref<NexusNativeMethod> re{};
+    if (!native_methods.try_get(p_method_name, re)) return nullptr;
+    return re.ptr();
+}
+
+void NexusRuntime::load_native_library(const VString& p_library_name, const VString& p_path) {
+    W_GUARD(natives_lock);
+    if (native_libraries.has(p_library_name)) throw RuntimeException(CharString("Library already loaded: ") + p_library_name.utf8());
+    void* handle{};
+    System::get_singleton()->load_dynamic_library(p_path, handle);
+    native_libraries[p_library_name] = handle;
+}
+
+const void* NexusRuntime::get_library_symbol(const VString& p_library_name, const CharString& p_symbol) const {
+    void* handle{};
+    {
+        R_GUARD(natives_lock);
+        if (!native_libraries.try_get(p_library_name, handle))
+            throw RuntimeException(CharString("Library not loaded: ") + p_library_name.utf8());
+    }
+    void* symbol{};
+    System::get_singleton()->get_dynamic_library_symbol_handle(handle, p_symbol, symbol);
+    if (!symbol) throw RuntimeException(CharString("Symbol is null: ") + p_symbol);
+    return symbol;
+}
+
+NexusRuntime::~NexusRuntime() {
+    if (singleton == this) singleton = nullptr;
+    interpreted_methods.clear();
+    bytecode_method_bodies.clear();
+    bytecode_instances.clear();
+    native_methods.clear();
+    // Leaked if the system is already gone, the process is exiting
+    if (System::get_singleton()) {
+        auto it = native_libraries.const_iterator();
+        while (it.move_next()) System::get_singleton()->close_dynamic_library(it.get_pair().value);
+    }
+    native_libraries.clear();
+    delete type_info_server;
+}
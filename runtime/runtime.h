@@ -5,9 +5,11 @@
 #ifndef NEXUS_RUNTIME_H
 #define NEXUS_RUNTIME_H
 #include "../language/bytecode.h"
+#include "interpreter.h"
 #include "system.h"
+#include "native_bindings/native_method.h"
 
-class RuntimeException : Exception {
+class RuntimeException : public Exception {
 public:
     explicit RuntimeException(const char* p_msg) : Exception(p_msg) {}
     explicit RuntimeException(const CharString& p_msg) : Exception(p_msg) {}
@@ -16,16 +18,49 @@ public:
 class NexusRuntime : public ManagedObject {
 public:
 private:
+    static NexusRuntime* singleton;
+
     HashMap<VString, Ref<NexusBytecodeInstance>> bytecode_instances{};
     HashMap<VString, Ref<NexusBytecodeInstance>> bytecode_method_bodies{};
+    // Decoded at load time (LOAD_ALL) or on first use, and kept for the runtime's lifetime
+    HashMap<VString, Ref<NexusInterpretedMethod>> interpreted_methods{};
     RWLock rwlock{};
+    // Separate from rwlock, decoding looks natives up while loads hold it
+    HashMap<VString, Ref<NexusNativeMethod>> native_methods{};
+    // Handles from System::load_dynamic_library, closed with the runtime
+    HashMap<VString, void*> native_libraries{};
+    mutable RWLock natives_lock{};
     SafeNumeric<uint32_t> anonymous_instances_count{};
     NexusTypeInfoServer* type_info_server;
 
     void cache_method_bodies(const Ref<NexusBytecodeInstance>& instance);
+    // __builtin_array_*, over NexusTypedArray
+    void register_array_builtins();
 public:
+    static _FORCE_INLINE_ NexusRuntime* get_singleton() { return singleton; }
+    _NO_DISCARD_ _FORCE_INLINE_ const NexusTypeInfoServer* get_type_info_server() const { return type_info_server; }
+
     void load_bytecode(const VString& p_bytecode_path, NexusBytecodeInstance::BytecodeLoadMode p_load_mode);
     void load_bytecode(FilePointer& p_file_pointer, NexusBytecodeInstance::BytecodeLoadMode p_load_mode);
+    Ref<NexusMethodPointer> get_method(const VString& p_method_name);
+    Ref<NexusInterpretedMethod> get_interpreted_method(const VString& p_method_name);
+    // Natives must be registered before any bytecode declaring them is loaded
+    void add_native_method(const VString& p_method_name, const Ref<NexusNativeMethod>& p_method);
+    template <auto Function>
+    _FORCE_INLINE_ void register_native_method(const VString& p_method_name) {
+        add_native_method(p_method_name, NexusNativeMethod::bind<Function>());
+    }
+    // Opens a shared library whose symbols may then be bound under p_library_name
+    void load_native_library(const VString& p_library_name, const VString& p_path);
+    // Resolves p_symbol once, calls go through a trampoline generated for Signature, which must
+    // match the symbol's C signature
+    template <class Signature>
+    void bind_library_method(const VString& p_method_name, const VString& p_library_name, const CharString& p_symbol) {
+        add_native_method(p_method_name, NexusNativeMethod::bind<Signature>(get_library_symbol(p_library_name, p_symbol)));
+    }
+    _NO_DISCARD_ const void* get_library_symbol(const VString& p_library_name, const CharString& p_symbol) const;
+    // nullptr if no native has that name. Natives are never unregistered
+    _NO_DISCARD_ const NexusNativeMethod* get_native_method(const VString& p_method_name) const;
 
     NexusRuntime();
     ~NexusRuntime() override;
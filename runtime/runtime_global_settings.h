@@ -14,6 +14,17 @@ struct NexusRuntimeGlobalSettings {
 
     uint8_t task_scheduler_max_request_per_cycle;
     uint8_t task_scheduler_starting_thread_count;
+
+    // Calls before a method is handed to NexusJIT, 0 never compiles on calls
+    uint32_t jit_hotness_threshold;
+    // Iterations of any one loop before its method is handed to NexusJIT, 0 never compiles on loops.
+    // Interpreted calls still in the loop move to the compiled code at its next iteration
+    uint32_t jit_loop_threshold;
+    // Compile on a LOW priority thread pool worker instead of the calling task
+    bool jit_background_compilation;
+
+    // Translate verified methods to register instructions when they are decoded
+    bool interpreter_register_form;
 private:
     static NexusRuntimeGlobalSettings* singleton;
 public:
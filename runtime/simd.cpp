@@ -0,0 +1,241 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <cstring>
+#include <type_traits>
+#include "simd.h"
+
+// Packs wider than the default target are only passed between always inlined helpers
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// Every kernel is written once over a pack of Bytes / sizeof(T) lanes, using GCC vector extensions,
+// and instantiated inside functions compiled for each instruction set. Bytes == 0 is plain scalar code
+namespace {
+    template <class T, size_t Bytes>
+    struct Pack {
+#ifdef NEXUS_SIMD_ENABLED
+        typedef T Type __attribute__((vector_size(Bytes)));
+#endif
+        static constexpr size_t lanes = Bytes / sizeof(T);
+    };
+    template <class T>
+    struct Pack<T, 0> {
+        typedef T Type;
+        static constexpr size_t lanes = 1;
+    };
+
+    template <class V, class T>
+    _ALWAYS_INLINE_ V load(const T* p_from) {
+        V re;
+        memcpy(&re, p_from, sizeof(V));
+        return re;
+    }
+    template <class V, class T>
+    _ALWAYS_INLINE_ void store(T* p_to, const V& p_value) {
+        memcpy(p_to, &p_value, sizeof(V));
+    }
+    template <class V, class T>
+    _ALWAYS_INLINE_ V broadcast(const T& p_value) {
+        if constexpr (std::is_arithmetic_v<V>) return p_value;
+        else {
+            V re{};
+            return re + p_value;
+        }
+    }
+    // Comparisons give a bool for scalars and a lane mask of all ones or zeroes for packs
+    template <class V, class Mask>
+    _ALWAYS_INLINE_ V to_number(const Mask& p_mask) {
+        if constexpr (std::is_arithmetic_v<V>) return V(p_mask);
+#ifdef NEXUS_SIMD_ENABLED
+        else return __builtin_convertvector(-p_mask, V);
+#endif
+    }
+
+    template <class V>
+    _ALWAYS_INLINE_ auto element_of(const V& p_value) {
+        if constexpr (std::is_arithmetic_v<V>) return p_value;
+        else return p_value[0];
+    }
+    // Two's complement negation, MIN stays MIN
+    template <class V>
+    _ALWAYS_INLINE_ V wrapping_negate(const V& p_value) {
+        typedef std::make_unsigned_t<decltype(element_of(p_value))> U;
+        if constexpr (std::is_arithmetic_v<V>) return V(U(0) - U(p_value));
+#ifdef NEXUS_SIMD_ENABLED
+        else {
+            typedef U UV __attribute__((vector_size(sizeof(V))));
+            return (V)(UV{} - (UV)p_value);
+        }
+#endif
+    }
+
+#define NEXUS_SIMD_OP(m_name, m_expression)                                                     \
+    struct m_name {                                                                             \
+        template <class V>                                                                      \
+        static _ALWAYS_INLINE_ V apply(const V& p_lhs, const V& p_rhs) { return m_expression; } \
+    };
+    NEXUS_SIMD_OP(OpAdd, p_lhs + p_rhs)
+    NEXUS_SIMD_OP(OpSubtract, p_lhs - p_rhs)
+    NEXUS_SIMD_OP(OpMultiply, p_lhs * p_rhs)
+    NEXUS_SIMD_OP(OpMin, p_rhs < p_lhs ? p_rhs : p_lhs)
+    NEXUS_SIMD_OP(OpMax, p_lhs < p_rhs ? p_rhs : p_lhs)
+    NEXUS_SIMD_OP(OpEqual, to_number<V>(p_lhs == p_rhs))
+    NEXUS_SIMD_OP(OpNotEqual, to_number<V>(p_lhs != p_rhs))
+    NEXUS_SIMD_OP(OpLesser, to_number<V>(p_lhs < p_rhs))
+    NEXUS_SIMD_OP(OpLesserOrEqual, to_number<V>(p_lhs <= p_rhs))
+    NEXUS_SIMD_OP(OpGreater, to_number<V>(p_lhs > p_rhs))
+    NEXUS_SIMD_OP(OpGreaterOrEqual, to_number<V>(p_lhs >= p_rhs))
+#undef NEXUS_SIMD_OP
+    // Integer MIN / -1 gives MIN, as in NexusInterpreter, where idiv would trap.
+    // Lanes dividing by -1 divide by 1 and are negated instead
+    struct OpDivide {
+        template <class V>
+        static _ALWAYS_INLINE_ V apply(const V& p_lhs, const V& p_rhs) {
+            typedef decltype(element_of(p_lhs)) T;
+            if constexpr (std::is_floating_point_v<T>) return p_lhs / p_rhs;
+            else {
+                const auto negated = p_rhs == broadcast<V>(T(-1));
+                const V quotient = p_lhs / (negated ? broadcast<V>(T(1)) : p_rhs);
+                return negated ? wrapping_negate(quotient) : quotient;
+            }
+        }
+    };
+
+    template <class T, size_t Bytes, class Op, bool ScalarRhs>
+    _ALWAYS_INLINE_ void binary_loop(void* p_dst, const void* p_lhs, const void* p_rhs, size_t p_count) {
+        typedef typename Pack<T, Bytes>::Type V;
+        constexpr auto lanes = Pack<T, Bytes>::lanes;
+        auto dst = (T*)p_dst;
+        auto lhs = (const T*)p_lhs;
+        auto rhs = (const T*)p_rhs;
+        size_t i = 0;
+        if constexpr (ScalarRhs) {
+            const auto value = broadcast<V>(*rhs);
+            for (; i + lanes <= p_count; i += lanes) store(dst + i, Op::apply(load<V>(lhs + i), value));
+            for (; i < p_count; i++) dst[i] = Op::apply(lhs[i], *rhs);
+        } else {
+            for (; i + lanes <= p_count; i += lanes) store(dst + i, Op::apply(load<V>(lhs + i), load<V>(rhs + i)));
+            for (; i < p_count; i++) dst[i] = Op::apply(lhs[i], rhs[i]);
+        }
+    }
+
+    template <class T, size_t Bytes, class Op>
+    _ALWAYS_INLINE_ void reduce_loop(void* p_result, const void* p_src, size_t p_count) {
+        typedef typename Pack<T, Bytes>::Type V;
+        constexpr auto lanes = Pack<T, Bytes>::lanes;
+        auto src = (const T*)p_src;
+        if (!p_count) {
+            *(T*)p_result = T();
+            return;
+        }
+        T re = src[0];
+        size_t i = 1;
+        if constexpr (lanes > 1) {
+            if (p_count >= lanes) {
+                // One accumulator per lane, folded together at the end
+                auto accumulator = load<V>(src);
+                for (i = lanes; i + lanes <= p_count; i += lanes) accumulator = Op::apply(accumulator, load<V>(src + i));
+                re = accumulator[0];
+                for (size_t lane = 1; lane < lanes; lane++) re = Op::apply(re, T(accumulator[lane]));
+            }
+        }
+        for (; i < p_count; i++) re = Op::apply(re, src[i]);
+        *(T*)p_result = re;
+    }
+
+    template <class T, size_t Bytes>
+    _ALWAYS_INLINE_ void fill_loop(void* p_dst, const void* p_value, size_t p_count) {
+        typedef typename Pack<T, Bytes>::Type V;
+        constexpr auto lanes = Pack<T, Bytes>::lanes;
+        auto dst = (T*)p_dst;
+        const auto value = *(const T*)p_value;
+        const auto packed = broadcast<V>(value);
+        size_t i = 0;
+        for (; i + lanes <= p_count; i += lanes) store(dst + i, packed);
+        for (; i < p_count; i++) dst[i] = value;
+    }
+}
+
+// Entry points of one level, compiled with m_target and filled into m_namespace::kernels
+#define NEXUS_SIMD_ROW(m_kernel, m_op) { &m_kernel<int32_t, m_op>, &m_kernel<int64_t, m_op>, &m_kernel<float, m_op>, &m_kernel<double, m_op> }
+#define NEXUS_SIMD_KERNELS(m_namespace, m_target, m_bytes)                                                          \
+namespace m_namespace {                                                                                             \
+    template <class T, class Op>                                                                                    \
+    m_target void binary(void* p_dst, const void* p_lhs, const void* p_rhs, size_t p_count) {                       \
+        binary_loop<T, m_bytes, Op, false>(p_dst, p_lhs, p_rhs, p_count);                                          \
+    }                                                                                                               \
+    template <class T, class Op>                                                                                    \
+    m_target void binary_scalar(void* p_dst, const void* p_lhs, const void* p_rhs, size_t p_count) {                \
+        binary_loop<T, m_bytes, Op, true>(p_dst, p_lhs, p_rhs, p_count);                                           \
+    }                                                                                                               \
+    template <class T, class Op>                                                                                    \
+    m_target void reduce(void* p_result, const void* p_src, size_t p_count) {                                       \
+        reduce_loop<T, m_bytes, Op>(p_result, p_src, p_count);                                                      \
+    }                                                                                                               \
+    template <class T>                                                                                              \
+    m_target void fill(void* p_dst, const void* p_value, size_t p_count) {                                          \
+        fill_loop<T, m_bytes>(p_dst, p_value, p_count);                                                             \
+    }                                                                                                               \
+    const NexusSimd::Kernels kernels = {                                                                            \
+        { NEXUS_SIMD_ROW(binary, OpAdd), NEXUS_SIMD_ROW(binary, OpSubtract),                                        \
+          NEXUS_SIMD_ROW(binary, OpMultiply), NEXUS_SIMD_ROW(binary, OpDivide) },                                   \
+        { NEXUS_SIMD_ROW(binary_scalar, OpAdd), NEXUS_SIMD_ROW(binary_scalar, OpSubtract),                          \
+          NEXUS_SIMD_ROW(binary_scalar, OpMultiply), NEXUS_SIMD_ROW(binary_scalar, OpDivide) },                     \
+        { NEXUS_SIMD_ROW(binary, OpEqual), NEXUS_SIMD_ROW(binary, OpNotEqual),                                      \
+          NEXUS_SIMD_ROW(binary, OpLesser), NEXUS_SIMD_ROW(binary, OpLesserOrEqual),                                \
+          NEXUS_SIMD_ROW(binary, OpGreater), NEXUS_SIMD_ROW(binary, OpGreaterOrEqual) },                            \
+        { NEXUS_SIMD_ROW(reduce, OpAdd), NEXUS_SIMD_ROW(reduce, OpMin), NEXUS_SIMD_ROW(reduce, OpMax) },            \
+        { &fill<int32_t>, &fill<int64_t>, &fill<float>, &fill<double> },                                            \
+    };                                                                                                              \
+}
+
+NEXUS_SIMD_KERNELS(scalar_kernels, , 0)
+#ifdef NEXUS_SIMD_ENABLED
+NEXUS_SIMD_KERNELS(sse2_kernels, __attribute__((target("sse2"))), 16)
+NEXUS_SIMD_KERNELS(avx2_kernels, __attribute__((target("avx2"))), 32)
+// DQ brings 64 bit multiplies and conversions
+NEXUS_SIMD_KERNELS(avx512_kernels, __attribute__((target("avx512f,avx512dq"))), 64)
+#endif
+#undef NEXUS_SIMD_KERNELS
+#undef NEXUS_SIMD_ROW
+
+#ifdef NEXUS_SIMD_ENABLED
+const NexusSimd::Kernels* const NexusSimd::tables[LEVEL_MAX] = {
+        &scalar_kernels::kernels, &sse2_kernels::kernels, &avx2_kernels::kernels, &avx512_kernels::kernels };
+#else
+const NexusSimd::Kernels* const NexusSimd::tables[LEVEL_MAX] = {
+        &scalar_kernels::kernels, &scalar_kernels::kernels, &scalar_kernels::kernels, &scalar_kernels::kernels };
+#endif
+std::atomic<NexusSimd::Level> NexusSimd::level{ LEVEL_MAX };
+
+NexusSimd::Level NexusSimd::get_supported_level() {
+#ifdef NEXUS_SIMD_ENABLED
+    // Also checks that the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return LEVEL_AVX512;
+    if (__builtin_cpu_supports("avx2")) return LEVEL_AVX2;
+    return LEVEL_SSE2;
+#else
+    return LEVEL_SCALAR;
+#endif
+}
+
+NexusSimd::Level NexusSimd::get_level() {
+    auto re = level.load(std::memory_order_relaxed);
+    if (unlikely(re == LEVEL_MAX)) {
+        // Racing threads detect the same level
+        re = get_supported_level();
+        level.store(re, std::memory_order_relaxed);
+    }
+    return re;
+}
+
+void NexusSimd::set_level(const Level& p_level) {
+    auto supported = get_supported_level();
+    level.store(p_level < supported ? p_level : supported, std::memory_order_relaxed);
+}
+
+const NexusSimd::Kernels& NexusSimd::get_kernels() {
+    return *tables[get_level()];
+}
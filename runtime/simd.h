@@ -0,0 +1,102 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_SIMD_H
+#define NEXUS_SIMD_H
+
+#include <atomic>
+#include "../core/typedefs.h"
+#include "../language/standard_types.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Vector extensions and per function target attributes, see simd.cpp
+#define NEXUS_SIMD_ENABLED
+#endif
+
+// Bulk kernels over contiguous numbers, used by NexusTypedArray. One table per instruction set,
+// the widest one the CPU and OS support is picked on first use. Kernels work on unaligned memory,
+// so the destination may alias either source
+class NexusSimd {
+public:
+    enum Level : uint8_t {
+        LEVEL_SCALAR,
+        LEVEL_SSE2,
+        LEVEL_AVX2,
+        LEVEL_AVX512,
+        LEVEL_MAX,
+    };
+    // Order of the element types in the tables below
+    enum ElementType : uint8_t {
+        ELEMENT_I32,
+        ELEMENT_I64,
+        ELEMENT_F32,
+        ELEMENT_F64,
+        ELEMENT_MAX,
+    };
+    enum BinaryOp : uint8_t {
+        BINARY_ADD,
+        BINARY_SUBTRACT,
+        BINARY_MULTIPLY,
+        // Integer kernels do not check for zero, callers do
+        BINARY_DIVIDE,
+        BINARY_MAX,
+    };
+    // Results are 1 or 0 in the element type
+    enum CompareOp : uint8_t {
+        COMPARE_EQUAL,
+        COMPARE_NOT_EQUAL,
+        COMPARE_LESSER,
+        COMPARE_LESSER_OR_EQUAL,
+        COMPARE_GREATER,
+        COMPARE_GREATER_OR_EQUAL,
+        COMPARE_MAX,
+    };
+    // Floating point sums are added lane by lane, so they may round differently from a sequential loop
+    enum ReduceOp : uint8_t {
+        REDUCE_SUM,
+        // Need at least one element
+        REDUCE_MIN,
+        REDUCE_MAX,
+        REDUCE_MAX_OP,
+    };
+
+    // p_dst[i] = p_lhs[i] op p_rhs[i], or p_lhs[i] op *p_rhs for the scalar variants
+    typedef void (*BinaryKernel)(void* p_dst, const void* p_lhs, const void* p_rhs, size_t p_count);
+    // *p_result = p_src[0] op ... op p_src[p_count - 1]
+    typedef void (*ReduceKernel)(void* p_result, const void* p_src, size_t p_count);
+    // p_dst[i] = *p_value
+    typedef void (*FillKernel)(void* p_dst, const void* p_value, size_t p_count);
+
+    struct Kernels {
+        BinaryKernel binary[BINARY_MAX][ELEMENT_MAX];
+        BinaryKernel binary_scalar[BINARY_MAX][ELEMENT_MAX];
+        BinaryKernel compare[COMPARE_MAX][ELEMENT_MAX];
+        ReduceKernel reduce[REDUCE_MAX_OP][ELEMENT_MAX];
+        FillKernel fill[ELEMENT_MAX];
+    };
+private:
+    static const Kernels* const tables[LEVEL_MAX];
+    // LEVEL_MAX until the first get_level()
+    static std::atomic<Level> level;
+public:
+    // Widest level this machine supports
+    static Level get_supported_level();
+    _NO_DISCARD_ static Level get_level();
+    // Clamped to get_supported_level(), for tests and benchmarks. Not synchronized with running kernels
+    static void set_level(const Level& p_level);
+    _NO_DISCARD_ static const Kernels& get_kernels();
+
+    // ELEMENT_MAX if p_type is not an element type
+    _NO_DISCARD_ static constexpr ElementType element_type_of(const NexusStandardType& p_type) {
+        switch (p_type) {
+            case SIGNED_32_BIT_INTEGER: return ELEMENT_I32;
+            case SIGNED_64_BIT_INTEGER: return ELEMENT_I64;
+            case SINGLE_PRECISION_FLOATING_POINT: return ELEMENT_F32;
+            case DOUBLE_PRECISION_FLOATING_POINT: return ELEMENT_F64;
+            default: return ELEMENT_MAX;
+        }
+    }
+};
+
+#endif //NEXUS_SIMD_H
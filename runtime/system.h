@@ -6,6 +6,7 @@
 #define NEXUS_SYSTEM_H
 
 #include <thread>
+#include <chrono>
 #include "../core/typedefs.h"
 #include "../core/types/vstring.h"
 #include "../core/cmd_handler.h"
@@ -43,6 +44,15 @@ public:
         throw SystemException("Unavailable");
     }
     virtual void yield() { ManagedThread::yield(); }
+    // Monotonic wall clock, in microseconds
+    virtual uint64_t get_ticks_usec() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // CPU time consumed by the calling thread, in microseconds
+    virtual uint64_t get_thread_cpu_time_usec() {
+        throw SystemException("Unavailable");
+    }
     virtual ~System() = default;
 };
 
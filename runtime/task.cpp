@@ -4,10 +4,35 @@
 
 #include "../language/bytecode.h"
 #include "nexus_stack.h"
+#include "interpreter.h"
 #include "task.h"
 #include "task_scheduler.h"
+#include "system.h"
 
-NexusExecutionState::~NexusExecutionState() { delete thread_stack; }
+void TaskStatistics::merge(const TaskStatistics &p_other) {
+    cpu_time_usec += p_other.cpu_time_usec;
+    wall_time_usec += p_other.wall_time_usec;
+    frozen_time_usec += p_other.frozen_time_usec;
+    awaits_issued += p_other.awaits_issued;
+    instructions_executed += p_other.instructions_executed;
+    if (p_other.stack_peak_usage > stack_peak_usage) stack_peak_usage = p_other.stack_peak_usage;
+    task_count += p_other.task_count;
+}
+
+bool TaskGroup::is_cancelled() const {
+    if (cancelled.is_set()) return true;
+    if (deadline_usec && System::get_singleton()->get_ticks_usec() >= deadline_usec) {
+        // Latch, so later safepoints do not have to read the clock
+        cancelled.set();
+        return true;
+    }
+    return false;
+}
+
+NexusExecutionState::~NexusExecutionState() {
+    delete interpreter_context;
+    delete thread_stack;
+}
 
 NexusExecutionState::NexusExecutionState(const Ref<NexusMethodPointer> &p_method_pointer) : method_pointer(p_method_pointer) {
     thread_stack = new NexusStack(p_method_pointer->get_type_info_server(),
@@ -20,7 +45,7 @@ uint32_t Task::hash(const Task *p_task) { return p_task->get_id(); }
 uint32_t Task::hash(const Ref<Task> &p_task) { return hash(p_task.ptr()); }
 
 bool Task::compare(const Task *p_lhs, const Task *p_rhs) {
-    return p_lhs->get_id() == p_lhs->get_id();
+    return p_lhs->get_id() == p_rhs->get_id();
 }
 
 bool Task::compare(const Ref<Task> &p_lhs, const Ref<Task> &p_rhs) {
@@ -31,24 +56,36 @@ Task::Task(TupleT2<Task::AsyncCallbackReturn, Ref<Task>> (*p_callback)(NexusExec
            void (*p_resume_callback)(Ref<Task>, Ref<Task>),
            const Ref<NexusMethodPointer>& p_mp,
            const uint8_t& p_priority)
-           : Task(TaskScheduler::get_singleton()->task_id_allocator.increment(), p_callback, p_resume_callback, p_mp, p_priority) {}
+           : Task(TaskScheduler::next_task_id(), p_callback, p_resume_callback, p_mp, p_priority) {}
 
 Task::Task(const uint32_t &p_id,
            TupleT2<Task::AsyncCallbackReturn, Ref<Task>> (*p_callback)(NexusExecutionState *),
            void (*p_resume_callback)(Ref<Task>, Ref<Task>),
            const Ref<NexusMethodPointer> &p_mp, const uint8_t& p_priority)
-           : task_id(p_id), callback(p_callback), resume_callback(p_resume_callback), state(p_mp), priority(p_priority) {}
+           : ManagedObject(false), task_id(p_id), callback(p_callback), resume_callback(p_resume_callback), state(p_mp), priority(p_priority) {}
 
 TupleT2<Task::AsyncCallbackReturn, Ref<Task>> Task::execute() const {
     return callback(const_cast<NexusExecutionState*>(&state));
 }
 
 void Task::handle_resume() {
+    if (!resume_callback || get_child_task().is_null()) return;
     Ref<Task> as_ref = Ref<Task>::from_initialized_object(this);
     resume_callback(as_ref, get_child_task());
     set_child_task(Ref<Task>::null());
 }
 
+TupleT2<Task::AsyncCallbackReturn, Ref<Task>> Task::suspend(NexusExecutionState *p_state,
+                                                             const std::initializer_list<Ref<TaskWaitQueue>> &p_targets) {
+    for (const auto& target : p_targets) p_state->wait_targets.push_back(target);
+    return { SUSPEND, Ref<Task>::null() };
+}
+
+void Task::set_group(const Ref<TaskGroup> &p_group) {
+    group = p_group;
+    state.group = group.ptr();
+}
+
 NexusExecutionState *Task::get_state() {
     return &state;
 }
@@ -57,4 +94,36 @@ const NexusExecutionState *Task::get_state() const {
     return &state;
 }
 
-Task::~Task() = default;
\ No newline at end of file
+Task::~Task() = default;
+
+void TaskWaitQueue::park(const Ref<Task> &p_task, const uint32_t &p_token) {
+    waiters.enqueue({ p_task, p_token });
+    waiter_count.fetch_add(1, std::memory_order_seq_cst);
+    // Entries of tasks woken elsewhere are otherwise only dropped by notify_one, drop up to two here
+    // so a queue that is rarely notified stays bounded. A live entry goes back to the tail
+    Waiter waiter{};
+    for (int i = 0; i < 2 && waiters.try_dequeue(waiter); i++) {
+        if (TaskScheduler::is_parked(waiter.task, waiter.token)) {
+            waiters.enqueue(waiter);
+            break;
+        }
+        waiter_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+bool TaskWaitQueue::notify_one() {
+    // Pairs with the fence in TaskScheduler::park_task
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter_count.load(std::memory_order_seq_cst) == 0) return false;
+    Waiter waiter{};
+    while (waiters.try_dequeue(waiter)) {
+        waiter_count.fetch_sub(1, std::memory_order_relaxed);
+        // Entries left behind by a select that was woken elsewhere fail here
+        if (TaskScheduler::wake_task(waiter.task, waiter.token, this)) return true;
+    }
+    return false;
+}
+
+void TaskWaitQueue::notify_all() {
+    while (notify_one()) {}
+}
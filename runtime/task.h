@@ -5,19 +5,69 @@
 #ifndef NEXUS_TASK_H
 #define NEXUS_TASK_H
 
+#include <atomic>
+#include <exception>
+#include <initializer_list>
 #include "../core/types/object.h"
 #include "../core/types/tuple.h"
+#include "../core/types/lock_free_queue.h"
 
 class TaskScheduler;
 class NexusStack;
 class Task;
 class NexusMethodPointer;
+class TaskWaitQueue;
+struct NexusInterpreterContext;
 struct AmbiguousValue;
 
+struct TaskStatistics {
+    // CPU time spent executing on worker threads (CLOCK_THREAD_CPUTIME_ID)
+    uint64_t cpu_time_usec{};
+    // Time between the first dispatch and completion
+    uint64_t wall_time_usec{};
+    // Time spent in TaskScheduler::frozen_tasks, waiting for child tasks
+    uint64_t frozen_time_usec{};
+    uint64_t awaits_issued{};
+    uint64_t instructions_executed{};
+    // NexusStack high-water mark, in bytes. Merged records keep the maximum
+    uint64_t stack_peak_usage{};
+    // Number of tasks folded into this record
+    uint64_t task_count{};
+
+    void merge(const TaskStatistics& p_other);
+};
+
+// Cancellation token shared by every task of a group
+class TaskGroup : public ThreadSafeObject {
+private:
+    mutable SafeFlag cancelled{false};
+    // Absolute deadline on System::get_ticks_usec(), 0 if there is none
+    const uint64_t deadline_usec;
+public:
+    explicit TaskGroup(const uint64_t& p_deadline_usec = 0) : deadline_usec(p_deadline_usec) {}
+
+    _FORCE_INLINE_ void cancel() { cancelled.set(); }
+    _NO_DISCARD_ _FORCE_INLINE_ uint64_t get_deadline() const { return deadline_usec; }
+    _NO_DISCARD_ bool is_cancelled() const;
+};
+
 struct NexusExecutionState {
 public:
     NexusStack *thread_stack;
     Ref<NexusMethodPointer> method_pointer;
+    // Owned by the Task
+    const TaskGroup* group{};
+    // Filled before returning Task::SUSPEND, consumed by the scheduler
+    Vector<Ref<TaskWaitQueue>> wait_targets{};
+    // Bumped by the executor, folded into TaskStatistics by the scheduler
+    uint64_t instructions_executed{};
+    // Filled before returning Task::EXCEPTION_THROWN
+    std::exception_ptr exception{};
+    // Call stack of a task run by NexusInterpreter, owned by the state
+    NexusInterpreterContext* interpreter_context{};
+
+    // Checked by the executor at safepoints, the task must unwind and return Task::CANCELLED if true
+    _NO_DISCARD_ _FORCE_INLINE_ bool should_unwind() const { return group && group->is_cancelled(); }
 
     explicit NexusExecutionState(const Ref<NexusMethodPointer>& p_method_pointer);
     ~NexusExecutionState();
@@ -25,15 +75,22 @@ public:
 
 class TaskScheduler;
 
+// Not biased, tasks are created by one thread and run, awaited and released by others
 class Task : public ManagedObject {
 public:
     enum AsyncCallbackReturn {
         EXITED_SAFELY,
         EXCEPTION_THROWN,
         AWAIT,
+        // Unwound after observing a cancelled TaskGroup
+        CANCELLED,
+        // Parked until one of NexusExecutionState::wait_targets is ready,
+        // then executed again from the top of the callback
+        SUSPEND,
     };
 private:
     SafeFlag finished{false};
+    SafeFlag cancelled{false};
     uint32_t task_id;
     uint8_t priority;
 
@@ -42,9 +99,18 @@ private:
     // resume_callback(original_task, child_task)
     void (*resume_callback)(Ref<Task>, Ref<Task>);
     NexusExecutionState state;
+    Ref<TaskGroup> group{};
+    TaskStatistics statistics{};
+    uint64_t dispatched_at_usec{};
+    uint64_t frozen_at_usec{};
+    // Non-zero while parked on TaskWaitQueues, whoever clears it requeues the task
+    std::atomic<uint32_t> wait_token{0};
+    // Set by the TaskWaitQueue that woke the task
+    Ref<TaskWaitQueue> woken_by{};
 
     friend class TaskScheduler;
     _FORCE_INLINE_ void set_finished() { finished.set(); }
+    _FORCE_INLINE_ void set_cancelled() { cancelled.set(); }
     explicit Task(const uint32_t& p_id,
                   TupleT2<Task::AsyncCallbackReturn, Ref<Task>> (*p_callback)(NexusExecutionState*),
                   void (*p_resume_callback)(Ref<Task>, Ref<Task>),
@@ -54,9 +120,15 @@ public:
     _FORCE_INLINE_ uint32_t get_id() const { return task_id; }
     _FORCE_INLINE_ uint8_t get_priority() const { return priority; }
     _FORCE_INLINE_ bool is_finished() const { return finished.is_set(); }
+    // Cancelled tasks are also finished
+    _FORCE_INLINE_ bool is_cancelled() const { return cancelled.is_set(); }
+    // Finished by an exception, see NexusExecutionState::exception
+    _FORCE_INLINE_ bool is_faulted() const { return bool(state.exception); }
     _FORCE_INLINE_ void wait() const {
         finished.wait();
     }
+    // Only complete once is_finished() returns true
+    _FORCE_INLINE_ const TaskStatistics& get_statistics() const { return statistics; }
     static uint32_t hash(const Ref<Task>& p_task);
     static uint32_t hash(const Task* p_task);
     static bool compare(const Ref<Task>& p_lhs, const Ref<Task>& p_rhs);
@@ -64,12 +136,19 @@ public:
 
     _ALWAYS_INLINE_ void set_child_task(const Ref<Task>& p_child_task) { child_task = p_child_task; }
     _ALWAYS_INLINE_ Ref<Task> get_child_task() const { return child_task; }
+    _ALWAYS_INLINE_ Ref<TaskGroup> get_group() const { return group; }
+    void set_group(const Ref<TaskGroup>& p_group);
 
     NexusExecutionState* get_state();
     const NexusExecutionState* get_state() const;
     TupleT2<Task::AsyncCallbackReturn, Ref<Task>> execute() const;
     void handle_resume();
 
+    // Suspend the current task until any of p_targets becomes ready.
+    // Checking several channels before suspending on all of them implements select
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> suspend(NexusExecutionState* p_state,
+                                                                 const std::initializer_list<Ref<TaskWaitQueue>>& p_targets);
+
     explicit Task(TupleT2<Task::AsyncCallbackReturn, Ref<Task>> (*p_callback)(NexusExecutionState*),
                   void (*p_resume_callback)(Ref<Task>, Ref<Task>),
                   const Ref<NexusMethodPointer>& p_mp,
@@ -77,4 +156,26 @@ public:
     ~Task() override;
 };
 
+// A condition suspended tasks can park on, see Task::SUSPEND
+class TaskWaitQueue : public ThreadSafeObject {
+private:
+    struct Waiter {
+        Ref<Task> task{};
+        uint32_t token{};
+    };
+    UnboundedMPMCQueue<Waiter> waiters{};
+    std::atomic<uint32_t> waiter_count{0};
+
+    friend class TaskScheduler;
+    void park(const Ref<Task>& p_task, const uint32_t& p_token);
+public:
+    // Must be safe to call from any thread at any time
+    _NO_DISCARD_ virtual bool is_ready() const = 0;
+    // Wakes at most one parked task, call after every change that may make is_ready() true
+    bool notify_one();
+    void notify_all();
+
+    ~TaskWaitQueue() override = default;
+};
+
 #endif //NEXUS_TASK_H
@@ -6,6 +6,7 @@
 #include "../language/bytecode.h"
 #include "system.h"
 #include "nexus_output.h"
+#include "nexus_stack.h"
 #include "task.h"
 
 TaskScheduler* TaskScheduler::singleton = nullptr;
@@ -32,39 +33,252 @@ void TaskScheduler::freeze_task(const Ref<Task>& p_from_task, const Ref<Task>& p
     TASK_SCHEDULER->frozen_tasks[p_to_task] = p_from_task;
 }
 
+void TaskScheduler::record_statistics(const Ref<Task> &p_task) {
+    const auto& method_pointer = p_task->get_state()->method_pointer;
+    if (method_pointer.is_null()) return;
+    auto metadata = method_pointer->get_method_metadata();
+    if (metadata.is_null()) return;
+    W_GUARD(TASK_SCHEDULER->statistics_lock);
+    TASK_SCHEDULER->method_statistics[metadata->method_name].merge(p_task->statistics);
+}
+
+TaskStatistics TaskScheduler::get_method_statistics(const InternedString &p_method_name) {
+    R_GUARD(TASK_SCHEDULER->statistics_lock);
+    TaskStatistics re{};
+    TASK_SCHEDULER->method_statistics.try_get(p_method_name, re);
+    return re;
+}
+
+HashMap<InternedString, TaskStatistics> TaskScheduler::get_all_method_statistics() {
+    R_GUARD(TASK_SCHEDULER->statistics_lock);
+    return TASK_SCHEDULER->method_statistics;
+}
+
+uint64_t TaskScheduler::get_completed_task_count() {
+    return TASK_SCHEDULER->completed_task_count.get();
+}
+
+uint64_t TaskScheduler::get_instructions_executed() {
+    return TASK_SCHEDULER->instructions_executed.get();
+}
+
 std::future<void> TaskScheduler::queue_task(const Ref<Task> &p_task) {
 //    TS_W;
-    return queue_task_internal(p_task);
+    auto task = p_task;
+    task->dispatched_at_usec = System::get_singleton()->get_ticks_usec();
+    return queue_task_internal(task);
+}
+
+std::future<void> TaskScheduler::queue_task(const Ref<Task> &p_task, const Ref<TaskGroup> &p_group) {
+    auto task = p_task;
+    task->set_group(p_group);
+    return queue_task(task);
+}
+
+Ref<TaskGroup> TaskScheduler::create_group(const uint64_t &p_timeout_usec) {
+    uint64_t deadline = 0;
+    if (p_timeout_usec) deadline = System::get_singleton()->get_ticks_usec() + p_timeout_usec;
+    return Ref<TaskGroup>::make_ref(deadline);
+}
+
+void TaskScheduler::cancel_group(const Ref<TaskGroup> &p_group) {
+    if (p_group.is_null()) return;
+    auto group = p_group;
+    group->cancel();
+    wake_cancelled_tasks();
+}
+
+void TaskScheduler::wake_cancelled_tasks() {
+    Vector<Ref<Task>> tasks{};
+    Vector<uint32_t> tokens{};
+    {
+        std::unique_lock<std::mutex> guard(TASK_SCHEDULER->parking_mutex);
+        auto it = TASK_SCHEDULER->parked_tasks.const_iterator();
+        while (it.move_next()) {
+            const auto& pair = it.get_pair();
+            if (!pair.key->get_state()->should_unwind()) continue;
+            tasks.push_back(pair.key);
+            tokens.push_back(pair.value);
+        }
+    }
+    // Outside the lock, wake_task takes it again
+    for (size_t i = 0; i < tasks.size(); i++) wake_task(tasks[i], tokens[i], nullptr);
+}
+
+void TaskScheduler::watch_deadlines() {
+    std::unique_lock<std::mutex> guard(parking_mutex);
+    while (!is_parking_terminated) {
+        uint64_t next_deadline = 0;
+        auto it = parked_tasks.const_iterator();
+        while (it.move_next()) {
+            auto deadline = it.get_pair().key->get_group()->get_deadline();
+            if (deadline && (!next_deadline || deadline < next_deadline)) next_deadline = deadline;
+        }
+        if (!next_deadline) {
+            parking_condition.wait(guard);
+            continue;
+        }
+        auto now = System::get_singleton()->get_ticks_usec();
+        if (now < next_deadline) {
+            parking_condition.wait_for(guard, std::chrono::microseconds(next_deadline - now));
+            continue;
+        }
+        guard.unlock();
+        wake_cancelled_tasks();
+        guard.lock();
+    }
+}
+
+bool TaskScheduler::queue_background_work(const std::function<void()>& p_work) {
+    auto scheduler = TASK_SCHEDULER;
+    if (!scheduler || scheduler->is_terminating.is_set()) return false;
+    scheduler->thread_pool->queue_task(ThreadPool::LOW, p_work);
+    return true;
+}
+
+size_t TaskScheduler::get_worker_count() {
+    auto scheduler = TASK_SCHEDULER;
+    if (!scheduler || scheduler->is_terminating.is_set()) return 0;
+    return scheduler->thread_pool->get_thread_count();
+}
+
+void TaskScheduler::finish_task(const Ref<Task> &p_task, const uint64_t &p_now) {
+    auto current_task = p_task;
+    // Lock guard
+    TS_W
+    Ref<Task> parent_task{};
+    if (TASK_SCHEDULER->frozen_tasks.try_get(current_task, parent_task)) {
+        // current_task is spawned from another task, resuming root task
+        TASK_SCHEDULER->frozen_tasks.erase(current_task);
+        parent_task->statistics.frozen_time_usec += p_now - parent_task->frozen_at_usec;
+        queue_task_internal(parent_task);
+    }
+    current_task->set_finished();
 }
 
 TaskScheduler::TaskScheduler() {
     singleton = this;
     thread_pool = new ThreadPool();
     thread_pool->batch_allocate_workers(NexusRuntimeGlobalSettings::get_settings()->task_scheduler_starting_thread_count);
+    deadline_thread.start_method(this, &TaskScheduler::watch_deadlines);
+}
+
+void TaskScheduler::park_task(const Ref<Task> &p_task) {
+    auto current_task = p_task;
+    // The task may be running again before this function returns
+    auto targets = current_task->state.wait_targets;
+    current_task->state.wait_targets.clear();
+    if (targets.empty()) throw TaskSchedulerException("Task suspended without wait targets");
+    uint32_t token;
+    do {
+        token = TASK_SCHEDULER->wait_token_allocator.next();
+    } while (!token);
+    current_task->frozen_at_usec = System::get_singleton()->get_ticks_usec();
+    current_task->wait_token.store(token, std::memory_order_seq_cst);
+    const auto group = current_task->get_group();
+    if (group.is_valid()) {
+        std::unique_lock<std::mutex> guard(TASK_SCHEDULER->parking_mutex);
+        TASK_SCHEDULER->parked_tasks[current_task] = token;
+        if (group->get_deadline()) TASK_SCHEDULER->parking_condition.notify_one();
+    }
+    for (const auto& target : targets) const_cast<TaskWaitQueue*>(target.ptr())->park(current_task, token);
+    // Pairs with the fence in TaskWaitQueue::notify_one: either the notifier sees this task parked,
+    // or the readiness check below sees the notifier's change
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Likewise, cancel_group either finds this task in parked_tasks or the check below sees the
+    // group cancelled
+    if (current_task->get_state()->should_unwind()) {
+        wake_task(current_task, token, nullptr);
+        return;
+    }
+    for (const auto& target : targets) {
+        if (target->is_ready()) {
+            wake_task(current_task, token, const_cast<TaskWaitQueue*>(target.ptr()));
+            break;
+        }
+    }
+}
+
+bool TaskScheduler::is_parked(const Ref<Task> &p_task, const uint32_t &p_token) {
+    return p_task->wait_token.load(std::memory_order_acquire) == p_token;
+}
+
+bool TaskScheduler::wake_task(const Ref<Task> &p_task, const uint32_t &p_token, TaskWaitQueue *p_by) {
+    auto task = p_task;
+    auto expected = p_token;
+    if (!task->wait_token.compare_exchange_strong(expected, 0, std::memory_order_acq_rel)) return false;
+    if (task->get_group().is_valid()) {
+        std::unique_lock<std::mutex> guard(TASK_SCHEDULER->parking_mutex);
+        TASK_SCHEDULER->parked_tasks.erase(task);
+    }
+    if (p_by) task->woken_by = Ref<TaskWaitQueue>::from_initialized_object(p_by);
+    task->statistics.frozen_time_usec += System::get_singleton()->get_ticks_usec() - task->frozen_at_usec;
+    queue_task_internal(task);
+    return true;
 }
 
 void TaskScheduler::task_handler(const Ref<Task>& p_current_task) {
     auto current_task = p_current_task;
+    auto system = System::get_singleton();
+    if (current_task->get_state()->should_unwind()) {
+        // Dropped without running. A frozen parent is still resumed,
+        // and will observe the cancellation itself
+        current_task->set_cancelled();
+        finish_task(current_task, system->get_ticks_usec());
+        return;
+    }
+    const auto child_task = current_task->get_child_task();
+    if (child_task.is_valid() && child_task->is_cancelled() && child_task->get_group().ptr() != current_task->get_group().ptr()) {
+        // The awaited task was cancelled with a group this task is not part of. It never returned,
+        // so this task is cancelled in turn instead of resumed
+        current_task->set_cancelled();
+        finish_task(current_task, system->get_ticks_usec());
+        return;
+    }
+    auto cpu_time_begin = system->get_thread_cpu_time_usec();
     // If there's no branched task, it should do nothing
     current_task->handle_resume();
     // Return a tuple
     auto result = current_task->execute();
+    current_task->statistics.cpu_time_usec += system->get_thread_cpu_time_usec() - cpu_time_begin;
     Task::AsyncCallbackReturn async_return = Task::EXITED_SAFELY;
     Ref<Task> branched_task = Ref<Task>::null();
     result.unpack(async_return, branched_task);
+    if (current_task->woken_by.is_valid()) {
+        // A select may have consumed another target than the one that woke it, pass the wakeup on
+        auto woken_by = current_task->woken_by;
+        current_task->woken_by = Ref<TaskWaitQueue>::null();
+        if (woken_by->is_ready()) woken_by->notify_one();
+    }
     switch (async_return) {
         case Task::EXITED_SAFELY:{
-            // Lock guard
-            TS_W
-            if (TASK_SCHEDULER->frozen_tasks.has(current_task)) {
-                // current_task is spawned from another task, resuming root task
-                TASK_SCHEDULER->frozen_tasks.erase(current_task);
-                queue_task_internal(TASK_SCHEDULER->frozen_tasks[current_task]);
-            }
-            current_task->set_finished();
+            auto now = system->get_ticks_usec();
+            auto& statistics = current_task->statistics;
+            statistics.wall_time_usec = now - current_task->dispatched_at_usec;
+            statistics.instructions_executed = current_task->get_state()->instructions_executed;
+            statistics.stack_peak_usage = current_task->get_state()->thread_stack->get_peak_allocated();
+            statistics.task_count = 1;
+            TASK_SCHEDULER->completed_task_count.increment();
+            TASK_SCHEDULER->instructions_executed.add(statistics.instructions_executed);
+            record_statistics(current_task);
+            finish_task(current_task, now);
+            break;
+        }
+        case Task::CANCELLED: {
+            // Statistics only describe completed tasks
+            current_task->set_cancelled();
+            finish_task(current_task, system->get_ticks_usec());
             break;
         }
+        case Task::SUSPEND:
+            park_task(current_task);
+            break;
         case Task::AWAIT: {
+            current_task->statistics.awaits_issued++;
+            current_task->frozen_at_usec = system->get_ticks_usec();
+            branched_task->dispatched_at_usec = current_task->frozen_at_usec;
+            // Awaited tasks share the lifetime of their parent
+            if (branched_task->get_group().is_null()) branched_task->set_group(current_task->get_group());
             // Set this request's child task as the branched task's task object
             current_task->set_child_task(branched_task);
             freeze_task(current_task, branched_task);
@@ -72,14 +286,25 @@ void TaskScheduler::task_handler(const Ref<Task>& p_current_task) {
             break;
         }
         case Task::EXCEPTION_THROWN:
-            throw TaskSchedulerException("Not yet supported...");
+            // The exception is kept in the task's state, statistics only describe completed tasks
+            finish_task(current_task, system->get_ticks_usec());
+            break;
     }
 }
 
 TaskScheduler::~TaskScheduler() {
     is_terminating.set();
+    {
+        std::unique_lock<std::mutex> guard(parking_mutex);
+        is_parking_terminated = true;
+        parking_condition.notify_one();
+    }
+    deadline_thread.join();
     thread_pool->terminate_all_workers();
     delete thread_pool;
+    // Tasks still parked are never resumed
+    parked_tasks.clear();
+    if (singleton == this) singleton = nullptr;
 }
 
 #undef TASK_SCHEDULER
@@ -5,6 +5,7 @@
 #ifndef NEXUS_TASK_SCHEDULER_H
 #define NEXUS_TASK_SCHEDULER_H
 
+#include <condition_variable>
 #include "../core/exception.h"
 #include "../core/types/reference.h"
 #include "../core/types/tuple.h"
@@ -12,6 +13,8 @@
 #include "../core/types/linked_list.h"
 #include "../core/lock.h"
 #include "../core/types/queue.h"
+#include "../core/types/interned_string.h"
+#include "../core/types/sharded_counter.h"
 #include "runtime_global_settings.h"
 #include "thread_pool.h"
 
@@ -27,22 +30,65 @@ class TaskScheduler {
 private:
     static TaskScheduler* singleton;
     RWLock lock{};
-    SafeNumeric<uint32_t> task_id_allocator{0};
+    IDRangeAllocator<uint32_t> task_id_allocator{0};
+    IDRangeAllocator<uint32_t> wait_token_allocator{0};
     SafeFlag is_terminating{false};
     HashMap<Ref<Task>, Ref<Task>, Task, Task> frozen_tasks{};
+    RWLock statistics_lock{};
+    HashMap<InternedString, TaskStatistics> method_statistics{};
+    // Totals over every method, bumped by each worker without taking statistics_lock
+    ShardedCounter<uint64_t> completed_task_count{};
+    ShardedCounter<uint64_t> instructions_executed{};
     ThreadPool* thread_pool;
+    // Parked tasks of a group with their wait token, woken when the group is cancelled or its
+    // deadline passes. The deadline thread sleeps until the earliest deadline among them
+    std::mutex parking_mutex{};
+    std::condition_variable parking_condition{};
+    HashMap<Ref<Task>, uint32_t, Task, Task> parked_tasks{};
+    bool is_parking_terminated{false};
+    ManagedThread deadline_thread{};
 
     static _ALWAYS_INLINE_ TaskScheduler* get_singleton() { return singleton; }
     static _ALWAYS_INLINE_ uint32_t next_task_id() {
-        return get_singleton()->task_id_allocator.increment();
+        return get_singleton()->task_id_allocator.next();
     }
     static void task_handler(const Ref<Task>& p_async_request);
 
     friend class Task;
+    friend class TaskWaitQueue;
     static std::future<void> queue_task_internal(const Ref<Task>& p_task);
     static void freeze_task(const Ref<Task>& p_from_task, const Ref<Task>& p_to_task);
+    static void record_statistics(const Ref<Task>& p_task);
+    static void finish_task(const Ref<Task>& p_task, const uint64_t& p_now);
+    static void park_task(const Ref<Task>& p_task);
+    // Requeue p_task if it is still parked with p_token. p_by is nullptr if it was woken by cancellation
+    static bool wake_task(const Ref<Task>& p_task, const uint32_t& p_token, TaskWaitQueue* p_by);
+    static bool is_parked(const Ref<Task>& p_task, const uint32_t& p_token);
+    // Wakes every parked task whose group is cancelled, they unwind once requeued
+    static void wake_cancelled_tasks();
+    void watch_deadlines();
 public:
     static std::future<void> queue_task(const Ref<Task>& p_task);
+    // p_task and every task it awaits are bound to p_group
+    static std::future<void> queue_task(const Ref<Task>& p_task, const Ref<TaskGroup>& p_group);
+    // p_timeout_usec is relative to now, 0 for no deadline
+    static Ref<TaskGroup> create_group(const uint64_t& p_timeout_usec = 0);
+    // Queued tasks of the group are dropped before they run,
+    // running tasks unwind at their next safepoint
+    static void cancel_group(const Ref<TaskGroup>& p_group);
+    // Runs p_work on the LOW priority lane of the thread pool, after any task waiting for a worker.
+    // False if there is no scheduler to run it
+    static bool queue_background_work(const std::function<void()>& p_work);
+    // Threads of the pool, 0 if there is no scheduler
+    static size_t get_worker_count();
+
+    // Aggregated statistics of every finished task started from p_method_name
+    static TaskStatistics get_method_statistics(const InternedString& p_method_name);
+    static HashMap<InternedString, TaskStatistics> get_all_method_statistics();
+    // Tasks completed so far and the instructions they executed, including tasks without method
+    // metadata. Read while workers run, the two may not match
+    static uint64_t get_completed_task_count();
+    static uint64_t get_instructions_executed();
 
     TaskScheduler();
     ~TaskScheduler();
@@ -13,6 +13,7 @@
 #include "../core/types/vector.h"
 #include "../core/types/priority_queue.h"
 #include "../core/types/queue.h"
+#include "../core/types/object.h"
 
 template <class T>
 class GroupTaskPromise {
@@ -113,7 +114,10 @@ private:
                     }
                     dequeued = task_queue.try_pop(func);
                 }
-                if (dequeued) func();
+                if (dequeued) {
+                    func();
+                    BiasedObject::flush_thread();
+                }
             }
         });
         auto id = worker->get_id();
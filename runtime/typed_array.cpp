@@ -0,0 +1,71 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include "typed_array.h"
+
+NexusTypedArray::NexusTypedArray(const NexusStandardType& p_element_type, const size_t& p_size)
+        : ManagedObject(), element_type(p_element_type), kernel_type(NexusSimd::element_type_of(p_element_type)), element_count(p_size), data() {
+    if (kernel_type == NexusSimd::ELEMENT_MAX) throw TypedArrayException("Typed arrays hold 32 or 64 bit signed integers or floating points");
+    // Rounded up to whole cache lines, which keeps the widest kernels within one line per access
+    auto bytes = (p_size * get_element_size() + CACHE_LINE_SIZE - 1) & ~size_t(CACHE_LINE_SIZE - 1);
+    if (bytes) {
+        data = aligned_alloc(CACHE_LINE_SIZE, bytes);
+        if (!data) throw TypedArrayException("Out of memory");
+        memset(data, 0, bytes);
+    }
+}
+
+NexusTypedArray::~NexusTypedArray() {
+    free(data);
+}
+
+void NexusTypedArray::check_operand(const NexusTypedArray& p_operand) const {
+    if (p_operand.element_type != element_type) throw TypedArrayException("Operand of incompatible type");
+    if (p_operand.element_count != element_count) throw TypedArrayException("Operand of different size");
+}
+
+void NexusTypedArray::check_divisors(const void* p_divisors, const size_t& p_count) const {
+    if (kernel_type == NexusSimd::ELEMENT_I32) {
+        for (size_t i = 0; i < p_count; i++) if (unlikely(((const int32_t*)p_divisors)[i] == 0)) throw TypedArrayException("Division by zero");
+    } else {
+        for (size_t i = 0; i < p_count; i++) if (unlikely(((const int64_t*)p_divisors)[i] == 0)) throw TypedArrayException("Division by zero");
+    }
+}
+
+void NexusTypedArray::apply(const NexusSimd::BinaryOp& p_op, const NexusTypedArray& p_lhs, const NexusTypedArray& p_rhs) {
+    check_operand(p_lhs);
+    check_operand(p_rhs);
+    if (p_op == NexusSimd::BINARY_DIVIDE && is_integer()) check_divisors(p_rhs.data, element_count);
+    NexusSimd::get_kernels().binary[p_op][kernel_type](data, p_lhs.data, p_rhs.data, element_count);
+}
+
+void NexusTypedArray::apply_scalar(const NexusSimd::BinaryOp& p_op, const NexusTypedArray& p_lhs, const void* p_value) {
+    check_operand(p_lhs);
+    if (p_op == NexusSimd::BINARY_DIVIDE && is_integer()) check_divisors(p_value, 1);
+    NexusSimd::get_kernels().binary_scalar[p_op][kernel_type](data, p_lhs.data, p_value, element_count);
+}
+
+void NexusTypedArray::compare(const NexusSimd::CompareOp& p_op, const NexusTypedArray& p_lhs, const NexusTypedArray& p_rhs) {
+    check_operand(p_lhs);
+    check_operand(p_rhs);
+    NexusSimd::get_kernels().compare[p_op][kernel_type](data, p_lhs.data, p_rhs.data, element_count);
+}
+
+void NexusTypedArray::fill_element(const void* p_value) {
+    NexusSimd::get_kernels().fill[kernel_type](data, p_value, element_count);
+}
+
+void NexusTypedArray::reduce_element(const NexusSimd::ReduceOp& p_op, void* p_result) const {
+    if (!element_count && p_op != NexusSimd::REDUCE_SUM) throw TypedArrayException("Array is empty");
+    NexusSimd::get_kernels().reduce[p_op][kernel_type](p_result, data, element_count);
+}
+
+NexusTypedArray* NexusTypedArray::cast(const Ref<ManagedObject>& p_object) {
+    // The referenced array is not const, only the reference to it is
+    auto re = dynamic_cast<NexusTypedArray*>(const_cast<ManagedObject*>(p_object.ptr()));
+    if (!re) throw TypedArrayException("Object is not a typed array");
+    return re;
+}
@@ -0,0 +1,114 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_TYPED_ARRAY_H
+#define NEXUS_TYPED_ARRAY_H
+
+#include <type_traits>
+#include "../core/types/object.h"
+#include "../core/exception.h"
+#include "simd.h"
+
+class TypedArrayException : public Exception {
+public:
+    explicit TypedArrayException(const char* p_msg = nullptr) : Exception(p_msg) {}
+};
+
+// Fixed size, zero initialized array of one numeric type: SIGNED_32_BIT_INTEGER, SIGNED_64_BIT_INTEGER,
+// SINGLE_PRECISION_FLOATING_POINT or DOUBLE_PRECISION_FLOATING_POINT. Bulk operations run NexusSimd
+// kernels over the whole array; operands must have the same type and size as the array written to,
+// which may be one of them. Not synchronized
+class NexusTypedArray : public ManagedObject {
+    const NexusStandardType element_type;
+    const NexusSimd::ElementType kernel_type;
+    const size_t element_count;
+    // Cache line aligned
+    void* data;
+
+    void check_operand(const NexusTypedArray& p_operand) const;
+    void check_divisors(const void* p_divisors, const size_t& p_count) const;
+    _NO_DISCARD_ _FORCE_INLINE_ bool is_integer() const {
+        return kernel_type == NexusSimd::ELEMENT_I32 || kernel_type == NexusSimd::ELEMENT_I64;
+    }
+    // Converts between T and the element type. p_element holds one element, 8 bytes at most
+    template <class T>
+    void to_element(const T& p_value, void* p_element) const {
+        switch (kernel_type) {
+            case NexusSimd::ELEMENT_I32: *(int32_t*)p_element = int32_t(p_value); break;
+            case NexusSimd::ELEMENT_I64: *(int64_t*)p_element = int64_t(p_value); break;
+            case NexusSimd::ELEMENT_F32: *(float*)p_element = float(p_value); break;
+            default: *(double*)p_element = double(p_value); break;
+        }
+    }
+    template <class T>
+    _NO_DISCARD_ T from_element(const void* p_element) const {
+        switch (kernel_type) {
+            case NexusSimd::ELEMENT_I32: return T(*(const int32_t*)p_element);
+            case NexusSimd::ELEMENT_I64: return T(*(const int64_t*)p_element);
+            case NexusSimd::ELEMENT_F32: return T(*(const float*)p_element);
+            default: return T(*(const double*)p_element);
+        }
+    }
+    void apply_scalar(const NexusSimd::BinaryOp& p_op, const NexusTypedArray& p_lhs, const void* p_value);
+    void fill_element(const void* p_value);
+    void reduce_element(const NexusSimd::ReduceOp& p_op, void* p_result) const;
+public:
+    NexusTypedArray(const NexusStandardType& p_element_type, const size_t& p_size);
+    ~NexusTypedArray() override;
+
+    _NO_DISCARD_ _FORCE_INLINE_ NexusStandardType get_element_type() const { return element_type; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t size() const { return element_count; }
+    _NO_DISCARD_ _FORCE_INLINE_ size_t get_element_size() const {
+        return kernel_type == NexusSimd::ELEMENT_I32 || kernel_type == NexusSimd::ELEMENT_F32 ? 4 : 8;
+    }
+    _NO_DISCARD_ _FORCE_INLINE_ const void* ptr() const { return data; }
+    _NO_DISCARD_ _FORCE_INLINE_ void* ptrw() { return data; }
+
+    // Element p_index converted to or from T, which must be arithmetic
+    template <class T>
+    _NO_DISCARD_ T get(const size_t& p_index) const {
+        static_assert(std::is_arithmetic_v<T>);
+        if (p_index >= element_count) throw TypedArrayException("Index out of bounds");
+        return from_element<T>((const uint8_t*)data + p_index * get_element_size());
+    }
+    template <class T>
+    void set(const size_t& p_index, const T& p_value) {
+        static_assert(std::is_arithmetic_v<T>);
+        if (p_index >= element_count) throw TypedArrayException("Index out of bounds");
+        to_element(p_value, (uint8_t*)data + p_index * get_element_size());
+    }
+
+    // this = p_lhs op p_rhs, element by element
+    void apply(const NexusSimd::BinaryOp& p_op, const NexusTypedArray& p_lhs, const NexusTypedArray& p_rhs);
+    // this = p_lhs op p_value, with p_value converted to the element type first
+    template <class T>
+    void apply(const NexusSimd::BinaryOp& p_op, const NexusTypedArray& p_lhs, const T& p_value) {
+        static_assert(std::is_arithmetic_v<T>);
+        uint64_t element{};
+        to_element(p_value, &element);
+        apply_scalar(p_op, p_lhs, &element);
+    }
+    // this = 1 where p_lhs op p_rhs holds, 0 elsewhere
+    void compare(const NexusSimd::CompareOp& p_op, const NexusTypedArray& p_lhs, const NexusTypedArray& p_rhs);
+    template <class T>
+    void fill(const T& p_value) {
+        static_assert(std::is_arithmetic_v<T>);
+        uint64_t element{};
+        to_element(p_value, &element);
+        fill_element(&element);
+    }
+    // Sums of empty arrays are 0, their minimum and maximum throw
+    template <class T>
+    _NO_DISCARD_ T reduce(const NexusSimd::ReduceOp& p_op) const {
+        static_assert(std::is_arithmetic_v<T>);
+        uint64_t element{};
+        reduce_element(p_op, &element);
+        return from_element<T>(&element);
+    }
+
+    // Throws if p_object is not a NexusTypedArray
+    static NexusTypedArray* cast(const Ref<ManagedObject>& p_object);
+};
+
+#endif //NEXUS_TYPED_ARRAY_H
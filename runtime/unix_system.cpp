@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <dlfcn.h>
+#include <ctime>
 #include "unix_system.h"
 #include "../core/io/file_access_server.h"
 
@@ -22,6 +23,8 @@ void UnixSystem::load_dynamic_library(const VString &p_lib_path, void *&p_librar
     if (!FileAccessServer::exists(path)){
         path = get_executable_path().get_base_dir().plus_file("../lib").plus_file(p_lib_path.get_file());
     }
+    // Let the dynamic linker search its own paths
+    if (!FileAccessServer::exists(path)) path = p_lib_path;
     p_library_handle = dlopen(path.utf8().c_str(), RTLD_NOW);
     if (!p_library_handle) throw SystemException((VString("Can't open dynamic library: ") + p_lib_path
         + ". Error: " + dlerror()).utf8());
@@ -46,6 +49,12 @@ void UnixSystem::print_line(const VString &p_message) {
     std::wcout << p_message << L"\n";
 }
 
+uint64_t UnixSystem::get_thread_cpu_time_usec() {
+    timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) throw SystemException("Failed to read thread CPU time");
+    return uint64_t(ts.tv_sec) * 1'000'000 + uint64_t(ts.tv_nsec) / 1'000;
+}
+
 UnixSystem::UnixSystem() {
     singleton = this;
 }
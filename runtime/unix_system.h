@@ -14,6 +14,7 @@ public:
     void print_line(const VString& p_message) override;
     void print_error(const VString& p_message) override { print_line(p_message); }
     void print_warning(const VString& p_message) override { print_line(p_message); }
+    uint64_t get_thread_cpu_time_usec() override;
     UnixSystem();
     ~UnixSystem() override;
 };
@@ -0,0 +1,169 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include "verifier.h"
+#include "native_bindings/native_method.h"
+
+typedef NexusSerializedBytecode BC;
+typedef NexusInterpretedMethod::StackState StackState;
+
+static _FORCE_INLINE_ bool is_numeric(const StackItemMetadata* p_type) {
+    return p_type->type >= NexusStandardType::UNSIGNED_32_BIT_INTEGER &&
+           p_type->type <= NexusStandardType::DOUBLE_PRECISION_FLOATING_POINT;
+}
+
+static bool same_stack(const Vector<const StackItemMetadata*>& p_lhs, const Vector<const StackItemMetadata*>& p_rhs) {
+    if (p_lhs.size() != p_rhs.size()) return false;
+    for (size_t i = 0; i < p_lhs.size(); i++) if (p_lhs[i] != p_rhs[i]) return false;
+    return true;
+}
+
+const char* NexusBytecodeVerifier::verify(NexusInterpretedMethod* p_method, const NexusTypeInfoServer* p_type_info_server) {
+    const auto count = p_method->instructions_count + 1;
+    const auto slot_count = uint32_t(p_method->argument_types.size() + p_method->local_types.size());
+    const auto u32_type = p_type_info_server->get_primitive_metadata(NexusStandardType::UNSIGNED_32_BIT_INTEGER);
+    // Evaluation stack types on entry of every instruction reached so far
+    Vector<Vector<const StackItemMetadata*>> entries{};
+    Vector<StackState> states{};
+    for (uint32_t i = 0; i < count; i++) {
+        entries.push_back({});
+        states.push_back({ .opcode = NexusInterpretedMethod::get_generic_opcode(p_method->get_opcode(i)), .operand = p_method->instructions[i].operand,
+                           .depth = StackState::UNREACHABLE, .top = nullptr });
+    }
+    // Set by the first reachable return, nullptr if it returns nothing
+    const StackItemMetadata* return_type{};
+    bool returns = false;
+    Vector<uint32_t> worklist{};
+    states.ptrw()[0].depth = 0;
+    worklist.push_back(0);
+    auto flow_to = [&](const uint32_t& p_target, const Vector<const StackItemMetadata*>& p_stack) {
+        if (states[p_target].depth == StackState::UNREACHABLE) {
+            entries.ptrw()[p_target] = p_stack;
+            states.ptrw()[p_target].depth = p_stack.size();
+            worklist.push_back(p_target);
+            return true;
+        }
+        return same_stack(entries[p_target], p_stack);
+    };
+    // Handlers are entered with an empty evaluation stack from anywhere in their range
+    for (const auto& range : p_method->exception_table) {
+        if (!flow_to(range.handler, {})) return "Evaluation stack differs between branches";
+    }
+
+    while (!worklist.empty()) {
+        auto i = worklist.last();
+        worklist.pop_back();
+        auto stack = entries[i];
+        auto& state = states.ptrw()[i];
+        state.top = stack.empty() ? nullptr : stack.last();
+        const auto& instruction = p_method->instructions[i];
+        const auto depth = uint32_t(stack.size());
+        // NONE unless the instruction was decoded from a typed opcode
+        const auto specialized_type = NexusInterpretedMethod::get_specialized_type(p_method->get_opcode(i));
+        bool falls_through = true;
+        switch (state.opcode) {
+            case BC::OPCODE_UNUSED:
+                break;
+            case BC::OPCODE_LOAD_CONSTANT_I32:
+            case BC::OPCODE_LOAD_CONSTANT_I64:
+            case BC::OPCODE_LOAD_CONSTANT_U32:
+            case BC::OPCODE_LOAD_CONSTANT_U64:
+            case BC::OPCODE_LOAD_CONSTANT_FP32:
+            case BC::OPCODE_LOAD_CONSTANT_FP64:
+                stack.push_back(instruction.metadata);
+                break;
+            case BC::OP_DUPLICATE:
+                if (depth < 1) return "Evaluation stack underflow";
+                stack.push_back(stack.last());
+                break;
+            case BC::OP_POP:
+                if (depth < 1) return "Evaluation stack underflow";
+                stack.pop_back();
+                break;
+            case BC::OP_LOAD_ARG:
+                stack.push_back(p_method->argument_types[instruction.operand.u32]);
+                break;
+            case BC::OP_LOAD_STACK: {
+                auto index = instruction.operand.u32;
+                if (index >= slot_count + depth) return "Invalid stack frame index";
+                stack.push_back(index < slot_count ? p_method->get_slot_type(index) : stack[index - slot_count]);
+                break;
+            }
+            case BC::OP_STORE_ARG:
+            case BC::OP_STORE_STACK: {
+                auto index = instruction.operand.u32;
+                if (depth < 1) return "Evaluation stack underflow";
+                if (index >= slot_count + depth - 1) return "Invalid stack frame index";
+                auto target = index < slot_count ? p_method->get_slot_type(index) : stack[index - slot_count];
+                if (target != stack.last()) return "Can not store a value of incompatible type";
+                stack.pop_back();
+                break;
+            }
+            case BC::OP_ADD:
+            case BC::OP_SUBTRACT:
+            case BC::OP_MULTIPLY:
+            case BC::OP_DIVIDE:
+                if (depth < 2) return "Evaluation stack underflow";
+                if (stack[depth - 2] != stack[depth - 1]) return "Operands are of different types";
+                if (!is_numeric(stack.last())) return "Operator not supported for this type";
+                if (specialized_type != NexusStandardType::NONE && stack.last()->type != specialized_type)
+                    return "Operands are not of the type of the opcode";
+                stack.pop_back();
+                break;
+            case BC::OP_EQUAL:
+            case BC::OP_NOT_EQUAL:
+            case BC::OP_LESSER:
+            case BC::OP_LESSER_OR_EQUAL:
+            case BC::OP_GREATER:
+            case BC::OP_GREATER_OR_EQUAL:
+                if (depth < 2) return "Evaluation stack underflow";
+                if (stack[depth - 2] != stack[depth - 1]) return "Operands are of different types";
+                if (!is_numeric(stack.last())) return "Operator not supported for this type";
+                if (specialized_type != NexusStandardType::NONE && stack.last()->type != specialized_type)
+                    return "Operands are not of the type of the opcode";
+                stack.pop_back();
+                stack.last() = u32_type;
+                break;
+            case BC::OP_GOTO:
+                falls_through = false;
+                if (!flow_to(i + instruction.operand.i32, stack)) return "Evaluation stack differs between branches";
+                break;
+            case BC::OP_GOTO_IF_TRUE:
+            case BC::OP_GOTO_IF_FALSE:
+                if (depth < 1) return "Evaluation stack underflow";
+                if (!is_numeric(stack.last()) && stack.last()->type != NexusStandardType::METHOD) return "Condition must be numeric";
+                stack.pop_back();
+                if (!flow_to(i + instruction.operand.i32, stack)) return "Evaluation stack differs between branches";
+                break;
+            case NexusInterpretedMethod::QOP_CALL_NATIVE: {
+                const auto native = p_method->call_sites[instruction.operand.u32].native;
+                const auto argc = uint32_t(native->get_argument_count());
+                if (depth < argc) return "Evaluation stack underflow";
+                for (uint32_t j = 0; j < argc; j++) {
+                    if (stack[depth - argc + j]->type != native->get_argument_type(j)) return "Argument of incompatible type";
+                }
+                for (uint32_t j = 0; j < argc; j++) stack.pop_back();
+                if (native->get_return_type() != NexusStandardType::NONE)
+                    stack.push_back(p_type_info_server->get_primitive_metadata(native->get_return_type()));
+                break;
+            }
+            case BC::OP_RETURN: {
+                falls_through = false;
+                if (depth > 1) return "Values left on the evaluation stack on return";
+                auto returned = depth ? stack.last() : nullptr;
+                if (returns && returned != return_type) return "Methods must return the same type everywhere";
+                returns = true;
+                return_type = returned;
+                break;
+            }
+            default:
+                return "Stack effect is only known at run time";
+        }
+        if (stack.size() > p_method->max_stack) return "Evaluation stack overflow, max_stack exceeded";
+        if (falls_through && !flow_to(i + 1, stack)) return "Evaluation stack differs between branches";
+    }
+    p_method->stack_states = states;
+    p_method->verified = true;
+    return nullptr;
+}
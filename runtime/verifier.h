@@ -0,0 +1,24 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_VERIFIER_H
+#define NEXUS_VERIFIER_H
+
+#include "interpreter.h"
+
+// Proves at load time what NexusInterpreter otherwise checks on every instruction: the evaluation
+// stack never underflows or grows past max_stack, frame indexes are in range, and every operand has
+// the type its instruction needs. Every return leaves at most one value, of the same type on every
+// path as bytecode declares no return type. Abstract interprets the method over stack types, which must agree
+// wherever control flow merges.
+// Calls, field access and anything else whose stack effect is only known at run time make a method
+// unverifiable, it then runs fully checked
+class NexusBytecodeVerifier {
+public:
+    // Fills p_method's stack states and sets it verified. Returns nullptr on success, the reason
+    // otherwise. Must run before superinstructions are fused
+    static const char* verify(NexusInterpretedMethod* p_method, const NexusTypeInfoServer* p_type_info_server);
+};
+
+#endif //NEXUS_VERIFIER_H
@@ -63,6 +63,17 @@ void WindowsSystem::get_dynamic_library_symbol_handle(void *p_library_handle, co
     }
 }
 
+uint64_t WindowsSystem::get_thread_cpu_time_usec() {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+        throw SystemException("Failed to read thread CPU time");
+    // FILETIME is measured in 100-nanosecond intervals
+    auto to_u64 = [](const FILETIME& p_ft) -> uint64_t {
+        return (uint64_t(p_ft.dwHighDateTime) << 32) | uint64_t(p_ft.dwLowDateTime);
+    };
+    return (to_u64(kernel_time) + to_u64(user_time)) / 10;
+}
+
 WindowsSystem::WindowsSystem() : System() {
     singleton = this;
 }
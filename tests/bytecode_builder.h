@@ -0,0 +1,137 @@
+//
+// Created by cycastic on 8/17/2023.
+//
+
+#ifndef NEXUS_BYTECODE_BUILDER_H
+#define NEXUS_BYTECODE_BUILDER_H
+
+#include "../language/bytecode.h"
+
+// Assembles bytecode in memory, for tests and benchmarks
+typedef NexusSerializedBytecode BC;
+
+template <class ...Args>
+static Ref<NexusBytecodeRawInstruction> make_instruction(const NexusSerializedBytecode::OpCode& p_opcode, const Args&... p_args){
+    auto re = Ref<NexusBytecodeRawInstruction>::make_ref();
+    re->opcode = p_opcode;
+    (re->arguments.push_back(Ref<NexusBytecodeArgument>::make_ref(p_args)), ...);
+    return re;
+}
+
+static void add_method(const Ref<NexusBytecode>& p_bytecode, const InternedString& p_name,
+                       const Vector<NexusStandardType>& p_arguments, const Vector<NexusStandardType>& p_locals,
+                       const uint16_t& p_max_stack, const Vector<Ref<NexusBytecodeRawInstruction>>& p_instructions,
+                       const Vector<NexusBytecodeExceptionHandler>& p_exception_handlers = {}){
+    auto metadata = Ref<NexusBytecodeMethodMetadata>::make_ref();
+    metadata->id = p_bytecode->get_methods_metadata().size();
+    metadata->method_name = p_name;
+    auto body = Ref<NexusBytecodeMethodBody>::make_ref();
+    body->method_name = p_name;
+    for (const auto& type : p_arguments) body->arguments.push_back(Ref<NexusBytecodeArgument>::make_ref(type));
+    for (const auto& type : p_locals) body->locals_init.push_back(Ref<NexusBytecodeArgument>::make_ref(type));
+    body->max_stack = p_max_stack;
+    body->instructions = p_instructions;
+    body->exception_handlers = p_exception_handlers;
+    auto bytecode = p_bytecode;
+    bytecode->add_method(metadata, body);
+}
+
+static void add_external_method(const Ref<NexusBytecode>& p_bytecode, const InternedString& p_name){
+    auto metadata = Ref<NexusBytecodeMethodMetadata>::make_ref();
+    metadata->id = p_bytecode->get_methods_metadata().size();
+    metadata->method_name = p_name;
+    auto bytecode = p_bytecode;
+    bytecode->add_external_method(metadata);
+}
+
+static FilePointer to_virtual_file(const Ref<NexusBytecode>& p_bytecode){
+    auto file = FileAccessServer::open_virtual();
+    p_bytecode->serialize(file);
+    file->seek(0);
+    return file;
+}
+
+// sum(i64 n): sum of [0, n)
+static void add_sum_method(const Ref<NexusBytecode>& p_bytecode, const InternedString& p_name){
+    // Frame: 0: n, 1: i, 2: sum
+    add_method(p_bytecode, p_name, { SIGNED_64_BIT_INTEGER }, { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, 2, {
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"loop")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LESSER),
+        make_instruction(BC::OP_GOTO_IF_FALSE, InternedString(L"end")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(2)),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_STORE_STACK, uint32_t(2)),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_STORE_STACK, uint32_t(1)),
+        make_instruction(BC::OP_GOTO, InternedString(L"loop")),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(2)),
+        make_instruction(BC::OP_RETURN),
+    });
+}
+
+// fib(u64 n): naive recursive Fibonacci, dominated by calls
+static void add_fib_method(const Ref<NexusBytecode>& p_bytecode, const InternedString& p_name){
+    add_method(p_bytecode, p_name, { UNSIGNED_64_BIT_INTEGER }, {}, 3, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(2)),
+        make_instruction(BC::OP_LESSER),
+        make_instruction(BC::OP_GOTO_IF_FALSE, InternedString(L"recurse")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_RETURN),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"recurse")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(1)),
+        make_instruction(BC::OP_SUBTRACT),
+        make_instruction(BC::OP_CALL, p_name),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(2)),
+        make_instruction(BC::OP_SUBTRACT),
+        make_instruction(BC::OP_CALL, p_name),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+}
+
+// poly(i64 n): sum of (3i^2 - 5i + 7) / 2 for i in [0, n), dominated by arithmetic
+static void add_polynomial_method(const Ref<NexusBytecode>& p_bytecode, const InternedString& p_name){
+    // Frame: 0: n, 1: i, 2: sum
+    add_method(p_bytecode, p_name, { SIGNED_64_BIT_INTEGER }, { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, 5, {
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"loop")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LESSER),
+        make_instruction(BC::OP_GOTO_IF_FALSE, InternedString(L"end")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(2)),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OP_MULTIPLY),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(3)),
+        make_instruction(BC::OP_MULTIPLY),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(5)),
+        make_instruction(BC::OP_MULTIPLY),
+        make_instruction(BC::OP_SUBTRACT),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(7)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(2)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_STORE_STACK, uint32_t(2)),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_STORE_STACK, uint32_t(1)),
+        make_instruction(BC::OP_GOTO, InternedString(L"loop")),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+        make_instruction(BC::OP_LOAD_STACK, uint32_t(2)),
+        make_instruction(BC::OP_RETURN),
+    });
+}
+
+#endif //NEXUS_BYTECODE_BUILDER_H
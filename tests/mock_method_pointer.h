@@ -0,0 +1,30 @@
+//
+// Created by cycastic on 8/14/2023.
+//
+
+#ifndef NEXUS_MOCK_METHOD_POINTER_H
+#define NEXUS_MOCK_METHOD_POINTER_H
+
+#include "../language/bytecode.h"
+
+// Method pointer without a body, for tasks driven by native callbacks
+struct MockMethodPointer : public NexusMethodPointer {
+private:
+    Ref<NexusBytecodeMethodMetadata> method_metadata;
+public:
+    MockMethodPointer(const NexusTypeInfoServer* p_type_info_server, const InternedString& p_method_name)
+            : NexusMethodPointer(p_type_info_server), method_metadata(Ref<NexusBytecodeMethodMetadata>::make_ref()) {
+        method_metadata->method_name = p_method_name;
+    }
+
+    int64_t get_iterator() const override { return -1; }
+    void move_iterator(const int64_t& p_new_pos) override {}
+    Ref<NexusBytecodeRawInstruction> get_next_instruction() override { return Ref<NexusBytecodeRawInstruction>::null(); }
+    Ref<NexusBytecodeMethodMetadata> get_method_metadata() const override { return method_metadata; }
+    Vector<Ref<NexusBytecodeArgument>> get_arguments() const override { return {}; }
+    Vector<Ref<NexusBytecodeArgument>> get_locals() const override { return {}; }
+    uint16_t get_max_stack() const override { return 0; }
+    void load_method(const Ref<NexusBytecodeInstance>& p_bci, const InternedString& p_method_name) override {}
+};
+
+#endif //NEXUS_MOCK_METHOD_POINTER_H
@@ -0,0 +1,60 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#ifndef NEXUS_RUNTIME_TEST_FIXTURE_H
+#define NEXUS_RUNTIME_TEST_FIXTURE_H
+
+#include <gtest/gtest.h>
+#include "../runtime/config.h"
+#include "../runtime/runtime.h"
+#include "../runtime/interpreter.h"
+#include "../runtime/task_scheduler.h"
+#include "bytecode_builder.h"
+
+// Loads serialized bytecode into a fresh NexusRuntime and runs its methods as interpreted tasks
+class RuntimeTestFixture : public ::testing::Test {
+public:
+    NexusRuntime* runtime{};
+    // nexus_settings is static to each translation unit and only the one of whichever unit
+    // provided this SetUp is set, tests go through this pointer instead
+    NexusRuntimeGlobalSettings* settings{};
+
+    void SetUp() override {
+        InternedString::configure();
+        initialize_nexus_runtime(false);
+        settings = nexus_settings;
+        runtime = new NexusRuntime();
+    }
+    void TearDown() override {
+        destroy_nexus_runtime();
+        delete runtime;
+        InternedString::cleanup();
+    }
+    void load(const Ref<NexusBytecode>& p_bytecode, NexusBytecodeInstance::BytecodeLoadMode p_load_mode = NexusBytecodeInstance::LOAD_ALL){
+        auto file = to_virtual_file(p_bytecode);
+        runtime->load_bytecode(file, p_load_mode);
+    }
+    static void resume_callback(Ref<Task> p_task, Ref<Task> p_child) {}
+    template <typename T = int64_t>
+    Ref<Task> run(const InternedString& p_method, const Vector<T>& p_arguments, const Ref<TaskGroup>& p_group = Ref<TaskGroup>::null()){
+        auto task = Ref<Task>::make_ref(NexusInterpreter::execute, resume_callback, runtime->get_method(p_method));
+        if (!p_arguments.empty()){
+            auto& frame = task->get_state()->thread_stack->push_stack_frame();
+            for (const auto& argument : p_arguments) frame->push(argument);
+        }
+        if (p_group.is_null()) TaskScheduler::queue_task(task);
+        else TaskScheduler::queue_task(task, p_group);
+        task->wait();
+        return task;
+    }
+    template <typename T>
+    static T result_of(const Ref<Task>& p_task){
+        auto info = p_task->get_state()->thread_stack->get_last_frame()->top();
+        T re;
+        memcpy(&re, info.data, sizeof(T));
+        return re;
+    }
+};
+
+#endif //NEXUS_RUNTIME_TEST_FIXTURE_H
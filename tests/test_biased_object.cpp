@@ -0,0 +1,97 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <gtest/gtest.h>
+#include <future>
+#include <thread>
+#include "../core/types/object.h"
+
+static constexpr int THREAD_COUNT = 4;
+static constexpr int PER_THREAD = 10'000;
+
+class TrackedObject : public ManagedObject {
+    std::atomic<int>* destroyed;
+public:
+    explicit TrackedObject(std::atomic<int>* p_destroyed) : destroyed(p_destroyed) {}
+    ~TrackedObject() override { destroyed->fetch_add(1); }
+};
+
+TEST(BiasedObjectTest, TestOwnerOnly){
+    std::atomic<int> destroyed{};
+    {
+        auto object = Ref<TrackedObject>::make_ref(&destroyed);
+        auto copy = object;
+        EXPECT_EQ(object->get_reference_count(), 2);
+        EXPECT_EQ(ObjectDB::get_instance(object->get_object_id()).ptr(), object.ptr());
+    }
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST(BiasedObjectTest, TestReleasedByOtherThread){
+    std::atomic<int> destroyed{};
+    {
+        auto object = Ref<TrackedObject>::make_ref(&destroyed);
+        // Copied here, released over there: the shared count goes negative and queues the object back
+        std::thread([copy = object]() mutable { copy = Ref<TrackedObject>(); }).join();
+        EXPECT_EQ(object->get_reference_count(), 1);
+    }
+    // The biased count still holds the reference the other thread released, until this thread flushes
+    EXPECT_EQ(destroyed.load(), 0);
+    BiasedObject::flush_thread();
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST(BiasedObjectTest, TestDeferredUntilOwnerExits){
+    std::atomic<int> destroyed{};
+    Ref<TrackedObject> object{};
+    std::promise<void> created{};
+    std::promise<void> released{};
+    // The owner outlives the release and never flushes until it exits
+    std::thread owner([&object, &destroyed, &created, &released]() {
+        object = Ref<TrackedObject>::make_ref(&destroyed);
+        created.set_value();
+        released.get_future().wait();
+    });
+    created.get_future().wait();
+    object = Ref<TrackedObject>();
+    // Queued to the owner, which still counts the reference this thread released
+    EXPECT_EQ(destroyed.load(), 0);
+    released.set_value();
+    owner.join();
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST(BiasedObjectTest, TestOwnerExited){
+    std::atomic<int> destroyed{};
+    Ref<TrackedObject> object{};
+    std::thread([&object, &destroyed]() { object = Ref<TrackedObject>::make_ref(&destroyed); }).join();
+    auto copy = object;
+    EXPECT_EQ(object->get_reference_count(), 2);
+    copy = Ref<TrackedObject>();
+    EXPECT_EQ(destroyed.load(), 0);
+    // Nobody is left to flush, the last release merges on its own
+    object = Ref<TrackedObject>();
+    EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST(BiasedObjectTest, TestConcurrentReleases){
+    std::atomic<int> destroyed{};
+    {
+        auto object = Ref<TrackedObject>::make_ref(&destroyed);
+        std::vector<std::thread> threads{};
+        for (int i = 0; i < THREAD_COUNT; i++){
+            threads.emplace_back([copy = object]() mutable {
+                for (int j = 0; j < PER_THREAD; j++) {
+                    auto other = copy;
+                    EXPECT_GE(other->get_reference_count(), 1);
+                }
+                copy = Ref<TrackedObject>();
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        EXPECT_EQ(object->get_reference_count(), 1);
+    }
+    BiasedObject::flush_thread();
+    EXPECT_EQ(destroyed.load(), 1);
+}
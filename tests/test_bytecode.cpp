@@ -0,0 +1,48 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <gtest/gtest.h>
+#include "bytecode_builder.h"
+
+class BytecodeTestFixture : public ::testing::Test {
+public:
+    void SetUp() override {
+        InternedString::configure();
+    }
+    void TearDown() override {
+        InternedString::cleanup();
+    }
+};
+
+TEST_F(BytecodeTestFixture, TestConstantPool){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_fib_method(bytecode, L"fib");
+    add_method(bytecode, L"half", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 0.5),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(2)),
+        make_instruction(BC::OP_RETURN),
+    });
+    auto loaded = NexusBytecode(to_virtual_file(bytecode));
+    // Method names and labels, each stored once however many times it is used
+    const auto& pool = loaded.get_constant_pool();
+    ASSERT_EQ(pool->strings.size(), 3);
+    EXPECT_EQ(pool->strings[0], InternedString(L"fib"));
+    EXPECT_EQ(pool->strings[2], InternedString(L"recurse"));
+    // 2, 1, 0.5 and -1
+    EXPECT_EQ(pool->numbers.size(), 4);
+
+    loaded.build_bodies_map();
+    const auto& fib = loaded.get_bodies_map()[L"fib"];
+    EXPECT_EQ(fib->method_name, InternedString(L"fib"));
+    ASSERT_EQ(fib->get_instructions_count(), 17);
+    EXPECT_EQ(fib->instructions[1]->arguments[0]->get_data<uint64_t>(), 2);
+    EXPECT_EQ(fib->instructions[3]->arguments[0]->get_data<InternedString>(), InternedString(L"recurse"));
+    EXPECT_EQ(fib->instructions[10]->arguments[0]->get_data<InternedString>(), InternedString(L"fib"));
+    const auto& half = loaded.get_bodies_map()[L"half"];
+    EXPECT_EQ(half->instructions[0]->arguments[0]->get_data<double>(), 0.5);
+    EXPECT_EQ(half->instructions[1]->arguments[0]->get_data<int64_t>(), -1);
+    EXPECT_EQ(half->instructions[1]->arguments[0]->type, SIGNED_64_BIT_INTEGER);
+    EXPECT_EQ(half->instructions[2]->arguments[0]->get_data<uint64_t>(), 2);
+}
@@ -0,0 +1,243 @@
+//
+// Created by cycastic on 8/14/2023.
+//
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "../runtime/config.h"
+#include "../runtime/nexus_stack.h"
+#include "../runtime/channel.h"
+#include "mock_method_pointer.h"
+
+static constexpr int64_t MESSAGE_COUNT = 20'000;
+
+template <class Queue>
+static void produce_and_consume(Queue& p_queue, const int& p_producers, const int& p_consumers){
+    std::atomic<int64_t> sum{0};
+    std::atomic<int64_t> received{0};
+    const int64_t per_producer = MESSAGE_COUNT / p_producers;
+    const int64_t total = per_producer * p_producers;
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < p_producers; i++){
+        threads.emplace_back([&p_queue, per_producer](){
+            for (int64_t v = 1; v <= per_producer; v++){
+                while (!p_queue.try_enqueue(v)) std::this_thread::yield();
+            }
+        });
+    }
+    for (int i = 0; i < p_consumers; i++){
+        threads.emplace_back([&p_queue, &sum, &received, total](){
+            int64_t v{};
+            while (received.load() < total){
+                if (p_queue.try_dequeue(v)){
+                    sum.fetch_add(v);
+                    received.fetch_add(1);
+                } else std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(sum.load(), p_producers * (per_producer * (per_producer + 1) / 2));
+    EXPECT_TRUE(p_queue.empty());
+}
+
+TEST(LockFreeQueueTest, TestBoundedMPMCQueue){
+    BoundedMPMCQueue<int64_t> queue(6);
+    EXPECT_EQ(queue.capacity(), 8);
+    for (int64_t i = 0; i < 8; i++) EXPECT_TRUE(queue.try_enqueue(i));
+    EXPECT_FALSE(queue.try_enqueue(8));
+    int64_t v{};
+    for (int64_t i = 0; i < 8; i++){
+        EXPECT_TRUE(queue.try_dequeue(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_FALSE(queue.try_dequeue(v));
+    produce_and_consume(queue, 3, 3);
+}
+
+TEST(LockFreeQueueTest, TestBoundedSPSCQueue){
+    BoundedSPSCQueue<int64_t> queue(4);
+    for (int64_t i = 0; i < 4; i++) EXPECT_TRUE(queue.try_enqueue(i));
+    EXPECT_FALSE(queue.try_enqueue(4));
+    int64_t v{};
+    for (int64_t i = 0; i < 4; i++){
+        EXPECT_TRUE(queue.try_dequeue(v));
+        EXPECT_EQ(v, i);
+    }
+    produce_and_consume(queue, 1, 1);
+}
+
+TEST(LockFreeQueueTest, TestUnboundedQueues){
+    UnboundedSPSCQueue<int64_t, 16> spsc{};
+    produce_and_consume(spsc, 1, 1);
+    UnboundedMPMCQueue<int64_t, 16> mpmc{};
+    produce_and_consume(mpmc, 3, 3);
+    // Non trivial values must survive segment switches
+    UnboundedMPMCQueue<Ref<ThreadSafeObject>, 4> refs{};
+    auto object = Ref<ThreadSafeObject>::make_ref();
+    for (int i = 0; i < 10; i++) refs.enqueue(object);
+    EXPECT_EQ(object->get_reference_count(), 11);
+    Ref<ThreadSafeObject> out{};
+    while (refs.try_dequeue(out)) {}
+    out = Ref<ThreadSafeObject>::null();
+    EXPECT_EQ(object->get_reference_count(), 1);
+}
+
+class ChannelTestFixture : public ::testing::Test {
+    static NexusTypeInfoServer* type_info_server;
+public:
+    static Ref<BoundedChannel<int64_t>> numbers;
+    static Ref<UnboundedChannel<int64_t>> other_numbers;
+    static std::atomic<int64_t> next_value;
+    static std::atomic<int64_t> sum;
+    static std::atomic<int64_t> suspensions;
+
+    void SetUp() override {
+        InternedString::configure();
+        initialize_nexus_runtime(false);
+        type_info_server = new NexusTypeInfoServer(true);
+        numbers = Ref<BoundedChannel<int64_t>>::make_ref(4);
+        other_numbers = Ref<UnboundedChannel<int64_t>>::make_ref();
+        next_value = 1;
+        sum = 0;
+        suspensions = 0;
+    }
+    void TearDown() override {
+        numbers = Ref<BoundedChannel<int64_t>>::null();
+        other_numbers = Ref<UnboundedChannel<int64_t>>::null();
+        destroy_nexus_runtime();
+        delete type_info_server;
+        InternedString::cleanup();
+    }
+    static Ref<Task> make_task(TupleT2<Task::AsyncCallbackReturn, Ref<Task>> (*p_callback)(NexusExecutionState*)){
+        return Ref<Task>::make_ref(p_callback, nullptr,
+                                   Ref<MockMethodPointer>::make_ref(type_info_server, L"channel").safe_cast<NexusMethodPointer>());
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> producer_callback(NexusExecutionState* p_state){
+        while (next_value <= MESSAGE_COUNT){
+            if (!numbers->try_send(next_value)) {
+                suspensions++;
+                return Task::suspend(p_state, { numbers->writable() });
+            }
+            next_value++;
+        }
+        numbers->close();
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> consumer_callback(NexusExecutionState* p_state){
+        int64_t v{};
+        for (;;) {
+            if (numbers->try_recv(v)) {
+                sum += v;
+                continue;
+            }
+            if (numbers->is_closed()) break;
+            suspensions++;
+            return Task::suspend(p_state, { numbers->readable() });
+        }
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> select_callback(NexusExecutionState* p_state){
+        int64_t v{};
+        if (try_select_recv(v, *numbers.ptr(), *other_numbers.ptr()) >= 0) {
+            sum += v;
+            return { Task::EXITED_SAFELY, Ref<Task>::null() };
+        }
+        suspensions++;
+        return Task::suspend(p_state, { numbers->readable(), other_numbers->readable() });
+    }
+};
+
+NexusTypeInfoServer* ChannelTestFixture::type_info_server = nullptr;
+Ref<BoundedChannel<int64_t>> ChannelTestFixture::numbers{};
+Ref<UnboundedChannel<int64_t>> ChannelTestFixture::other_numbers{};
+std::atomic<int64_t> ChannelTestFixture::next_value{};
+std::atomic<int64_t> ChannelTestFixture::sum{};
+std::atomic<int64_t> ChannelTestFixture::suspensions{};
+
+TEST_F(ChannelTestFixture, TestProducerConsumerTasks){
+    auto consumer = make_task(consumer_callback);
+    auto producer = make_task(producer_callback);
+    TaskScheduler::queue_task(consumer);
+    TaskScheduler::queue_task(producer);
+    producer->wait();
+    consumer->wait();
+    EXPECT_EQ(sum.load(), MESSAGE_COUNT * (MESSAGE_COUNT + 1) / 2);
+    // Capacity is 4, so both sides must have been parked at least once
+    EXPECT_GT(suspensions.load(), 0);
+}
+
+TEST_F(ChannelTestFixture, TestSelect){
+    auto task = make_task(select_callback);
+    TaskScheduler::queue_task(task);
+    while (suspensions.load() == 0) std::this_thread::yield();
+    EXPECT_FALSE(task->is_finished());
+    EXPECT_TRUE(other_numbers->send(42));
+    task->wait();
+    EXPECT_EQ(sum.load(), 42);
+}
+
+TEST_F(ChannelTestFixture, TestCloseWakesReceivers){
+    auto first = make_task(consumer_callback);
+    auto second = make_task(consumer_callback);
+    TaskScheduler::queue_task(first);
+    TaskScheduler::queue_task(second);
+    while (suspensions.load() < 2) std::this_thread::yield();
+    EXPECT_TRUE(numbers->send(7));
+    numbers->close();
+    EXPECT_FALSE(numbers->try_send(8));
+    first->wait();
+    second->wait();
+    EXPECT_EQ(sum.load(), 7);
+    int64_t v{};
+    EXPECT_FALSE(numbers->recv(v));
+}
+
+TEST_F(ChannelTestFixture, TestCancelParkedTask){
+    auto group = TaskScheduler::create_group();
+    auto task = make_task(consumer_callback);
+    TaskScheduler::queue_task(task, group);
+    while (suspensions.load() == 0) std::this_thread::yield();
+    // Nothing is ever sent, only the cancellation wakes it
+    TaskScheduler::cancel_group(group);
+    task->wait();
+    EXPECT_TRUE(task->is_cancelled());
+
+    auto expiring = make_task(consumer_callback);
+    TaskScheduler::queue_task(expiring, TaskScheduler::create_group(2000));
+    expiring->wait();
+    EXPECT_TRUE(expiring->is_cancelled());
+    EXPECT_EQ(suspensions.load(), 2);
+}
+
+TEST_F(ChannelTestFixture, TestBlockingThreads){
+    // Capacity is 4, both threads block on each other many times
+    std::thread consumer([](){
+        int64_t v{};
+        while (numbers->recv(v)) sum += v;
+    });
+    for (int64_t v = 1; v <= MESSAGE_COUNT; v++) EXPECT_TRUE(numbers->send(v));
+    numbers->close();
+    consumer.join();
+    EXPECT_EQ(sum.load(), MESSAGE_COUNT * (MESSAGE_COUNT + 1) / 2);
+    EXPECT_FALSE(numbers->send(1));
+}
+
+TEST_F(ChannelTestFixture, TestBlockingSelect){
+    int64_t v{};
+    std::thread sender([](){
+        ManagedThread::sleep(1000);
+        other_numbers->send(42);
+        // The select keeps waiting on the channel still open
+        numbers->close();
+        ManagedThread::sleep(1000);
+        other_numbers->send(43);
+        other_numbers->close();
+    });
+    EXPECT_EQ(select_recv(v, *numbers.ptr(), *other_numbers.ptr()), 1);
+    EXPECT_EQ(v, 42);
+    EXPECT_EQ(select_recv(v, *numbers.ptr(), *other_numbers.ptr()), 1);
+    EXPECT_EQ(v, 43);
+    EXPECT_EQ(select_recv(v, *numbers.ptr(), *other_numbers.ptr()), -1);
+    sender.join();
+}
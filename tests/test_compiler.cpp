@@ -0,0 +1,133 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <gtest/gtest.h>
+#include "../language/compiler.h"
+#include "runtime_test_fixture.h"
+
+typedef NexusInterpretedMethod IM;
+typedef NexusASTNode AST;
+
+class CompilerTestFixture : public RuntimeTestFixture {
+public:
+    struct Parameter {
+        NexusStandardType type;
+        const wchar_t* name;
+    };
+
+    template <typename T, typename R>
+    R evaluate(const InternedString& p_method, const Vector<T>& p_arguments){
+        auto task = run(p_method, p_arguments);
+        EXPECT_EQ(task->get_state()->exception, nullptr);
+        return result_of<R>(task);
+    }
+
+    template <class T, class ...Args>
+    static Ref<AST> node(const Args&... p_args) { return Ref<T>::make_ref(p_args...).template c_style_cast<AST>(); }
+    static Ref<AST> identifier(const wchar_t* p_name) { return node<IdentifierNode>(InternedString(p_name)); }
+    static Ref<AST> binary(const AST::OperatorType& p_op, const Ref<AST>& p_lhs, const Ref<AST>& p_rhs) {
+        return node<BinaryOperatorNode>(p_op, p_lhs, p_rhs);
+    }
+    static Ref<AST> variable(const wchar_t* p_name, const NexusStandardType& p_type, const Ref<AST>& p_value) {
+        auto name = identifier(p_name).c_style_cast<IdentifierNode>();
+        auto initialization = Ref<VariableInitializationNode>::make_ref(p_value);
+        return node<VariableDeclarationNode>(name, p_type, ArgumentPropertyNode{ .properties = ArgumentPropertyNode::NO_PROP }, initialization);
+    }
+    static Ref<AST> call(const wchar_t* p_name, const Vector<Ref<AST>>& p_arguments) {
+        auto arguments = Ref<ArgumentsNode>::make_ref();
+        for (const auto& argument : p_arguments) arguments->arguments.push_back(Ref<ArgumentNode>::make_ref(argument));
+        return node<MethodInvocationNode>(InternedString(p_name), arguments);
+    }
+    static Ref<AST> ret(const Ref<AST>& p_value) { return node<ReturnNode>(p_value); }
+    static void declare(const Ref<NexusParser::NexusASTPackage>& p_package, const wchar_t* p_name, const NexusStandardType& p_return_type,
+                        const Vector<Parameter>& p_arguments, const Vector<Ref<AST>>& p_body) {
+        auto arguments = Ref<ArgumentsDeclarationNode>::make_ref();
+        for (const auto& argument : p_arguments) {
+            auto name = identifier(argument.name).c_style_cast<IdentifierNode>();
+            arguments->arguments.push_back(Ref<ArgumentDeclarationNode>::make_ref(argument.type, name,
+                                                                                  ArgumentPropertyNode{ .properties = ArgumentPropertyNode::NO_PROP }));
+        }
+        auto package = p_package;
+        package->method_declarations[InternedString(p_name)] = Ref<MethodDeclarationNode>::make_ref(
+                InternedString(p_name), arguments, Ref<MethodBodyNode>::make_ref(p_body), p_return_type);
+    }
+};
+
+TEST_F(CompilerTestFixture, TestTypedOpcodes){
+    auto package = Ref<NexusParser::NexusASTPackage>::make_ref();
+    // f64 half_area(f64 w, f64 h) { return w * h / 2.0; }
+    declare(package, L"half_area", DOUBLE_PRECISION_FLOATING_POINT, { { DOUBLE_PRECISION_FLOATING_POINT, L"w" }, { DOUBLE_PRECISION_FLOATING_POINT, L"h" } }, {
+        ret(binary(AST::OP_DIVIDE, binary(AST::OP_MULTIPLY, identifier(L"w"), identifier(L"h")), node<RealValueNode>(2.0))),
+    });
+    // f64 area_plus(f64 x) { f64 a = half_area(x, x + 1); a += 0.5; return a; }
+    declare(package, L"area_plus", DOUBLE_PRECISION_FLOATING_POINT, { { DOUBLE_PRECISION_FLOATING_POINT, L"x" } }, {
+        variable(L"a", DOUBLE_PRECISION_FLOATING_POINT,
+                 call(L"half_area", { identifier(L"x"), binary(AST::OP_ADD, identifier(L"x"), node<IntegerValueNode>(1)) })),
+        binary(AST::OP_ADD_ASSIGN, identifier(L"a"), node<RealValueNode>(0.5)),
+        ret(identifier(L"a")),
+    });
+    // u32 less(i32 a, i32 b) { return a < b; }
+    declare(package, L"less", UNSIGNED_32_BIT_INTEGER, { { SIGNED_32_BIT_INTEGER, L"a" }, { SIGNED_32_BIT_INTEGER, L"b" } }, {
+        ret(binary(AST::OP_LESSER, identifier(L"a"), identifier(L"b"))),
+    });
+    load(NexusCompiler::compile(package));
+
+    // Calls are only resolved at run time, so area_plus runs checked: its arithmetic is typed from the start
+    auto area_plus = runtime->get_interpreted_method(L"area_plus");
+    EXPECT_FALSE(area_plus->is_verified());
+    EXPECT_EQ(area_plus->get_opcode(3), IM::QOP_ADD_F64);
+    // a += 0.5 still fuses
+    EXPECT_EQ(area_plus->get_opcode(6), IM::SOP_ADD_TO_SLOT);
+    EXPECT_EQ((evaluate<double, double>(L"area_plus", { 3.0 })), 6.5);
+    // Guards held, nothing was rewritten
+    EXPECT_EQ(area_plus->get_opcode(3), IM::QOP_ADD_F64);
+    EXPECT_EQ(area_plus->get_opcode(8), IM::QOP_ADD_F64);
+    // Verified, translated to registers like generic arithmetic
+    EXPECT_EQ(runtime->get_interpreted_method(L"half_area")->get_opcode(0), IM::ROP_MULTIPLY_F64);
+
+    // Signed, an unsigned comparison would be false
+    auto less = runtime->get_interpreted_method(L"less");
+    EXPECT_TRUE(less->is_verified());
+    EXPECT_EQ(less->get_opcode(2), IM::QOP_LESSER_I32);
+    EXPECT_EQ((evaluate<int32_t, uint32_t>(L"less", { -3, 4 })), 1);
+    EXPECT_EQ((evaluate<int32_t, uint32_t>(L"less", { 4, -3 })), 0);
+}
+
+TEST_F(CompilerTestFixture, TestTypeErrors){
+    const Parameter i64 = { SIGNED_64_BIT_INTEGER, L"a" };
+    const Parameter i32 = { SIGNED_32_BIT_INTEGER, L"b" };
+    auto compile = [](const NexusStandardType& p_return_type, const Vector<Parameter>& p_arguments,
+                      const Vector<Ref<AST>>& p_body) {
+        auto package = Ref<NexusParser::NexusASTPackage>::make_ref();
+        declare(package, L"callee", NONE, { { SIGNED_32_BIT_INTEGER, L"value" } }, {});
+        declare(package, L"method", p_return_type, p_arguments, p_body);
+        NexusCompiler::compile(package);
+    };
+    EXPECT_NO_THROW(compile(SIGNED_64_BIT_INTEGER, { i64 }, { ret(binary(AST::OP_ADD, identifier(L"a"), node<IntegerValueNode>(1))) }));
+    EXPECT_THROW(compile(SIGNED_64_BIT_INTEGER, { i64, i32 }, { ret(binary(AST::OP_ADD, identifier(L"a"), identifier(L"b"))) }), CompilerException);
+    EXPECT_THROW(compile(SIGNED_32_BIT_INTEGER, { i64 }, { ret(identifier(L"a")) }), CompilerException);
+    EXPECT_THROW(compile(NONE, { i64 }, { binary(AST::OP_ASSIGN, identifier(L"a"), node<RealValueNode>(1.5)) }), CompilerException);
+    EXPECT_THROW(compile(NONE, { i64 }, { variable(L"c", SIGNED_32_BIT_INTEGER, identifier(L"a")) }), CompilerException);
+    EXPECT_THROW(compile(NONE, { i64 }, { call(L"callee", { identifier(L"a") }) }), CompilerException);
+    EXPECT_THROW(compile(NONE, {}, { call(L"missing", {}) }), CompilerException);
+    EXPECT_THROW(compile(NONE, {}, { ret(identifier(L"a")) }), CompilerException);
+    EXPECT_THROW(compile(SIGNED_64_BIT_INTEGER, { i64 }, {}), CompilerException);
+    EXPECT_THROW(compile(NONE, { i64, { SIGNED_64_BIT_INTEGER, L"a" } }, {}), CompilerException);
+}
+
+TEST_F(CompilerTestFixture, TestMistypedOpcode){
+    // Hand written, OP_ADD_I32 over 64 bit operands: not verifiable, the guard falls back at run time
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"add", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_ADD_I32),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"add");
+    EXPECT_FALSE(method->is_verified());
+    EXPECT_EQ((evaluate<int64_t, int64_t>(L"add", { int64_t(1) << 40, 2 })), (int64_t(1) << 40) + 2);
+    EXPECT_EQ(method->get_opcode(2), IM::QOP_ADD_POLYMORPHIC);
+}
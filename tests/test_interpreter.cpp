@@ -0,0 +1,645 @@
+//
+// Created by cycastic on 8/17/2023.
+//
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include "../runtime/profiler.h"
+#include "../runtime/parallel.h"
+#include "../runtime/typed_array.h"
+#include "runtime_test_fixture.h"
+
+static int64_t native_multiply_add(int64_t p_a, int64_t p_b, int64_t p_c) { return p_a * p_b + p_c; }
+static float native_half(float p_value) { return p_value / 2.0f; }
+static uint32_t native_calls{};
+static void native_count(uint32_t p_count) { native_calls += p_count; }
+static std::atomic<int64_t> native_visited{};
+static void native_visit(int64_t p_index) { native_visited.fetch_add(p_index + 1); }
+
+class InterpreterTestFixture : public RuntimeTestFixture {
+public:
+    static void add_factorial_methods(const Ref<NexusBytecode>& p_bytecode){
+        // fact(u64 n)
+        add_method(p_bytecode, L"fact", { UNSIGNED_64_BIT_INTEGER }, {}, 3, {
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(1)),
+            make_instruction(BC::OP_LESSER_OR_EQUAL),
+            make_instruction(BC::OP_GOTO_IF_FALSE, InternedString(L"recurse")),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(1)),
+            make_instruction(BC::OP_RETURN),
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"recurse")),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(1)),
+            make_instruction(BC::OP_SUBTRACT),
+            make_instruction(BC::OP_CALL, InternedString(L"fact")),
+            make_instruction(BC::OP_MULTIPLY),
+            make_instruction(BC::OP_RETURN),
+        });
+        add_method(p_bytecode, L"main", {}, {}, 1, {
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_U64, uint64_t(20)),
+            make_instruction(BC::OP_CALL, InternedString(L"fact")),
+            make_instruction(BC::OP_RETURN),
+        });
+    }
+};
+
+TEST_F(InterpreterTestFixture, TestLoop){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    auto task = run(L"sum", { 1000 });
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<int64_t>(task), 999 * 1000 / 2);
+    // 13 instructions per iteration, labels are not executed
+    EXPECT_EQ(task->get_statistics().instructions_executed, 1000 * 13 + 4 + 2);
+    EXPECT_EQ(task->get_state()->thread_stack->get_last_frame()->object_count(), 1);
+}
+
+TEST_F(InterpreterTestFixture, TestRecursion){
+    for (auto load_mode : { NexusBytecodeInstance::LOAD_ALL, NexusBytecodeInstance::LOAD_HEADER }){
+        delete runtime;
+        runtime = new NexusRuntime();
+        auto bytecode = Ref<NexusBytecode>::make_ref();
+        add_factorial_methods(bytecode);
+        load(bytecode, load_mode);
+        auto task = run(L"main", {});
+        ASSERT_FALSE(task->is_faulted());
+        EXPECT_EQ(result_of<uint64_t>(task), 2432902008176640000ull);
+    }
+}
+
+TEST_F(InterpreterTestFixture, TestDivisionByZero){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"main", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I32, int32_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I32, int32_t(0)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto task = run(L"main", {});
+    ASSERT_TRUE(task->is_faulted());
+    EXPECT_THROW(std::rethrow_exception(task->get_state()->exception), InterpreterException);
+}
+
+TEST_F(InterpreterTestFixture, TestStackOverflow){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"forever", { SIGNED_64_BIT_INTEGER }, { SIGNED_64_BIT_INTEGER }, 1, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_CALL, InternedString(L"forever")),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto task = run(L"forever", { 0 });
+    ASSERT_TRUE(task->is_faulted());
+    try {
+        std::rethrow_exception(task->get_state()->exception);
+    } catch (const InterpreterException& e){
+        EXPECT_NE(std::string(e.what()).find("Stack overflow"), std::string::npos);
+    }
+}
+
+TEST_F(InterpreterTestFixture, TestCancellation){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"spin", {}, {}, 0, {
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"loop")),
+        make_instruction(BC::OP_GOTO, InternedString(L"loop")),
+    });
+    load(bytecode);
+    auto group = TaskScheduler::create_group(10000);
+    auto task = run(L"spin", {}, group);
+    EXPECT_TRUE(task->is_cancelled());
+    EXPECT_FALSE(task->is_faulted());
+}
+
+TEST_F(InterpreterTestFixture, TestUndeclaredLabel){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"main", {}, {}, 0, {
+        make_instruction(BC::OP_GOTO, InternedString(L"nowhere")),
+    });
+    // Rejected at load time when the bodies are loaded eagerly, on the first call otherwise
+    EXPECT_THROW(load(bytecode), BytecodeException);
+    load(bytecode, NexusBytecodeInstance::LOAD_HEADER);
+    auto task = run(L"main", {});
+    EXPECT_TRUE(task->is_faulted());
+}
+
+TEST_F(InterpreterTestFixture, TestDecodedMethod){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"sum");
+    // Without the two labels
+    EXPECT_EQ(method->get_instructions_count(), 15);
+    EXPECT_EQ(method->get_argument_count(), 1);
+    EXPECT_EQ(method->get_local_count(), 2);
+    // Decoded once and shared
+    EXPECT_EQ(runtime->get_interpreted_method(L"sum").ptr(), method.ptr());
+    // Loop condition, sum += i and i += 1 are one block of register instructions
+    EXPECT_EQ(method->get_opcode(0), NexusInterpretedMethod::ROP_LESSER_BRANCH_I64);
+    EXPECT_EQ(method->get_opcode(1), NexusInterpretedMethod::ROP_ADD_I64);
+    EXPECT_EQ(method->get_opcode(2), NexusInterpretedMethod::ROP_ADD_I64);
+    EXPECT_EQ(method->get_opcode(12), BC::OP_GOTO);
+}
+
+TEST_F(InterpreterTestFixture, TestRegisterForm){
+    int64_t expected = 0;
+    for (int64_t i = 0; i < 100; i++) expected += (3 * i * i - 5 * i + 7) / 2;
+    auto add_methods = [](const Ref<NexusBytecode>& p_bytecode) {
+        add_polynomial_method(p_bytecode, L"poly");
+        add_factorial_methods(p_bytecode);
+        // (a * b + c) / b, or -1 if b is 0
+        add_method(p_bytecode, L"mad_div", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"try")),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+            make_instruction(BC::OP_MULTIPLY),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(2)),
+            make_instruction(BC::OP_ADD),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+            make_instruction(BC::OP_DIVIDE),
+            make_instruction(BC::OP_RETURN),
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-1)),
+            make_instruction(BC::OP_RETURN),
+        }, { { L"try", L"end", L"end" } });
+        // Swaps a and b, then returns a * 10 + b. The stores must not clobber the pending loads
+        add_method(p_bytecode, L"swap", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+            make_instruction(BC::OP_STORE_ARG, uint32_t(0)),
+            make_instruction(BC::OP_STORE_ARG, uint32_t(1)),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(10)),
+            make_instruction(BC::OP_MULTIPLY),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+            make_instruction(BC::OP_ADD),
+            make_instruction(BC::OP_RETURN),
+        });
+        // The protected range starts at the division, the loads before it must not be fused with it
+        add_method(p_bytecode, L"divide_to", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, { SIGNED_64_BIT_INTEGER }, 2, {
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+            make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"try")),
+            make_instruction(BC::OP_DIVIDE),
+            make_instruction(BC::OP_STORE_STACK, uint32_t(2)),
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+            make_instruction(BC::OP_LOAD_STACK, uint32_t(2)),
+            make_instruction(BC::OP_RETURN),
+            make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"handler")),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-1)),
+            make_instruction(BC::OP_RETURN),
+        }, { { L"try", L"end", L"handler" } });
+        add_method(p_bytecode, L"constants", {}, {}, 2, {
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 1.5),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 2.0),
+            make_instruction(BC::OP_MULTIPLY),
+            make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 0.5),
+            make_instruction(BC::OP_ADD),
+            make_instruction(BC::OP_RETURN),
+        });
+    };
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_methods(bytecode);
+    load(bytecode);
+    auto poly = runtime->get_interpreted_method(L"poly");
+    ASSERT_TRUE(poly->is_verified());
+    // 25 stack instructions per iteration become 10 register instructions: the loop condition,
+    // 7 for the polynomial, i += 1 and the OP_GOTO
+    EXPECT_EQ(poly->get_opcode(0), NexusInterpretedMethod::ROP_LESSER_BRANCH_I64);
+    EXPECT_EQ(poly->get_opcode(1), NexusInterpretedMethod::ROP_MULTIPLY_I64);
+    EXPECT_EQ(poly->get_opcode(7), NexusInterpretedMethod::ROP_ADD_I64);
+    EXPECT_EQ(poly->get_opcode(8), NexusInterpretedMethod::ROP_ADD_I64);
+    EXPECT_EQ(poly->get_opcode(24), BC::OP_GOTO);
+    // Unverified methods keep their superinstructions
+    EXPECT_EQ(runtime->get_interpreted_method(L"fact")->get_opcode(0), NexusInterpretedMethod::SOP_LESSER_OR_EQUAL_BRANCH);
+    EXPECT_EQ(runtime->get_interpreted_method(L"mad_div")->get_opcode(0), NexusInterpretedMethod::ROP_MULTIPLY_I64);
+    EXPECT_EQ(runtime->get_interpreted_method(L"constants")->get_opcode(0), NexusInterpretedMethod::ROP_MULTIPLY_F64);
+
+    // Same results and instruction counts as the stack form
+    for (auto register_form : { true, false }){
+        if (!register_form){
+            settings->interpreter_register_form = false;
+            delete runtime;
+            runtime = new NexusRuntime();
+            bytecode = Ref<NexusBytecode>::make_ref();
+            add_methods(bytecode);
+            load(bytecode);
+            EXPECT_EQ(runtime->get_interpreted_method(L"poly")->get_opcode(0), NexusInterpretedMethod::SOP_LESSER_BRANCH);
+        }
+        auto task = run(L"poly", { 100 });
+        ASSERT_FALSE(task->is_faulted());
+        EXPECT_EQ(result_of<int64_t>(task), expected);
+        EXPECT_EQ(task->get_statistics().instructions_executed, 100 * 25 + 4 + 2);
+        EXPECT_EQ(task->get_state()->thread_stack->get_last_frame()->object_count(), 1);
+        EXPECT_EQ(result_of<int64_t>(run(L"mad_div", { 3, 4, 5 })), 4);
+        // Thrown halfway through the block, caught by the handler around it
+        EXPECT_EQ(result_of<int64_t>(run(L"mad_div", { 1, 0, 5 })), -1);
+        EXPECT_EQ(result_of<int64_t>(run(L"swap", { 1, 2 })), 21);
+        EXPECT_EQ(result_of<double>(run(L"constants", {})), 3.5);
+        EXPECT_EQ(runtime->get_interpreted_method(L"divide_to")->get_opcode(0), BC::OP_LOAD_ARG);
+        EXPECT_EQ(result_of<int64_t>(run(L"divide_to", { 7, 2 })), 3);
+        auto divide_to = run(L"divide_to", { 1, 0 });
+        ASSERT_FALSE(divide_to->is_faulted());
+        EXPECT_EQ(result_of<int64_t>(divide_to), -1);
+    }
+}
+
+TEST_F(InterpreterTestFixture, TestQuickening){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    // mixed(i64 flag): 2 + 3 if flag is set, 2.5 + 0.5 otherwise, both through the same OP_ADD
+    add_method(bytecode, L"mixed", { SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_GOTO_IF_FALSE, InternedString(L"floats")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(2)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(3)),
+        make_instruction(BC::OP_GOTO, InternedString(L"add")),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"floats")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 2.5),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 0.5),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"add")),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"mixed");
+    static constexpr uint32_t add_index = 7;
+    EXPECT_EQ(method->get_opcode(add_index), BC::OP_ADD);
+
+    EXPECT_EQ(result_of<int64_t>(run(L"mixed", { 1 })), 5);
+    EXPECT_EQ(method->get_opcode(add_index), NexusInterpretedMethod::QOP_ADD_I64);
+    // Guard fails, the instruction falls back to the generic form for good
+    EXPECT_EQ(result_of<double>(run(L"mixed", { 0 })), 3.0);
+    EXPECT_EQ(method->get_opcode(add_index), NexusInterpretedMethod::QOP_ADD_POLYMORPHIC);
+    EXPECT_EQ(result_of<int64_t>(run(L"mixed", { 1 })), 5);
+    EXPECT_EQ(method->get_opcode(add_index), NexusInterpretedMethod::QOP_ADD_POLYMORPHIC);
+}
+
+TEST_F(InterpreterTestFixture, TestCallSiteCache){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_factorial_methods(bytecode);
+    load(bytecode);
+    auto main = runtime->get_interpreted_method(L"main");
+    auto fact = runtime->get_interpreted_method(L"fact");
+    ASSERT_EQ(main->get_call_sites_count(), 1);
+    EXPECT_EQ(main->get_call_site(0).name, InternedString(L"fact"));
+    EXPECT_EQ(main->get_call_site(0).target.load(), nullptr);
+    EXPECT_EQ(result_of<uint64_t>(run(L"main", {})), 2432902008176640000ull);
+    // Resolved by the first call
+    EXPECT_EQ(main->get_call_site(0).target.load(), fact.ptr());
+    EXPECT_EQ(fact->get_call_site(0).target.load(), fact.ptr());
+    EXPECT_EQ(result_of<uint64_t>(run(L"main", {})), 2432902008176640000ull);
+}
+
+TEST_F(InterpreterTestFixture, TestVerifier){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    add_factorial_methods(bytecode);
+    add_method(bytecode, L"underflow", {}, {}, 1, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"leftover", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(2)),
+        make_instruction(BC::OP_RETURN),
+    });
+    // i64 on one path, f64 on the other
+    add_method(bytecode, L"mixed_returns", { SIGNED_64_BIT_INTEGER }, {}, 1, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_GOTO_IF_TRUE, InternedString(L"real")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_RETURN),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"real")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 2.0),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto sum = runtime->get_interpreted_method(L"sum");
+    ASSERT_TRUE(sum->is_verified());
+    EXPECT_EQ(sum->get_stack_state(0).depth, 0);
+    EXPECT_EQ(sum->get_stack_state(2).depth, 2);
+    EXPECT_EQ(sum->get_stack_state(2).opcode, BC::OP_LESSER);
+    EXPECT_EQ(sum->get_stack_state(3).top->type, UNSIGNED_32_BIT_INTEGER);
+    EXPECT_EQ(sum->get_stack_state(14).top->type, SIGNED_64_BIT_INTEGER);
+    // The implicit OP_RETURN follows an explicit one
+    EXPECT_EQ(sum->get_stack_state(15).depth, NexusInterpretedMethod::StackState::UNREACHABLE);
+    // Calls are only resolved at run time
+    EXPECT_FALSE(runtime->get_interpreted_method(L"fact")->is_verified());
+    // Rejected before it runs, then caught by the checked interpreter
+    EXPECT_FALSE(runtime->get_interpreted_method(L"underflow")->is_verified());
+    EXPECT_TRUE(run(L"underflow", {})->is_faulted());
+    // Returns are checked against each other, the checked interpreter still runs both
+    EXPECT_FALSE(runtime->get_interpreted_method(L"leftover")->is_verified());
+    EXPECT_EQ(result_of<int64_t>(run(L"leftover", {})), 2);
+    EXPECT_FALSE(runtime->get_interpreted_method(L"mixed_returns")->is_verified());
+    EXPECT_EQ(result_of<double>(run(L"mixed_returns", { 1 })), 2.0);
+}
+
+TEST_F(InterpreterTestFixture, TestVerifiedQuickening){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"add", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    // Unverified, switches to the unchecked interpreter for add and back
+    add_method(bytecode, L"caller", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(40)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(2)),
+        make_instruction(BC::OP_CALL, InternedString(L"add")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_SUBTRACT),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto add = runtime->get_interpreted_method(L"add");
+    ASSERT_TRUE(add->is_verified());
+    // Operand types are known, no need to wait for the first execution
+    EXPECT_EQ(add->get_opcode(2), NexusInterpretedMethod::QOP_ADD_I64);
+    EXPECT_FALSE(runtime->get_interpreted_method(L"caller")->is_verified());
+    EXPECT_EQ(result_of<int64_t>(run(L"caller", {})), 41);
+    EXPECT_EQ(result_of<int64_t>(run(L"add", { 2, 3 })), 5);
+}
+
+TEST_F(InterpreterTestFixture, TestProfiler){
+    // Keep sum interpreted
+    settings->jit_hotness_threshold = 0;
+    settings->jit_loop_threshold = 0;
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    NexusProfiler profiler(100);
+    EXPECT_THROW(NexusProfiler(), ProfilerException);
+    for (int i = 0; i < 100 && profiler.get_sample_count() == 0; i++) run(L"sum", { 100000 });
+    profiler.stop();
+    ASSERT_GT(profiler.get_sample_count(), 0);
+    EXPECT_EQ(profiler.get_sample_count("sum:"), profiler.get_sample_count());
+    // Taken at the loop's backward branch, or at the return
+    EXPECT_EQ(profiler.get_sample_count("sum:12") + profiler.get_sample_count("sum:14"), profiler.get_sample_count());
+    std::stringstream stream{};
+    profiler.write_collapsed(stream);
+    EXPECT_EQ(stream.str().rfind("sum:", 0), 0);
+    // Nothing is recorded once stopped
+    auto samples = profiler.get_sample_count();
+    run(L"sum", { 100000 });
+    EXPECT_EQ(profiler.get_sample_count(), samples);
+}
+
+TEST_F(InterpreterTestFixture, TestNativeMethods){
+    runtime->register_native_method<native_multiply_add>(L"multiply_add");
+    runtime->register_native_method<native_half>(L"half");
+    runtime->register_native_method<native_count>(L"count");
+    EXPECT_THROW(runtime->register_native_method<native_half>(L"half"), RuntimeException);
+    native_calls = 0;
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_external_method(bytecode, L"multiply_add");
+    add_external_method(bytecode, L"half");
+    add_external_method(bytecode, L"count");
+    add_method(bytecode, L"mad", {}, {}, 3, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(6)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(7)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-2)),
+        make_instruction(BC::OP_CALL, InternedString(L"multiply_add")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_U32, uint32_t(3)),
+        make_instruction(BC::OP_CALL, InternedString(L"count")),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"half_of", { SINGLE_PRECISION_FLOATING_POINT }, {}, 1, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_CALL, InternedString(L"half")),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"mismatch", {}, {}, 3, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(2)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I32, int32_t(3)),
+        make_instruction(BC::OP_CALL, InternedString(L"multiply_add")),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto mad = runtime->get_interpreted_method(L"mad");
+    // Resolved at load time, calls with known types verify
+    EXPECT_EQ(mad->get_opcode(3), NexusInterpretedMethod::QOP_CALL_NATIVE);
+    ASSERT_TRUE(mad->is_verified());
+    EXPECT_EQ(mad->get_stack_state(4).top->type, SIGNED_64_BIT_INTEGER);
+    EXPECT_EQ(result_of<int64_t>(run(L"mad", {})), 40);
+    EXPECT_EQ(native_calls, 3);
+
+    auto task = Ref<Task>::make_ref(NexusInterpreter::execute, resume_callback, runtime->get_method(L"half_of"));
+    task->get_state()->thread_stack->push_stack_frame()->push(3.0f);
+    TaskScheduler::queue_task(task);
+    task->wait();
+    EXPECT_EQ(result_of<float>(task), 1.5f);
+
+    EXPECT_FALSE(runtime->get_interpreted_method(L"mismatch")->is_verified());
+    EXPECT_TRUE(run(L"mismatch", {})->is_faulted());
+
+    // Every external method needs a native
+    auto unresolved = Ref<NexusBytecode>::make_ref();
+    add_external_method(unresolved, L"missing");
+    EXPECT_THROW(load(unresolved), RuntimeException);
+    auto shadowing = Ref<NexusBytecode>::make_ref();
+    add_method(shadowing, L"half", {}, {}, 0, {});
+    EXPECT_THROW(load(shadowing), RuntimeException);
+}
+
+#ifdef __linux__
+TEST_F(InterpreterTestFixture, TestLibraryMethods){
+    runtime->load_native_library(L"libm", L"libm.so.6");
+    EXPECT_THROW(runtime->load_native_library(L"libm", L"libm.so.6"), RuntimeException);
+    runtime->bind_library_method<double(double, double)>(L"pow", L"libm", "pow");
+    runtime->bind_library_method<int32_t(double)>(L"ilogb", L"libm", "ilogb");
+    EXPECT_THROW(runtime->bind_library_method<double(double)>(L"sin", L"libc", "sin"), RuntimeException);
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_external_method(bytecode, L"pow");
+    add_external_method(bytecode, L"ilogb");
+    add_method(bytecode, L"exponent", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, double(2.0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, double(10.0)),
+        make_instruction(BC::OP_CALL, InternedString(L"pow")),
+        make_instruction(BC::OP_CALL, InternedString(L"ilogb")),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto exponent = runtime->get_interpreted_method(L"exponent");
+    EXPECT_EQ(exponent->get_opcode(2), NexusInterpretedMethod::QOP_CALL_NATIVE);
+    EXPECT_TRUE(exponent->is_verified());
+    // ilogb(pow(2, 10))
+    EXPECT_EQ(result_of<int32_t>(run(L"exponent", {})), 10);
+}
+#endif
+
+TEST_F(InterpreterTestFixture, TestExceptionHandlers){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"divide", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"safe_divide", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"try")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-1)),
+        make_instruction(BC::OP_RETURN),
+    }, { { L"try", L"end", L"end" } });
+    // The fault happens two frames up, with a value left on the caller's evaluation stack
+    add_method(bytecode, L"offset_divide", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 3, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(100)),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"try")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_CALL, InternedString(L"divide")),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"end")),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"handler")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(-2)),
+        make_instruction(BC::OP_RETURN),
+    }, { { L"try", L"end", L"handler" } });
+    add_method(bytecode, L"nested", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_CALL, InternedString(L"offset_divide")),
+        make_instruction(BC::OP_RETURN),
+    });
+    // Headers are read lazily, through NexusMethodPointerJIT
+    load(bytecode, NexusBytecodeInstance::LOAD_HEADER);
+    auto safe_divide = runtime->get_interpreted_method(L"safe_divide");
+    ASSERT_EQ(safe_divide->get_exception_table().size(), 1);
+    EXPECT_EQ(safe_divide->find_exception_handler(2), 4);
+    EXPECT_EQ(safe_divide->find_exception_handler(4), NexusInterpretedMethod::NO_HANDLER);
+    EXPECT_TRUE(safe_divide->is_verified());
+
+    EXPECT_EQ(result_of<int64_t>(run(L"safe_divide", { 10, 2 })), 5);
+    EXPECT_EQ(result_of<int64_t>(run(L"safe_divide", { 1, 0 })), -1);
+    EXPECT_EQ(result_of<int64_t>(run(L"offset_divide", { 10, 2 })), 105);
+    auto task = run(L"nested", { 1, 0 });
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<int64_t>(task), -2);
+    // Only the result is left, every frame above the handler was dropped
+    EXPECT_EQ(task->get_state()->thread_stack->frame_count(), 1);
+    EXPECT_EQ(task->get_state()->thread_stack->get_last_frame()->object_count(), 1);
+    EXPECT_TRUE(run(L"divide", { 1, 0 })->is_faulted());
+
+    auto undeclared = Ref<NexusBytecode>::make_ref();
+    add_method(undeclared, L"undeclared", {}, {}, 0, {
+        make_instruction(BC::OP_RETURN),
+    }, { { L"try", L"end", L"handler" } });
+    EXPECT_THROW(load(undeclared), BytecodeException);
+}
+
+TEST_F(InterpreterTestFixture, TestParallelBuiltins){
+    runtime->register_native_method<native_visit>(L"visit_native");
+    runtime->add_native_method(L"sum_squares", NexusParallel::bind_reduce(L"square", L"add"));
+    native_visited = 0;
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_external_method(bytecode, L"visit_native");
+    add_external_method(bytecode, L"sum_squares");
+    add_method(bytecode, L"visit", { SIGNED_64_BIT_INTEGER }, {}, 1, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_CALL, InternedString(L"visit_native")),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"square", { SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_MULTIPLY),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"add", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"inverse", { SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"fail", { SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(0)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"main", {}, {}, 3, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(1000)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(0)),
+        make_instruction(BC::OP_CALL, InternedString(L"sum_squares")),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+
+    // Every index is visited exactly once
+    NexusParallel::parallel_for(L"visit", 0, 10000);
+    EXPECT_EQ(native_visited.load(), 10000ll * 10001 / 2);
+    NexusParallel::parallel_for(L"visit", 5, 5);
+    EXPECT_EQ(native_visited.load(), 10000ll * 10001 / 2);
+    EXPECT_EQ(NexusParallel::parallel_reduce(L"square", L"add", 0, 1000, 0), 332833500);
+    EXPECT_EQ(NexusParallel::parallel_reduce(L"square", L"add", 3, 3, 7), 7);
+    // Called from bytecode running on the pool, which helps with its own loop
+    EXPECT_EQ(result_of<int64_t>(run(L"main", {})), 332833500);
+    // The body divides by zero at index 0, the exception reaches the caller
+    EXPECT_THROW(NexusParallel::parallel_reduce(L"inverse", L"add", -500, 500, 0), InterpreterException);
+    // The whole signed range is more indexes than an int64_t counts, every chunk fails at its first
+    EXPECT_THROW(NexusParallel::parallel_for(L"fail", INT64_MIN, INT64_MAX), InterpreterException);
+    // Bodies must leave a signed 64 bit integer to reduce
+    EXPECT_THROW(NexusParallel::parallel_reduce(L"visit", L"add", 0, 10, 0), ParallelException);
+}
+
+TEST_F(InterpreterTestFixture, TestArrayBuiltins){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_external_method(bytecode, L"__builtin_array_multiply");
+    add_external_method(bytecode, L"__builtin_array_sum_f64");
+    add_external_method(bytecode, L"__builtin_array_get_f64");
+    // dot(a, b, scratch): sum of a[i] * b[i], scratch[0] must then read back as its first product
+    add_method(bytecode, L"dot", { REFERENCE_COUNTED_OBJECT, REFERENCE_COUNTED_OBJECT, REFERENCE_COUNTED_OBJECT }, {}, 3, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(2)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_CALL, InternedString(L"__builtin_array_multiply")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(2)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(0)),
+        make_instruction(BC::OP_CALL, InternedString(L"__builtin_array_get_f64")),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(2)),
+        make_instruction(BC::OP_CALL, InternedString(L"__builtin_array_sum_f64")),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto dot = [this](const Ref<NexusTypedArray>& p_lhs, const Ref<NexusTypedArray>& p_rhs, const Ref<NexusTypedArray>& p_scratch){
+        auto task = Ref<Task>::make_ref(NexusInterpreter::execute, resume_callback, runtime->get_method(L"dot"));
+        auto& frame = task->get_state()->thread_stack->push_stack_frame();
+        for (const auto& array : { p_lhs, p_rhs, p_scratch }) frame->push(array.safe_cast<ManagedObject>());
+        TaskScheduler::queue_task(task);
+        task->wait();
+        return task;
+    };
+    auto lhs = Ref<NexusTypedArray>::make_ref(DOUBLE_PRECISION_FLOATING_POINT, 100);
+    auto rhs = Ref<NexusTypedArray>::make_ref(DOUBLE_PRECISION_FLOATING_POINT, 100);
+    auto scratch = Ref<NexusTypedArray>::make_ref(DOUBLE_PRECISION_FLOATING_POINT, 100);
+    for (size_t i = 0; i < 100; i++) {
+        lhs->set(i, double(i));
+        rhs->set(i, 2.0);
+    }
+    auto task = dot(lhs, rhs, scratch);
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<double>(task), 99.0 * 100.0);
+    // Mismatched operands fault the task
+    auto shorter = Ref<NexusTypedArray>::make_ref(DOUBLE_PRECISION_FLOATING_POINT, 10);
+    task = dot(lhs, rhs, shorter);
+    ASSERT_TRUE(task->is_faulted());
+    EXPECT_THROW(std::rethrow_exception(task->get_state()->exception), TypedArrayException);
+}
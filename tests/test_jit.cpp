@@ -0,0 +1,205 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#include <gtest/gtest.h>
+#include "../runtime/jit.h"
+#include "runtime_test_fixture.h"
+
+class JITTestFixture : public RuntimeTestFixture {
+public:
+    void SetUp() override {
+        if (!NexusJIT::is_supported()) GTEST_SKIP() << "NexusJIT does not support this platform";
+        RuntimeTestFixture::SetUp();
+        // Compile on the first call, before it runs
+        settings->jit_hotness_threshold = 1;
+        settings->jit_loop_threshold = 0;
+        settings->jit_background_compilation = false;
+    }
+    void TearDown() override {
+        if (NexusJIT::is_supported()) RuntimeTestFixture::TearDown();
+    }
+};
+
+TEST_F(JITTestFixture, TestCompile){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"sum");
+    auto code = NexusJIT::compile(method.ptr());
+    ASSERT_NE(code, nullptr);
+    EXPECT_EQ(code->get_return_type(), NexusStandardType::SIGNED_64_BIT_INTEGER);
+
+    uint64_t slots[NexusJIT::MAX_SLOTS]{ 1000 };
+    uint64_t result = 0;
+    NexusJITFrame frame{ .instructions_executed = 0, .state = nullptr, .safepoint_countdown = 1 };
+    EXPECT_EQ(code->get_entry()(slots, &result, &frame), NexusCompiledMethod::STATUS_RETURNED);
+    EXPECT_EQ(int64_t(result), 999 * 1000 / 2);
+    // Same count as the interpreter
+    EXPECT_EQ(frame.instructions_executed, 1000 * 13 + 4 + 2);
+    delete code;
+}
+
+TEST_F(JITTestFixture, TestLargeConstants){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"offset", { SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(100)),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    // Constants are not frame indexes, one past the slot count still compiles
+    auto code = NexusJIT::compile(runtime->get_interpreted_method(L"offset").ptr());
+    ASSERT_NE(code, nullptr);
+    uint64_t slots[NexusJIT::MAX_SLOTS]{ 23 };
+    uint64_t result = 0;
+    NexusJITFrame frame{ .instructions_executed = 0, .state = nullptr, .safepoint_countdown = 1 };
+    EXPECT_EQ(code->get_entry()(slots, &result, &frame), NexusCompiledMethod::STATUS_RETURNED);
+    EXPECT_EQ(int64_t(result), 123);
+    delete code;
+}
+
+TEST_F(JITTestFixture, TestRejected){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_fib_method(bytecode, L"fib");
+    add_method(bytecode, L"half", { DOUBLE_PRECISION_FLOATING_POINT }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_FP64, 2.0),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    // Calls and floating point stay in the interpreter
+    EXPECT_EQ(NexusJIT::compile(runtime->get_interpreted_method(L"fib").ptr()), nullptr);
+    EXPECT_EQ(NexusJIT::compile(runtime->get_interpreted_method(L"half").ptr()), nullptr);
+}
+
+TEST_F(JITTestFixture, TestHotMethods){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    add_method(bytecode, L"main", {}, {}, 2, {
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(100)),
+        make_instruction(BC::OP_CALL, InternedString(L"sum")),
+        make_instruction(BC::OPCODE_LOAD_CONSTANT_I64, int64_t(10)),
+        make_instruction(BC::OP_CALL, InternedString(L"sum")),
+        make_instruction(BC::OP_ADD),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto task = run(L"main", {});
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<int64_t>(task), 99 * 100 / 2 + 9 * 10 / 2);
+    // main has calls, sum is run natively
+    EXPECT_EQ(runtime->get_interpreted_method(L"main")->get_compiled_method(), nullptr);
+    EXPECT_NE(runtime->get_interpreted_method(L"sum")->get_compiled_method(), nullptr);
+    EXPECT_EQ(task->get_statistics().instructions_executed, 6 + (100 * 13 + 6) + (10 * 13 + 6));
+
+    task = run(L"sum", { 1000 });
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<int64_t>(task), 999 * 1000 / 2);
+    EXPECT_EQ(task->get_state()->thread_stack->get_last_frame()->object_count(), 1);
+}
+
+TEST_F(JITTestFixture, TestDivision){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"divide", { SIGNED_64_BIT_INTEGER, SIGNED_64_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    EXPECT_EQ(result_of<int64_t>(run(L"divide", { -7, 2 })), -3);
+    EXPECT_NE(runtime->get_interpreted_method(L"divide")->get_compiled_method(), nullptr);
+    EXPECT_EQ(result_of<int64_t>(run(L"divide", { INT64_MIN, -1 })), INT64_MIN);
+    auto task = run(L"divide", { 1, 0 });
+    ASSERT_TRUE(task->is_faulted());
+    EXPECT_THROW(std::rethrow_exception(task->get_state()->exception), InterpreterException);
+}
+
+TEST_F(JITTestFixture, TestCancellation){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"spin", {}, {}, 0, {
+        make_instruction(BC::OP_LABEL_DECLARE, InternedString(L"loop")),
+        make_instruction(BC::OP_GOTO, InternedString(L"loop")),
+    });
+    load(bytecode);
+    auto group = TaskScheduler::create_group(10000);
+    auto task = run(L"spin", {}, group);
+    EXPECT_NE(runtime->get_interpreted_method(L"spin")->get_compiled_method(), nullptr);
+    EXPECT_TRUE(task->is_cancelled());
+    EXPECT_FALSE(task->is_faulted());
+}
+
+TEST_F(JITTestFixture, TestOnStackReplacement){
+    settings->jit_hotness_threshold = 0;
+    settings->jit_loop_threshold = 100;
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"sum");
+    auto task = run(L"sum", { 10 });
+    EXPECT_EQ(result_of<int64_t>(task), 9 * 10 / 2);
+    EXPECT_EQ(method->get_compiled_method(), nullptr);
+    // The loop gets hot halfway through the call, which finishes in compiled code
+    task = run(L"sum", { 1000 });
+    ASSERT_FALSE(task->is_faulted());
+    EXPECT_EQ(result_of<int64_t>(task), 999 * 1000 / 2);
+    ASSERT_NE(method->get_compiled_method(), nullptr);
+    EXPECT_NE(method->get_compiled_method()->get_osr_entry(0), nullptr);
+    EXPECT_EQ(task->get_statistics().instructions_executed, 1000 * 13 + 4 + 2);
+    EXPECT_EQ(task->get_state()->thread_stack->get_last_frame()->object_count(), 1);
+}
+
+TEST_F(JITTestFixture, TestBackgroundCompilation){
+    settings->jit_background_compilation = true;
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    load(bytecode);
+    auto method = runtime->get_interpreted_method(L"sum");
+    // Calls keep being interpreted until the worker is done
+    for (int i = 0; i < 1000 && !method->get_compiled_method(); i++) {
+        EXPECT_EQ(result_of<int64_t>(run(L"sum", { 100 })), 99 * 100 / 2);
+        ManagedThread::sleep(1000);
+    }
+    ASSERT_NE(method->get_compiled_method(), nullptr);
+    EXPECT_EQ(result_of<int64_t>(run(L"sum", { 100 })), 99 * 100 / 2);
+}
+
+TEST_F(JITTestFixture, TestNarrowIntegers){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_method(bytecode, L"divide_i32", { SIGNED_32_BIT_INTEGER, SIGNED_32_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_DIVIDE),
+        make_instruction(BC::OP_RETURN),
+    });
+    add_method(bytecode, L"greater_u32", { UNSIGNED_32_BIT_INTEGER, UNSIGNED_32_BIT_INTEGER }, {}, 2, {
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(0)),
+        make_instruction(BC::OP_LOAD_ARG, uint32_t(1)),
+        make_instruction(BC::OP_GREATER),
+        make_instruction(BC::OP_RETURN),
+    });
+    load(bytecode);
+    auto divide = NexusJIT::compile(runtime->get_interpreted_method(L"divide_i32").ptr());
+    auto greater = NexusJIT::compile(runtime->get_interpreted_method(L"greater_u32").ptr());
+    ASSERT_NE(divide, nullptr);
+    ASSERT_NE(greater, nullptr);
+    auto call = [](const NexusCompiledMethod* p_code, uint32_t p_lhs, uint32_t p_rhs){
+        uint64_t slots[NexusJIT::MAX_SLOTS]{ p_lhs, p_rhs };
+        uint64_t result = ~0ull;
+        NexusJITFrame frame{ .instructions_executed = 0, .state = nullptr, .safepoint_countdown = 1 };
+        EXPECT_EQ(p_code->get_entry()(slots, &result, &frame), NexusCompiledMethod::STATUS_RETURNED);
+        EXPECT_EQ(frame.instructions_executed, 4);
+        return result;
+    };
+    // 32 bit results are zero extended
+    EXPECT_EQ(call(divide, uint32_t(-7), 2), uint32_t(-3));
+    EXPECT_EQ(call(divide, uint32_t(INT32_MIN), uint32_t(-1)), uint32_t(INT32_MIN));
+    // Unsigned comparison
+    EXPECT_EQ(call(greater, 4000000000u, 1), 1);
+    EXPECT_EQ(call(greater, 1, 4000000000u), 0);
+    delete divide;
+    delete greater;
+}
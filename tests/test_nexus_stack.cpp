@@ -45,6 +45,12 @@ public:
     void pop_frame(){
         stack->pop_stack_frame();
     }
+    const NexusStack::Frame* last_frame() const {
+        return stack->get_last_frame().ptr();
+    }
+    Box<NexusStack::Frame, ThreadUnsafeObject> copy_last_frame() const {
+        return stack->get_last_frame();
+    }
     void add_objects_1(){
         auto& frame = stack->get_last_frame();
         frame->push(12);
@@ -175,4 +181,30 @@ TEST_F(NexusStackTestFixture, TestNexusStack){
 
 //    add_frame();
 //    add_objects_1();
-}
\ No newline at end of file
+}
+
+TEST_F(NexusStackTestFixture, TestFrameRecycling){
+    add_frame();
+    add_objects_1();
+    add_frame();
+    const auto* popped = last_frame();
+    add_objects_2();
+    pop_frame();
+    // The popped frame is reused, empty and on top of its caller
+    add_frame();
+    EXPECT_EQ(last_frame(), popped);
+    EXPECT_EQ(last_frame()->object_count(), 0);
+    add_objects_2();
+    EXPECT_TRUE(check_objects_2(-1));
+    EXPECT_TRUE(check_objects_1(-2));
+
+    // A frame whose box was copied escaped, it is not reused
+    add_frame();
+    auto escaped = copy_last_frame();
+    pop_frame();
+    add_frame();
+    EXPECT_NE(last_frame(), escaped.ptr());
+    pop_frame();
+    pop_frame();
+    pop_frame();
+}
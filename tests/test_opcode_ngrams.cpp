@@ -0,0 +1,62 @@
+//
+// Created by cycastic on 8/18/2023.
+//
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include "../language/opcode_ngrams.h"
+#include "bytecode_builder.h"
+
+class OpcodeNGramsTestFixture : public ::testing::Test {
+public:
+    void SetUp() override {
+        InternedString::configure();
+    }
+    void TearDown() override {
+        InternedString::cleanup();
+    }
+};
+
+TEST_F(OpcodeNGramsTestFixture, TestCounting){
+    auto bytecode = Ref<NexusBytecode>::make_ref();
+    add_sum_method(bytecode, L"sum");
+    add_fib_method(bytecode, L"fib");
+    OpcodeNGramCounter counter(4);
+    counter.add_bytecode(bytecode);
+    // 15 executed instructions in sum, 16 in fib
+    EXPECT_EQ(counter.get_total(), (15 - 3) + (16 - 3));
+    EXPECT_EQ(counter.get_count({ BC::OP_LOAD_STACK, BC::OP_LOAD_STACK, BC::OP_ADD, BC::OP_STORE_STACK }), 1);
+    EXPECT_EQ(counter.get_count({ BC::OP_LOAD_ARG, BC::OPCODE_LOAD_CONSTANT_U64, BC::OP_SUBTRACT, BC::OP_CALL }), 2);
+    // Labels do not break runs
+    EXPECT_EQ(counter.get_count({ BC::OP_GOTO, BC::OP_LOAD_STACK, BC::OP_RETURN }), 0);
+    EXPECT_EQ(counter.get_count({ BC::OP_STORE_STACK, BC::OP_GOTO, BC::OP_LOAD_STACK, BC::OP_RETURN }), 1);
+
+    auto top = counter.get_most_frequent(1);
+    ASSERT_EQ(top.size(), 1);
+    EXPECT_EQ(top[0].count, 2);
+    EXPECT_EQ(top[0].opcodes[0], BC::OP_LOAD_ARG);
+    std::stringstream stream{};
+    counter.print(stream, 1);
+    EXPECT_NE(stream.str().find("LOAD_ARG, LOAD_CONSTANT_U64, SUBTRACT, CALL"), std::string::npos);
+}
+
+TEST_F(OpcodeNGramsTestFixture, TestCommand){
+    static constexpr const char* PATH = "opcode_ngrams_test.nex";
+    {
+        auto bytecode = Ref<NexusBytecode>::make_ref();
+        add_sum_method(bytecode, L"sum");
+        add_fib_method(bytecode, L"fib");
+        auto file = FileAccessServer::open(PATH, FileAccess::ACCESS_WRITE);
+        ASSERT_TRUE(file->is_open());
+        bytecode->serialize(file);
+    }
+    std::stringstream stream{};
+    EXPECT_EQ(OpcodeNGramCounter::run_command({ "nexus", "--opcode-ngrams", "4", "1", PATH }, 2, stream), 0);
+    EXPECT_NE(stream.str().find("2 ("), std::string::npos);
+    EXPECT_NE(stream.str().find("LOAD_ARG, LOAD_CONSTANT_U64, SUBTRACT, CALL"), std::string::npos);
+    std::remove(PATH);
+
+    std::stringstream errors{};
+    EXPECT_EQ(OpcodeNGramCounter::run_command({ "nexus", "--opcode-ngrams", "4", "1", "missing.nex" }, 2, errors), 1);
+    EXPECT_EQ(OpcodeNGramCounter::run_command({ "nexus", "--opcode-ngrams", "4" }, 2, errors), 1);
+}
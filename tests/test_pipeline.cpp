@@ -0,0 +1,77 @@
+//
+// Created by cycastic on 8/15/2023.
+//
+
+#include <gtest/gtest.h>
+#include "../runtime/pipeline.h"
+
+class PipelineTestFixture : public ::testing::Test {
+protected:
+    ThreadPool* thread_pool{};
+public:
+    void SetUp() override {
+        thread_pool = new ThreadPool(4);
+    }
+    void TearDown() override {
+        delete thread_pool;
+    }
+};
+
+TEST_F(PipelineTestFixture, TestOrderedDelivery){
+    static constexpr int64_t item_count = 10'000;
+    int64_t produced = 0;
+    std::atomic<int64_t> in_flight_peak{0};
+    std::atomic<int64_t> in_flight{0};
+    Vector<int64_t> output{};
+    Pipeline<int64_t> pipeline{};
+    pipeline.set_source([&](int64_t& p_item) -> bool {
+                if (produced == item_count) return false;
+                p_item = produced++;
+                auto current = in_flight.fetch_add(1) + 1;
+                auto peak = in_flight_peak.load();
+                while (current > peak && !in_flight_peak.compare_exchange_weak(peak, current)) {}
+                return true;
+            })
+            .add_stage(Pipeline<int64_t>::PARALLEL, [](int64_t& p_item){ p_item *= 2; })
+            .add_stage(Pipeline<int64_t>::SERIAL_OUT_OF_ORDER, [](int64_t& p_item){ p_item += 1; })
+            .add_stage(Pipeline<int64_t>::SERIAL_IN_ORDER, [&](int64_t& p_item){
+                output.push_back(p_item);
+                in_flight.fetch_sub(1);
+            });
+    pipeline.run(thread_pool, 8);
+    ASSERT_EQ(output.size(), item_count);
+    for (int64_t i = 0; i < item_count; i++) EXPECT_EQ(output[i], i * 2 + 1);
+    EXPECT_LE(in_flight_peak.load(), 8);
+
+    // Pipelines can be run again
+    produced = 0;
+    output = Vector<int64_t>();
+    pipeline.run(thread_pool, 1, 2);
+    EXPECT_EQ(output.size(), item_count);
+}
+
+TEST_F(PipelineTestFixture, TestUnorderedDelivery){
+    std::atomic<int64_t> produced{0};
+    std::atomic<int64_t> sum{0};
+    Pipeline<int64_t> pipeline{};
+    pipeline.set_source([&](int64_t& p_item) -> bool {
+                p_item = produced.fetch_add(1) + 1;
+                return p_item <= 1000;
+            })
+            .add_stage(Pipeline<int64_t>::PARALLEL, [&](int64_t& p_item){ sum.fetch_add(p_item); });
+    pipeline.run(thread_pool, 16);
+    EXPECT_EQ(sum.load(), 1000 * 1001 / 2);
+}
+
+TEST_F(PipelineTestFixture, TestStageException){
+    int64_t produced = 0;
+    Pipeline<int64_t> pipeline{};
+    pipeline.set_source([&](int64_t& p_item) -> bool {
+                p_item = produced++;
+                return true;
+            })
+            .add_stage(Pipeline<int64_t>::PARALLEL, [](int64_t& p_item){
+                if (p_item == 100) throw PipelineException("Stage failed");
+            });
+    EXPECT_THROW(pipeline.run(thread_pool, 4), PipelineException);
+}
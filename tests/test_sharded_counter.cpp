@@ -0,0 +1,54 @@
+//
+// Created by cycastic on 8/16/2023.
+//
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "../core/types/sharded_counter.h"
+#include "../core/types/hashset.h"
+
+static constexpr int THREAD_COUNT = 4;
+static constexpr int PER_THREAD = 10'000;
+
+TEST(ShardedCounterTest, TestShardedCounter){
+    ShardedCounter<int64_t> counter{5};
+    EXPECT_EQ(counter.get(), 5);
+    std::vector<std::thread> threads{};
+    for (int i = 0; i < THREAD_COUNT; i++){
+        threads.emplace_back([&counter](){
+            for (int j = 0; j < PER_THREAD; j++) counter.increment();
+            counter.sub(10);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(counter.get(), 5 + THREAD_COUNT * (PER_THREAD - 10));
+    counter.set(0);
+    EXPECT_EQ(counter.get(), 0);
+}
+
+TEST(ShardedCounterTest, TestIDRangeAllocator){
+    IDRangeAllocator<uint64_t> allocator{100};
+    std::vector<uint64_t> ids[THREAD_COUNT];
+    std::vector<std::thread> threads{};
+    for (auto& thread_ids : ids){
+        threads.emplace_back([&allocator, &thread_ids](){
+            for (int j = 0; j < PER_THREAD; j++) thread_ids.push_back(allocator.next());
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    HashSet<uint64_t> seen{};
+    for (auto& thread_ids : ids){
+        for (auto id : thread_ids){
+            EXPECT_GT(id, 100);
+            EXPECT_LE(id, allocator.get_reserved());
+            EXPECT_FALSE(seen.has(id));
+            seen.add(id);
+        }
+    }
+    EXPECT_EQ(seen.size(), THREAD_COUNT * PER_THREAD);
+
+    // Resetting drops the blocks cached by this thread
+    allocator.reset(0);
+    EXPECT_EQ(allocator.next(), 1);
+    EXPECT_EQ(allocator.next(), 2);
+}
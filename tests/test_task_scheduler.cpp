@@ -0,0 +1,173 @@
+//
+// Created by cycastic on 8/12/2023.
+//
+
+#include <gtest/gtest.h>
+#include "../runtime/config.h"
+#include "../runtime/nexus_stack.h"
+#include "../runtime/task.h"
+#include "mock_method_pointer.h"
+#include "../runtime/task_scheduler.h"
+#include "../runtime/system.h"
+#include <future>
+
+class TaskSchedulerTestFixture : public ::testing::Test {
+    static NexusTypeInfoServer* type_info_server;
+public:
+    // Fulfilled once a spinning task runs
+    static std::promise<void> spinner_started;
+    // Group given to the spinner awaited by awaiting_grouped_spinner_callback
+    static Ref<TaskGroup> spinner_group;
+    static std::atomic<uint32_t> resume_count;
+
+    void SetUp() override {
+        spinner_started = std::promise<void>();
+        resume_count = 0;
+        InternedString::configure();
+        initialize_nexus_runtime(false);
+        type_info_server = new NexusTypeInfoServer(true);
+    }
+    void TearDown() override {
+        destroy_nexus_runtime();
+        delete type_info_server;
+        InternedString::cleanup();
+    }
+    static Ref<NexusMethodPointer> make_method(const InternedString& p_name){
+        return Ref<MockMethodPointer>::make_ref(type_info_server, p_name).safe_cast<NexusMethodPointer>();
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> leaf_callback(NexusExecutionState* p_state){
+        auto& frame = p_state->thread_stack->push_stack_frame();
+        frame->push(int64_t(1));
+        frame->push(2.0);
+        p_state->instructions_executed += 2;
+        p_state->thread_stack->pop_stack_frame();
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+    static void resume_callback(Ref<Task> p_task, Ref<Task> p_child) {}
+    static void counting_resume_callback(Ref<Task> p_task, Ref<Task> p_child) { resume_count++; }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> root_callback(NexusExecutionState* p_state){
+        p_state->instructions_executed++;
+        if (p_state->thread_stack->empty()){
+            p_state->thread_stack->push_stack_frame();
+            auto child = Ref<Task>::make_ref(leaf_callback, resume_callback, make_method(L"leaf"));
+            return { Task::AWAIT, child };
+        }
+        p_state->thread_stack->pop_stack_frame();
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> spinning_callback(NexusExecutionState* p_state){
+        spinner_started.set_value();
+        // Safepoint loop, only exits through cancellation
+        while (!p_state->should_unwind()) p_state->instructions_executed++;
+        return { Task::CANCELLED, Ref<Task>::null() };
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> awaiting_spinner_callback(NexusExecutionState* p_state){
+        if (p_state->thread_stack->empty()){
+            p_state->thread_stack->push_stack_frame();
+            return { Task::AWAIT, Ref<Task>::make_ref(spinning_callback, resume_callback, make_method(L"spinner")) };
+        }
+        p_state->thread_stack->pop_stack_frame();
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+    static TupleT2<Task::AsyncCallbackReturn, Ref<Task>> awaiting_grouped_spinner_callback(NexusExecutionState* p_state){
+        if (p_state->thread_stack->empty()){
+            p_state->thread_stack->push_stack_frame();
+            auto child = Ref<Task>::make_ref(spinning_callback, resume_callback, make_method(L"spinner"));
+            child->set_group(spinner_group);
+            return { Task::AWAIT, child };
+        }
+        p_state->thread_stack->pop_stack_frame();
+        return { Task::EXITED_SAFELY, Ref<Task>::null() };
+    }
+};
+
+NexusTypeInfoServer* TaskSchedulerTestFixture::type_info_server = nullptr;
+std::promise<void> TaskSchedulerTestFixture::spinner_started{};
+Ref<TaskGroup> TaskSchedulerTestFixture::spinner_group{};
+std::atomic<uint32_t> TaskSchedulerTestFixture::resume_count{};
+
+TEST_F(TaskSchedulerTestFixture, TestTaskStatistics){
+    auto root = Ref<Task>::make_ref(root_callback, resume_callback, make_method(L"root"));
+    TaskScheduler::queue_task(root);
+    root->wait();
+
+    const auto& root_statistics = root->get_statistics();
+    EXPECT_EQ(root_statistics.awaits_issued, 1);
+    EXPECT_EQ(root_statistics.instructions_executed, 2);
+    EXPECT_EQ(root_statistics.task_count, 1);
+    EXPECT_GE(root_statistics.wall_time_usec, root_statistics.frozen_time_usec);
+
+    auto leaf_statistics = TaskScheduler::get_method_statistics(L"leaf");
+    EXPECT_EQ(leaf_statistics.task_count, 1);
+    EXPECT_EQ(leaf_statistics.awaits_issued, 0);
+    EXPECT_EQ(leaf_statistics.instructions_executed, 2);
+    EXPECT_EQ(leaf_statistics.stack_peak_usage, sizeof(int64_t) + sizeof(double));
+
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"root").task_count, 1);
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"unknown").task_count, 0);
+    EXPECT_EQ(TaskScheduler::get_completed_task_count(), 2);
+    EXPECT_EQ(TaskScheduler::get_instructions_executed(), 4);
+}
+
+TEST_F(TaskSchedulerTestFixture, TestCancelBeforeDispatch){
+    auto group = TaskScheduler::create_group();
+    TaskScheduler::cancel_group(group);
+    auto task = Ref<Task>::make_ref(leaf_callback, resume_callback, make_method(L"leaf"));
+    TaskScheduler::queue_task(task, group);
+    task->wait();
+    EXPECT_TRUE(task->is_cancelled());
+    EXPECT_EQ(task->get_statistics().instructions_executed, 0);
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"leaf").task_count, 0);
+}
+
+TEST_F(TaskSchedulerTestFixture, TestExpiredDeadline){
+    auto group = Ref<TaskGroup>::make_ref(1);
+    EXPECT_TRUE(group->is_cancelled());
+    auto task = Ref<Task>::make_ref(leaf_callback, resume_callback, make_method(L"leaf"));
+    TaskScheduler::queue_task(task, group);
+    task->wait();
+    EXPECT_TRUE(task->is_cancelled());
+}
+
+TEST_F(TaskSchedulerTestFixture, TestCancelRunningGroup){
+    auto group = TaskScheduler::create_group();
+    auto root = Ref<Task>::make_ref(awaiting_spinner_callback, resume_callback, make_method(L"root"));
+    TaskScheduler::queue_task(root, group);
+    // The child is set before it is queued
+    spinner_started.get_future().wait();
+    EXPECT_EQ(root->get_child_task()->get_group().ptr(), group.ptr());
+    TaskScheduler::cancel_group(group);
+    root->wait();
+    EXPECT_TRUE(root->get_child_task()->is_cancelled());
+    // The parent is dropped when resumed, never reaching EXITED_SAFELY
+    EXPECT_TRUE(root->is_cancelled());
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"root").task_count, 0);
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"spinner").task_count, 0);
+}
+
+TEST_F(TaskSchedulerTestFixture, TestCancelChildGroup){
+    auto parent_group = TaskScheduler::create_group();
+    spinner_group = TaskScheduler::create_group();
+    auto root = Ref<Task>::make_ref(awaiting_grouped_spinner_callback, counting_resume_callback, make_method(L"root"));
+    TaskScheduler::queue_task(root, parent_group);
+    spinner_started.get_future().wait();
+    EXPECT_EQ(root->get_child_task()->get_group().ptr(), spinner_group.ptr());
+    TaskScheduler::cancel_group(spinner_group);
+    root->wait();
+    EXPECT_TRUE(root->get_child_task()->is_cancelled());
+    // The parent's group is alive, but the parent is cancelled without resuming on a child that never returned
+    EXPECT_FALSE(parent_group->is_cancelled());
+    EXPECT_TRUE(root->is_cancelled());
+    EXPECT_EQ(resume_count.load(), 0);
+    EXPECT_EQ(TaskScheduler::get_method_statistics(L"root").task_count, 0);
+    spinner_group = Ref<TaskGroup>::null();
+}
+
+TEST_F(TaskSchedulerTestFixture, TestGroupDeadline){
+    auto group = TaskScheduler::create_group(1000);
+    auto task = Ref<Task>::make_ref(spinning_callback, resume_callback, make_method(L"spinner"));
+    TaskScheduler::queue_task(task, group);
+    task->wait();
+    EXPECT_TRUE(task->is_cancelled());
+    EXPECT_GE(System::get_singleton()->get_ticks_usec(), group->get_deadline());
+}
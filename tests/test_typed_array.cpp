@@ -0,0 +1,148 @@
+//
+// Created by cycastic on 8/19/2023.
+//
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include "../runtime/typed_array.h"
+
+// Odd sizes leave a scalar tail at every pack width
+static constexpr size_t SIZES[] = { 0, 1, 7, 67, 1000 };
+
+class TypedArrayTest : public ::testing::Test {
+public:
+    NexusSimd::Level original_level{};
+
+    void SetUp() override { original_level = NexusSimd::get_level(); }
+    void TearDown() override { NexusSimd::set_level(original_level); }
+
+    static Ref<NexusTypedArray> make(const NexusStandardType& p_type, const size_t& p_size, const int64_t& p_seed){
+        auto re = Ref<NexusTypedArray>::make_ref(p_type, p_size);
+        // Small, nonzero and of both signs, so every operation stays exact
+        for (size_t i = 0; i < p_size; i++) {
+            auto value = int64_t((i * 7 + p_seed) % 19) - 9;
+            re->set(i, value ? value : 10);
+        }
+        return re;
+    }
+    template <class T>
+    static T expected_binary(const NexusSimd::BinaryOp& p_op, const T& p_lhs, const T& p_rhs){
+        switch (p_op) {
+            case NexusSimd::BINARY_ADD: return p_lhs + p_rhs;
+            case NexusSimd::BINARY_SUBTRACT: return p_lhs - p_rhs;
+            case NexusSimd::BINARY_MULTIPLY: return p_lhs * p_rhs;
+            default: return p_lhs / p_rhs;
+        }
+    }
+    template <class T>
+    static T expected_compare(const NexusSimd::CompareOp& p_op, const T& p_lhs, const T& p_rhs){
+        switch (p_op) {
+            case NexusSimd::COMPARE_EQUAL: return p_lhs == p_rhs;
+            case NexusSimd::COMPARE_NOT_EQUAL: return p_lhs != p_rhs;
+            case NexusSimd::COMPARE_LESSER: return p_lhs < p_rhs;
+            case NexusSimd::COMPARE_LESSER_OR_EQUAL: return p_lhs <= p_rhs;
+            case NexusSimd::COMPARE_GREATER: return p_lhs > p_rhs;
+            default: return p_lhs >= p_rhs;
+        }
+    }
+    // Every kernel against a scalar loop over T, at the current level
+    template <class T>
+    static void check_kernels(const NexusStandardType& p_type){
+        for (auto size : SIZES){
+            auto lhs = make(p_type, size, 3);
+            auto rhs = make(p_type, size, 11);
+            auto dst = Ref<NexusTypedArray>::make_ref(p_type, size);
+            for (uint8_t op = 0; op < NexusSimd::BINARY_MAX; op++){
+                dst->apply(NexusSimd::BinaryOp(op), *lhs.ptr(), *rhs.ptr());
+                for (size_t i = 0; i < size; i++)
+                    ASSERT_EQ(dst->get<T>(i), expected_binary(NexusSimd::BinaryOp(op), lhs->get<T>(i), rhs->get<T>(i)));
+                dst->apply(NexusSimd::BinaryOp(op), *lhs.ptr(), -3);
+                for (size_t i = 0; i < size; i++)
+                    ASSERT_EQ(dst->get<T>(i), expected_binary(NexusSimd::BinaryOp(op), lhs->get<T>(i), T(-3)));
+            }
+            for (uint8_t op = 0; op < NexusSimd::COMPARE_MAX; op++){
+                dst->compare(NexusSimd::CompareOp(op), *lhs.ptr(), *rhs.ptr());
+                for (size_t i = 0; i < size; i++)
+                    ASSERT_EQ(dst->get<T>(i), expected_compare(NexusSimd::CompareOp(op), lhs->get<T>(i), rhs->get<T>(i)));
+            }
+            T sum{}, min{}, max{};
+            for (size_t i = 0; i < size; i++){
+                auto value = lhs->get<T>(i);
+                sum += value;
+                min = i && min < value ? min : value;
+                max = i && max > value ? max : value;
+            }
+            EXPECT_EQ(lhs->reduce<T>(NexusSimd::REDUCE_SUM), sum);
+            if (size){
+                EXPECT_EQ(lhs->reduce<T>(NexusSimd::REDUCE_MIN), min);
+                EXPECT_EQ(lhs->reduce<T>(NexusSimd::REDUCE_MAX), max);
+            }
+            dst->fill(5);
+            for (size_t i = 0; i < size; i++) ASSERT_EQ(dst->get<T>(i), T(5));
+            // The destination may be an operand
+            dst->apply(NexusSimd::BINARY_MULTIPLY, *dst.ptr(), *dst.ptr());
+            EXPECT_EQ(dst->reduce<T>(NexusSimd::REDUCE_SUM), T(25 * size));
+        }
+    }
+};
+
+TEST_F(TypedArrayTest, TestKernels){
+    for (uint8_t level = NexusSimd::LEVEL_SCALAR; level <= NexusSimd::get_supported_level(); level++){
+        NexusSimd::set_level(NexusSimd::Level(level));
+        ASSERT_EQ(NexusSimd::get_level(), level);
+        check_kernels<int32_t>(SIGNED_32_BIT_INTEGER);
+        check_kernels<int64_t>(SIGNED_64_BIT_INTEGER);
+        check_kernels<float>(SINGLE_PRECISION_FLOATING_POINT);
+        check_kernels<double>(DOUBLE_PRECISION_FLOATING_POINT);
+    }
+    // Never above what the machine supports
+    NexusSimd::set_level(NexusSimd::LEVEL_AVX512);
+    EXPECT_EQ(NexusSimd::get_level(), NexusSimd::get_supported_level());
+}
+
+TEST_F(TypedArrayTest, TestDivisionOverflow){
+    for (uint8_t level = NexusSimd::LEVEL_SCALAR; level <= NexusSimd::get_supported_level(); level++){
+        NexusSimd::set_level(NexusSimd::Level(level));
+        // MIN / -1 wraps to MIN, as in NexusInterpreter, in packed lanes and in the scalar tail
+        for (auto type : { SIGNED_32_BIT_INTEGER, SIGNED_64_BIT_INTEGER }) {
+            const auto min = type == SIGNED_32_BIT_INTEGER ? int64_t(std::numeric_limits<int32_t>::min()) : std::numeric_limits<int64_t>::min();
+            auto dividends = make(type, 67, 3);
+            auto divisors = make(type, 67, 11);
+            for (size_t i : { size_t(5), size_t(66) }) {
+                dividends->set(i, min);
+                divisors->set(i, -1);
+            }
+            divisors->set(6, -1);
+            auto quotients = Ref<NexusTypedArray>::make_ref(type, 67);
+            quotients->apply(NexusSimd::BINARY_DIVIDE, *dividends.ptr(), *divisors.ptr());
+            EXPECT_EQ(quotients->get<int64_t>(5), min);
+            EXPECT_EQ(quotients->get<int64_t>(66), min);
+            EXPECT_EQ(quotients->get<int64_t>(6), -dividends->get<int64_t>(6));
+            EXPECT_EQ(quotients->get<int64_t>(7), dividends->get<int64_t>(7) / divisors->get<int64_t>(7));
+            quotients->apply(NexusSimd::BINARY_DIVIDE, *dividends.ptr(), -1);
+            EXPECT_EQ(quotients->get<int64_t>(66), min);
+            EXPECT_EQ(quotients->get<int64_t>(0), -dividends->get<int64_t>(0));
+        }
+    }
+}
+
+TEST_F(TypedArrayTest, TestErrors){
+    EXPECT_THROW(Ref<NexusTypedArray>::make_ref(STRING, 4), TypedArrayException);
+    auto integers = make(SIGNED_32_BIT_INTEGER, 16, 0);
+    auto longer = make(SIGNED_32_BIT_INTEGER, 17, 0);
+    auto floats = make(SINGLE_PRECISION_FLOATING_POINT, 16, 0);
+    EXPECT_THROW(integers->apply(NexusSimd::BINARY_ADD, *integers.ptr(), *longer.ptr()), TypedArrayException);
+    EXPECT_THROW(integers->compare(NexusSimd::COMPARE_EQUAL, *floats.ptr(), *integers.ptr()), TypedArrayException);
+    EXPECT_THROW((void)integers->get<int32_t>(16), TypedArrayException);
+    EXPECT_THROW((void)Ref<NexusTypedArray>::make_ref(DOUBLE_PRECISION_FLOATING_POINT, 0)->reduce<double>(NexusSimd::REDUCE_MIN), TypedArrayException);
+    // Integer division checks every divisor first and leaves the destination alone
+    auto zeroes = Ref<NexusTypedArray>::make_ref(SIGNED_32_BIT_INTEGER, 16);
+    EXPECT_THROW(integers->apply(NexusSimd::BINARY_DIVIDE, *integers.ptr(), *zeroes.ptr()), TypedArrayException);
+    EXPECT_THROW(integers->apply(NexusSimd::BINARY_DIVIDE, *integers.ptr(), 0), TypedArrayException);
+    EXPECT_EQ(integers->get<int32_t>(1), make(SIGNED_32_BIT_INTEGER, 16, 0)->get<int32_t>(1));
+    // Floating points divide by zero as IEEE 754 does
+    floats->apply(NexusSimd::BINARY_DIVIDE, *floats.ptr(), 0.0);
+    EXPECT_TRUE(std::isinf(floats->get<float>(0)));
+    EXPECT_EQ(NexusTypedArray::cast(integers.safe_cast<ManagedObject>()), integers.ptr());
+}